@@ -0,0 +1,23 @@
+# add_funcfile_kernel(<target> <Funcfile> <function name>)
+#
+# Generates C++ source computing function from Funcfile together with its
+# derivatives and builds it as library <target>. Header <function name>.h
+# is available to targets linking <target>.
+function(add_funcfile_kernel TARGET FUNCFILE NAME)
+    get_filename_component(FUNCFILE ${FUNCFILE} ABSOLUTE)
+    set(OUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/${TARGET})
+
+    add_custom_command(
+        OUTPUT ${OUT_DIR}/${NAME}.cpp ${OUT_DIR}/${NAME}.h
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${OUT_DIR}
+        COMMAND funcgen ${FUNCFILE} ${OUT_DIR} ${NAME}
+        DEPENDS funcgen ${FUNCFILE}
+        COMMENT "Generating ${NAME} from ${FUNCFILE}")
+
+    add_library(${TARGET} ${OUT_DIR}/${NAME}.cpp)
+
+    # Generated code is meant to be fast, not debugged
+    target_compile_options(${TARGET} PRIVATE -O3)
+
+    target_include_directories(${TARGET} PUBLIC ${OUT_DIR})
+endfunction()
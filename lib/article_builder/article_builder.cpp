@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -5,17 +6,27 @@
 
 #include "article_builder.h"
 
-static inline int rand_init(void) { srand(time(NULL)); return 1; }
+/* Fragments only mark places of phrases, which are chosen when fragment is
+   joined, so that choice does not depend on order of building fragments */
+static const char STARTER_MARK     = '\x01';
+static const char TRANSITION_MARK  = '\x02';
+static const char PLACEHOLDER_MARK = '\x03';
 
-static int rand_initialized_ = rand_init();
+/* Every article has its own generator state, so that articles can be built
+   concurrently */
+static inline size_t my_rand(unsigned int* seed)
+{
+    return ((size_t)rand_r(seed) << 16) + (size_t)rand_r(seed);
+}
 
-static inline size_t my_rand(void) {return ((size_t)rand() << 16) + (size_t)rand(); }
+static const char* find_mark(const char* text, const char* end);
+static void join_text(article_builder* article, const char* text, const char* end);
 
 void article_ctor(article_builder *article)
 {
     LOG_ASSERT(article, return);
 
-    *article = {.state = ARTC_NEW};
+    *article = {.state = ARTC_NEW, .seed = (unsigned int) time(NULL)};
     string_builder_ctor(&article->text, "\\documentclass{article}\n");
 }
 
@@ -53,6 +64,13 @@ void article_use_preamble(article_builder *article, const char *filename)
     article->preamble = filename;
 }
 
+void article_set_seed(article_builder *article, unsigned int seed)
+{
+    LOG_ASSERT(article, return);
+
+    article->seed = seed;
+}
+
 void article_dtor(article_builder *article)
 {
     LOG_ASSERT(article, return);
@@ -65,6 +83,44 @@ void article_dtor(article_builder *article)
     *article = {.state = ARTC_DELETED};
 }
 
+void article_fork(article_builder *article, article_builder *fragment)
+{
+    LOG_ASSERT(article, return);
+    LOG_ASSERT(fragment, return);
+    LOG_ASSERT(article->state == ARTC_STARTED || article->state == ARTC_FRAGMENT, return);
+
+    *fragment = {.state = ARTC_FRAGMENT};
+    string_builder_ctor(&fragment->text);
+}
+
+void article_join(article_builder *article, article_builder *fragment)
+{
+    LOG_ASSERT(article, return);
+    LOG_ASSERT(fragment, return);
+    LOG_ASSERT(article->state == ARTC_STARTED || article->state == ARTC_FRAGMENT, return);
+    LOG_ASSERT(fragment->state == ARTC_FRAGMENT, return);
+
+    /* Chunks without phrase marks are moved to article as they are */
+    string_chunk* chunk = string_builder_release(&fragment->text);
+    while (chunk)
+    {
+        string_chunk* next = chunk->next;
+        const char* end = chunk->data + chunk->size;
+
+        if (find_mark(chunk->data, end) == end)
+            string_builder_append_chunk(&article->text, chunk);
+        else
+        {
+            join_text(article, chunk->data, end);
+            free(chunk);
+        }
+
+        chunk = next;
+    }
+
+    article_dtor(fragment);
+}
+
 void article_add_title(article_builder *article, const char *title, const char* author)
 {
     LOG_ASSERT(article, return);
@@ -123,7 +179,13 @@ void article_add_section(article_builder *article, const char *title)
 void article_add_starter(article_builder *article)
 {
     LOG_ASSERT(article, return);
-    LOG_ASSERT(article->state == ARTC_STARTED, return);
+    LOG_ASSERT(article->state == ARTC_STARTED || article->state == ARTC_FRAGMENT, return);
+
+    if (article->state == ARTC_FRAGMENT)
+    {
+        string_builder_append(&article->text, STARTER_MARK);
+        return;
+    }
 
     if (article->starters.text == NULL)
     {
@@ -132,13 +194,19 @@ void article_add_starter(article_builder *article)
     }
 
     string_builder_append_format(&article->text, "\n%s\n",
-                article->starters.lines[my_rand() % article->starters.line_count].line);
+                article->starters.lines[my_rand(&article->seed) % article->starters.line_count].line);
 }
 
 void article_add_transition(article_builder *article)
 {
     LOG_ASSERT(article, return);
-    LOG_ASSERT(article->state == ARTC_STARTED, return);
+    LOG_ASSERT(article->state == ARTC_STARTED || article->state == ARTC_FRAGMENT, return);
+
+    if (article->state == ARTC_FRAGMENT)
+    {
+        string_builder_append(&article->text, TRANSITION_MARK);
+        return;
+    }
 
     if (article->transitions.text == NULL)
     {
@@ -147,13 +215,19 @@ void article_add_transition(article_builder *article)
     }
 
     string_builder_append_format(&article->text, "%s ",
-                article->transitions.lines[my_rand() % article->transitions.line_count].line);
+                article->transitions.lines[my_rand(&article->seed) % article->transitions.line_count].line);
 }
 
 void article_add_placeholder(article_builder *article)
 {
     LOG_ASSERT(article, return);
-    LOG_ASSERT(article->state == ARTC_STARTED, return);
+    LOG_ASSERT(article->state == ARTC_STARTED || article->state == ARTC_FRAGMENT, return);
+
+    if (article->state == ARTC_FRAGMENT)
+    {
+        string_builder_append(&article->text, PLACEHOLDER_MARK);
+        return;
+    }
 
     if (article->placeholders.text == NULL)
     {
@@ -162,25 +236,71 @@ void article_add_placeholder(article_builder *article)
     }
 
     string_builder_append_format(&article->text, "%s\n",
-                article->placeholders.lines[my_rand() % article->placeholders.line_count].line);
+                article->placeholders.lines[my_rand(&article->seed) % article->placeholders.line_count].line);
 }
 
-void article_build(article_builder *article, const char *output_dir)
+void article_write(article_builder *article, const char *output_dir)
 {
     LOG_ASSERT(article, return);
     LOG_ASSERT(output_dir, return);
     LOG_ASSERT(article->state == ARTC_ENDED, return);
 
-    FILE* output = fopen("article.tex", "w+");
+    /* Article is written directly to output directory, as working directory
+       is shared with articles built concurrently */
+    char* filename = NULL;
+    LOG_ASSERT(asprintf(&filename, "%s/article.tex", output_dir) > 0, return);
+
+    FILE* output = fopen(filename, "w+");
+    free(filename);
+    LOG_ASSERT_ERROR(output != NULL, return,
+        "Could not create article in '%s'", output_dir);
     string_builder_print(&article->text, output);
     fclose(output);
 
+    if (!article->preamble) return;
+
     FILE* shell = popen("sh", "w");
+    fprintf(shell, "cp -T %s %s/preamble.sty\n", article->preamble, output_dir);
+    pclose(shell);
+}
 
-    if (article->preamble)
-        fprintf(shell, "cp -T %s %s/preamble.sty\n", article->preamble, output_dir);
-    fprintf(shell, "mv article.tex %s\n", output_dir);
-    fprintf(shell, "cd %s && pdflatex -shell-escape article.tex", output_dir);
+void article_build(article_builder *article, const char *output_dir)
+{
+    LOG_ASSERT(article, return);
+    LOG_ASSERT(output_dir, return);
+
+    article_write(article, output_dir);
 
+    FILE* shell = popen("sh", "w");
+    fprintf(shell, "cd %s && pdflatex -shell-escape article.tex", output_dir);
     pclose(shell);
 }
+
+static const char* find_mark(const char* text, const char* end)
+{
+    while (text < end && (*text < STARTER_MARK || *text > PLACEHOLDER_MARK))
+        text++;
+    return text;
+}
+
+static void join_text(article_builder* article, const char* text, const char* end)
+{
+    while (text < end)
+    {
+        const char* mark = find_mark(text, end);
+
+        if (mark > text)
+            string_builder_append_n(&article->text, text, (size_t) (mark - text));
+        if (mark == end) break;
+
+        switch (*mark)
+        {
+        case STARTER_MARK:     article_add_starter    (article); break;
+        case TRANSITION_MARK:  article_add_transition (article); break;
+        case PLACEHOLDER_MARK: article_add_placeholder(article); break;
+        default:
+            LOG_ASSERT(0 && "Invalid phrase mark.", return);
+        }
+        text = mark + 1;
+    }
+}
@@ -10,6 +10,7 @@ enum article_state
     ARTC_TITLE,
     ARTC_STARTED,
     ARTC_ENDED,
+    ARTC_FRAGMENT,
     ARTC_DELETED
 };
 
@@ -21,6 +22,7 @@ struct article_builder
     TextLines placeholders;
     string_builder text;
     const char* preamble;
+    unsigned int seed;
 };
 
 void article_ctor(article_builder* article);
@@ -28,7 +30,10 @@ void article_use_starters(article_builder* article, const char* filename);
 void article_use_transitions(article_builder* article, const char* filename);
 void article_use_placeholders(article_builder* article, const char* filename);
 void article_use_preamble(article_builder* article, const char* filename);
+void article_set_seed(article_builder* article, unsigned int seed);
 void article_dtor(article_builder* article);
+void article_fork(article_builder* article, article_builder* fragment);
+void article_join(article_builder* article, article_builder* fragment);
 void article_add_title(article_builder* article, const char* title, const char* author);
 void article_start(article_builder* article);
 void article_end(article_builder* article);
@@ -37,6 +42,7 @@ void article_add_section(article_builder* article, const char* title);
 void article_add_starter(article_builder* article);
 void article_add_transition(article_builder* article);
 void article_add_placeholder(article_builder* article);
+void article_write(article_builder* article, const char* output_dir);
 void article_build(article_builder* article, const char* output_dir);
 
 #endif
\ No newline at end of file
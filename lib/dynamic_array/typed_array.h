@@ -0,0 +1,414 @@
+/**
+ * @file typed_array.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Dynamic array template
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Unlike arrays from "dynamic_array.h", element type needs no
+ * `copy_element()` and `delete_element()`: elements are copied, moved and
+ * destroyed by their own constructors and destructors, so move-only types
+ * may be stored too. Array is usable through the same `array_*` functions:
+ *
+ *     typedef typed_array<token, 16> dynamic_array(token);
+ *
+ *     dynamic_array(token) tokens = {};
+ *     array_reserve(&tokens, 64);
+ *     array_push(&tokens, tok);
+ *
+ * First `InlineCount` elements are stored inside array itself, so short
+ * arrays do not allocate memory at all.
+ */
+
+#ifndef TYPED_ARRAY_H
+#define TYPED_ARRAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <concepts>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "logger.h"
+
+#include "_array_macros.h"
+
+/**
+ * @brief Default array allocator
+ */
+struct heap_allocator
+{
+    void* allocate(size_t bytes) { return malloc(bytes); }
+    void* reallocate(void* ptr, size_t bytes) { return realloc(ptr, bytes); }
+    void  deallocate(void* ptr) { free(ptr); }
+};
+
+/**
+ * @brief Allocator, used by array for its heap buffer. Memory must be
+ * suitably aligned for any element type, as with `malloc()`
+ */
+template <class A>
+concept array_allocator = requires(A alloc, void* ptr, size_t bytes)
+{
+    { alloc.allocate(bytes) } -> std::same_as<void*>;
+    { alloc.reallocate(ptr, bytes) } -> std::same_as<void*>;
+    alloc.deallocate(ptr);
+};
+
+/**
+ * @brief Double capacity on growth. Default policy
+ */
+struct grow_double
+{
+    static size_t next_capacity(size_t capacity) { return capacity ? 2 * capacity : 16; }
+};
+
+/**
+ * @brief Increase capacity by half on growth. Wastes less memory than
+ * `grow_double` at the cost of more reallocations
+ */
+struct grow_half
+{
+    static size_t next_capacity(size_t capacity) { return capacity ? capacity + (capacity + 1) / 2 : 16; }
+};
+
+/**
+ * @brief Capacity growth policy
+ */
+template <class G>
+concept growth_policy = requires(size_t capacity)
+{
+    { G::next_capacity(capacity) } -> std::same_as<size_t>;
+};
+
+/**
+ * @brief Storage for elements inside array
+ */
+template <class T, size_t Count>
+struct inline_storage
+{
+    alignas(T) unsigned char bytes[Count * sizeof(T)];
+
+    T* get() { return reinterpret_cast<T*>(bytes); }
+    const T* get() const { return reinterpret_cast<const T*>(bytes); }
+};
+
+template <class T>
+struct inline_storage<T, 0>
+{
+    T* get() { return NULL; }
+    const T* get() const { return NULL; }
+};
+
+/**
+ * @brief Dynamic array of `T`
+ *
+ * @tparam T Element type
+ * @tparam InlineCount Number of elements, stored without allocation
+ * @tparam Growth Capacity growth policy
+ * @tparam Allocator Heap allocator
+ */
+template <class T, size_t InlineCount = 0,
+          growth_policy Growth = grow_double, array_allocator Allocator = heap_allocator>
+struct typed_array
+{
+    T* data;
+    size_t capacity;
+    size_t size;
+
+    [[no_unique_address]] Allocator allocator;
+    [[no_unique_address]] inline_storage<T, InlineCount> storage;
+
+    typed_array():
+        data(NULL), capacity(InlineCount), size(0), allocator(), storage()
+    {
+        data = storage.get();
+    }
+
+    typed_array(const typed_array& other);
+    typed_array(typed_array&& other) noexcept;
+
+    typed_array& operator=(const typed_array& other);
+    typed_array& operator=(typed_array&& other) noexcept;
+
+    ~typed_array();
+
+    /**
+     * @brief Check whether elements are stored inside array
+     */
+    bool is_inline() const { return data == storage.get(); }
+};
+
+#define TYPED_ARRAY_TEMPLATE \
+    template <class T, size_t InlineCount, growth_policy Growth, array_allocator Allocator>
+
+#define TYPED_ARRAY typed_array<T, InlineCount, Growth, Allocator>
+
+/**
+ * @brief Construct empty array in uninitialized memory
+ *
+ * @param[out] array Constructed array
+ */
+TYPED_ARRAY_TEMPLATE
+void array_ctor(TYPED_ARRAY* array)
+{
+    LOG_ASSERT(array != NULL, return);
+
+    new (array) TYPED_ARRAY();
+}
+
+/**
+ * @brief Destroy all elements and free array memory. Array is left
+ * empty and may be used again
+ *
+ * @param[inout] array Destroyed array
+ */
+TYPED_ARRAY_TEMPLATE
+void array_dtor(TYPED_ARRAY* array)
+{
+    LOG_ASSERT(array != NULL, return);
+
+    for (size_t i = 0; i < array->size; i++)
+        array->data[i].~T();
+
+    if (!array->is_inline())
+        array->allocator.deallocate(array->data);
+
+    array->data     = array->storage.get();
+    array->capacity = InlineCount;
+    array->size     = 0;
+}
+
+/**
+ * @brief Ensure that array can hold `capacity` elements without
+ * reallocation
+ *
+ * @param[inout] array Array
+ * @param[in] capacity Required capacity
+ * @return 0 upon success, -1 otherwise
+ */
+TYPED_ARRAY_TEMPLATE
+int array_reserve(TYPED_ARRAY* array, size_t capacity)
+{
+    LOG_ASSERT(array != NULL, return -1);
+
+    if (capacity <= array->capacity)
+        return 0;
+
+    LOG_ASSERT_ERROR(capacity <= SIZE_MAX / sizeof(T), return -1,
+        "Array is too large", NULL);
+
+    T* data = NULL;
+    if (std::is_trivially_copyable_v<T> && !array->is_inline())
+        data = (T*) array->allocator.reallocate(array->data, capacity * sizeof(T));
+    else
+    {
+        data = (T*) array->allocator.allocate(capacity * sizeof(T));
+        for (size_t i = 0; data && i < array->size; i++)
+        {
+            new (&data[i]) T(std::move(array->data[i]));
+            array->data[i].~T();
+        }
+        if (data && !array->is_inline())
+            array->allocator.deallocate(array->data);
+    }
+
+    LOG_ASSERT_ERROR(data != NULL, return -1, "Failed to allocate memory", NULL);
+
+    array->data     = data;
+    array->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Construct new element at the end of array
+ *
+ * @param[inout] array Array
+ * @param[in] args Element constructor arguments
+ * @return Constructed element, `NULL` upon failure
+ */
+template <class T, size_t InlineCount, growth_policy Growth, array_allocator Allocator,
+          class... Args>
+T* array_emplace(TYPED_ARRAY* array, Args&&... args)
+{
+    LOG_ASSERT(array != NULL, return NULL);
+
+    if (array->size < array->capacity)
+        return new (&array->data[array->size++]) T(std::forward<Args>(args)...);
+
+    /* Arguments may refer to array elements, so they are used before reallocation */
+    T element(std::forward<Args>(args)...);
+    if (array_reserve(array, Growth::next_capacity(array->capacity)) != 0)
+        return NULL;
+
+    return new (&array->data[array->size++]) T(std::move(element));
+}
+
+/**
+ * @brief Copy element to the end of array
+ *
+ * @param[inout] array Array
+ * @param[in] element Added element
+ * @return 0 upon success, -1 otherwise
+ */
+TYPED_ARRAY_TEMPLATE
+int array_push(TYPED_ARRAY* array, const T& element)
+{
+    return array_emplace(array, element) ? 0 : -1;
+}
+
+/**
+ * @brief Move element to the end of array
+ *
+ * @param[inout] array Array
+ * @param[in] element Added element
+ * @return 0 upon success, -1 otherwise
+ */
+TYPED_ARRAY_TEMPLATE
+int array_push(TYPED_ARRAY* array, T&& element)
+{
+    return array_emplace(array, std::move(element)) ? 0 : -1;
+}
+
+/**
+ * @brief Destroy last element. Memory is kept for further pushes
+ *
+ * @param[inout] array Array
+ */
+TYPED_ARRAY_TEMPLATE
+void array_pop(TYPED_ARRAY* array)
+{
+    LOG_ASSERT(array != NULL, return);
+    LOG_ASSERT(array->size > 0, return);
+
+    array->size--;
+    array->data[array->size].~T();
+}
+
+/**
+ * @brief Destroy all elements. Memory is kept for further pushes
+ *
+ * @param[inout] array Array
+ */
+TYPED_ARRAY_TEMPLATE
+void array_clear(TYPED_ARRAY* array)
+{
+    LOG_ASSERT(array != NULL, return);
+
+    for (size_t i = 0; i < array->size; i++)
+        array->data[i].~T();
+    array->size = 0;
+}
+
+/**
+ * @brief Construct copy of array in uninitialized memory
+ *
+ * @param[out] dest Constructed array
+ * @param[in] src Copied array
+ */
+TYPED_ARRAY_TEMPLATE
+void array_copy(TYPED_ARRAY* dest, const TYPED_ARRAY* src)
+{
+    LOG_ASSERT(dest != NULL, return);
+    LOG_ASSERT(src  != NULL, return);
+
+    new (dest) TYPED_ARRAY(*src);
+}
+
+/**
+ * @brief Get array element
+ *
+ * @param[in] array Array
+ * @param[in] index Element index
+ * @return Element, `NULL` if index is out of bounds
+ */
+TYPED_ARRAY_TEMPLATE
+T* array_get_element(const TYPED_ARRAY* array, size_t index)
+{
+    LOG_ASSERT(array != NULL, return NULL);
+    LOG_ASSERT(index < array->size, return NULL);
+
+    return &array->data[index];
+}
+
+TYPED_ARRAY_TEMPLATE
+TYPED_ARRAY::typed_array(const typed_array& other):
+    typed_array()
+{
+    allocator = other.allocator;
+    if (array_reserve(this, other.size) != 0)
+        return;
+
+    for (size_t i = 0; i < other.size; i++)
+        new (&data[i]) T(other.data[i]);
+    size = other.size;
+}
+
+TYPED_ARRAY_TEMPLATE
+TYPED_ARRAY::typed_array(typed_array&& other) noexcept:
+    typed_array()
+{
+    *this = std::move(other);
+}
+
+TYPED_ARRAY_TEMPLATE
+TYPED_ARRAY& TYPED_ARRAY::operator=(const typed_array& other)
+{
+    if (this == &other)
+        return *this;
+
+    array_clear(this);
+    if (array_reserve(this, other.size) != 0)
+        return *this;
+
+    for (size_t i = 0; i < other.size; i++)
+        new (&data[i]) T(other.data[i]);
+    size = other.size;
+
+    return *this;
+}
+
+TYPED_ARRAY_TEMPLATE
+TYPED_ARRAY& TYPED_ARRAY::operator=(typed_array&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    array_dtor(this);
+    allocator = std::move(other.allocator);
+    if (!other.is_inline())
+    {
+        /* Heap buffer is taken over */
+        data     = other.data;
+        capacity = other.capacity;
+        size     = other.size;
+
+        other.data     = other.storage.get();
+        other.capacity = InlineCount;
+        other.size     = 0;
+        return *this;
+    }
+
+    for (size_t i = 0; i < other.size; i++)
+        new (&data[i]) T(std::move(other.data[i]));
+    size = other.size;
+
+    array_clear(&other);
+    return *this;
+}
+
+TYPED_ARRAY_TEMPLATE
+TYPED_ARRAY::~typed_array()
+{
+    array_dtor(this);
+}
+
+#undef TYPED_ARRAY
+#undef TYPED_ARRAY_TEMPLATE
+
+#endif
@@ -0,0 +1,241 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+#include "autodiff.h"
+#include "bytecode.h"
+
+#define ARRAY_ELEMENT ad_entry
+#include "dynamic_array_impl.h"
+
+struct record_state
+{
+    autodiff_tape* tape;
+    const dynamic_array(var_name)* variables;
+};
+
+static int record_subtree(record_state* state, const ast_node* node, size_t* index);
+static size_t push_entry(autodiff_tape* tape, ad_entry entry);
+static void propagate(autodiff_tape* tape, size_t index);
+static double unary_partial(op_type op, double arg);
+
+int autodiff_ctor(autodiff_tape* tape, const abstract_syntax_tree* ast)
+{
+    LOG_ASSERT(tape != NULL, return -1);
+    LOG_ASSERT(ast != NULL, return -1);
+
+    *tape = {
+        .entries = {},
+        .var_count = ast->variables.size,
+        .output = 0,
+        .values = NULL,
+        .adjoints = NULL
+    };
+    array_ctor(&tape->entries);
+
+    for (size_t i = 0; i < tape->var_count; i++)
+        push_entry(tape, {.type = NODE_VAR, .value = {}, .left = 0, .right = 0});
+
+    record_state state = {
+        .tape = tape,
+        .variables = &ast->variables
+    };
+
+    if (record_subtree(&state, ast->root, &tape->output) != 0)
+    {
+        autodiff_dtor(tape);
+        return -1;
+    }
+
+    tape->values   = (double*) calloc(tape->entries.size, sizeof(*tape->values));
+    tape->adjoints = (double*) calloc(tape->entries.size, sizeof(*tape->adjoints));
+
+    LOG_ASSERT_ERROR(tape->values != NULL && tape->adjoints != NULL,
+        { autodiff_dtor(tape); return -1; },
+        "Failed to allocate tape", NULL);
+
+    return 0;
+}
+
+void autodiff_dtor(autodiff_tape* tape)
+{
+    LOG_ASSERT(tape != NULL, return);
+
+    array_dtor(&tape->entries);
+    free(tape->values);
+    free(tape->adjoints);
+    *tape = {};
+}
+
+double autodiff_gradient(autodiff_tape* tape, const double* vars, double* gradient)
+{
+    LOG_ASSERT(tape != NULL, return NAN);
+
+    const ad_entry* entries = tape->entries.data;
+    size_t size = tape->entries.size;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (i < tape->var_count)
+            tape->values[i] = vars[i];
+        else if (entries[i].type == NODE_NUM)
+            tape->values[i] = entries[i].value.num;
+        else
+            tape->values[i] = apply_op(entries[i].value.op,
+                                       tape->values[entries[i].left],
+                                       tape->values[entries[i].right]);
+
+        tape->adjoints[i] = 0;
+    }
+
+    tape->adjoints[tape->output] = 1;
+    for (size_t i = size; i > tape->var_count; i--)
+        propagate(tape, i - 1);
+
+    for (size_t i = 0; i < tape->var_count; i++)
+        gradient[i] = tape->adjoints[i];
+
+    return tape->values[tape->output];
+}
+
+static int record_subtree(record_state* state, const ast_node* node, size_t* index)
+{
+    autodiff_tape* tape = state->tape;
+
+    if (is_num(node))
+    {
+        *index = push_entry(tape, {.type = NODE_NUM, .value = node->value, .left = 0, .right = 0});
+        return 0;
+    }
+
+    if (is_var(node))
+    {
+        LOG_ASSERT_ERROR(
+            array_try_find_symbol(state->variables, get_var(node), index),
+            return -1,
+            "Variable '%s' was not defined", symbol_name(get_var(node)));
+        return 0;
+    }
+
+    ad_entry entry = {.type = NODE_OP, .value = node->value, .left = 0, .right = 0};
+
+    if (node->left && record_subtree(state, node->left, &entry.left) != 0)
+        return -1;
+    if (record_subtree(state, node->right, &entry.right) != 0)
+        return -1;
+
+    const ad_entry* left  = array_get_element(&tape->entries, entry.left);
+    const ad_entry* right = array_get_element(&tape->entries, entry.right);
+
+    /* Constant operands are always the last recorded entries */
+    if (right->type == NODE_NUM && (!node->left || left->type == NODE_NUM))
+    {
+        double value = apply_op(get_op(node),
+                                node->left ? left->value.num : 0,
+                                right->value.num);
+
+        array_pop(&tape->entries);
+        if (node->left) array_pop(&tape->entries);
+
+        *index = push_entry(tape, {.type = NODE_NUM, .value = {.num = value}, .left = 0, .right = 0});
+        return 0;
+    }
+
+    *index = push_entry(tape, entry);
+    return 0;
+}
+
+static size_t push_entry(autodiff_tape* tape, ad_entry entry)
+{
+    array_push(&tape->entries, entry);
+    return tape->entries.size - 1;
+}
+
+static void propagate(autodiff_tape* tape, size_t index)
+{
+    const ad_entry* entry = &tape->entries.data[index];
+    if (entry->type != NODE_OP) return;
+
+    const double* values   = tape->values;
+    double*       adjoints = tape->adjoints;
+
+    double adjoint = adjoints[index];
+    double right   = values[entry->right];
+
+    if (entry->value.op >= OP_NEG)
+    {
+        adjoints[entry->right] += adjoint * unary_partial(entry->value.op, right);
+        return;
+    }
+
+    double left = values[entry->left];
+
+    /* Partial derivatives are only computed for operands, which depend on
+     * variables, so that e.g. `x^2` is differentiable at negative `x` */
+    int left_active  = tape->entries.data[entry->left ].type != NODE_NUM;
+    int right_active = tape->entries.data[entry->right].type != NODE_NUM;
+
+    switch (entry->value.op)
+    {
+    case OP_ADD:
+        adjoints[entry->left ] += adjoint;
+        adjoints[entry->right] += adjoint;
+        break;
+    case OP_SUB:
+        adjoints[entry->left ] += adjoint;
+        adjoints[entry->right] -= adjoint;
+        break;
+    case OP_MUL:
+        adjoints[entry->left ] += adjoint * right;
+        adjoints[entry->right] += adjoint * left;
+        break;
+    case OP_DIV:
+        adjoints[entry->left ] += adjoint / right;
+        adjoints[entry->right] -= adjoint * left / (right * right);
+        break;
+    case OP_POW:
+        if (left_active)
+            adjoints[entry->left ] += adjoint * right * pow(left, right - 1);
+        if (right_active)
+            adjoints[entry->right] += adjoint * values[index] * log(left);
+        break;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return);
+    }
+}
+
+#define NUM(num)            (num)
+#define CPY(node)           (node)
+#define RIGHT               arg
+
+#define ADD(left, right)    ((left) + (right))
+#define SUB(left, right)    ((left) - (right))
+#define MUL(left, right)    ((left) * (right))
+#define FRAC(left, right)   ((left) / (right))
+#define POW(left, right)    pow(left, right)
+#define NEG(right)          (-(right))
+#define SIN(right)          sin(right)
+#define COS(right)          cos(right)
+#define SQRT(right)         sqrt(right)
+
+static double unary_partial(op_type op, double arg)
+{
+    #define MATH_FUNC(name, diff, ...)\
+        case OP_##name:\
+            return diff;
+
+    switch (op)
+    {
+    case OP_NEG:
+        return -1;
+    #include "functions.h"
+
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return NAN);
+    }
+
+    #undef MATH_FUNC
+
+    LOG_ASSERT(0 && "Unreachable code", return NAN);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file autodiff.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Reverse-mode automatic differentiation of syntax trees
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef AUTODIFF_H
+#define AUTODIFF_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+/**
+ * @brief Tape entry, operands are referenced by their indices in tape
+ */
+struct ad_entry
+{
+    /**
+     * @brief Entry type
+     */
+    node_type type;
+    /**
+     * @brief Constant value for `NODE_NUM` or operation for `NODE_OP`
+     */
+    node_value value;
+    /**
+     * @brief Left operand index (unused for unary operations)
+     */
+    size_t left;
+    /**
+     * @brief Right operand index
+     */
+    size_t right;
+};
+
+#define ARRAY_ELEMENT ad_entry
+
+inline void copy_element(ARRAY_ELEMENT* dest, const ARRAY_ELEMENT* src) { *dest = *src; }
+inline void delete_element(ARRAY_ELEMENT* element) { *element = {}; }
+
+#include "dynamic_array.h"
+
+#undef ARRAY_ELEMENT
+
+/**
+ * @brief Recorded expression. First `var_count` entries are tree variables,
+ * every operation is placed after its operands.
+ */
+struct autodiff_tape
+{
+    /**
+     * @brief Recorded entries
+     */
+    dynamic_array(ad_entry) entries;
+
+    /**
+     * @brief Number of variables, equal to size of tree variable array
+     */
+    size_t var_count;
+
+    /**
+     * @brief Index of entry holding expression value
+     */
+    size_t output;
+
+    /**
+     * @brief Entry values of last forward pass
+     */
+    double* values;
+    /**
+     * @brief Partial derivatives of expression with respect to entries
+     */
+    double* adjoints;
+};
+
+/**
+ * @brief Record syntax tree onto tape. Variables are resolved to their
+ * indices in `ast->variables`, constant subtrees are folded.
+ *
+ * @param[out] tape Constructed tape
+ * @param[in] ast Recorded tree
+ * @return 0 upon success, -1 otherwise
+ */
+int autodiff_ctor(autodiff_tape* tape, const abstract_syntax_tree* ast);
+
+/**
+ * @brief Destroy tape
+ *
+ * @param[inout] tape `autodiff_tape` instance to be destroyed
+ */
+void autodiff_dtor(autodiff_tape* tape);
+
+/**
+ * @brief Evaluate expression and its gradient in one forward and one
+ * backward pass
+ *
+ * @param[inout] tape Recorded expression
+ * @param[in] vars Variable values, indexed by variable slot
+ * @param[out] gradient Array of `tape->var_count` partial derivatives
+ * @return Expression value
+ */
+double autodiff_gradient(autodiff_tape* tape, const double* vars, double* gradient);
+
+#endif
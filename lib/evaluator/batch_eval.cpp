@@ -0,0 +1,259 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "simd_math.h"
+#include "batch_eval.h"
+
+/* Kernels are compiled for several instruction sets, the best one is
+ * selected by dynamic loader at program startup. Kernels are optimized even
+ * in debug builds: otherwise every vector temporary of inlined helpers gets
+ * its own stack slot, and kernel frames grow to tens of kilobytes */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SIMD_KERNEL __attribute__((target_clones("avx512f", "avx2", "default"), optimize("O2")))
+#elif defined(__GNUC__)
+#define SIMD_KERNEL __attribute__((optimize("O2")))
+#else
+#define SIMD_KERNEL
+#endif
+
+/* Vectors are only passed between kernels and always inlined helpers. Warning
+ * is reported for kernel clones at the end of file, so it is disabled for the
+ * whole file rather than for kernel definitions */
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#define BINARY_KERNEL(name, expr)                                   \
+    SIMD_KERNEL static void name(double* dst,                       \
+                                 const double* lhs,                 \
+                                 const double* rhs,                 \
+                                 size_t count)                      \
+    {                                                               \
+        for (size_t i = 0; i < count; i += SIMD_LANES)              \
+        {                                                           \
+            vec_double a = simd_load(lhs + i);                      \
+            vec_double b = simd_load(rhs + i);                      \
+            simd_store(dst + i, expr);                              \
+        }                                                           \
+    }
+
+#define UNARY_KERNEL(name, expr)                                    \
+    SIMD_KERNEL static void name(double* data, size_t count)        \
+    {                                                               \
+        for (size_t i = 0; i < count; i += SIMD_LANES)              \
+        {                                                           \
+            vec_double a = simd_load(data + i);                     \
+            simd_store(data + i, expr);                             \
+        }                                                           \
+    }
+
+/* Lanes with arguments too large for vector range reduction are
+ * recomputed with scalar functions */
+#define TRIG_KERNEL(name, op, expr)                                 \
+    SIMD_KERNEL static void name(double* data, size_t count)        \
+    {                                                               \
+        for (size_t i = 0; i < count; i += SIMD_LANES)              \
+        {                                                           \
+            vec_double a = simd_load(data + i);                     \
+            vec_double s = {}, c = {};                              \
+            simd_sincos(a, &s, &c);                                 \
+            simd_store(data + i, expr);                             \
+            for (size_t lane = 0; lane < SIMD_LANES; lane++)        \
+                if (!(fabs(a[lane]) <= SIMD_TRIG_MAX_ARG))          \
+                    data[i + lane] = apply_op(op, 0, a[lane]);      \
+        }                                                           \
+    }
+
+BINARY_KERNEL(kernel_add, a + b)
+BINARY_KERNEL(kernel_sub, a - b)
+BINARY_KERNEL(kernel_mul, a * b)
+BINARY_KERNEL(kernel_div, a / b)
+BINARY_KERNEL(kernel_pow, simd_pow(a, b))
+
+UNARY_KERNEL(kernel_neg,    -a)
+UNARY_KERNEL(kernel_sqrt,   simd_sqrt(a))
+UNARY_KERNEL(kernel_ln,     simd_log(a))
+UNARY_KERNEL(kernel_arcsin, simd_asin(a))
+UNARY_KERNEL(kernel_arccos, simd_acos(a))
+UNARY_KERNEL(kernel_arctan, simd_atan(a))
+UNARY_KERNEL(kernel_arccot, M_PI_2 - simd_atan(a))
+
+TRIG_KERNEL(kernel_sin, OP_SIN, s)
+TRIG_KERNEL(kernel_cos, OP_COS, c)
+TRIG_KERNEL(kernel_tan, OP_TAN, s / c)
+TRIG_KERNEL(kernel_cot, OP_COT, c / s)
+
+SIMD_KERNEL static void kernel_powi(double* data, long long exponent, size_t count)
+{
+    long long abs_exp = exponent < 0 ? -exponent : exponent;
+
+    for (size_t i = 0; i < count; i += SIMD_LANES)
+    {
+        vec_double base = simd_load(data + i);
+        vec_double res  = simd_splat(1);
+
+        for (long long n = abs_exp; n > 0; n >>= 1)
+        {
+            if (n & 1) res = res * base;
+            base = base * base;
+        }
+
+        simd_store(data + i, exponent < 0 ? 1 / res : res);
+    }
+}
+
+#undef BINARY_KERNEL
+#undef UNARY_KERNEL
+#undef TRIG_KERNEL
+#undef SIMD_KERNEL
+
+/* Exponents up to this value are computed with repeated multiplication */
+static const long long MAX_INT_EXPONENT = 64;
+
+static void evaluate_block(const bytecode_program* program,
+                           double* stack,
+                           const double* const* vars,
+                           size_t start, size_t count);
+
+int batch_evaluate(const bytecode_program* program,
+                   const double* const* vars,
+                   size_t count,
+                   double* output)
+{
+    LOG_ASSERT(program != NULL, return -1);
+    LOG_ASSERT(program->var_count == 0 || vars != NULL, return -1);
+    LOG_ASSERT(output != NULL, return -1);
+
+    if (count == 0) return 0;
+
+    /* Temporaries are stored after evaluation stack */
+    size_t slots = program->stack_size + program->temp_count;
+    double* stack = (double*) aligned_alloc(sizeof(vec_double),
+                            slots * BATCH_BLOCK * sizeof(double));
+    LOG_ASSERT_ERROR(stack != NULL, return -1,
+                    "Failed to allocate evaluation stack", NULL);
+
+    for (size_t start = 0; start < count; start += BATCH_BLOCK)
+    {
+        size_t block_size = count - start < BATCH_BLOCK ? count - start : BATCH_BLOCK;
+
+        evaluate_block(program, stack, vars, start, block_size);
+        memcpy(output + start, stack, block_size * sizeof(double));
+    }
+
+    free(stack);
+    return 0;
+}
+
+int batch_evaluate_tree(const abstract_syntax_tree* ast,
+                        const double* const* vars,
+                        size_t count,
+                        double* output)
+{
+    bytecode_program program = {};
+    if (bytecode_compile(&program, ast) != 0)
+        return -1;
+
+    int res = batch_evaluate(&program, vars, count, output);
+
+    bytecode_dtor(&program);
+    return res;
+}
+
+int batch_sample_range(const bytecode_program* program,
+                       double start, double end,
+                       size_t count,
+                       double* points,
+                       double* output)
+{
+    LOG_ASSERT(program != NULL, return -1);
+    LOG_ASSERT(points != NULL, return -1);
+    LOG_ASSERT(count >= 2, return -1);
+    LOG_ASSERT_ERROR(program->var_count <= 1, return -1,
+                    "Cannot sample function of %zu variables", program->var_count);
+
+    double step = (end - start) / (double) (count - 1);
+    for (size_t i = 0; i < count; i++)
+        points[i] = start + step * (double) i;
+    points[count - 1] = end;
+
+    const double* vars[] = { points };
+    return batch_evaluate(program, vars, count, output);
+}
+
+static void evaluate_block(const bytecode_program* program,
+                           double* stack,
+                           const double* const* vars,
+                           size_t start, size_t count)
+{
+    #define SLOT(index) (stack + (index) * BATCH_BLOCK)
+    #define BINARY(kernel, first, second) \
+        do { kernel(SLOT(sp - 2), SLOT(first), SLOT(second), lanes); sp--; } while (0)
+
+    /* Round up to whole vectors, padding lanes are never read back */
+    size_t lanes = (count + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+
+    const bc_instruction* code = program->code.data;
+    size_t temps = program->stack_size;
+    size_t sp = 0;
+
+    for (size_t i = 0; i < program->code.size; i++)
+    {
+        switch (code[i].op)
+        {
+        case BC_NUM:
+            for (size_t lane = 0; lane < lanes; lane++)
+                SLOT(sp)[lane] = code[i].arg.num;
+            sp++;
+            break;
+        case BC_VAR:
+            memcpy(SLOT(sp), vars[code[i].arg.var] + start, count * sizeof(double));
+            memset(SLOT(sp) + count, 0, (lanes - count) * sizeof(double));
+            sp++;
+            break;
+        case BC_LOAD:
+            memcpy(SLOT(sp), SLOT(temps + code[i].arg.var), lanes * sizeof(double));
+            sp++;
+            break;
+        case BC_STORE:
+            memcpy(SLOT(temps + code[i].arg.var), SLOT(sp - 1), lanes * sizeof(double));
+            break;
+        case BC_ADD:  BINARY(kernel_add, sp - 2, sp - 1); break;
+        case BC_SUB:  BINARY(kernel_sub, sp - 2, sp - 1); break;
+        case BC_MUL:  BINARY(kernel_mul, sp - 2, sp - 1); break;
+        case BC_DIV:  BINARY(kernel_div, sp - 2, sp - 1); break;
+        case BC_RSUB: BINARY(kernel_sub, sp - 1, sp - 2); break;
+        case BC_RDIV: BINARY(kernel_div, sp - 1, sp - 2); break;
+        case BC_RPOW: BINARY(kernel_pow, sp - 1, sp - 2); break;
+        case BC_POW:
+        {
+            double exponent = i > 0 && code[i - 1].op == BC_NUM ? code[i - 1].arg.num : NAN;
+            /* Whole exponent, floor(x) <= x holds for every other value */
+            if (fabs(exponent) <= (double) MAX_INT_EXPONENT && exponent <= floor(exponent))
+            {
+                kernel_powi(SLOT(sp - 2), (long long) exponent, lanes);
+                sp--;
+            }
+            else
+                BINARY(kernel_pow, sp - 2, sp - 1);
+            break;
+        }
+        case BC_NEG:    kernel_neg   (SLOT(sp - 1), lanes); break;
+        case BC_SQRT:   kernel_sqrt  (SLOT(sp - 1), lanes); break;
+        case BC_LN:     kernel_ln    (SLOT(sp - 1), lanes); break;
+        case BC_SIN:    kernel_sin   (SLOT(sp - 1), lanes); break;
+        case BC_COS:    kernel_cos   (SLOT(sp - 1), lanes); break;
+        case BC_TAN:    kernel_tan   (SLOT(sp - 1), lanes); break;
+        case BC_COT:    kernel_cot   (SLOT(sp - 1), lanes); break;
+        case BC_ARCSIN: kernel_arcsin(SLOT(sp - 1), lanes); break;
+        case BC_ARCCOS: kernel_arccos(SLOT(sp - 1), lanes); break;
+        case BC_ARCTAN: kernel_arctan(SLOT(sp - 1), lanes); break;
+        case BC_ARCCOT: kernel_arccot(SLOT(sp - 1), lanes); break;
+        default: LOG_ASSERT(0 && "Invalid opcode", return);
+        }
+    }
+
+    #undef BINARY
+    #undef SLOT
+}
@@ -0,0 +1,71 @@
+/**
+ * @file batch_eval.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Vectorized evaluation of expressions over arrays of inputs
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef BATCH_EVAL_H
+#define BATCH_EVAL_H
+
+#include <stddef.h>
+
+#include "bytecode.h"
+
+/**
+ * @brief Number of points processed by each instruction at once
+ */
+const size_t BATCH_BLOCK = 256;
+
+/**
+ * @brief Evaluate compiled program for multiple points
+ *
+ * @param[in] program Compiled program
+ * @param[in] vars Array of `program->var_count` pointers to `count` values
+ * of each variable (structure of arrays)
+ * @param[in] count Number of points
+ * @param[out] output Array of `count` results
+ * @return 0 upon success, -1 otherwise
+ */
+int batch_evaluate(const bytecode_program* program,
+                   const double* const* vars,
+                   size_t count,
+                   double* output);
+
+/**
+ * @brief Compile tree and evaluate it for multiple points
+ *
+ * @param[in] ast Evaluated tree
+ * @param[in] vars Array of pointers to `count` values of each tree variable
+ * @param[in] count Number of points
+ * @param[out] output Array of `count` results
+ * @return 0 upon success, -1 otherwise
+ */
+int batch_evaluate_tree(const abstract_syntax_tree* ast,
+                        const double* const* vars,
+                        size_t count,
+                        double* output);
+
+/**
+ * @brief Evaluate function of at most one variable at `count` evenly spaced
+ * points of range `[start, end]`
+ *
+ * @param[in] program Compiled program
+ * @param[in] start Range start
+ * @param[in] end Range end
+ * @param[in] count Number of points, at least 2
+ * @param[out] points Array of `count` sampled points
+ * @param[out] output Array of `count` results
+ * @return 0 upon success, -1 otherwise
+ */
+int batch_sample_range(const bytecode_program* program,
+                       double start, double end,
+                       size_t count,
+                       double* points,
+                       double* output);
+
+#endif
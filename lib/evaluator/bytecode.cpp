@@ -0,0 +1,309 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+#include "bytecode.h"
+#include "expr_dag.h"
+
+#define ARRAY_ELEMENT bc_instruction
+#include "dynamic_array_impl.h"
+
+/**
+ * Properties of distinct subexpression
+ */
+struct node_info
+{
+    size_t uses;
+    size_t stack_need;
+    size_t temp;        /* Temporary slot + 1, 0 if value is not stored */
+    int has_variables;
+};
+
+struct compile_state
+{
+    bytecode_program* program;
+    const dynamic_array(var_name)* variables;
+    size_t depth;
+    node_info* info;
+};
+
+static void  analyze_subtree(compile_state* state, const dag_node* node);
+static int   compile_subtree(compile_state* state, const dag_node* node);
+static double evaluate_constant(const dag_node* node);
+static void  emit(compile_state* state, bc_instruction instruction);
+static void  emit_op(compile_state* state, op_type op, int reversed);
+
+int bytecode_compile(bytecode_program* program, const abstract_syntax_tree* ast)
+{
+    LOG_ASSERT(ast != NULL, return -1);
+
+    return bytecode_compile_node(program, ast->root, &ast->variables);
+}
+
+int bytecode_compile_node(bytecode_program* program,
+                          const ast_node* root,
+                          const dynamic_array(var_name)* variables)
+{
+    LOG_ASSERT(program != NULL, return -1);
+    LOG_ASSERT(root != NULL, return -1);
+    LOG_ASSERT(variables != NULL, return -1);
+
+    *program = {
+        .code = {},
+        .stack_size = 0,
+        .temp_count = 0,
+        .var_count = variables->size
+    };
+    array_ctor(&program->code);
+
+    /* Equal subtrees become the same graph node */
+    expr_dag dag = {};
+    dag_ctor(&dag);
+    const dag_node* dag_root = dag_from_node(&dag, root);
+
+    compile_state state = {
+        .program = program,
+        .variables = variables,
+        .depth = 0,
+        .info = (node_info*) calloc(dag.size, sizeof(node_info))
+    };
+
+    int status = -1;
+    if (state.info)
+    {
+        analyze_subtree(&state, dag_root);
+
+        status = 0;
+        LOG_ASSERT_ERROR(state.info[dag_root->id].stack_need < BC_MAX_STACK,
+            status = -1,
+            "Expression is too deep to be compiled", NULL);
+    }
+
+    if (status == 0)
+        status = compile_subtree(&state, dag_root);
+
+    free(state.info);
+    dag_dtor(&dag);
+
+    if (status != 0)
+        bytecode_dtor(program);
+
+    return status;
+}
+
+void bytecode_dtor(bytecode_program* program)
+{
+    LOG_ASSERT(program != NULL, return);
+
+    array_dtor(&program->code);
+    *program = {};
+}
+
+double bytecode_evaluate(const bytecode_program* program, const double* vars)
+{
+    /* Top of stack is kept separately, so that it stays in register */
+    double stack[BC_MAX_STACK];
+    double temps[BC_MAX_TEMPS];
+    double top = 0;
+    size_t sp  = 0;
+
+    const bc_instruction* ip  = program->code.data;
+    const bc_instruction* end = ip + program->code.size;
+
+    for (; ip < end; ip++)
+    {
+        switch (ip->op)
+        {
+        case BC_NUM:    stack[sp++] = top; top = ip->arg.num;       break;
+        case BC_VAR:    stack[sp++] = top; top = vars[ip->arg.var]; break;
+        case BC_LOAD:   stack[sp++] = top; top = temps[ip->arg.var];break;
+        case BC_STORE:  temps[ip->arg.var] = top;                   break;
+        case BC_ADD:    top = stack[--sp] + top;                    break;
+        case BC_SUB:    top = stack[--sp] - top;                    break;
+        case BC_MUL:    top = stack[--sp] * top;                    break;
+        case BC_DIV:    top = stack[--sp] / top;                    break;
+        case BC_POW:    top = pow(stack[--sp], top);                break;
+        case BC_RSUB:   top = top - stack[--sp];                    break;
+        case BC_RDIV:   top = top / stack[--sp];                    break;
+        case BC_RPOW:   top = pow(top, stack[--sp]);                break;
+        case BC_NEG:    top = -top;                                 break;
+        case BC_SQRT:   top = sqrt(top);                            break;
+        case BC_LN:     top = log(top);                             break;
+        case BC_SIN:    top = sin(top);                             break;
+        case BC_COS:    top = cos(top);                             break;
+        case BC_TAN:    top = tan(top);                             break;
+        case BC_COT:    top = 1 / tan(top);                         break;
+        case BC_ARCSIN: top = asin(top);                            break;
+        case BC_ARCCOS: top = acos(top);                            break;
+        case BC_ARCTAN: top = atan(top);                            break;
+        case BC_ARCCOT: top = M_PI_2 - atan(top);                   break;
+        default: LOG_ASSERT(0 && "Invalid opcode", return NAN);
+        }
+    }
+
+    return top;
+}
+
+double apply_op(op_type op, double left, double right)
+{
+    switch (op)
+    {
+    case OP_ADD:    return left + right;
+    case OP_SUB:    return left - right;
+    case OP_MUL:    return left * right;
+    case OP_DIV:    return left / right;
+    case OP_POW:    return pow(left, right);
+    case OP_NEG:    return -right;
+    case OP_SQRT:   return sqrt(right);
+    case OP_LN:     return log(right);
+    case OP_SIN:    return sin(right);
+    case OP_COS:    return cos(right);
+    case OP_TAN:    return tan(right);
+    case OP_COT:    return 1 / tan(right);
+    case OP_ARCSIN: return asin(right);
+    case OP_ARCCOS: return acos(right);
+    case OP_ARCTAN: return atan(right);
+    case OP_ARCCOT: return M_PI_2 - atan(right);
+    default: LOG_ASSERT(0 && "Invalid enum value.", return NAN);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return NAN);
+}
+
+static void analyze_subtree(compile_state* state, const dag_node* node)
+{
+    node_info* info = &state->info[node->id];
+    if (info->uses++ > 0) return;
+
+    info->has_variables = is_var(node);
+    info->stack_need    = 1;
+
+    if (!is_op(node)) return;
+
+    analyze_subtree(state, node->right);
+    const node_info* right = &state->info[node->right->id];
+
+    if (!node->left)
+    {
+        info->has_variables = right->has_variables;
+        info->stack_need    = right->stack_need;
+        return;
+    }
+
+    analyze_subtree(state, node->left);
+    const node_info* left = &state->info[node->left->id];
+
+    info->has_variables = left->has_variables || right->has_variables;
+
+    /* Upper bound, shared operands may end up being loaded from temporaries */
+    if (left->stack_need == right->stack_need)
+        info->stack_need = left->stack_need + 1;
+    else
+        info->stack_need = left->stack_need > right->stack_need
+                         ? left->stack_need : right->stack_need;
+}
+
+static int compile_subtree(compile_state* state, const dag_node* node)
+{
+    node_info* info = &state->info[node->id];
+
+    if (is_num(node) || !info->has_variables)
+    {
+        emit(state, {.op = BC_NUM, .arg = {.num = evaluate_constant(node)}});
+        return 0;
+    }
+
+    if (is_var(node))
+    {
+        size_t var_id = 0;
+        LOG_ASSERT_ERROR(
+            array_try_find_symbol(state->variables, get_var(node), &var_id),
+            return -1,
+            "Variable '%s' was not defined", symbol_name(get_var(node)));
+
+        emit(state, {.op = BC_VAR, .arg = {.var = var_id}});
+        return 0;
+    }
+
+    if (info->temp)
+    {
+        emit(state, {.op = BC_LOAD, .arg = {.var = info->temp - 1}});
+        return 0;
+    }
+
+    if (!node->left)
+    {
+        if (compile_subtree(state, node->right) != 0) return -1;
+        emit_op(state, get_op(node), 0);
+    }
+    else
+    {
+        /* Evaluate operand requiring more stack first, so that the total
+         * stack depth stays logarithmic in tree size */
+        int reversed = state->info[node->right->id].stack_need
+                     > state->info[node->left ->id].stack_need;
+
+        const dag_node* first  = reversed ? node->right : node->left;
+        const dag_node* second = reversed ? node->left  : node->right;
+
+        if (compile_subtree(state, first)  != 0) return -1;
+        if (compile_subtree(state, second) != 0) return -1;
+
+        emit_op(state, get_op(node), reversed);
+    }
+
+    if (info->uses > 1 && state->program->temp_count < BC_MAX_TEMPS)
+    {
+        info->temp = ++state->program->temp_count;
+        emit(state, {.op = BC_STORE, .arg = {.var = info->temp - 1}});
+    }
+
+    return 0;
+}
+
+static double evaluate_constant(const dag_node* node)
+{
+    if (is_num(node)) return get_num(node);
+
+    LOG_ASSERT(is_op(node), return NAN);
+
+    double left = node->left ? evaluate_constant(node->left) : 0;
+    return apply_op(get_op(node), left, evaluate_constant(node->right));
+}
+
+static void emit(compile_state* state, bc_instruction instruction)
+{
+    array_push(&state->program->code, instruction);
+
+    if (instruction.op <= BC_LOAD)
+    {
+        state->depth++;
+        if (state->depth > state->program->stack_size)
+            state->program->stack_size = state->depth;
+    }
+    else if (instruction.op <= BC_RPOW)
+        state->depth--;
+}
+
+static void emit_op(compile_state* state, op_type op, int reversed)
+{
+    #define MATH_FUNC(name, ...) case OP_##name: code = BC_##name; break;
+
+    bc_opcode code = BC_NUM;
+    switch (op)
+    {
+    case OP_ADD: code = BC_ADD;                        break;
+    case OP_SUB: code = reversed ? BC_RSUB : BC_SUB;   break;
+    case OP_MUL: code = BC_MUL;                        break;
+    case OP_DIV: code = reversed ? BC_RDIV : BC_DIV;   break;
+    case OP_POW: code = reversed ? BC_RPOW : BC_POW;   break;
+    case OP_NEG: code = BC_NEG;                        break;
+    #include "functions.h"
+    default: LOG_ASSERT(0 && "Invalid enum value.", return);
+    }
+
+    #undef MATH_FUNC
+
+    emit(state, {.op = code, .arg = {.var = 0}});
+}
@@ -0,0 +1,160 @@
+/**
+ * @file bytecode.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Flat postfix bytecode for repeated numeric evaluation of syntax trees
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+#define MATH_FUNC(name, ...) BC_##name,
+
+/**
+ * @brief Bytecode instruction opcode. Every `op_type` has an opcode of the
+ * same name, reversed variants of non-commutative operations expect their
+ * operands in swapped order on the stack. `BC_STORE` copies top of the stack
+ * into temporary slot, `BC_LOAD` pushes stored value back.
+ */
+enum bc_opcode
+{
+    BC_NUM,
+    BC_VAR,
+    BC_LOAD,
+    BC_ADD,
+    BC_SUB,
+    BC_MUL,
+    BC_DIV,
+    BC_POW,
+    BC_RSUB,
+    BC_RDIV,
+    BC_RPOW,
+    BC_STORE,
+    BC_NEG,
+    #include "functions.h"
+};
+
+#undef MATH_FUNC
+
+/**
+ * @brief Single bytecode instruction
+ */
+struct bc_instruction
+{
+    /**
+     * @brief Instruction opcode
+     */
+    bc_opcode op;
+    /**
+     * @brief Inlined constant for `BC_NUM`, variable slot for `BC_VAR` or
+     * temporary slot for `BC_STORE` and `BC_LOAD`
+     */
+    union {
+        double num;
+        size_t var;
+    } arg;
+};
+
+#define ARRAY_ELEMENT bc_instruction
+
+inline void copy_element(ARRAY_ELEMENT* dest, const ARRAY_ELEMENT* src) { *dest = *src; }
+inline void delete_element(ARRAY_ELEMENT* element) { *element = {}; }
+
+#include "dynamic_array.h"
+
+#undef ARRAY_ELEMENT
+
+/**
+ * @brief Maximal evaluation stack depth supported by interpreter
+ */
+const size_t BC_MAX_STACK = 64;
+
+/**
+ * @brief Maximal number of temporaries supported by interpreter
+ */
+const size_t BC_MAX_TEMPS = 256;
+
+/**
+ * @brief Compiled expression
+ */
+struct bytecode_program
+{
+    /**
+     * @brief Instructions in postfix order
+     */
+    dynamic_array(bc_instruction) code;
+
+    /**
+     * @brief Evaluation stack depth required by program
+     */
+    size_t stack_size;
+
+    /**
+     * @brief Number of temporary slots holding shared subexpressions
+     */
+    size_t temp_count;
+
+    /**
+     * @brief Number of variable slots, equal to size of tree variable array
+     */
+    size_t var_count;
+};
+
+/**
+ * @brief Compile syntax tree into bytecode. Variables are resolved to their
+ * indices in `ast->variables`, constant subtrees are folded, repeated
+ * subexpressions are evaluated once and stored in temporaries.
+ *
+ * @param[out] program Constructed program
+ * @param[in] ast Compiled tree
+ * @return 0 upon success, -1 otherwise
+ */
+int bytecode_compile(bytecode_program* program, const abstract_syntax_tree* ast);
+
+/**
+ * @brief Compile subtree into bytecode
+ *
+ * @param[out] program Constructed program
+ * @param[in] root Subtree root
+ * @param[in] variables Variable array used to resolve variable slots
+ * @return 0 upon success, -1 otherwise
+ */
+int bytecode_compile_node(bytecode_program* program,
+                          const ast_node* root,
+                          const dynamic_array(var_name)* variables);
+
+/**
+ * @brief Destroy compiled program
+ *
+ * @param[inout] program `bytecode_program` instance to be destroyed
+ */
+void bytecode_dtor(bytecode_program* program);
+
+/**
+ * @brief Evaluate compiled program
+ *
+ * @param[in] program Compiled program
+ * @param[in] vars Variable values, indexed by variable slot
+ * @return Expression value
+ */
+double bytecode_evaluate(const bytecode_program* program, const double* vars);
+
+/**
+ * @brief Apply operation to numeric operands
+ *
+ * @param[in] op Operation type
+ * @param[in] left Left operand (ignored for unary operations)
+ * @param[in] right Right operand
+ * @return Operation result
+ */
+double apply_op(op_type op, double left, double right);
+
+#endif
@@ -0,0 +1,387 @@
+#include <float.h>
+#include <math.h>
+
+#include "logger.h"
+
+#include "interval.h"
+
+static const interval UNDEFINED_INTERVAL = {.low = NAN, .high = NAN, .domain = IV_UNDEFINED};
+
+/**
+ * @brief Relative slack of checks, whether interval contains extremum or
+ * pole. False positives only make enclosure wider.
+ */
+static const double PHASE_SLACK = 1e-9;
+
+typedef double math_function(double);
+
+static interval evaluate(const ast_node* node, const dynamic_array(var_name)* variables,
+                         const interval* vars);
+
+static interval add_intervals     (interval left, interval right);
+static interval multiply_intervals(interval left, interval right);
+static interval divide_intervals  (interval left, interval right);
+static interval power_intervals   (interval base, interval exponent);
+static interval integer_power(interval base, double exponent);
+static interval real_power   (interval base, interval exponent);
+
+static interval enclose_monotone(interval arg, math_function* func, int increasing);
+static interval enclose_periodic(interval arg, math_function* func,
+                                 double max_phase, double min_phase);
+static interval enclose_tangent (interval arg, math_function* func, double pole_phase);
+static interval clip_domain(interval arg, double low, double high);
+static int contains_phase(interval arg, double phase, double period);
+
+static double cot   (double x) { return 1 / tan(x); }
+static double arccot(double x) { return M_PI_2 - atan(x); }
+
+static inline int is_zero(double value)
+{
+    return fpclassify(value) == FP_ZERO;
+}
+
+/**
+ * @brief Move finite value by at least one unit in the last place.
+ * Cheaper than `nextafter`, which is not inlined.
+ */
+static inline double round_outward(double value, double direction)
+{
+    if (!isfinite(value))
+        return value;
+    return value + direction * (fabs(value) * DBL_EPSILON + DBL_TRUE_MIN);
+}
+
+static inline interval make_interval(double low, double high)
+{
+    /* NaN bounds appear from operations like `inf - inf` and mean that
+     * nothing is known about value. Zero bounds are kept, so that sign of
+     * value is not lost (zero sums and differences are always exact). */
+    return {
+        .low    = isnan(low)  ? -INFINITY : is_zero(low)  ? low  : round_outward(low,  -1),
+        .high   = isnan(high) ?  INFINITY : is_zero(high) ? high : round_outward(high,  1),
+        .domain = IV_DEFINED
+    };
+}
+
+static inline interval negate(interval arg)
+{
+    return {.low = -arg.high, .high = -arg.low, .domain = IV_DEFINED};
+}
+
+static inline int contains_zero(interval arg)
+{
+    return !isgreater(arg.low, 0) && !isless(arg.high, 0);
+}
+
+static inline interval_domain worst_domain(interval_domain first, interval_domain second)
+{
+    return first > second ? first : second;
+}
+
+interval interval_evaluate(const abstract_syntax_tree* ast, const interval* vars)
+{
+    LOG_ASSERT(ast != NULL, return UNDEFINED_INTERVAL);
+
+    return interval_evaluate_node(ast->root, &ast->variables, vars);
+}
+
+interval interval_evaluate_node(const ast_node* node,
+                                const dynamic_array(var_name)* variables,
+                                const interval* vars)
+{
+    LOG_ASSERT(node != NULL, return UNDEFINED_INTERVAL);
+    LOG_ASSERT(variables != NULL, return UNDEFINED_INTERVAL);
+    LOG_ASSERT(vars != NULL || variables->size == 0, return UNDEFINED_INTERVAL);
+
+    return evaluate(node, variables, vars);
+}
+
+interval interval_apply_op(op_type op, interval left, interval right)
+{
+    int unary = op >= OP_NEG;
+
+    if (right.domain == IV_UNDEFINED || (!unary && left.domain == IV_UNDEFINED))
+        return UNDEFINED_INTERVAL;
+
+    interval_domain operands = unary ? right.domain : worst_domain(left.domain, right.domain);
+    interval result = UNDEFINED_INTERVAL;
+
+    switch (op)
+    {
+    case OP_ADD: result = add_intervals(left, right);                         break;
+    case OP_SUB: result = add_intervals(left, negate(right));                 break;
+    case OP_MUL: result = multiply_intervals(left, right);                    break;
+    case OP_DIV: result = divide_intervals(left, right);                      break;
+    case OP_POW: result = power_intervals(left, right);                       break;
+    case OP_NEG: result = negate(right);                                      break;
+
+    case OP_SQRT:
+        result = clip_domain(right, 0, INFINITY);
+        result = enclose_monotone(result, sqrt, 1);
+        result.low = fmax(result.low, 0);
+        break;
+    case OP_LN:
+        /* Logarithm of zero is infinite */
+        result = clip_domain(right, 0, INFINITY);
+        if (result.domain != IV_UNDEFINED && !isgreater(result.high, 0))
+            return UNDEFINED_INTERVAL;
+        if (result.domain != IV_UNDEFINED && is_zero(result.low))
+            result.domain = IV_PARTIAL;
+        result = enclose_monotone(result, log, 1);
+        break;
+
+    case OP_SIN: result = enclose_periodic(right, sin, M_PI_2, -M_PI_2);      break;
+    case OP_COS: result = enclose_periodic(right, cos, 0, M_PI);              break;
+    case OP_TAN: result = enclose_tangent (right, tan, M_PI_2);               break;
+    case OP_COT: result = enclose_tangent (right, cot, 0);                    break;
+
+    case OP_ARCSIN:
+        result = enclose_monotone(clip_domain(right, -1, 1), asin, 1);
+        break;
+    case OP_ARCCOS:
+        result = enclose_monotone(clip_domain(right, -1, 1), acos, 0);
+        result.low = fmax(result.low, 0);
+        break;
+    case OP_ARCTAN: result = enclose_monotone(right, atan, 1);                break;
+    case OP_ARCCOT:
+        result = enclose_monotone(right, arccot, 0);
+        result.low = fmax(result.low, 0);
+        break;
+
+    default: LOG_ASSERT(0 && "Invalid enum value.", return UNDEFINED_INTERVAL);
+    }
+
+    if (result.domain == IV_UNDEFINED)
+        return UNDEFINED_INTERVAL;
+
+    result.domain = worst_domain(result.domain, operands);
+    return result;
+}
+
+static interval evaluate(const ast_node* node, const dynamic_array(var_name)* variables,
+                         const interval* vars)
+{
+    if (is_num(node))
+        return {.low = get_num(node), .high = get_num(node), .domain = IV_DEFINED};
+
+    if (is_var(node))
+    {
+        size_t var_id = 0;
+        LOG_ASSERT_ERROR(array_try_find_symbol(variables, get_var(node), &var_id),
+            return UNDEFINED_INTERVAL,
+            "Variable '%s' was not defined", symbol_name(get_var(node)));
+        return vars[var_id];
+    }
+
+    interval right = evaluate(node->right, variables, vars);
+    interval left  = node->left ? evaluate(node->left, variables, vars) : right;
+
+    return interval_apply_op(get_op(node), left, right);
+}
+
+static interval add_intervals(interval left, interval right)
+{
+    return make_interval(left.low + right.low, left.high + right.high);
+}
+
+/**
+ * @brief Product, in which zero times infinity is zero
+ */
+static inline double bound_product(double first, double second)
+{
+    if (is_zero(first) || is_zero(second))
+        return 0;
+    return first * second;
+}
+
+static interval multiply_intervals(interval left, interval right)
+{
+    double products[] = {
+        bound_product(left.low,  right.low),
+        bound_product(left.low,  right.high),
+        bound_product(left.high, right.low),
+        bound_product(left.high, right.high)
+    };
+
+    double low  = products[0];
+    double high = products[0];
+    for (size_t i = 1; i < sizeof(products) / sizeof(*products); i++)
+    {
+        low  = fmin(low,  products[i]);
+        high = fmax(high, products[i]);
+    }
+
+    return make_interval(low, high);
+}
+
+static interval divide_intervals(interval left, interval right)
+{
+    if (!contains_zero(right))
+        return multiply_intervals(left, make_interval(1 / right.high, 1 / right.low));
+
+    if (is_zero(right.low) && is_zero(right.high))
+        return UNDEFINED_INTERVAL;
+
+    /* Division by zero gives pole */
+    interval reciprocal = {.low = -INFINITY, .high = INFINITY, .domain = IV_DEFINED};
+    if (is_zero(right.low))
+        reciprocal = make_interval(1 / right.high, INFINITY);
+    else if (is_zero(right.high))
+        reciprocal = make_interval(-INFINITY, 1 / right.low);
+
+    interval result = multiply_intervals(left, reciprocal);
+    result.domain = IV_PARTIAL;
+    return result;
+}
+
+static interval power_intervals(interval base, interval exponent)
+{
+    if (fpclassify(exponent.low - exponent.high) == FP_ZERO
+        && fpclassify(exponent.low - nearbyint(exponent.low)) == FP_ZERO)
+        return integer_power(base, exponent.low);
+
+    interval result = UNDEFINED_INTERVAL;
+    if (!isless(base.high, 0))
+        result = real_power({fmax(base.low, 0), base.high, IV_DEFINED}, exponent);
+
+    if (!isless(base.low, 0))
+        return result;
+
+    /* Negative base is only allowed at integer exponents, where value has
+     * magnitude of `|base|^exponent` and either sign */
+    if (islessequal(ceil(exponent.low), floor(exponent.high)))
+    {
+        interval magnitude = real_power({fmax(-base.high, 0), -base.low, IV_DEFINED}, exponent);
+
+        if (result.domain == IV_UNDEFINED)
+            result = {-magnitude.high, magnitude.high, IV_DEFINED};
+        else
+        {
+            result.low  = fmin(result.low,  -magnitude.high);
+            result.high = fmax(result.high,  magnitude.high);
+        }
+    }
+
+    if (result.domain != IV_UNDEFINED)
+        result.domain = IV_PARTIAL;
+
+    return result;
+}
+
+static interval integer_power(interval base, double exponent)
+{
+    if (is_zero(exponent))
+        return {.low = 1, .high = 1, .domain = IV_DEFINED};
+
+    if (isless(exponent, 0))
+        return divide_intervals({1, 1, IV_DEFINED}, integer_power(base, -exponent));
+
+    if (isgreater(fabs(fmod(exponent, 2)), 0))
+        return make_interval(pow(base.low, exponent), pow(base.high, exponent));
+
+    double low_abs  = contains_zero(base) ? 0 : fmin(fabs(base.low), fabs(base.high));
+    double high_abs = fmax(fabs(base.low), fabs(base.high));
+
+    interval result = make_interval(pow(low_abs, exponent), pow(high_abs, exponent));
+    result.low = fmax(result.low, 0);
+    return result;
+}
+
+/**
+ * @brief Power with non-negative base, computed as `exp(exponent * ln(base))`
+ */
+static interval real_power(interval base, interval exponent)
+{
+    /* Logarithm of zero is `-inf`, making zero base work as well */
+    interval logarithm = make_interval(log(base.low), log(base.high));
+    interval product = multiply_intervals(exponent, logarithm);
+
+    interval result = make_interval(exp(product.low), exp(product.high));
+    result.low = fmax(result.low, 0);
+
+    /* Zero to negative power is infinite */
+    if (is_zero(base.low) && isless(exponent.low, 0))
+        result.domain = IV_PARTIAL;
+
+    return result;
+}
+
+static interval enclose_monotone(interval arg, math_function* func, int increasing)
+{
+    if (arg.domain == IV_UNDEFINED)
+        return arg;
+
+    interval result = increasing ? make_interval(func(arg.low),  func(arg.high))
+                                 : make_interval(func(arg.high), func(arg.low));
+    result.domain = arg.domain;
+    return result;
+}
+
+/**
+ * @brief Enclose function with period of `2 pi` and range `[-1, 1]`
+ *
+ * @param[in] max_phase Point, where function reaches maximum
+ * @param[in] min_phase Point, where function reaches minimum
+ */
+static interval enclose_periodic(interval arg, math_function* func,
+                                 double max_phase, double min_phase)
+{
+    interval result = {.low = -1, .high = 1, .domain = IV_DEFINED};
+
+    if (!isfinite(arg.low) || !isfinite(arg.high) || !isless(arg.high - arg.low, 2 * M_PI))
+        return result;
+
+    double at_low  = func(arg.low);
+    double at_high = func(arg.high);
+
+    if (!contains_phase(arg, max_phase, 2 * M_PI))
+        result.high = fmin(round_outward(fmax(at_low, at_high),  1),  1);
+    if (!contains_phase(arg, min_phase, 2 * M_PI))
+        result.low  = fmax(round_outward(fmin(at_low, at_high), -1), -1);
+
+    return result;
+}
+
+/**
+ * @brief Enclose function with period of `pi`, which is monotone between
+ * its poles
+ *
+ * @param[in] pole_phase Point, where function has pole
+ */
+static interval enclose_tangent(interval arg, math_function* func, double pole_phase)
+{
+    if (!isfinite(arg.low) || !isfinite(arg.high) || !isless(arg.high - arg.low, M_PI)
+        || contains_phase(arg, pole_phase, M_PI))
+        return {.low = -INFINITY, .high = INFINITY, .domain = IV_PARTIAL};
+
+    /* Both tangent and cotangent are increasing or decreasing everywhere */
+    double at_low  = func(arg.low);
+    double at_high = func(arg.high);
+
+    return make_interval(fmin(at_low, at_high), fmax(at_low, at_high));
+}
+
+/**
+ * @brief Intersect argument with function domain `[low, high]`
+ */
+static interval clip_domain(interval arg, double low, double high)
+{
+    if (isless(arg.high, low) || isgreater(arg.low, high))
+        return UNDEFINED_INTERVAL;
+
+    if (isless(arg.low, low) || isgreater(arg.high, high))
+        return {.low = fmax(arg.low, low), .high = fmin(arg.high, high), .domain = IV_PARTIAL};
+
+    return arg;
+}
+
+/**
+ * @brief Check if interval contains any point `phase + k * period`
+ */
+static int contains_phase(interval arg, double phase, double period)
+{
+    double slack = PHASE_SLACK * fmax(1, fmax(fabs(arg.low), fabs(arg.high)));
+    double index = ceil((arg.low - slack - phase) / period);
+
+    return islessequal(phase + index * period, arg.high + slack);
+}
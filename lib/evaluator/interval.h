@@ -0,0 +1,78 @@
+/**
+ * @file interval.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Interval arithmetic evaluation of syntax trees
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Result encloses values of expression at every point of variable
+ * intervals, where expression is defined. Bounds are rounded outwards, so
+ * enclosure holds despite floating-point errors, though it may be much wider
+ * than actual range of values.
+ */
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include "ast.h"
+
+/**
+ * @brief Part of variable intervals, where expression is defined
+ */
+enum interval_domain
+{
+    /**
+     * @brief Expression is defined and finite everywhere
+     */
+    IV_DEFINED,
+    /**
+     * @brief Expression may be undefined or infinite somewhere
+     */
+    IV_PARTIAL,
+    /**
+     * @brief Expression is undefined everywhere, bounds are NaN
+     */
+    IV_UNDEFINED
+};
+
+struct interval
+{
+    double low;
+    double high;
+    interval_domain domain;
+};
+
+/**
+ * @brief Enclose values of expression over intervals of its variables
+ *
+ * @param[in] ast Evaluated expression
+ * @param[in] vars Variable intervals, indexed by variable slot
+ * @return Enclosure of expression values
+ */
+interval interval_evaluate(const abstract_syntax_tree* ast, const interval* vars);
+
+/**
+ * @brief Enclose values of subtree over intervals of its variables
+ *
+ * @param[in] node Subtree root
+ * @param[in] variables Tree variables, defining variable slots
+ * @param[in] vars Variable intervals, indexed by variable slot
+ * @return Enclosure of subtree values
+ */
+interval interval_evaluate_node(const ast_node* node,
+                                const dynamic_array(var_name)* variables,
+                                const interval* vars);
+
+/**
+ * @brief Enclose result of single operation
+ *
+ * @param[in] op Operation
+ * @param[in] left Left operand enclosure (ignored for unary operations)
+ * @param[in] right Right operand enclosure
+ * @return Enclosure of operation result
+ */
+interval interval_apply_op(op_type op, interval left, interval right);
+
+#endif
@@ -0,0 +1,659 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_NATIVE 1
+#else
+#define JIT_NATIVE 0
+#endif
+
+#include "logger.h"
+
+#include "batch_eval.h"
+#include "jit.h"
+
+#if JIT_NATIVE
+
+/**
+ * @brief Generated machine code
+ */
+struct code_buffer
+{
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    int failed;
+};
+
+/**
+ * @brief Code generation state. Top of evaluation stack is kept in `xmm0`,
+ * the rest of stack, temporaries and scratch space for calls are stored in
+ * stack frame. Register `rbx` holds pointer to variables.
+ */
+struct jit_state
+{
+    code_buffer* code;
+    int packed;
+    size_t depth;
+
+    size_t lane_size;
+    size_t temp_offset;
+    size_t scratch_offset;
+    size_t frame_size;
+
+    size_t loop_start;
+    size_t loop_exit;
+};
+
+enum x86_reg
+{
+    REG_RAX = 0,
+    REG_RBX = 3,
+    REG_RSP = 4,
+};
+
+static const unsigned char PREFIX_SCALAR = 0xF2;
+static const unsigned char PREFIX_PACKED = 0x66;
+
+static const unsigned char SSE_LOAD  = 0x10;
+static const unsigned char SSE_STORE = 0x11;
+static const unsigned char SSE_SQRT  = 0x51;
+static const unsigned char SSE_ADD   = 0x58;
+static const unsigned char SSE_MUL   = 0x59;
+static const unsigned char SSE_SUB   = 0x5C;
+static const unsigned char SSE_DIV   = 0x5E;
+
+/**
+ * @brief Maximal exponent, for which power is computed by multiplication
+ */
+static const double MAX_UNROLLED_POWER = 32;
+
+static void code_append(code_buffer* code, unsigned char byte);
+static int  generate(code_buffer* code, const bytecode_program* program, int packed);
+static int  generate_instruction(jit_state* state, const bc_instruction* instruction);
+static void* make_executable(const code_buffer* code, size_t* size);
+
+#endif
+
+int jit_compile(jit_function* func, const abstract_syntax_tree* ast)
+{
+    LOG_ASSERT(func != NULL, return -1);
+    LOG_ASSERT(ast != NULL, return -1);
+
+    *func = {};
+
+    if (bytecode_compile(&func->program, ast) != 0)
+        return -1;
+
+#if JIT_NATIVE
+    if (!__builtin_cpu_supports("sse2"))
+        return 0;
+
+    code_buffer code = {};
+
+    /* Packed variant is placed right after the scalar one */
+    int status = generate(&code, &func->program, 0);
+    while (code.size % 16 != 0)
+        code_append(&code, 0xCC);           /* int3 */
+
+    size_t packed_start = code.size;
+    if (status == 0)
+        status = generate(&code, &func->program, 1);
+
+    if (status == 0 && !code.failed)
+        func->code = make_executable(&code, &func->code_size);
+
+    free(code.data);
+
+    if (func->code)
+    {
+        /* Object pointers cannot be cast to function pointers directly */
+        unsigned char* packed_code = (unsigned char*) func->code + packed_start;
+        memcpy(&func->scalar, &func->code,  sizeof(func->scalar));
+        memcpy(&func->packed, &packed_code, sizeof(func->packed));
+    }
+#endif
+
+    return 0;
+}
+
+void jit_dtor(jit_function* func)
+{
+    LOG_ASSERT(func != NULL, return);
+
+#if JIT_NATIVE
+    if (func->code)
+        munmap(func->code, func->code_size);
+#endif
+
+    bytecode_dtor(&func->program);
+    *func = {};
+}
+
+double jit_evaluate(const jit_function* func, const double* vars)
+{
+    LOG_ASSERT(func != NULL, return NAN);
+
+    if (func->scalar)
+        return func->scalar(vars);
+
+    return bytecode_evaluate(&func->program, vars);
+}
+
+int jit_evaluate_batch(const jit_function* func,
+                       const double* const* vars,
+                       size_t count,
+                       double* output)
+{
+    LOG_ASSERT(func != NULL, return -1);
+    LOG_ASSERT(output != NULL, return -1);
+
+    if (!func->packed)
+        return batch_evaluate(&func->program, vars, count, output);
+
+    size_t packed_count = count - count % JIT_LANES;
+    func->packed(vars, packed_count, output);
+
+    if (packed_count == count)
+        return 0;
+
+    size_t var_count = func->program.var_count;
+    double* point = (double*) calloc(var_count + 1, sizeof(*point));
+
+    LOG_ASSERT_ERROR(point != NULL, return -1,
+        "Failed to allocate variable values", NULL);
+
+    for (size_t i = packed_count; i < count; i++)
+    {
+        for (size_t var = 0; var < var_count; var++)
+            point[var] = vars[var][i];
+
+        output[i] = jit_evaluate(func, point);
+    }
+
+    free(point);
+    return 0;
+}
+
+#if JIT_NATIVE
+
+static void code_append(code_buffer* code, unsigned char byte)
+{
+    if (code->failed) return;
+
+    if (code->size == code->capacity)
+    {
+        size_t new_capacity = code->capacity ? 2 * code->capacity : 256;
+        unsigned char* new_data = (unsigned char*) realloc(code->data, new_capacity);
+        LOG_ASSERT_ERROR(new_data != NULL, { code->failed = 1; return; },
+            "Failed to allocate code buffer", NULL);
+
+        code->data = new_data;
+        code->capacity = new_capacity;
+    }
+
+    code->data[code->size++] = byte;
+}
+
+static void emit_byte(jit_state* state, unsigned char byte)
+{
+    code_append(state->code, byte);
+}
+
+static void emit_bytes(jit_state* state, size_t count, const unsigned char* bytes)
+{
+    for (size_t i = 0; i < count; i++)
+        emit_byte(state, bytes[i]);
+}
+
+static void emit_imm32(jit_state* state, uint32_t value)
+{
+    for (size_t i = 0; i < sizeof(value); i++)
+        emit_byte(state, (unsigned char) (value >> (8 * i)));
+}
+
+static void emit_imm64(jit_state* state, uint64_t value)
+{
+    for (size_t i = 0; i < sizeof(value); i++)
+        emit_byte(state, (unsigned char) (value >> (8 * i)));
+}
+
+/* ModRM with 32-bit displacement from `base` */
+static void emit_modrm_mem(jit_state* state, unsigned reg, x86_reg base, size_t disp)
+{
+    emit_byte(state, (unsigned char) (0x80 | (reg << 3) | (unsigned) base));
+    if (base == REG_RSP)
+        emit_byte(state, 0x24);     /* SIB: no index */
+    emit_imm32(state, (uint32_t) disp);
+}
+
+/* `op xmm<reg>, [base + disp]` or `op [base + disp], xmm<reg>` */
+static void emit_sse_mem(jit_state* state, unsigned char opcode, unsigned reg,
+                         x86_reg base, size_t disp)
+{
+    emit_byte(state, state->packed ? PREFIX_PACKED : PREFIX_SCALAR);
+    emit_byte(state, 0x0F);
+    emit_byte(state, opcode);
+    emit_modrm_mem(state, reg, base, disp);
+}
+
+/* `op xmm<dest>, xmm<src>` */
+static void emit_sse_reg(jit_state* state, unsigned char opcode, unsigned dest, unsigned src)
+{
+    emit_byte(state, state->packed ? PREFIX_PACKED : PREFIX_SCALAR);
+    emit_byte(state, 0x0F);
+    emit_byte(state, opcode);
+    emit_byte(state, (unsigned char) (0xC0 | (dest << 3) | src));
+}
+
+/* `movapd xmm<dest>, xmm<src>` */
+static void emit_move(jit_state* state, unsigned dest, unsigned src)
+{
+    emit_byte(state, 0x66);
+    emit_byte(state, 0x0F);
+    emit_byte(state, 0x28);
+    emit_byte(state, (unsigned char) (0xC0 | (dest << 3) | src));
+}
+
+/* Broadcast 64-bit pattern to all lanes of `xmm<reg>` */
+static void emit_constant(jit_state* state, unsigned reg, uint64_t bits)
+{
+    static const unsigned char mov_rax[] = {0x48, 0xB8};
+    emit_bytes(state, sizeof(mov_rax), mov_rax);
+    emit_imm64(state, bits);
+
+    static const unsigned char movq[] = {0x66, 0x48, 0x0F, 0x6E};
+    emit_bytes(state, sizeof(movq), movq);
+    emit_byte(state, (unsigned char) (0xC0 | (reg << 3)));
+
+    if (state->packed)
+    {
+        static const unsigned char unpcklpd[] = {0x66, 0x0F, 0x14};
+        emit_bytes(state, sizeof(unpcklpd), unpcklpd);
+        emit_byte(state, (unsigned char) (0xC0 | (reg << 3) | reg));
+    }
+}
+
+/* `mov rax, address; call rax` */
+static void emit_call(jit_state* state, uint64_t address)
+{
+    static const unsigned char mov_rax[] = {0x48, 0xB8};
+    emit_bytes(state, sizeof(mov_rax), mov_rax);
+    emit_imm64(state, address);
+
+    static const unsigned char call_rax[] = {0xFF, 0xD0};
+    emit_bytes(state, sizeof(call_rax), call_rax);
+}
+
+static size_t stack_slot(const jit_state* state, size_t index)
+{
+    return index * state->lane_size;
+}
+
+static size_t temp_slot(const jit_state* state, size_t index)
+{
+    return state->temp_offset + index * state->lane_size;
+}
+
+static void push_top(jit_state* state)
+{
+    if (state->depth > 0)
+        emit_sse_mem(state, SSE_STORE, 0, REG_RSP, stack_slot(state, state->depth - 1));
+    state->depth++;
+}
+
+static double call_cot   (double arg) { return 1 / tan(arg);      }
+static double call_arccot(double arg) { return M_PI_2 - atan(arg); }
+
+typedef double (*unary_func)(double arg);
+
+static unary_func get_function(bc_opcode op)
+{
+    switch (op)
+    {
+    case BC_LN:     return (unary_func) log;
+    case BC_SIN:    return (unary_func) sin;
+    case BC_COS:    return (unary_func) cos;
+    case BC_TAN:    return (unary_func) tan;
+    case BC_COT:    return call_cot;
+    case BC_ARCSIN: return (unary_func) asin;
+    case BC_ARCCOS: return (unary_func) acos;
+    case BC_ARCTAN: return (unary_func) atan;
+    case BC_ARCCOT: return call_arccot;
+    default:        return NULL;
+    }
+}
+
+/* `movsd xmm<reg>, [rsp + disp]` or `movsd [rsp + disp], xmm<reg>` */
+static void emit_scalar_move(jit_state* state, unsigned char opcode, unsigned reg, size_t disp)
+{
+    emit_byte(state, PREFIX_SCALAR);
+    emit_byte(state, 0x0F);
+    emit_byte(state, opcode);
+    emit_modrm_mem(state, reg, REG_RSP, disp);
+}
+
+/* Calls function of top of stack and, for `BC_POW`, operand stored in
+ * `xmm1`. Library functions are scalar, so packed operands are passed
+ * through scratch space one lane at a time. */
+static void emit_function_call(jit_state* state, bc_opcode op)
+{
+    uintptr_t address = op == BC_POW ? (uintptr_t) (double (*)(double, double)) pow
+                                     : (uintptr_t) get_function(op);
+
+    if (!state->packed)
+    {
+        emit_call(state, address);
+        return;
+    }
+
+    size_t results  = state->scratch_offset;
+    size_t operands = state->scratch_offset + JIT_LANES * sizeof(double);
+
+    if (op == BC_POW)
+    {
+        emit_sse_mem(state, SSE_STORE, 0, REG_RSP, results);
+        emit_sse_mem(state, SSE_STORE, 1, REG_RSP, operands);
+    }
+    else
+        emit_sse_mem(state, SSE_STORE, 0, REG_RSP, operands);
+
+    for (size_t lane = 0; lane < JIT_LANES; lane++)
+    {
+        size_t offset = lane * sizeof(double);
+        if (op == BC_POW)
+        {
+            emit_scalar_move(state, SSE_LOAD, 0, results  + offset);
+            emit_scalar_move(state, SSE_LOAD, 1, operands + offset);
+        }
+        else
+            emit_scalar_move(state, SSE_LOAD, 0, operands + offset);
+
+        emit_call(state, address);
+        emit_scalar_move(state, SSE_STORE, 0, results + offset);
+    }
+
+    emit_sse_mem(state, SSE_LOAD, 0, REG_RSP, results);
+}
+
+static void emit_prologue(jit_state* state);
+static void emit_epilogue(jit_state* state);
+static int  emit_whole_power(jit_state* state, double exponent);
+
+static int generate(code_buffer* code, const bytecode_program* program, int packed)
+{
+    size_t lane_size = packed ? JIT_LANES * sizeof(double) : sizeof(double);
+
+    jit_state state = {
+        .code = code,
+        .packed = packed,
+        .depth = 0,
+        .lane_size = lane_size,
+        .temp_offset    = program->stack_size * lane_size,
+        .scratch_offset = (program->stack_size + program->temp_count) * lane_size,
+        .frame_size = 0,
+        .loop_start = 0,
+        .loop_exit = 0
+    };
+
+    /* Pushed registers keep stack aligned by 16 bytes */
+    state.frame_size = (state.scratch_offset + 2 * JIT_LANES * sizeof(double) + 15)
+                     & ~(size_t) 15;
+
+    emit_prologue(&state);
+
+    const bc_instruction* instructions = program->code.data;
+    for (size_t i = 0; i < program->code.size; i++)
+    {
+        /* Constant whole powers are computed by repeated squaring */
+        if (i + 1 < program->code.size
+            && instructions[i].op == BC_NUM && instructions[i + 1].op == BC_POW
+            && emit_whole_power(&state, instructions[i].arg.num) == 0)
+        {
+            i++;
+            continue;
+        }
+
+        if (generate_instruction(&state, &instructions[i]) != 0)
+            return -1;
+    }
+
+    emit_epilogue(&state);
+
+    return code->failed ? -1 : 0;
+}
+
+/*
+ * Scalar variant:  double f(const double* vars)
+ *     rbx - vars
+ *
+ * Packed variant:  void f(const double* const* vars, size_t count, double* output)
+ *     rbx - vars, r12 - offset of current points, r13 - end offset,
+ *     r14 - output
+ */
+static void emit_prologue(jit_state* state)
+{
+    if (!state->packed)
+    {
+        emit_byte(state, 0x53);                                 /* push rbx */
+    }
+    else
+    {
+        static const unsigned char push[] = {
+            0x55,                                               /* push rbp */
+            0x53,                                               /* push rbx */
+            0x41, 0x54,                                         /* push r12 */
+            0x41, 0x55,                                         /* push r13 */
+            0x41, 0x56,                                         /* push r14 */
+        };
+        emit_bytes(state, sizeof(push), push);
+    }
+
+    static const unsigned char sub_rsp[] = {0x48, 0x81, 0xEC};
+    emit_bytes(state, sizeof(sub_rsp), sub_rsp);
+    emit_imm32(state, (uint32_t) state->frame_size);
+
+    static const unsigned char mov_rbx_rdi[] = {0x48, 0x89, 0xFB};
+    emit_bytes(state, sizeof(mov_rbx_rdi), mov_rbx_rdi);
+
+    if (!state->packed)
+        return;
+
+    static const unsigned char setup[] = {
+        0x49, 0x89, 0xF5,                                       /* mov r13, rsi  */
+        0x49, 0xC1, 0xE5, 0x03,                                 /* shl r13, 3    */
+        0x49, 0x89, 0xD6,                                       /* mov r14, rdx  */
+        0x45, 0x31, 0xE4,                                       /* xor r12d, r12d */
+    };
+    emit_bytes(state, sizeof(setup), setup);
+
+    state->loop_start = state->code->size;
+
+    static const unsigned char check[] = {
+        0x4D, 0x39, 0xEC,                                       /* cmp r12, r13 */
+        0x0F, 0x83,                                             /* jae exit     */
+    };
+    emit_bytes(state, sizeof(check), check);
+
+    state->loop_exit = state->code->size;
+    emit_imm32(state, 0);
+}
+
+static void emit_epilogue(jit_state* state)
+{
+    if (state->packed)
+    {
+        static const unsigned char next[] = {
+            0x66, 0x43, 0x0F, 0x11, 0x04, 0x26,                 /* movupd [r14 + r12], xmm0 */
+            0x49, 0x83, 0xC4, 0x10,                             /* add r12, 16 */
+            0xE9,                                               /* jmp loop */
+        };
+        emit_bytes(state, sizeof(next), next);
+        emit_imm32(state, (uint32_t) (state->loop_start - (state->code->size + 4)));
+
+        /* Patch loop exit jump */
+        size_t exit_offset = state->code->size - (state->loop_exit + 4);
+        if (!state->code->failed)
+            for (size_t i = 0; i < 4; i++)
+                state->code->data[state->loop_exit + i] = (unsigned char) (exit_offset >> (8 * i));
+    }
+
+    static const unsigned char add_rsp[] = {0x48, 0x81, 0xC4};
+    emit_bytes(state, sizeof(add_rsp), add_rsp);
+    emit_imm32(state, (uint32_t) state->frame_size);
+
+    if (!state->packed)
+    {
+        emit_byte(state, 0x5B);                                 /* pop rbx */
+    }
+    else
+    {
+        static const unsigned char pop[] = {
+            0x41, 0x5E,                                         /* pop r14 */
+            0x41, 0x5D,                                         /* pop r13 */
+            0x41, 0x5C,                                         /* pop r12 */
+            0x5B,                                               /* pop rbx */
+            0x5D,                                               /* pop rbp */
+        };
+        emit_bytes(state, sizeof(pop), pop);
+    }
+
+    emit_byte(state, 0xC3);                                     /* ret */
+}
+
+/* Raise top of stack to constant power without calling `pow` */
+static int emit_whole_power(jit_state* state, double exponent)
+{
+    if (!(exponent >= 1 && exponent <= MAX_UNROLLED_POWER) || exponent > floor(exponent))
+        return -1;
+
+    unsigned power = (unsigned) exponent;
+
+    emit_move(state, 1, 0);
+
+    unsigned bit = 1;
+    while (2 * bit <= power)
+        bit *= 2;
+
+    for (bit /= 2; bit > 0; bit /= 2)
+    {
+        emit_sse_reg(state, SSE_MUL, 0, 0);
+        if (power & bit)
+            emit_sse_reg(state, SSE_MUL, 0, 1);
+    }
+
+    return 0;
+}
+
+static int generate_instruction(jit_state* state, const bc_instruction* instruction)
+{
+    size_t left = state->depth >= 2 ? stack_slot(state, state->depth - 2) : 0;
+
+    switch (instruction->op)
+    {
+    case BC_NUM:
+    {
+        push_top(state);
+        uint64_t bits = 0;
+        memcpy(&bits, &instruction->arg.num, sizeof(bits));
+        emit_constant(state, 0, bits);
+        return 0;
+    }
+    case BC_VAR:
+        push_top(state);
+        if (!state->packed)
+            emit_sse_mem(state, SSE_LOAD, 0, REG_RBX, instruction->arg.var * sizeof(double));
+        else
+        {
+            static const unsigned char mov_rax[] = {0x48, 0x8B};  /* mov rax, [rbx + disp] */
+            emit_bytes(state, sizeof(mov_rax), mov_rax);
+            emit_modrm_mem(state, REG_RAX, REG_RBX, instruction->arg.var * sizeof(double*));
+
+            static const unsigned char load[] = {               /* movupd xmm0, [rax + r12] */
+                0x66, 0x42, 0x0F, 0x10, 0x04, 0x20
+            };
+            emit_bytes(state, sizeof(load), load);
+        }
+        return 0;
+    case BC_LOAD:
+        push_top(state);
+        emit_sse_mem(state, SSE_LOAD, 0, REG_RSP, temp_slot(state, instruction->arg.var));
+        return 0;
+    case BC_STORE:
+        emit_sse_mem(state, SSE_STORE, 0, REG_RSP, temp_slot(state, instruction->arg.var));
+        return 0;
+
+    case BC_ADD:
+    case BC_MUL:
+        emit_sse_mem(state, instruction->op == BC_ADD ? SSE_ADD : SSE_MUL, 0, REG_RSP, left);
+        break;
+    case BC_SUB:
+    case BC_DIV:
+        emit_sse_mem(state, SSE_LOAD, 1, REG_RSP, left);
+        emit_sse_reg(state, instruction->op == BC_SUB ? SSE_SUB : SSE_DIV, 1, 0);
+        emit_move(state, 0, 1);
+        break;
+    case BC_RSUB:
+    case BC_RDIV:
+        emit_sse_mem(state, instruction->op == BC_RSUB ? SSE_SUB : SSE_DIV, 0, REG_RSP, left);
+        break;
+    case BC_POW:
+        emit_move(state, 1, 0);
+        emit_sse_mem(state, SSE_LOAD, 0, REG_RSP, left);
+        emit_function_call(state, BC_POW);
+        break;
+    case BC_RPOW:
+        emit_sse_mem(state, SSE_LOAD, 1, REG_RSP, left);
+        emit_function_call(state, BC_POW);
+        break;
+
+    case BC_NEG:
+        emit_constant(state, 1, 0x8000000000000000);
+        {
+            static const unsigned char xorpd[] = {0x66, 0x0F, 0x57, 0xC1};
+            emit_bytes(state, sizeof(xorpd), xorpd);
+        }
+        return 0;
+    case BC_SQRT:
+        emit_sse_reg(state, SSE_SQRT, 0, 0);
+        return 0;
+
+    default:
+        LOG_ASSERT_ERROR(get_function(instruction->op) != NULL, return -1,
+            "Unsupported opcode %d", (int) instruction->op);
+        emit_function_call(state, instruction->op);
+        return 0;
+    }
+
+    /* Binary operation consumed one stack slot */
+    state->depth--;
+    return 0;
+}
+
+static void* make_executable(const code_buffer* code, size_t* size)
+{
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    *size = (code->size + page_size - 1) / page_size * page_size;
+
+    void* memory = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return NULL;
+
+    memcpy(memory, code->data, code->size);
+
+    /* Memory is never writable and executable at the same time */
+    if (mprotect(memory, *size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, *size);
+        return NULL;
+    }
+
+    return memory;
+}
+
+#endif
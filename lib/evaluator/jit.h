@@ -0,0 +1,116 @@
+/**
+ * @file jit.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Native code generation for compiled expressions
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Machine code is generated from bytecode, so it shares constant
+ * folding and temporaries of repeated subexpressions with interpreter. Only
+ * x86-64 with SSE2 is supported, on other platforms or if executable memory
+ * cannot be allocated, interpreter is used instead.
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+
+#include "bytecode.h"
+
+/**
+ * @brief Native expression evaluator
+ *
+ * @param[in] vars Variable values, indexed by variable slot
+ * @return Expression value
+ */
+typedef double (*jit_scalar_func)(const double* vars);
+
+/**
+ * @brief Native evaluator, computing expression at `JIT_LANES` points at once
+ *
+ * @param[in] vars Array of pointers to `count` values of each variable
+ * (structure of arrays)
+ * @param[in] count Number of points, multiple of `JIT_LANES`
+ * @param[out] output Array of `count` results
+ */
+typedef void (*jit_packed_func)(const double* const* vars, size_t count, double* output);
+
+/**
+ * @brief Number of points evaluated by packed variant
+ */
+const size_t JIT_LANES = 2;
+
+/**
+ * @brief Compiled expression
+ */
+struct jit_function
+{
+    /**
+     * @brief Native scalar evaluator, `NULL` if native code is unavailable
+     */
+    jit_scalar_func scalar;
+    /**
+     * @brief Native packed evaluator, `NULL` if native code is unavailable
+     */
+    jit_packed_func packed;
+
+    /**
+     * @brief Executable memory holding both evaluators
+     */
+    void* code;
+    /**
+     * @brief Size of executable memory
+     */
+    size_t code_size;
+
+    /**
+     * @brief Bytecode, interpreted if native code is unavailable
+     */
+    bytecode_program program;
+};
+
+/**
+ * @brief Compile syntax tree into native code
+ *
+ * @param[out] func Constructed function
+ * @param[in] ast Compiled tree
+ * @return 0 upon success, -1 otherwise. Failure to generate native code is
+ * not an error, as interpreter is used then.
+ */
+int jit_compile(jit_function* func, const abstract_syntax_tree* ast);
+
+/**
+ * @brief Destroy compiled function
+ *
+ * @param[inout] func `jit_function` instance to be destroyed
+ */
+void jit_dtor(jit_function* func);
+
+/**
+ * @brief Evaluate compiled function
+ *
+ * @param[in] func Compiled function
+ * @param[in] vars Variable values, indexed by variable slot
+ * @return Expression value
+ */
+double jit_evaluate(const jit_function* func, const double* vars);
+
+/**
+ * @brief Evaluate compiled function for multiple points
+ *
+ * @param[in] func Compiled function
+ * @param[in] vars Array of `var_count` pointers to `count` values of each
+ * variable (structure of arrays)
+ * @param[in] count Number of points
+ * @param[out] output Array of `count` results
+ * @return 0 upon success, -1 otherwise
+ */
+int jit_evaluate_batch(const jit_function* func,
+                       const double* const* vars,
+                       size_t count,
+                       double* output);
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ * @file simd_math.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Vectorized elementary functions used by batch evaluator
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Functions operate on GCC generic vectors of `SIMD_LANES` doubles and
+ * are always inlined, so that they are compiled for the instruction set of
+ * the calling kernel (SSE2, AVX2 or AVX-512). Polynomial approximations
+ * follow Cephes and are accurate to a few ulp, except for `simd_pow()`,
+ * see its description.
+ */
+
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <stddef.h>
+#include <math.h>
+
+/* Vector arguments never cross a call boundary, helpers are always inlined */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef double    vec_double __attribute__((vector_size(64)));
+typedef long long vec_long   __attribute__((vector_size(64)));
+
+const size_t SIMD_LANES = sizeof(vec_double) / sizeof(double);
+
+#define SIMD_INLINE static inline __attribute__((always_inline))
+
+SIMD_INLINE vec_double simd_splat(double num)
+{
+    vec_double zero = {};
+    return zero + num;
+}
+
+SIMD_INLINE vec_double simd_load(const double* ptr)
+{
+    return *(const vec_double*) ptr;
+}
+
+SIMD_INLINE void simd_store(double* ptr, vec_double val)
+{
+    *(vec_double*) ptr = val;
+}
+
+SIMD_INLINE vec_double simd_select(vec_long mask, vec_double if_true, vec_double if_false)
+{
+    return mask ? if_true : if_false;
+}
+
+SIMD_INLINE vec_double simd_abs(vec_double x)
+{
+    return (vec_double) ((vec_long) x & 0x7fffffffffffffffLL);
+}
+
+SIMD_INLINE vec_double simd_floor(vec_double x)
+{
+    /* Values above 2^52 are already integer, NaN and infinities are kept */
+    vec_long exact = ~(simd_abs(x) < 4503599627370496.0);
+    vec_double safe = simd_select(exact, simd_splat(0), x);
+
+    vec_double trunc = __builtin_convertvector(
+                            __builtin_convertvector(safe, vec_long), vec_double);
+    trunc = simd_select(trunc > safe, trunc - 1, trunc);
+
+    return simd_select(exact, x, trunc);
+}
+
+/* 2^n for integer-valued n in [-1022, 1023] */
+SIMD_INLINE vec_double simd_pow2(vec_double n)
+{
+    return (vec_double) ((__builtin_convertvector(n, vec_long) + 1023) << 52);
+}
+
+SIMD_INLINE vec_double simd_sqrt(vec_double x)
+{
+    vec_double res = {};
+    for (size_t i = 0; i < SIMD_LANES; i++)
+        res[i] = __builtin_sqrt(x[i]);
+    return res;
+}
+
+SIMD_INLINE vec_double simd_exp(vec_double x)
+{
+    const double MAX_LOG =  7.09782712893383996843E2;
+    const double MIN_LOG = -7.45133219101941108420E2;
+    const double LOG2E   =  1.4426950408889634073599;
+    const double C1      =  6.93145751953125E-1;
+    const double C2      =  1.42860682030941723212E-6;
+
+    vec_long is_nan = x != x;
+    vec_double arg = simd_select(is_nan, simd_splat(0), x);
+    arg = simd_select(arg > MAX_LOG, simd_splat(MAX_LOG), arg);
+    arg = simd_select(arg < MIN_LOG, simd_splat(MIN_LOG), arg);
+
+    vec_double n = simd_floor(LOG2E * arg + 0.5);
+    arg = arg - n * C1;
+    arg = arg - n * C2;
+
+    vec_double xx = arg * arg;
+    vec_double px = arg * ((1.26177193074810590878E-4 * xx
+                            + 3.02994407707441961300E-2) * xx
+                            + 9.99999999999999999910E-1);
+    vec_double qx = ((3.00198505138664455042E-6 * xx
+                    + 2.52448340349684104192E-3) * xx
+                    + 2.27265548208155028766E-1) * xx
+                    + 2.00000000000000000009E0;
+
+    vec_double res = 1 + 2 * (px / (qx - px));
+
+    /* Scale in two steps, so that neither factor leaves normal range */
+    vec_double half = simd_floor(n * 0.5);
+    res = res * simd_pow2(half) * simd_pow2(n - half);
+
+    res = simd_select(x > MAX_LOG, simd_splat(__builtin_inf()), res);
+    res = simd_select(x < MIN_LOG, simd_splat(0), res);
+    return simd_select(is_nan, x, res);
+}
+
+SIMD_INLINE vec_double simd_log(vec_double x)
+{
+    const double SQRTH = 0.70710678118654752440;
+    const double MIN_NORMAL = 2.2250738585072014e-308;
+
+    vec_long subnormal = (x < MIN_NORMAL) & (x > 0);
+    vec_double arg = simd_select(subnormal, x * 18014398509481984.0 /* 2^54 */, x);
+
+    vec_long bits = (vec_long) arg;
+    vec_double e = __builtin_convertvector(((bits >> 52) & 0x7ff) - 1022, vec_double);
+    e = simd_select(subnormal, e - 54, e);
+
+    vec_double m = (vec_double) ((bits & 0x800fffffffffffffLL) | 0x3fe0000000000000LL);
+
+    vec_long small = m < SQRTH;
+    e = simd_select(small, e - 1, e);
+    m = simd_select(small, m + m - 1, m - 1);
+
+    vec_double z = m * m;
+    vec_double p = ((((1.01875663804580931796E-4 * m
+                    + 4.97494994976747001425E-1) * m
+                    + 4.70579119878881725854E0) * m
+                    + 1.44989225341610930846E1) * m
+                    + 1.79368678507819816313E1) * m
+                    + 7.70838733755885391666E0;
+    vec_double q = ((((m
+                    + 1.12873587189167450590E1) * m
+                    + 4.52279145837532221105E1) * m
+                    + 8.29875266912776603211E1) * m
+                    + 7.11544750618563894466E1) * m
+                    + 2.31251620126765340583E1;
+
+    vec_double y = m * (z * p / q);
+    y = y - e * 2.121944400546905827679e-4;
+    y = y - 0.5 * z;
+    vec_double res = m + y + e * 0.693359375;
+
+    res = simd_select(x == __builtin_inf(), x, res);
+    res = simd_select(x == 0, simd_splat(-__builtin_inf()), res);
+    return simd_select((x < 0) | (x != x), simd_splat(__builtin_nan("")), res);
+}
+
+/**
+ * Arguments with |x| above this threshold lose precision after range
+ * reduction and must be recomputed with scalar functions
+ */
+const double SIMD_TRIG_MAX_ARG = 1.073741824e9;
+
+SIMD_INLINE void simd_sincos(vec_double x, vec_double* sin_res, vec_double* cos_res)
+{
+    const double FOPI = 1.27323954473516268615;
+    const double DP1  = 7.85398125648498535156E-1;
+    const double DP2  = 3.77489470793079817668E-8;
+    const double DP3  = 2.69515142907905952645E-15;
+
+    vec_long negative = x < 0;
+    vec_double arg = simd_abs(x);
+    arg = simd_select(~(arg <= SIMD_TRIG_MAX_ARG), simd_splat(0), arg);
+
+    vec_long j = __builtin_convertvector(arg * FOPI, vec_long);
+    j = j + (j & 1);
+    vec_double y = __builtin_convertvector(j, vec_double);
+    j = j & 7;
+
+    vec_long upper = j > 3;
+    j = j & 3;
+
+    vec_double z = ((arg - y * DP1) - y * DP2) - y * DP3;
+    vec_double zz = z * z;
+
+    vec_double sin_poly = z + z * zz * (((((1.58962301576546568060E-10 * zz
+                                        - 2.50507477628578072866E-8) * zz
+                                        + 2.75573136213857245213E-6) * zz
+                                        - 1.98412698295895385996E-4) * zz
+                                        + 8.33333333332211858878E-3) * zz
+                                        - 1.66666666666666307295E-1);
+    vec_double cos_poly = 1 - 0.5 * zz + zz * zz * (((((-1.13585365213876817300E-11 * zz
+                                        + 2.08757008419747316778E-9) * zz
+                                        - 2.75573141792967388112E-7) * zz
+                                        + 2.48015872888517045348E-5) * zz
+                                        - 1.38888888888730564116E-3) * zz
+                                        + 4.16666666666665929218E-2);
+
+    vec_long swap = (j == 1) | (j == 2);
+
+    vec_double sin_val = simd_select(swap, cos_poly, sin_poly);
+    vec_double cos_val = simd_select(swap, sin_poly, cos_poly);
+
+    vec_long sin_flip = negative ^ upper;
+    vec_long cos_flip = upper ^ (j > 1);
+
+    *sin_res = simd_select(sin_flip, -sin_val, sin_val);
+    *cos_res = simd_select(cos_flip, -cos_val, cos_val);
+}
+
+SIMD_INLINE vec_double simd_atan(vec_double x)
+{
+    const double T3P8     = 2.41421356237309504880;
+    const double MOREBITS = 6.123233995736765886130E-17;
+
+    vec_long negative = x < 0;
+    vec_double arg = simd_abs(x);
+
+    vec_long big = arg > T3P8;
+    vec_long mid = ~big & (arg > 0.66);
+
+    vec_double num = simd_select(big, simd_splat(-1),
+                        simd_select(mid, arg - 1, arg));
+    vec_double den = simd_select(big, arg,
+                        simd_select(mid, arg + 1, simd_splat(1)));
+    vec_double base = simd_select(big, simd_splat(M_PI_2),
+                        simd_select(mid, simd_splat(M_PI_4), simd_splat(0)));
+    vec_double extra = simd_select(big, simd_splat(MOREBITS),
+                        simd_select(mid, simd_splat(0.5 * MOREBITS), simd_splat(0)));
+
+    vec_double t = num / den;
+    vec_double z = t * t;
+    vec_double p = (((-8.750608600031904122785E-1 * z
+                    - 1.615753718733365076637E1) * z
+                    - 7.500855792314704667340E1) * z
+                    - 1.228866684490136173410E2) * z
+                    - 6.485021904942025371773E1;
+    vec_double q = ((((z
+                    + 2.485846490142306297962E1) * z
+                    + 1.650270098316988542046E2) * z
+                    + 4.328810604912902668951E2) * z
+                    + 4.853903996359136964868E2) * z
+                    + 1.945506571482613964425E2;
+
+    vec_double res = base + ((t * (z * p / q) + t) + extra);
+    return simd_select(negative, -res, res);
+}
+
+SIMD_INLINE vec_double simd_asin(vec_double x)
+{
+    vec_double den = simd_sqrt((1 - x) * (1 + x));
+    vec_long edge = den == 0;
+
+    vec_double res = simd_atan(x / simd_select(edge, simd_splat(1), den));
+    return simd_select(edge, simd_select(x < 0, simd_splat(-M_PI_2), simd_splat(M_PI_2)), res);
+}
+
+SIMD_INLINE vec_double simd_acos(vec_double x)
+{
+    vec_double den = 1 + x;
+    vec_long edge = den == 0;
+
+    vec_double res = 2 * simd_atan(simd_sqrt((1 - x) / simd_select(edge, simd_splat(1), den)));
+    return simd_select(edge, simd_splat(M_PI), res);
+}
+
+/* Computed as exp(exponent * ln|base|), so error of logarithm is scaled
+ * by exponent: relative error is about |exponent * ln(base)| ulp rather
+ * than a few ulp. Small whole exponents are handled by repeated
+ * multiplication in batch evaluator instead */
+SIMD_INLINE vec_double simd_pow(vec_double base, vec_double exponent)
+{
+    vec_double res = simd_exp(exponent * simd_log(simd_abs(base)));
+
+    vec_long is_int = simd_floor(exponent) == exponent;
+    vec_double half = exponent * 0.5;
+    vec_long is_odd = is_int & (simd_floor(half) != half);
+
+    vec_double signed_res = simd_select(is_odd, -res, res);
+    res = simd_select(base < 0,
+                simd_select(is_int, signed_res, simd_splat(__builtin_nan(""))),
+                res);
+
+    return simd_select((exponent == 0) | (base == 1), simd_splat(1), res);
+}
+
+#undef SIMD_INLINE
+
+#pragma GCC diagnostic pop
+
+#endif
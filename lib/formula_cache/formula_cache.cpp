@@ -0,0 +1,745 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#include "ast_binary.h"
+#include "formula_cache.h"
+#include "tree_math.h"
+
+#define ARRAY_ELEMENT cache_entry
+#include "dynamic_array_impl.h"
+
+static const char CACHE_MAGIC[8] = {'F', 'M', 'L', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t CACHE_VERSION = 2;
+
+static const size_t MIN_BUCKETS = 64;
+
+/**
+ * @brief Cache file header
+ */
+struct file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t clock;
+};
+
+/**
+ * @brief Header of every entry in cache file. Entry data follows it and is
+ * padded to multiple of 8 bytes.
+ */
+struct record_header
+{
+    uint64_t hash;
+    uint64_t last_used;
+    uint32_t key_size;
+    uint32_t tree_size;
+    uint32_t text_size;
+    /**
+     * @brief Lower half of data hash
+     */
+    uint32_t checksum;
+};
+
+enum cache_operation
+{
+    CACHE_DERIVATIVE,
+    CACHE_SIMPLIFY,
+    CACHE_TAYLOR
+};
+
+/**
+ * @brief Growing byte buffer
+ */
+struct cache_buffer
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+static void load_file(formula_cache* cache);
+static int  insert_entry(formula_cache* cache, cache_entry entry);
+static int  rehash(formula_cache* cache, size_t bucket_count);
+static void fill_buckets(formula_cache* cache, size_t* buckets, size_t bucket_count);
+static void evict_entries(formula_cache* cache);
+static void free_retired(formula_cache* cache);
+static cache_entry* find_entry(formula_cache* cache, uint64_t hash, const cache_buffer* key);
+static size_t record_size(const cache_entry* entry);
+static int  compare_recency(const void* first, const void* second);
+
+static int make_key(cache_buffer* key, cache_operation operation,
+                    const abstract_syntax_tree* ast,
+                    const char* var, double point, int pow);
+static abstract_syntax_tree* cache_find(formula_cache* cache, const cache_buffer* key,
+                                        abstract_syntax_tree* target, article_builder* article);
+static void cache_add(formula_cache* cache, const cache_buffer* key,
+                      const abstract_syntax_tree* result,
+                      const string_builder* text, size_t text_start);
+
+static void put_bytes (cache_buffer* buffer, const void* data, size_t size);
+static void put_u32   (cache_buffer* buffer, uint32_t value);
+static void put_string(cache_buffer* buffer, const char* str);
+
+static uint64_t hash_bytes(const uint8_t* data, size_t size);
+
+static inline size_t round_up(size_t size)
+{
+    return (size + 7) & ~(size_t) 7;
+}
+
+int formula_cache_ctor(formula_cache* cache, const char* filename, size_t max_size)
+{
+    LOG_ASSERT(cache != NULL, return -1);
+    LOG_ASSERT(filename != NULL, return -1);
+
+    *cache = {
+        .filename         = strdup(filename),
+        .max_size         = max_size,
+        .mapping          = NULL,
+        .mapping_size     = 0,
+        .entries          = {},
+        .buckets          = NULL,
+        .bucket_count     = 0,
+        .size             = sizeof(file_header),
+        .readers          = 0,
+        .retired          = NULL,
+        .retired_count    = 0,
+        .retired_capacity = 0,
+        .clock            = 1,
+        .modified         = 0,
+        .stats            = {},
+        .lock             = PTHREAD_MUTEX_INITIALIZER
+    };
+    array_ctor(&cache->entries);
+
+    LOG_ASSERT_ERROR(cache->filename != NULL, { formula_cache_dtor(cache); return -1; },
+        "Failed to allocate memory", NULL);
+    LOG_ASSERT(rehash(cache, MIN_BUCKETS) == 0, { formula_cache_dtor(cache); return -1; });
+
+    load_file(cache);
+
+    /* Limit may be lower than in previous run */
+    evict_entries(cache);
+    return 0;
+}
+
+void formula_cache_dtor(formula_cache* cache)
+{
+    LOG_ASSERT(cache != NULL, return);
+
+    if (cache->filename && cache->modified)
+        formula_cache_save(cache);
+
+    for (size_t i = 0; i < cache->entries.size; i++)
+        if (cache->entries.data[i].owned)
+            free(cache->entries.data[i].data);
+    free_retired(cache);
+    free(cache->retired);
+
+    array_dtor(&cache->entries);
+    free(cache->buckets);
+    free(cache->filename);
+
+    if (cache->mapping)
+        munmap(cache->mapping, cache->mapping_size);
+
+    pthread_mutex_destroy(&cache->lock);
+    *cache = {};
+}
+
+int formula_cache_save(formula_cache* cache)
+{
+    LOG_ASSERT(cache != NULL, return -1);
+
+    pthread_mutex_lock(&cache->lock);
+
+    size_t count = cache->entries.size;
+    const cache_entry** order = (const cache_entry**) calloc(count + 1, sizeof(*order));
+    char* tmp_name = NULL;
+    FILE* output = NULL;
+    int result = -1;
+
+    LOG_ASSERT_ERROR(order != NULL, goto cleanup, "Failed to allocate memory", NULL);
+    LOG_ASSERT(asprintf(&tmp_name, "%s.%d.tmp", cache->filename, getpid()) > 0,
+               { tmp_name = NULL; goto cleanup; });
+
+    for (size_t i = 0; i < count; i++)
+        order[i] = &cache->entries.data[i];
+
+    /* Most recently used entries are kept, while they fit */
+    qsort(order, count, sizeof(*order), compare_recency);
+
+    {
+        size_t total = sizeof(file_header);
+        size_t kept = 0;
+        while (kept < count && total + record_size(order[kept]) <= cache->max_size)
+            total += record_size(order[kept++]);
+
+        output = fopen(tmp_name, "wb");
+        LOG_ASSERT_ERROR(output != NULL, goto cleanup,
+            "Could not open file '%s'", tmp_name);
+
+        file_header header = {
+            .magic = {},
+            .version = CACHE_VERSION,
+            .entry_count = (uint32_t) kept,
+            .clock = cache->clock
+        };
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        fwrite(&header, sizeof(header), 1, output);
+
+        static const uint8_t padding[8] = {};
+        for (size_t i = 0; i < kept; i++)
+        {
+            const cache_entry* entry = order[i];
+            size_t data_size = (size_t) entry->key_size + entry->tree_size + entry->text_size;
+            record_header record = {
+                .hash      = entry->hash,
+                .last_used = entry->last_used,
+                .key_size  = entry->key_size,
+                .tree_size = entry->tree_size,
+                .text_size = entry->text_size,
+                .checksum  = (uint32_t) hash_bytes(entry->data, data_size)
+            };
+
+            fwrite(&record, sizeof(record), 1, output);
+            fwrite(entry->data, 1, data_size, output);
+            fwrite(padding, 1, round_up(data_size) - data_size, output);
+        }
+
+        int failed = ferror(output);
+        failed |= fclose(output);
+        output = NULL;
+        LOG_ASSERT_ERROR(!failed, { unlink(tmp_name); goto cleanup; },
+            "Could not write file '%s'", tmp_name);
+
+        /* Readers of old file still see it until they unmap it */
+        LOG_ASSERT_ERROR(rename(tmp_name, cache->filename) == 0,
+            { unlink(tmp_name); goto cleanup; },
+            "Could not replace file '%s'", cache->filename);
+
+        cache->stats.evictions += count - kept;
+        cache->modified = 0;
+        result = 0;
+    }
+
+cleanup:
+    if (output) fclose(output);
+    free(tmp_name);
+    free(order);
+    pthread_mutex_unlock(&cache->lock);
+    return result;
+}
+
+formula_cache_stats formula_cache_get_stats(formula_cache* cache)
+{
+    LOG_ASSERT(cache != NULL, return {});
+
+    pthread_mutex_lock(&cache->lock);
+    formula_cache_stats stats = cache->stats;
+    stats.entries = cache->entries.size;
+    stats.bytes   = cache->size;
+    pthread_mutex_unlock(&cache->lock);
+
+    return stats;
+}
+
+abstract_syntax_tree* cached_derivative(formula_cache* cache, abstract_syntax_tree* ast,
+                                        const char* var, article_builder* article)
+{
+    LOG_ASSERT(ast != NULL, return NULL);
+    LOG_ASSERT(article != NULL, return NULL);
+
+    /* Narration of complete article has phrases chosen already */
+    if (!cache || article->state != ARTC_FRAGMENT)
+        return derivative(ast, var, article);
+
+    cache_buffer key = {};
+    if (make_key(&key, CACHE_DERIVATIVE, ast, var, 0, 0) != 0)
+    {
+        free(key.data);
+        return derivative(ast, var, article);
+    }
+
+    abstract_syntax_tree* result = cache_find(cache, &key, NULL, article);
+    if (!result)
+    {
+        size_t text_start = article->text.size;
+        result = derivative(ast, var, article);
+        if (result)
+            cache_add(cache, &key, result, &article->text, text_start);
+    }
+
+    free(key.data);
+    return result;
+}
+
+void cached_simplify(formula_cache* cache, abstract_syntax_tree* ast)
+{
+    LOG_ASSERT(ast != NULL, return);
+
+    if (!cache)
+    {
+        simplify(ast);
+        return;
+    }
+
+    cache_buffer key = {};
+    if (make_key(&key, CACHE_SIMPLIFY, ast, "", 0, 0) != 0)
+    {
+        free(key.data);
+        simplify(ast);
+        return;
+    }
+
+    if (!cache_find(cache, &key, ast, NULL))
+    {
+        simplify(ast);
+        cache_add(cache, &key, ast, NULL, 0);
+    }
+
+    free(key.data);
+}
+
+abstract_syntax_tree* cached_taylor_series(formula_cache* cache, abstract_syntax_tree* ast,
+                                           double point, const char* var, int pow,
+                                           article_builder* article)
+{
+    LOG_ASSERT(ast != NULL, return NULL);
+    LOG_ASSERT(article != NULL, return NULL);
+
+    if (!cache || article->state != ARTC_FRAGMENT)
+        return taylor_series(ast, point, var, pow, article);
+
+    cache_buffer key = {};
+    if (make_key(&key, CACHE_TAYLOR, ast, var, point, pow) != 0)
+    {
+        free(key.data);
+        return taylor_series(ast, point, var, pow, article);
+    }
+
+    abstract_syntax_tree* result = cache_find(cache, &key, NULL, article);
+    if (!result)
+    {
+        size_t text_start = article->text.size;
+        result = taylor_series(ast, point, var, pow, article);
+        if (result)
+            cache_add(cache, &key, result, &article->text, text_start);
+    }
+
+    free(key.data);
+    return result;
+}
+
+/**
+ * @brief Serialize operation with its parameters and argument
+ *
+ * @return 0 upon success, -1 otherwise
+ */
+static int make_key(cache_buffer* key, cache_operation operation,
+                    const abstract_syntax_tree* ast,
+                    const char* var, double point, int pow)
+{
+    uint8_t op_byte = (uint8_t) operation;
+    put_bytes (key, &op_byte, sizeof(op_byte));
+    put_string(key, var);
+    put_bytes (key, &point, sizeof(point));
+    put_u32   (key, (uint32_t) pow);
+
+    size_t tree_size = 0;
+    uint8_t* tree = tree_serialize(ast, &tree_size);
+    if (!tree) return -1;
+
+    put_bytes(key, tree, tree_size);
+    free(tree);
+
+    return key->data ? 0 : -1;
+}
+
+/**
+ * @brief Find cached result and replay its narration
+ *
+ * @param[inout] target Tree, which receives result, or `NULL` to create new one
+ * @param[inout] article Article, which receives narration. Ignored if set to `NULL`
+ * @return Tree with result, `NULL` if it is not cached
+ */
+static abstract_syntax_tree* cache_find(formula_cache* cache, const cache_buffer* key,
+                                        abstract_syntax_tree* target, article_builder* article)
+{
+    uint64_t hash = hash_bytes(key->data, key->size);
+
+    pthread_mutex_lock(&cache->lock);
+
+    cache_entry* entry = find_entry(cache, hash, key);
+    if (!entry)
+    {
+        cache->stats.misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+
+    entry->last_used = cache->clock;
+    cache->modified  = 1;
+    cache_entry found = *entry;
+
+    /* Entry data is not freed while there are readers, even if entry is
+       evicted meanwhile */
+    cache->readers++;
+    pthread_mutex_unlock(&cache->lock);
+
+    abstract_syntax_tree* result = target ? target : tree_ctor();
+    int deserialized =
+        tree_deserialize_into(result, found.data + found.key_size, found.tree_size) == 0;
+
+    if (!deserialized)
+    {
+        if (!target) tree_dtor(result);
+        result = NULL;
+    }
+    /* Narration is stored with terminating null character */
+    else if (article && found.text_size > 1)
+        string_builder_append(&article->text,
+            (const char*) (found.data + found.key_size + found.tree_size));
+
+    pthread_mutex_lock(&cache->lock);
+    if (--cache->readers == 0)
+        free_retired(cache);
+    if (deserialized)
+        cache->stats.hits++;
+    else
+        cache->stats.misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    return result;
+}
+
+static void cache_add(formula_cache* cache, const cache_buffer* key,
+                      const abstract_syntax_tree* result,
+                      const string_builder* text, size_t text_start)
+{
+    /* Narration is the part of text, added since `text_start` */
+    size_t text_size = text ? text->size - text_start : 0;
+
+    size_t tree_size = 0;
+    uint8_t* tree = tree_serialize(result, &tree_size);
+    if (!tree) return;
+
+    size_t data_size = key->size + tree_size + text_size + 1;
+    uint8_t* data = (uint8_t*) calloc(data_size, sizeof(*data));
+    LOG_ASSERT_ERROR(data != NULL, { free(tree); return; },
+        "Failed to allocate memory", NULL);
+
+    memcpy(data, key->data, key->size);
+    memcpy(data + key->size, tree, tree_size);
+    if (text_size > 0)
+        string_builder_copy_range(text, text_start, text_size,
+                                  (char*) (data + key->size + tree_size));
+    free(tree);
+
+    cache_entry entry = {
+        .hash      = hash_bytes(key->data, key->size),
+        .last_used = 0,
+        .data      = data,
+        .key_size  = (uint32_t) key->size,
+        .tree_size = (uint32_t) tree_size,
+        .text_size = (uint32_t) (text_size + 1),
+        .owned     = 1
+    };
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry.last_used = cache->clock;
+
+    /* Same result may be computed concurrently */
+    if (find_entry(cache, entry.hash, key) || insert_entry(cache, entry) != 0)
+        free(data);
+    else
+    {
+        cache->modified = 1;
+        evict_entries(cache);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void load_file(formula_cache* cache)
+{
+    int fd = open(cache->filename, O_RDONLY);
+    if (fd < 0)
+    {
+        LOG_ASSERT_ERROR(errno == ENOENT, return,
+            "Could not open file '%s'", cache->filename);
+        return;
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(file_header))
+    {
+        close(fd);
+        return;
+    }
+
+    size_t size = (size_t) info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    LOG_ASSERT_ERROR(mapping != MAP_FAILED, return,
+        "Could not map file '%s'", cache->filename);
+
+    cache->mapping      = (uint8_t*) mapping;
+    cache->mapping_size = size;
+
+    file_header header = {};
+    memcpy(&header, cache->mapping, sizeof(header));
+    LOG_ASSERT_ERROR(memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+                     && header.version == CACHE_VERSION, return,
+        "Cache file '%s' is corrupted, it will be overwritten", cache->filename);
+
+    cache->clock = header.clock + 1;
+
+    size_t pos = sizeof(file_header);
+    for (uint32_t i = 0; i < header.entry_count; i++)
+    {
+        record_header record = {};
+        LOG_ASSERT_ERROR(pos + sizeof(record) <= size, return,
+            "Cache file '%s' is truncated", cache->filename);
+        memcpy(&record, cache->mapping + pos, sizeof(record));
+        pos += sizeof(record);
+
+        size_t data_size = (size_t) record.key_size + record.tree_size + record.text_size;
+        LOG_ASSERT_ERROR(data_size <= size - pos && record.text_size > 0, return,
+            "Cache file '%s' is truncated", cache->filename);
+
+        cache_entry entry = {
+            .hash      = record.hash,
+            .last_used = record.last_used,
+            .data      = cache->mapping + pos,
+            .key_size  = record.key_size,
+            .tree_size = record.tree_size,
+            .text_size = record.text_size,
+            .owned     = 0
+        };
+        pos += round_up(data_size);
+
+        /* Narration must be null-terminated, since it is appended as string */
+        if (entry.data[data_size - 1] != '\0'
+            || record.checksum != (uint32_t) hash_bytes(entry.data, data_size))
+            continue;
+
+        if (insert_entry(cache, entry) != 0)
+            return;
+    }
+}
+
+static int insert_entry(formula_cache* cache, cache_entry entry)
+{
+    if ((cache->entries.size + 1) * 2 > cache->bucket_count
+        && rehash(cache, cache->bucket_count * 2) != 0)
+        return -1;
+
+    array_push(&cache->entries, entry);
+
+    size_t mask = cache->bucket_count - 1;
+    size_t bucket = entry.hash & mask;
+    while (cache->buckets[bucket])
+        bucket = (bucket + 1) & mask;
+
+    cache->buckets[bucket] = cache->entries.size;
+    cache->size += record_size(&entry);
+    return 0;
+}
+
+static int rehash(formula_cache* cache, size_t bucket_count)
+{
+    size_t* buckets = (size_t*) calloc(bucket_count, sizeof(*buckets));
+    LOG_ASSERT_ERROR(buckets != NULL, return -1, "Failed to allocate memory", NULL);
+
+    fill_buckets(cache, buckets, bucket_count);
+    return 0;
+}
+
+/**
+ * @brief Index all entries in zeroed bucket array and replace old table
+ * with it
+ */
+static void fill_buckets(formula_cache* cache, size_t* buckets, size_t bucket_count)
+{
+    size_t mask = bucket_count - 1;
+    for (size_t i = 0; i < cache->entries.size; i++)
+    {
+        size_t bucket = cache->entries.data[i].hash & mask;
+        while (buckets[bucket])
+            bucket = (bucket + 1) & mask;
+        buckets[bucket] = i + 1;
+    }
+
+    free(cache->buckets);
+    cache->buckets      = buckets;
+    cache->bucket_count = bucket_count;
+}
+
+/**
+ * @brief Drop least recently used entries, if cache exceeds size limit.
+ * Cache is shrunk to 3/4 of limit, so that entries are not evicted on
+ * every insertion. Must be called with cache locked
+ */
+static void evict_entries(formula_cache* cache)
+{
+    if (cache->size <= cache->max_size || cache->entries.size == 0) return;
+
+    size_t count = cache->entries.size;
+    const cache_entry** order = (const cache_entry**) calloc(count + 1, sizeof(*order));
+    uint8_t* keep   = (uint8_t*) calloc(count + 1, sizeof(*keep));
+    size_t* buckets = (size_t*)  calloc(cache->bucket_count, sizeof(*buckets));
+
+    /* Evicted data is retired, so space for all of it is reserved beforehand */
+    size_t retired_capacity = cache->retired_count + count;
+    uint8_t** retired = retired_capacity <= cache->retired_capacity ? cache->retired
+                      : (uint8_t**) realloc(cache->retired, retired_capacity * sizeof(*retired));
+
+    if (retired) cache->retired = retired;
+    if (retired && retired_capacity > cache->retired_capacity)
+        cache->retired_capacity = retired_capacity;
+
+    LOG_ASSERT_ERROR(order != NULL && keep != NULL && buckets != NULL && retired != NULL,
+        { free(order); free(keep); free(buckets); return; },
+        "Failed to allocate memory", NULL);
+
+    for (size_t i = 0; i < count; i++)
+        order[i] = &cache->entries.data[i];
+
+    /* Most recently used entries are kept, same as in saved file */
+    qsort(order, count, sizeof(*order), compare_recency);
+
+    size_t limit = cache->max_size / 4 * 3;
+    size_t total = sizeof(file_header);
+    for (size_t i = 0; i < count && total + record_size(order[i]) <= limit; i++)
+    {
+        total += record_size(order[i]);
+        keep[(size_t) (order[i] - cache->entries.data)] = 1;
+    }
+
+    /* Remaining entries keep their order */
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        cache_entry* entry = &cache->entries.data[i];
+        if (keep[i])
+            cache->entries.data[kept++] = *entry;
+        else if (entry->owned)
+            cache->retired[cache->retired_count++] = entry->data;
+    }
+    cache->entries.size = kept;
+
+    fill_buckets(cache, buckets, cache->bucket_count);
+
+    cache->size = total;
+    cache->stats.evictions += count - kept;
+    cache->modified = 1;
+
+    if (cache->readers == 0)
+        free_retired(cache);
+
+    free(order);
+    free(keep);
+}
+
+static void free_retired(formula_cache* cache)
+{
+    for (size_t i = 0; i < cache->retired_count; i++)
+        free(cache->retired[i]);
+    cache->retired_count = 0;
+}
+
+static cache_entry* find_entry(formula_cache* cache, uint64_t hash, const cache_buffer* key)
+{
+    size_t mask = cache->bucket_count - 1;
+    for (size_t bucket = hash & mask; cache->buckets[bucket];
+         bucket = (bucket + 1) & mask)
+    {
+        cache_entry* entry = &cache->entries.data[cache->buckets[bucket] - 1];
+        if (entry->hash == hash && entry->key_size == key->size
+            && memcmp(entry->data, key->data, key->size) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
+static size_t record_size(const cache_entry* entry)
+{
+    return sizeof(record_header)
+         + round_up((size_t) entry->key_size + entry->tree_size + entry->text_size);
+}
+
+static int compare_recency(const void* first, const void* second)
+{
+    const cache_entry* a = *(const cache_entry* const*) first;
+    const cache_entry* b = *(const cache_entry* const*) second;
+
+    if (a->last_used != b->last_used)
+        return a->last_used > b->last_used ? -1 : 1;
+
+    /* Keep file order for entries of the same run */
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static void put_bytes(cache_buffer* buffer, const void* data, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 256;
+        while (capacity < buffer->size + size)
+            capacity *= 2;
+
+        uint8_t* new_data = (uint8_t*) realloc(buffer->data, capacity);
+        if (!new_data)
+        {
+            free(buffer->data);
+            *buffer = {};
+            return;
+        }
+
+        buffer->data     = new_data;
+        buffer->capacity = capacity;
+    }
+
+    if (!buffer->data) return;
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void put_u32(cache_buffer* buffer, uint32_t value)
+{
+    put_bytes(buffer, &value, sizeof(value));
+}
+
+static void put_string(cache_buffer* buffer, const char* str)
+{
+    size_t length = strlen(str);
+    put_u32(buffer, (uint32_t) length);
+    put_bytes(buffer, str, length);
+}
+
+/**
+ * @brief 64-bit FNV-1a hash
+ */
+static uint64_t hash_bytes(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file formula_cache.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Persistent cache of symbolic computation results
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Results are keyed by hash of operation, its parameters and
+ * structure of argument tree, so they are found regardless of node
+ * addresses or the run, which computed them. Together with result, cache
+ * stores narration written to article fragment, so that cached article is
+ * the same as computed one. Cache file is mapped into memory on load and
+ * rewritten on destruction. Size limit applies both to file and to cache in
+ * memory: when new result does not fit, least recently used results are
+ * evicted. Cache may be shared by threads, but not by concurrently running
+ * processes: the last one to finish wins.
+ */
+
+#ifndef FORMULA_CACHE_H
+#define FORMULA_CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "article_builder.h"
+#include "ast.h"
+
+/**
+ * @brief Cached result
+ */
+struct cache_entry
+{
+    /**
+     * @brief Hash of key
+     */
+    uint64_t hash;
+    /**
+     * @brief Number of run, which last used this entry
+     */
+    uint64_t last_used;
+    /**
+     * @brief Key, result tree and narration, stored one after another
+     */
+    uint8_t* data;
+    uint32_t key_size;
+    uint32_t tree_size;
+    uint32_t text_size;
+    /**
+     * @brief Whether `data` was allocated by cache rather than mapped
+     * from file
+     */
+    int owned;
+};
+
+#define ARRAY_ELEMENT cache_entry
+
+inline void copy_element(ARRAY_ELEMENT* dest, const ARRAY_ELEMENT* src) { *dest = *src; }
+inline void delete_element(ARRAY_ELEMENT* element) { *element = {}; }
+
+#include "dynamic_array.h"
+
+#undef ARRAY_ELEMENT
+
+struct formula_cache_stats
+{
+    size_t hits;
+    size_t misses;
+    /**
+     * @brief Entries, dropped to fit into size limit
+     */
+    size_t evictions;
+    size_t entries;
+    /**
+     * @brief Size of cache file, if it was saved now
+     */
+    size_t bytes;
+};
+
+struct formula_cache
+{
+    char* filename;
+    size_t max_size;
+
+    uint8_t* mapping;
+    size_t mapping_size;
+
+    dynamic_array(cache_entry) entries;
+    /**
+     * @brief Open addressing hash table of entry indices plus one, zero
+     * marks empty bucket
+     */
+    size_t* buckets;
+    size_t bucket_count;
+
+    /**
+     * @brief Size of cache file, if it was saved now
+     */
+    size_t size;
+
+    /**
+     * @brief Number of threads, reading entry data without lock
+     */
+    size_t readers;
+    /**
+     * @brief Data of evicted entries, freed when there are no readers
+     */
+    uint8_t** retired;
+    size_t retired_count;
+    size_t retired_capacity;
+
+    /**
+     * @brief Number of current run
+     */
+    uint64_t clock;
+    int modified;
+    formula_cache_stats stats;
+
+    pthread_mutex_t lock;
+};
+
+/**
+ * @brief Load cache from file. Missing or corrupted file gives empty cache.
+ *
+ * @param[out] cache Constructed cache
+ * @param[in] filename Cache file
+ * @param[in] max_size Limit of cache size in bytes, as stored in file
+ * @return 0 upon success, -1 otherwise
+ */
+int formula_cache_ctor(formula_cache* cache, const char* filename, size_t max_size);
+
+/**
+ * @brief Save cache to its file and destroy it
+ *
+ * @param[inout] cache `formula_cache` instance to be destroyed
+ */
+void formula_cache_dtor(formula_cache* cache);
+
+/**
+ * @brief Write cache to its file, evicting least recently used results,
+ * if it does not fit into size limit
+ *
+ * @param[inout] cache Saved cache
+ * @return 0 upon success, -1 otherwise
+ */
+int formula_cache_save(formula_cache* cache);
+
+/**
+ * @brief Get hit and miss counters and cache size
+ *
+ * @param[in] cache Cache
+ * @return Cache statistics
+ */
+formula_cache_stats formula_cache_get_stats(formula_cache* cache);
+
+/**
+ * @brief Same as `derivative()`, but result is looked up in cache first
+ *
+ * @param[inout] cache Cache, `NULL` to compute result without cache
+ * @param[in] ast Differentiated function
+ * @param[in] var Differentiation variable
+ * @param[inout] article Article fragment for narration. Results are not
+ * cached for other articles, since their narration depends on article state.
+ * @return Derivative tree
+ */
+abstract_syntax_tree* cached_derivative(formula_cache* cache, abstract_syntax_tree* ast,
+                                        const char* var, article_builder* article);
+
+/**
+ * @brief Same as `simplify()`, but result is looked up in cache first
+ *
+ * @param[inout] cache Cache, `NULL` to compute result without cache
+ * @param[inout] ast Simplified tree
+ */
+void cached_simplify(formula_cache* cache, abstract_syntax_tree* ast);
+
+/**
+ * @brief Same as `taylor_series()`, but result is looked up in cache first
+ *
+ * @param[inout] cache Cache, `NULL` to compute result without cache
+ * @param[in] ast Expanded function
+ * @param[in] point Expansion point
+ * @param[in] var Expansion variable
+ * @param[in] pow Order of series
+ * @param[inout] article Article fragment for narration (see `cached_derivative()`)
+ * @return Taylor series tree
+ */
+abstract_syntax_tree* cached_taylor_series(formula_cache* cache, abstract_syntax_tree* ast,
+                                           double point, const char* var, int pow,
+                                           article_builder* article);
+
+#endif
@@ -1,86 +1,251 @@
+#include <stdint.h>
 #include <stdio.h>
-#include <string.h>
-#include <ctype.h>
+#include <stdlib.h>
 
 #include "logger.h"
 
 #include "lexer.h"
 
-static int has_prefix(const char* str1, const char* str2);
-
-dynamic_array(token)* parse_tokens(const char* str)
+/**
+ * @brief Command name, such as `\\sin`
+ */
+struct keyword
 {
-    dynamic_array(token) *tokens = (dynamic_array(token)*)calloc(1, sizeof(*tokens));
-    array_ctor(tokens);
+    const char* name;
+    size_t length;
+    token_type type;
+};
 
-    while(*str)
-    {
-        while (*str && isspace(*str))
-            str++;
+static const size_t KEYWORD_TABLE_SIZE = 16;
+static const size_t MIN_KEYWORD_LENGTH = 2;
+static const size_t MAX_KEYWORD_LENGTH = 6;
 
-        if(!*str) break;
+struct keyword_table
+{
+    keyword entries[KEYWORD_TABLE_SIZE];
+    int is_perfect;
+};
 
-        char* next_char = NULL;
-        double number = strtod(str, &next_char);
-        
-        if(next_char != str)
-        {
-            array_push(tokens, {.type = TOK_NUM, .value = {.num = number}});
-            str = next_char;
-            continue;
-        }
-        
-        switch (*(str++))
-        {
-        case '+': array_push(tokens, {.type = TOK_PLUS});     continue;
-        case '-': array_push(tokens, {.type = TOK_MINUS});    continue;
-        case '^': array_push(tokens, {.type = TOK_CARET});    continue;
-        case '(': array_push(tokens, {.type = TOK_LPAREN});   continue;
-        case ')': array_push(tokens, {.type = TOK_RPAREN});   continue;
-        case '{': array_push(tokens, {.type = TOK_LBRACKET}); continue;
-        case '}': array_push(tokens, {.type = TOK_RBRACKET}); continue;
-
-        default:
-            str--;
-            break;
-        }
-
-        #define MATH_FUNC(name, ...)                        \
-            if(has_prefix(str, "\\"#name))                     \
-            {                                               \
-                str += sizeof("\\"#name)/sizeof(char) - 1;  \
-                array_push(tokens, {.type = TOK_##name});    \
-                continue;                                   \
-            }
+static constexpr size_t keyword_hash(const char* word, size_t length)
+{
+    /* Letters only differ in 0x20 bit between cases */
+    return (length * 5
+                + (size_t) (word[0]          | 0x20)
+                + (size_t) (word[length - 1] | 0x20) * 12
+                + (size_t) (word[length - 2] | 0x20)) % KEYWORD_TABLE_SIZE;
+}
+
+static constexpr keyword_table make_keyword_table(void)
+{
+    #define MATH_FUNC(name, ...) { #name, sizeof(#name) - 1, TOK_##name },
 
+    const keyword keywords[] = {
         MATH_FUNC(CDOT)
         MATH_FUNC(FRAC)
         #include "functions.h"
+    };
 
-        #undef MATH_FUNC
+    #undef MATH_FUNC
 
-        token tok = {.type = TOK_VAR, .value = {.name = NULL}};        
+    keyword_table table = {};
+    table.is_perfect = 1;
 
-        int n_read = 0;
-        LOG_ASSERT_ERROR(
-            sscanf(str, " %32m[\\A-Za-z_] %n", &tok.value.name, &n_read) == 1,
-            {
-                array_dtor(tokens);
-                return NULL;
-            },
-            "Invalid symbol: '%c'", *str
-        );
+    for (const keyword& kw : keywords)
+    {
+        keyword* slot = &table.entries[keyword_hash(kw.name, kw.length)];
+        if (slot->name || kw.length < MIN_KEYWORD_LENGTH || kw.length > MAX_KEYWORD_LENGTH)
+            table.is_perfect = 0;
+        *slot = kw;
+    }
 
-        array_push(tokens, tok);
-        str += n_read;
+    return table;
+}
+
+static constexpr keyword_table KEYWORDS = make_keyword_table();
+static_assert(KEYWORDS.is_perfect,
+              "Keywords collide, change coefficients of keyword_hash()");
+
+static inline int is_space (char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+                                             || c == '\v' || c == '\f'; }
+static inline int is_digit (char c) { return '0' <= c && c <= '9'; }
+static inline int is_letter(char c) { return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'); }
+static inline int is_name  (char c) { return is_letter(c) || c == '_'; }
+
+static token lex_number (lexer* lex);
+static token lex_command(lexer* lex);
+static token lex_name   (lexer* lex);
+static const keyword* find_keyword(const char* word, size_t length);
+
+void lexer_ctor(lexer* lex, const char* str)
+{
+    LOG_ASSERT(lex != NULL, return);
+    LOG_ASSERT(str != NULL, return);
+
+    *lex = {
+        .str = str,
+        .pos = 0
+    };
+}
+
+token lexer_next(lexer* lex)
+{
+    while (is_space(lex->str[lex->pos]))
+        lex->pos++;
+
+    char c = lex->str[lex->pos];
+    switch (c)
+    {
+    case '\0': return {.type = TOK_EOF};
+
+    case '+': lex->pos++; return {.type = TOK_PLUS};
+    case '-': lex->pos++; return {.type = TOK_MINUS};
+    case '^': lex->pos++; return {.type = TOK_CARET};
+    case '(': lex->pos++; return {.type = TOK_LPAREN};
+    case ')': lex->pos++; return {.type = TOK_RPAREN};
+    case '{': lex->pos++; return {.type = TOK_LBRACKET};
+    case '}': lex->pos++; return {.type = TOK_RBRACKET};
+
+    case '\\': return lex_command(lex);
+
+    default:
+        break;
     }
 
-    array_push(tokens, {.type = TOK_EOF});
+    if (is_digit(c) || (c == '.' && is_digit(lex->str[lex->pos + 1])))
+        return lex_number(lex);
+
+    if (is_name(c))
+        return lex_name(lex);
+
+    LOG_ASSERT_ERROR(0, return {.type = TOK_NONE},
+        "Invalid symbol: '%c'", c);
+}
+
+dynamic_array(token)* parse_tokens(const char* str)
+{
+    dynamic_array(token) *tokens = (dynamic_array(token)*)calloc(1, sizeof(*tokens));
+    array_ctor(tokens);
+
+    lexer lex = {};
+    lexer_ctor(&lex, str);
+
+    token tok = {};
+    do
+    {
+        tok = lexer_next(&lex);
+        LOG_ASSERT(tok.type != TOK_NONE,
+        {
+            array_dtor(tokens);
+            free(tokens);
+            return NULL;
+        });
+        array_push(tokens, tok);
+    } while (tok.type != TOK_EOF);
 
     return tokens;
 }
 
-int has_prefix(const char *str, const char *pref)
+static token lex_number(lexer* lex)
 {
-    return strncasecmp(str, pref, strlen(pref)) == 0;
+    /* Exact powers of ten, representable as double */
+    static const double POWERS_OF_TEN[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int MAX_EXACT_POWER = 22;
+    const int MAX_DIGITS = 19;
+    const uint64_t MAX_EXACT_MANTISSA = (uint64_t) 1 << 53;
+
+    const char* start = lex->str + lex->pos;
+    const char* str = start;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+
+    for (; is_digit(*str); str++, digits++)
+        if (digits < MAX_DIGITS) mantissa = mantissa * 10 + (uint64_t) (*str - '0');
+    if (*str == '.')
+        for (str++; is_digit(*str); str++, digits++, exponent--)
+            if (digits < MAX_DIGITS) mantissa = mantissa * 10 + (uint64_t) (*str - '0');
+
+    /* Exponent is only a part of number if it has digits */
+    if ((*str == 'e' || *str == 'E') &&
+        (is_digit(str[1]) || ((str[1] == '-' || str[1] == '+') && is_digit(str[2]))))
+    {
+        int sign = 1;
+        str++;
+        if (*str == '-' || *str == '+')
+            sign = *(str++) == '-' ? -1 : 1;
+
+        int value = 0;
+        for (; is_digit(*str); str++)
+            if (value < 100000) value = value * 10 + (*str - '0');
+        exponent += sign * value;
+    }
+
+    lex->pos += (size_t) (str - start);
+
+    /* Both mantissa and power of ten are exact, so single rounding of their
+       product or quotient gives correctly rounded result. Otherwise strtod()
+       reads exactly the same characters. */
+    double number = 0;
+    if (digits <= MAX_DIGITS && mantissa <= MAX_EXACT_MANTISSA
+        && -MAX_EXACT_POWER <= exponent && exponent <= MAX_EXACT_POWER)
+        number = exponent < 0
+               ? (double) mantissa / POWERS_OF_TEN[-exponent]
+               : (double) mantissa * POWERS_OF_TEN[ exponent];
+    else
+        number = strtod(start, NULL);
+
+    return {.type = TOK_NUM, .value = {.num = number}};
+}
+
+static token lex_command(lexer* lex)
+{
+    const char* word = lex->str + lex->pos + 1;
+    size_t length = 0;
+    while (is_letter(word[length]))
+        length++;
+
+    /* Longest keyword, which is a prefix of command, so that "\lnx" is
+       "\ln x", while unknown commands are variables */
+    size_t max_length = length < MAX_KEYWORD_LENGTH ? length : MAX_KEYWORD_LENGTH;
+    for (size_t prefix = max_length; prefix >= MIN_KEYWORD_LENGTH; prefix--)
+    {
+        const keyword* found = find_keyword(word, prefix);
+        if (!found) continue;
+
+        lex->pos += 1 + prefix;
+        return {.type = found->type};
+    }
+
+    return lex_name(lex);
+}
+
+static token lex_name(lexer* lex)
+{
+    size_t start = lex->pos;
+
+    if (lex->str[lex->pos] == '\\')
+        lex->pos++;
+    while (is_name(lex->str[lex->pos]))
+        lex->pos++;
+
+    return {
+        .type = TOK_VAR,
+        .value = {.name = {.offset = start, .length = lex->pos - start}}
+    };
+}
+
+static const keyword* find_keyword(const char* word, size_t length)
+{
+    const keyword* candidate = &KEYWORDS.entries[keyword_hash(word, length)];
+    if (candidate->length != length) return NULL;
+
+    for (size_t i = 0; i < length; i++)
+        if ((word[i] | 0x20) != (candidate->name[i] | 0x20))
+            return NULL;
+
+    return candidate;
 }
@@ -4,12 +4,44 @@
 #include "token_array.h"
 
 /**
- * @brief 
+ * @brief Lazy lexer, producing tokens one by one without allocations
+ */
+struct lexer
+{
+    /**
+     * @brief Lexed string, token views point into it
+     */
+    const char* str;
+    /**
+     * @brief Offset of first unread character
+     */
+    size_t pos;
+};
+
+/**
+ * @brief Start lexing string
+ *
+ * @param[out] lex Constructed lexer
+ * @param[in] str Input string. Must outlive lexer and all its tokens.
+ */
+void lexer_ctor(lexer* lex, const char* str);
+
+/**
+ * @brief Read next token
+ *
+ * @param[inout] lex Lexer
+ * @return Next token. `TOK_EOF` is returned at the end of string and
+ * `TOK_NONE` upon invalid symbol.
+ */
+token lexer_next(lexer* lex);
+
+/**
+ * @brief
  * Split input string into separate lexemes
- * 
- * @param[in] str Input string
+ *
+ * @param[in] str Input string. Variable names in tokens point into it.
  * @return list of tokens
  */
 dynamic_array(token)* parse_tokens(const char* str);
 
-#endif
\ No newline at end of file
+#endif
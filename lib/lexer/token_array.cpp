@@ -1,4 +0,0 @@
-#include "token_array.h"
-
-#define ARRAY_ELEMENT token
-#include "dynamic_array_impl.h"
\ No newline at end of file
@@ -28,36 +28,36 @@ enum token_type
 
 #undef MATH_FUNC
 
-const size_t MAX_NAME = 32;
+/**
+ * @brief Part of lexed string
+ */
+struct token_view
+{
+    /**
+     * @brief Offset of first character in lexed string
+     */
+    size_t offset;
+    /**
+     * @brief View length
+     */
+    size_t length;
+};
 
 struct token
 {
     token_type type;
     union {
-        char* name;
+        /**
+         * @brief Variable name, points into lexed string
+         */
+        token_view name;
         double num;
     } value;
 };
 
-#define ARRAY_ELEMENT token
-
-/* Shallow copy */
-inline void copy_element(ARRAY_ELEMENT* dest, const ARRAY_ELEMENT* src)
-{
-    dest->type = src->type;
-    dest->value = src->value;
-}
-
-inline void delete_element(ARRAY_ELEMENT* element)
-{
-    if (element->type == TOK_VAR)
-        free(element->value.name);
-
-    element = {};
-}
-
-#include "dynamic_array.h"
+#include "typed_array.h"
 
-#undef ARRAY_ELEMENT
+/* Tokens do not own any memory, so they are copied and stored inline */
+typedef typed_array<token, 16> dynamic_array(token);
 
 #endif
\ No newline at end of file
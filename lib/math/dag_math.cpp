@@ -0,0 +1,261 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "dag_math.h"
+
+struct diff_state
+{
+    expr_dag* dag;
+    var_name var;
+    article_builder* article;
+    dag_memo derivatives;
+    signed char* depends;
+    size_t depends_cap;
+};
+
+static const dag_node* differentiate     (diff_state* state, const dag_node* node, int narrate);
+static const dag_node* differentiate_node(diff_state* state, const dag_node* node, int narrate);
+static int depends_on(diff_state* state, const dag_node* node);
+static void print_dag_node(const dag_node* node, string_builder* builder);
+
+static const dag_node* substitute(expr_dag* dag, dag_memo* memo,
+                                  const dag_node* node, var_name var, double val);
+
+const dag_node* dag_differential(expr_dag* dag, const dag_node* node,
+                                 var_name var, article_builder* article)
+{
+    LOG_ASSERT(dag != NULL, return NULL);
+    LOG_ASSERT(node != NULL, return NULL);
+
+    diff_state state = {
+        .dag = dag,
+        .var = var,
+        .article = article,
+        .derivatives = {},
+        .depends = NULL,
+        .depends_cap = 0
+    };
+    dag_memo_ctor(&state.derivatives);
+
+    const dag_node* result = differentiate(&state, node, 1);
+
+    dag_memo_dtor(&state.derivatives);
+    free(state.depends);
+
+    return result;
+}
+
+const dag_node* dag_substitute(expr_dag* dag, const dag_node* node,
+                               var_name var, double val)
+{
+    LOG_ASSERT(dag != NULL, return NULL);
+    LOG_ASSERT(node != NULL, return NULL);
+
+    dag_memo memo = {};
+    dag_memo_ctor(&memo);
+
+    const dag_node* result = substitute(dag, &memo, node, var, val);
+
+    dag_memo_dtor(&memo);
+    return result;
+}
+
+#define LEFT  node->left
+#define RIGHT node->right
+
+#define NUM(num)            dag_make_number(dag, num)
+#define ADD(left, right)    dag_make_binary(dag, OP_ADD, left, right)
+#define SUB(left, right)    dag_make_binary(dag, OP_SUB, left, right)
+#define MUL(left, right)    dag_make_binary(dag, OP_MUL, left, right)
+#define FRAC(left, right)   dag_make_binary(dag, OP_DIV, left, right)
+#define POW(left, right)    dag_make_binary(dag, OP_POW, left, right)
+#define NEG(right)          dag_make_unary (dag, OP_NEG,  right)
+#define SIN(right)          dag_make_unary (dag, OP_SIN,  right)
+#define COS(right)          dag_make_unary (dag, OP_COS,  right)
+#define SQRT(right)         dag_make_unary (dag, OP_SQRT, right)
+#define LN(right)           dag_make_unary (dag, OP_LN,   right)
+
+/* Subexpressions are shared, no copying needed */
+#define CPY(node) (node)
+
+#define D(node) differentiate(state, node, narrate)
+
+static const dag_node* differentiate(diff_state* state, const dag_node* node, int narrate)
+{
+    const dag_node* result = dag_memo_get(&state->derivatives, node);
+    if (result) return result;
+
+    if (narrate && state->article && !is_op(LEFT) && !is_op(RIGHT))
+    {
+        article_builder* article = state->article;
+
+        article_add_starter(article);
+        print_dag_node(node, &article->text);
+        article_add_transition(article);
+
+        result = differentiate_node(state, node, 0);
+        string_builder_append(&article->text, "the derivative of this is equal to\n");
+        print_dag_node(result, &article->text);
+    }
+    else
+        result = differentiate_node(state, node, narrate);
+
+    dag_memo_set(&state->derivatives, node, result);
+    return result;
+}
+
+static const dag_node* differentiate_node(diff_state* state, const dag_node* node, int narrate)
+{
+    expr_dag* dag = state->dag;
+
+    if (is_var(node) && get_var(node) == state->var)
+        return NUM(1);
+
+    if (!depends_on(state, node))
+        return NUM(0);
+
+    #define MATH_FUNC(name, diff, ...)\
+        case OP_##name:\
+            return MUL(diff, D(RIGHT));
+
+    switch(get_op(node))
+    {
+        case OP_ADD:
+            return ADD(D(LEFT), D(RIGHT));
+        case OP_SUB:
+            return SUB(D(LEFT), D(RIGHT));
+        case OP_MUL:
+            return ADD(
+                MUL(D(LEFT), CPY(RIGHT)),
+                MUL(CPY(LEFT), D(RIGHT))
+            );
+        case OP_DIV:
+            return FRAC(
+                SUB(
+                    MUL(D(LEFT), CPY(RIGHT)),
+                    MUL(CPY(LEFT), D(RIGHT))
+                ),
+                POW(CPY(RIGHT), NUM(2))
+            );
+        case OP_POW:
+            if (!depends_on(state, LEFT))
+                return MUL(
+                    MUL(
+                        LN(CPY(LEFT)),
+                        CPY(node)
+                    ),
+                    D(RIGHT)
+                );
+            if (!depends_on(state, RIGHT))
+                return MUL(
+                    MUL(
+                        CPY(RIGHT),
+                        POW(
+                            CPY(LEFT),
+                            SUB(CPY(RIGHT), NUM(1))
+                        )
+                    ),
+                    D(LEFT)
+                );
+            return MUL(
+                CPY(node),
+                ADD(
+                    MUL(
+                        D(RIGHT),
+                        LN(CPY(LEFT))
+                    ),
+                    MUL(
+                        CPY(RIGHT),
+                        FRAC(
+                            D(LEFT),
+                            CPY(LEFT)
+                        )
+                    )
+                )
+            );
+        case OP_NEG:
+            return NEG(D(RIGHT));
+        #include "functions.h"
+
+        default:
+            LOG_ASSERT_ERROR(0, return NULL,
+                "Unknown node", NULL);
+    }
+
+    #undef MATH_FUNC
+
+    LOG_ASSERT(0 && "Unreachable code", return NULL);
+}
+
+static int depends_on(diff_state* state, const dag_node* node)
+{
+    if (!node) return 0;
+
+    if (node->id >= state->depends_cap)
+    {
+        size_t new_cap = state->depends_cap ? state->depends_cap : 64;
+        while (new_cap <= node->id)
+            new_cap *= 2;
+
+        /* Node is assumed to depend on variable, so that derivative is
+           still computed correctly */
+        signed char* depends = (signed char*) realloc(state->depends, new_cap);
+        LOG_ASSERT_ERROR(depends != NULL, return 1, "Failed to allocate memory", NULL);
+
+        memset(depends + state->depends_cap, -1, new_cap - state->depends_cap);
+        state->depends     = depends;
+        state->depends_cap = new_cap;
+    }
+
+    if (state->depends[node->id] >= 0)
+        return state->depends[node->id];
+
+    int res = 0;
+    if (is_var(node))
+        res = get_var(node) == state->var;
+    else if (is_op(node))
+        res = depends_on(state, LEFT) || depends_on(state, RIGHT);
+
+    state->depends[node->id] = (signed char) res;
+    return res;
+}
+
+static void print_dag_node(const dag_node* node, string_builder* builder)
+{
+    node_arena arena = {};
+    node_arena_ctor(&arena);
+
+    node_arena* prev_arena = node_arena_use(&arena);
+    ast_node* tree = dag_to_node(node);
+    node_arena_use(prev_arena);
+
+    print_node(tree, builder);
+
+    node_arena_dtor(&arena);
+}
+
+#undef D
+
+static const dag_node* substitute(expr_dag* dag, dag_memo* memo,
+                                  const dag_node* node, var_name var, double val)
+{
+    const dag_node* result = dag_memo_get(memo, node);
+    if (result) return result;
+
+    if (is_var(node) && get_var(node) == var)
+        result = NUM(val);
+    else if (!is_op(node))
+        result = node;
+    else if (!LEFT)
+        result = dag_make_unary(dag, get_op(node), substitute(dag, memo, RIGHT, var, val));
+    else
+        result = dag_make_binary(dag, get_op(node),
+                                substitute(dag, memo, LEFT,  var, val),
+                                substitute(dag, memo, RIGHT, var, val));
+
+    dag_memo_set(memo, node, result);
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef DAG_MATH_H
+#define DAG_MATH_H
+
+#include "article_builder.h"
+
+#include "expr_dag.h"
+
+/**
+ * @brief Differentiate graph node. Every shared subexpression is
+ * differentiated once, results share nodes with the original expression.
+ *
+ * @param[inout] dag Expression graph
+ * @param[in] node Differentiated expression
+ * @param[in] var Differentiation variable
+ * @param[inout] article Article for derivation steps. Ignored if set to `NULL`
+ * @return Derivative
+ */
+const dag_node* dag_differential(expr_dag* dag, const dag_node* node,
+                                 var_name var, article_builder* article = NULL);
+
+/**
+ * @brief Simplify graph node. Every shared subexpression is simplified once.
+ *
+ * @param[inout] dag Expression graph
+ * @param[in] node Simplified expression
+ * @return Simplified expression
+ */
+const dag_node* dag_simplify(expr_dag* dag, const dag_node* node);
+
+/**
+ * @brief Substitute number in place of variable
+ *
+ * @param[inout] dag Expression graph
+ * @param[in] node Expression
+ * @param[in] var Substituted variable
+ * @param[in] val Variable value
+ * @return Expression with substituted variable
+ */
+const dag_node* dag_substitute(expr_dag* dag, const dag_node* node,
+                               var_name var, double val);
+
+#endif
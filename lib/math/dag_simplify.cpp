@@ -0,0 +1,573 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "bytecode.h"
+#include "dag_math.h"
+
+/*
+ * Every simplified expression is in canonical form:
+ *  - negative numbers are stored as negation of positive ones;
+ *  - sums are flattened, like terms are collected, terms are sorted with
+ *    positive ones first and constant last;
+ *  - products are flattened, equal bases are collected into powers,
+ *    numeric coefficient is extracted to the front.
+ * Rewrite rules are applied until no rule changes the expression. Rules
+ * must produce expressions, which are left unchanged by rules themselves.
+ */
+
+typedef const dag_node* (*rewrite_func)(expr_dag* dag, op_type op,
+                                        const dag_node* left,
+                                        const dag_node* right);
+
+struct rewrite_rule
+{
+    /**
+     * @brief Operation, to which rule applies. `ANY_OP` for all operations
+     */
+    int op;
+    /**
+     * @brief Rewrite function. Returns `NULL` if rule is not applicable
+     */
+    rewrite_func apply;
+};
+
+static const int ANY_OP = -1;
+
+static const dag_node* fold_constants (expr_dag* dag, op_type op, const dag_node* left, const dag_node* right);
+static const dag_node* collect_sum    (expr_dag* dag, op_type op, const dag_node* left, const dag_node* right);
+static const dag_node* collect_product(expr_dag* dag, op_type op, const dag_node* left, const dag_node* right);
+static const dag_node* simplify_power (expr_dag* dag, op_type op, const dag_node* left, const dag_node* right);
+static const dag_node* extract_odd    (expr_dag* dag, op_type op, const dag_node* left, const dag_node* right);
+static const dag_node* extract_even   (expr_dag* dag, op_type op, const dag_node* left, const dag_node* right);
+
+static const rewrite_rule RULES[] =
+{
+    { ANY_OP,    fold_constants  },
+    { OP_ADD,    collect_sum     },
+    { OP_SUB,    collect_sum     },
+    { OP_NEG,    collect_sum     },
+    { OP_MUL,    collect_product },
+    { OP_DIV,    collect_product },
+    { OP_POW,    simplify_power  },
+    { OP_SIN,    extract_odd     },
+    { OP_TAN,    extract_odd     },
+    { OP_COT,    extract_odd     },
+    { OP_ARCSIN, extract_odd     },
+    { OP_ARCTAN, extract_odd     },
+    { OP_COS,    extract_even    },
+};
+
+static const size_t RULE_COUNT = sizeof(RULES) / sizeof(*RULES);
+
+static const dag_node* simplify_node(expr_dag* dag, dag_memo* memo, const dag_node* node);
+
+const dag_node* dag_simplify(expr_dag* dag, const dag_node* node)
+{
+    LOG_ASSERT(dag != NULL, return NULL);
+    LOG_ASSERT(node != NULL, return NULL);
+
+    dag_memo memo = {};
+    dag_memo_ctor(&memo);
+
+    const dag_node* result = simplify_node(dag, &memo, node);
+
+    dag_memo_dtor(&memo);
+    return result;
+}
+
+static inline int equals(double a, double b) { return islessequal(a, b) && isgreaterequal(a, b); }
+static inline int is_whole(double a) { return isfinite(a) && equals(a, floor(a)); }
+
+static const dag_node* make_constant(expr_dag* dag, double val)
+{
+    if (val < 0)
+        return dag_make_unary(dag, OP_NEG, dag_make_number(dag, -val));
+    return dag_make_number(dag, val);
+}
+
+static int get_constant(const dag_node* node, double* val)
+{
+    if (is_num(node))
+    {
+        *val = get_num(node);
+        return 1;
+    }
+    if (op_cmp(node, OP_NEG) && is_num(node->right))
+    {
+        *val = -get_num(node->right);
+        return 1;
+    }
+    return 0;
+}
+
+static const dag_node* simplify_node(expr_dag* dag, dag_memo* memo, const dag_node* node)
+{
+    const dag_node* result = dag_memo_get(memo, node);
+    if (result) return result;
+
+    if (!is_op(node))
+    {
+        result = is_num(node) ? make_constant(dag, get_num(node)) : node;
+        dag_memo_set(memo, node, result);
+        dag_memo_set(memo, result, result);
+        return result;
+    }
+
+    const dag_node* left  = node->left ? simplify_node(dag, memo, node->left) : NULL;
+    const dag_node* right = simplify_node(dag, memo, node->right);
+
+    op_type op = get_op(node);
+    const dag_node* current = left ? dag_make_binary(dag, op, left, right)
+                                   : dag_make_unary (dag, op, right);
+
+    /* Provisional result, breaks cycles between rules */
+    dag_memo_set(memo, node, current);
+    dag_memo_set(memo, current, current);
+
+    result = current;
+    for (size_t i = 0; i < RULE_COUNT; i++)
+    {
+        if (RULES[i].op != ANY_OP && RULES[i].op != (int) op)
+            continue;
+
+        const dag_node* rewritten = RULES[i].apply(dag, op, left, right);
+        if (rewritten && rewritten != current)
+        {
+            result = simplify_node(dag, memo, rewritten);
+            break;
+        }
+    }
+
+    dag_memo_set(memo, node, result);
+    dag_memo_set(memo, current, result);
+    dag_memo_set(memo, result, result);
+    return result;
+}
+
+static int compare_nodes(const dag_node* node1, const dag_node* node2)
+{
+    if (node1 == node2) return 0;
+    if (!node1 || !node2) return node1 ? 1 : -1;
+
+    if (node1->type != node2->type)
+        return node1->type < node2->type ? -1 : 1;
+
+    int res = 0;
+    switch (node1->type)
+    {
+    case NODE_NUM:
+        if (get_num(node1) < get_num(node2)) res = -1;
+        if (get_num(node1) > get_num(node2)) res =  1;
+        break;
+    case NODE_VAR:
+        /* Order of terms is visible in output, so names are compared */
+        res = strcmp(symbol_name(get_var(node1)), symbol_name(get_var(node2)));
+        break;
+    case NODE_OP:
+        if (get_op(node1) != get_op(node2))
+            return get_op(node1) < get_op(node2) ? -1 : 1;
+        res = compare_nodes(node1->left, node2->left);
+        if (res == 0)
+            res = compare_nodes(node1->right, node2->right);
+        break;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return 0);
+    }
+
+    /* Structurally different nodes are never equal */
+    if (res == 0)
+        return node1->id < node2->id ? -1 : 1;
+    return res;
+}
+
+static const dag_node* fold_constants(expr_dag* dag, op_type op,
+                                      const dag_node* left, const dag_node* right)
+{
+    /* Negative numbers are already folded */
+    if (op == OP_NEG && is_num(right)) return NULL;
+
+    double l_val = 0, r_val = 0;
+    if (left && !get_constant(left, &l_val)) return NULL;
+    if (!get_constant(right, &r_val)) return NULL;
+
+    double val = apply_op(op, l_val, r_val);
+    if (!isfinite(val)) return NULL;
+
+    return make_constant(dag, val);
+}
+
+/* Sums */
+
+struct sum_term
+{
+    double coef;
+    const dag_node* term;
+};
+
+struct term_list
+{
+    sum_term* terms;
+    size_t size;
+    size_t capacity;
+    double constant;
+    /**
+     * @brief Whether some term was lost due to allocation failure
+     */
+    int failed;
+};
+
+static const dag_node* split_coefficient(expr_dag* dag, const dag_node* node, double* coef);
+static const dag_node* make_term(expr_dag* dag, double coef, const dag_node* term);
+
+static void add_terms(expr_dag* dag, term_list* list, const dag_node* node, double sign)
+{
+    double val = 0;
+    if (get_constant(node, &val))
+    {
+        list->constant += sign * val;
+        return;
+    }
+
+    if (op_cmp(node, OP_ADD) || op_cmp(node, OP_SUB))
+    {
+        add_terms(dag, list, node->left, sign);
+        add_terms(dag, list, node->right, op_cmp(node, OP_ADD) ? sign : -sign);
+        return;
+    }
+
+    if (op_cmp(node, OP_NEG))
+    {
+        add_terms(dag, list, node->right, -sign);
+        return;
+    }
+
+    if (list->size == list->capacity)
+    {
+        size_t capacity = list->capacity ? 2 * list->capacity : 8;
+        sum_term* terms = (sum_term*) realloc(list->terms, capacity * sizeof(*terms));
+        LOG_ASSERT_ERROR(terms != NULL, { list->failed = 1; return; },
+            "Failed to allocate memory", NULL);
+
+        list->terms    = terms;
+        list->capacity = capacity;
+    }
+
+    double coef = 1;
+    const dag_node* term = split_coefficient(dag, node, &coef);
+    list->terms[list->size++] = {.coef = sign * coef, .term = term};
+}
+
+static int compare_terms(const void* term1, const void* term2)
+{
+    return compare_nodes(((const sum_term*) term1)->term, ((const sum_term*) term2)->term);
+}
+
+static const dag_node* collect_sum(expr_dag* dag, op_type op,
+                                   const dag_node* left, const dag_node* right)
+{
+    term_list list = {};
+
+    if (left) add_terms(dag, &list, left, 1);
+    add_terms(dag, &list, right, op == OP_ADD ? 1 : -1);
+
+    /* Sum is left as is, if some of its terms were lost */
+    if (list.failed)
+    {
+        free(list.terms);
+        return NULL;
+    }
+
+    if (list.size > 0)
+        qsort(list.terms, list.size, sizeof(*list.terms), compare_terms);
+
+    size_t count = 0;
+    for (size_t i = 0; i < list.size; i++)
+    {
+        if (count > 0 && list.terms[count - 1].term == list.terms[i].term)
+            list.terms[count - 1].coef += list.terms[i].coef;
+        else
+            list.terms[count++] = list.terms[i];
+    }
+
+    const dag_node* result = NULL;
+
+    /* Positive terms go first, so that sum does not start with negation */
+    for (int negative = 0; negative <= 1; negative++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            double coef = list.terms[i].coef;
+            if (equals(coef, 0) || (coef < 0) != negative) continue;
+
+            const dag_node* term = make_term(dag, fabs(coef), list.terms[i].term);
+
+            if (!result)
+                result = negative ? dag_make_unary(dag, OP_NEG, term) : term;
+            else
+                result = dag_make_binary(dag, negative ? OP_SUB : OP_ADD, result, term);
+        }
+    }
+
+    if (!result)
+        result = make_constant(dag, list.constant);
+    else if (!equals(list.constant, 0))
+        result = dag_make_binary(dag, list.constant < 0 ? OP_SUB : OP_ADD,
+                                 result, dag_make_number(dag, fabs(list.constant)));
+
+    free(list.terms);
+    return result;
+}
+
+static const dag_node* split_coefficient(expr_dag* dag, const dag_node* node, double* coef)
+{
+    *coef = 1;
+
+    if (op_cmp(node, OP_MUL) && is_num(node->left))
+    {
+        *coef = get_num(node->left);
+        return node->right;
+    }
+
+    if (op_cmp(node, OP_DIV) && is_num(node->left))
+    {
+        *coef = get_num(node->left);
+        return dag_make_binary(dag, OP_DIV, dag_make_number(dag, 1), node->right);
+    }
+
+    return node;
+}
+
+static const dag_node* make_term(expr_dag* dag, double coef, const dag_node* term)
+{
+    if (equals(coef, 1)) return term;
+
+    if (op_cmp(term, OP_DIV) && is_num(term->left) && equals(get_num(term->left), 1))
+        return dag_make_binary(dag, OP_DIV, dag_make_number(dag, coef), term->right);
+
+    return dag_make_binary(dag, OP_MUL, dag_make_number(dag, coef), term);
+}
+
+/* Products */
+
+struct product_factor
+{
+    double exponent;
+    const dag_node* base;
+};
+
+struct factor_list
+{
+    product_factor* factors;
+    size_t size;
+    size_t capacity;
+    double coef;
+    int zero_division;
+    /**
+     * @brief Whether some factor was lost due to allocation failure
+     */
+    int failed;
+};
+
+static void add_factors(factor_list* list, const dag_node* node, double exponent)
+{
+    double val = 0;
+    if (get_constant(node, &val))
+    {
+        if (exponent < 0 && equals(val, 0))
+            list->zero_division = 1;
+        else
+            list->coef *= pow(val, exponent);
+        return;
+    }
+
+    if (op_cmp(node, OP_MUL) || op_cmp(node, OP_DIV))
+    {
+        add_factors(list, node->left, exponent);
+        add_factors(list, node->right, op_cmp(node, OP_MUL) ? exponent : -exponent);
+        return;
+    }
+
+    /* Exponent is always whole here, unless it came from power below */
+    if (op_cmp(node, OP_NEG))
+    {
+        if (!is_whole(exponent / 2))
+            list->coef = -list->coef;
+        add_factors(list, node->right, exponent);
+        return;
+    }
+
+    const dag_node* base = node;
+    if (op_cmp(node, OP_POW) && get_constant(node->right, &val))
+    {
+        base = node->left;
+        exponent *= val;
+
+        /* (a*b)^n = a^n * b^n only holds for whole n */
+        if (is_whole(exponent) && (op_cmp(base, OP_MUL) || op_cmp(base, OP_DIV)
+                                                     || op_cmp(base, OP_NEG)))
+        {
+            add_factors(list, base, exponent);
+            return;
+        }
+    }
+
+    if (list->size == list->capacity)
+    {
+        size_t capacity = list->capacity ? 2 * list->capacity : 8;
+        product_factor* factors = (product_factor*) realloc(list->factors,
+                                                    capacity * sizeof(*factors));
+        LOG_ASSERT_ERROR(factors != NULL, { list->failed = 1; return; },
+            "Failed to allocate memory", NULL);
+
+        list->factors  = factors;
+        list->capacity = capacity;
+    }
+
+    list->factors[list->size++] = {.exponent = exponent, .base = base};
+}
+
+static int compare_factors(const void* factor1, const void* factor2)
+{
+    return compare_nodes(((const product_factor*) factor1)->base,
+                         ((const product_factor*) factor2)->base);
+}
+
+static const dag_node* make_power(expr_dag* dag, const dag_node* base, double exponent)
+{
+    if (equals(exponent, 1)) return base;
+    return dag_make_binary(dag, OP_POW, base, make_constant(dag, exponent));
+}
+
+static const dag_node* collect_product(expr_dag* dag, op_type op,
+                                       const dag_node* left, const dag_node* right)
+{
+    factor_list list = {.factors = NULL, .size = 0, .capacity = 0, .coef = 1,
+                        .zero_division = 0, .failed = 0};
+
+    add_factors(&list, left, 1);
+    add_factors(&list, right, op == OP_MUL ? 1 : -1);
+
+    /* Product is left as is, if some of its factors were lost */
+    if (list.failed)
+    {
+        free(list.factors);
+        return NULL;
+    }
+
+    if (list.zero_division)
+    {
+        free(list.factors);
+        LOG_ASSERT_ERROR(0, return NULL, "Division by zero", NULL);
+    }
+
+    if (equals(list.coef, 0))
+    {
+        free(list.factors);
+        return dag_make_number(dag, 0);
+    }
+
+    if (list.size > 0)
+        qsort(list.factors, list.size, sizeof(*list.factors), compare_factors);
+
+    const dag_node* numerator   = NULL;
+    const dag_node* denominator = NULL;
+
+    for (size_t i = 0; i < list.size; )
+    {
+        const dag_node* base = list.factors[i].base;
+        double exponent = 0;
+        for (; i < list.size && list.factors[i].base == base; i++)
+            exponent += list.factors[i].exponent;
+
+        if (equals(exponent, 0)) continue;
+
+        const dag_node** part = exponent > 0 ? &numerator : &denominator;
+        const dag_node* factor = make_power(dag, base, fabs(exponent));
+        *part = *part ? dag_make_binary(dag, OP_MUL, *part, factor) : factor;
+    }
+
+    free(list.factors);
+
+    double coef = fabs(list.coef);
+    const dag_node* result = NULL;
+
+    if (!numerator)
+    {
+        result = dag_make_number(dag, coef);
+        if (denominator)
+            result = dag_make_binary(dag, OP_DIV, result, denominator);
+    }
+    else
+    {
+        result = numerator;
+        if (denominator)
+            result = dag_make_binary(dag, OP_DIV, result, denominator);
+        if (!equals(coef, 1))
+            result = dag_make_binary(dag, OP_MUL, dag_make_number(dag, coef), result);
+    }
+
+    if (list.coef < 0)
+        result = dag_make_unary(dag, OP_NEG, result);
+
+    return result;
+}
+
+/* Functions */
+
+static const dag_node* simplify_power(expr_dag* dag, op_type op,
+                                      const dag_node* left, const dag_node* right)
+{
+    (void) op;
+
+    double exponent = 0, base = 0;
+
+    if (get_constant(left, &base) && equals(base, 1))
+        return dag_make_number(dag, 1);
+
+    if (!get_constant(right, &exponent))
+        return NULL;
+
+    if (equals(exponent, 0)) return dag_make_number(dag, 1);
+    if (equals(exponent, 1)) return left;
+
+    if (!is_whole(exponent))
+        return NULL;
+
+    if (op_cmp(left, OP_NEG))
+    {
+        const dag_node* power = dag_make_binary(dag, OP_POW, left->right, right);
+        if (is_whole(exponent / 2))
+            return power;
+        return dag_make_unary(dag, OP_NEG, power);
+    }
+
+    /* (a^m)^n = a^(m*n) only holds for whole m and n */
+    double inner = 0;
+    if (op_cmp(left, OP_POW) && get_constant(left->right, &inner) && is_whole(inner))
+        return make_power(dag, left->left, inner * exponent);
+
+    return NULL;
+}
+
+static const dag_node* extract_odd(expr_dag* dag, op_type op,
+                                   const dag_node* left, const dag_node* right)
+{
+    (void) left;
+
+    if (!op_cmp(right, OP_NEG)) return NULL;
+
+    return dag_make_unary(dag, OP_NEG, dag_make_unary(dag, op, right->right));
+}
+
+static const dag_node* extract_even(expr_dag* dag, op_type op,
+                                    const dag_node* left, const dag_node* right)
+{
+    (void) left;
+
+    if (!op_cmp(right, OP_NEG)) return NULL;
+
+    return dag_make_unary(dag, op, right->right);
+}
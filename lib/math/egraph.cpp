@@ -0,0 +1,947 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "bytecode.h"
+#include "egraph.h"
+
+static const size_t DEFAULT_CAPACITY   = 256;
+static const size_t DEFAULT_TABLE_SIZE = 512;
+
+/**
+ * @brief Maximal exponent, for which power is rewritten as multiplication
+ */
+static const double MAX_UNROLLED_POWER = 16;
+
+static size_t find(egraph* graph, size_t id);
+static void   merge(egraph* graph, size_t id1, size_t id2);
+static size_t add_node(egraph* graph, const egraph_node* pattern);
+static size_t add_num(egraph* graph, double val);
+static size_t add_unary(egraph* graph, op_type op, size_t right);
+static size_t add_binary(egraph* graph, op_type op, size_t left, size_t right);
+
+static void   rebuild(egraph* graph);
+static void   rewrite_node(egraph* graph, size_t index);
+
+static size_t hash_node(egraph* graph, const egraph_node* node);
+static int    equal_nodes(egraph* graph, const egraph_node* node1, const egraph_node* node2);
+static size_t table_find(egraph* graph, const egraph_node* node);
+static void   table_insert(egraph* graph, size_t index);
+static void   table_grow(egraph* graph);
+
+static int    is_total_node(egraph* graph, const egraph_node* node);
+
+static double op_cost(op_type op);
+static ast_node* build_tree(const egraph* graph, const size_t* best, size_t cls);
+
+void egraph_ctor(egraph* graph)
+{
+    LOG_ASSERT(graph != NULL, return);
+
+    *graph = {
+        .nodes = (egraph_node*) calloc(DEFAULT_CAPACITY, sizeof(egraph_node)),
+        .size = 0,
+        .capacity = DEFAULT_CAPACITY,
+        .table = (size_t*) calloc(DEFAULT_TABLE_SIZE, sizeof(size_t)),
+        .table_size = DEFAULT_TABLE_SIZE,
+        .class_start = NULL,
+        .members = NULL,
+        .version = 0
+    };
+
+    for (size_t i = 0; i < graph->table_size; i++)
+        graph->table[i] = EGRAPH_NONE;
+}
+
+void egraph_dtor(egraph* graph)
+{
+    LOG_ASSERT(graph != NULL, return);
+
+    free(graph->nodes);
+    free(graph->table);
+    free(graph->class_start);
+    free(graph->members);
+    *graph = {};
+}
+
+size_t egraph_add_tree(egraph* graph, const ast_node* node)
+{
+    LOG_ASSERT(graph != NULL, return EGRAPH_NONE);
+    LOG_ASSERT(node != NULL, return EGRAPH_NONE);
+
+    egraph_node pattern = {
+        .type = node->type,
+        .value = node->value,
+        .left = EGRAPH_NONE,
+        .right = EGRAPH_NONE
+    };
+
+    if (is_op(node))
+    {
+        if (node->left)
+            pattern.left = egraph_add_tree(graph, node->left);
+        pattern.right = egraph_add_tree(graph, node->right);
+    }
+
+    return add_node(graph, &pattern);
+}
+
+size_t egraph_saturate(egraph* graph, size_t max_iterations, size_t max_nodes)
+{
+    LOG_ASSERT(graph != NULL, return 0);
+
+    size_t iteration = 0;
+    while (iteration < max_iterations && graph->size < max_nodes)
+    {
+        rebuild(graph);
+
+        size_t version = graph->version;
+        size_t size    = graph->size;
+
+        /* Nodes added during this iteration are only matched in the next */
+        for (size_t i = 0; i < size && graph->size < max_nodes; i++)
+            if (graph->nodes[i].alive)
+                rewrite_node(graph, i);
+
+        iteration++;
+        if (graph->version == version)
+            break;
+    }
+
+    rebuild(graph);
+    return iteration;
+}
+
+ast_node* egraph_extract(egraph* graph, size_t root)
+{
+    LOG_ASSERT(graph != NULL, return NULL);
+    LOG_ASSERT(root < graph->size, return NULL);
+
+    rebuild(graph);
+
+    double* cost = (double*) calloc(graph->size, sizeof(*cost));
+    size_t* best = (size_t*) calloc(graph->size, sizeof(*best));
+
+    LOG_ASSERT_ERROR(cost != NULL && best != NULL,
+        { free(cost); free(best); return NULL; },
+        "Failed to allocate extraction tables", NULL);
+
+    for (size_t i = 0; i < graph->size; i++)
+    {
+        cost[i] = INFINITY;
+        best[i] = EGRAPH_NONE;
+    }
+
+    /* Every operation has positive cost, so the cheapest node of e-class
+     * never depends on e-class itself, and iteration converges */
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (size_t i = 0; i < graph->size; i++)
+        {
+            const egraph_node* node = &graph->nodes[i];
+            if (!node->alive) continue;
+
+            double node_cost = 1;
+            if (node->type == NODE_OP)
+            {
+                /* Equal operands are evaluated once */
+                node_cost = op_cost(node->value.op) + cost[node->right];
+                if (node->left != EGRAPH_NONE && node->left != node->right)
+                    node_cost += cost[node->left];
+            }
+
+            size_t cls = find(graph, i);
+            if (node_cost < cost[cls])
+            {
+                cost[cls] = node_cost;
+                best[cls] = i;
+                changed = 1;
+            }
+        }
+    }
+
+    ast_node* result = build_tree(graph, best, find(graph, root));
+
+    free(cost);
+    free(best);
+    return result;
+}
+
+static size_t find(egraph* graph, size_t id)
+{
+    while (graph->nodes[id].parent != id)
+    {
+        size_t parent = graph->nodes[id].parent;
+        graph->nodes[id].parent = graph->nodes[parent].parent;
+        id = parent;
+    }
+    return id;
+}
+
+static void merge(egraph* graph, size_t id1, size_t id2)
+{
+    if (id1 == EGRAPH_NONE || id2 == EGRAPH_NONE) return;
+
+    id1 = find(graph, id1);
+    id2 = find(graph, id2);
+    if (id1 == id2) return;
+
+    if (id2 < id1)
+    {
+        size_t tmp = id1;
+        id1 = id2;
+        id2 = tmp;
+    }
+
+    egraph_node* root = &graph->nodes[id1];
+    egraph_node* child = &graph->nodes[id2];
+
+    child->parent = id1;
+    if (!root->is_const && child->is_const)
+    {
+        root->is_const = 1;
+        root->constant = child->constant;
+    }
+    root->is_total |= child->is_total;
+
+    graph->version++;
+}
+
+static int get_constant(egraph* graph, size_t cls, double* val)
+{
+    const egraph_node* root = &graph->nodes[find(graph, cls)];
+    if (!root->is_const) return 0;
+
+    *val = root->constant;
+    return 1;
+}
+
+static int is_constant(egraph* graph, size_t cls, double val)
+{
+    double constant = 0;
+    return get_constant(graph, cls, &constant)
+        && islessequal(constant, val) && isgreaterequal(constant, val);
+}
+
+static int is_total(egraph* graph, size_t cls)
+{
+    return graph->nodes[find(graph, cls)].is_total;
+}
+
+static inline int is_whole(double val) { return isfinite(val) && islessequal(val, floor(val)); }
+
+static size_t add_node(egraph* graph, const egraph_node* pattern)
+{
+    egraph_node node = *pattern;
+    if (node.left  != EGRAPH_NONE) node.left  = find(graph, node.left);
+    if (node.right != EGRAPH_NONE) node.right = find(graph, node.right);
+
+    size_t existing = table_find(graph, &node);
+    if (existing != EGRAPH_NONE)
+        return find(graph, existing);
+
+    if (graph->size == graph->capacity)
+    {
+        size_t new_capacity = 2 * graph->capacity;
+        egraph_node* new_nodes = (egraph_node*) realloc(graph->nodes,
+                                            new_capacity * sizeof(*new_nodes));
+        LOG_ASSERT_ERROR(new_nodes != NULL, return EGRAPH_NONE,
+                        "Failed to allocate e-graph nodes", NULL);
+
+        graph->nodes = new_nodes;
+        graph->capacity = new_capacity;
+    }
+
+    size_t index = graph->size++;
+    node.parent   = index;
+    node.alive    = 1;
+    node.is_const = node.type == NODE_NUM;
+    node.constant = node.is_const ? node.value.num : 0;
+
+    double left = 0, right = 0;
+    if (node.type == NODE_OP
+        && (node.left == EGRAPH_NONE || get_constant(graph, node.left, &left))
+        && get_constant(graph, node.right, &right))
+    {
+        double val = apply_op(node.value.op, left, right);
+        if (isfinite(val))
+        {
+            node.is_const = 1;
+            node.constant = val;
+        }
+    }
+    node.is_total = (node.is_const && isfinite(node.constant))
+                 || is_total_node(graph, &node);
+
+    graph->nodes[index] = node;
+    graph->version++;
+
+    table_insert(graph, index);
+    return index;
+}
+
+static size_t add_num(egraph* graph, double val)
+{
+    egraph_node pattern = {
+        .type = NODE_NUM,
+        .value = {.num = val},
+        .left = EGRAPH_NONE,
+        .right = EGRAPH_NONE
+    };
+    return add_node(graph, &pattern);
+}
+
+static size_t add_unary(egraph* graph, op_type op, size_t right)
+{
+    if (right == EGRAPH_NONE) return EGRAPH_NONE;
+
+    egraph_node pattern = {
+        .type = NODE_OP,
+        .value = {.op = op},
+        .left = EGRAPH_NONE,
+        .right = right
+    };
+    return add_node(graph, &pattern);
+}
+
+static size_t add_binary(egraph* graph, op_type op, size_t left, size_t right)
+{
+    if (left == EGRAPH_NONE || right == EGRAPH_NONE) return EGRAPH_NONE;
+
+    egraph_node pattern = {
+        .type = NODE_OP,
+        .value = {.op = op},
+        .left = left,
+        .right = right
+    };
+    return add_node(graph, &pattern);
+}
+
+static size_t add_power(egraph* graph, size_t base, double exponent)
+{
+    if (islessequal(exponent, 1) && isgreaterequal(exponent, 1))
+        return base;
+    return add_binary(graph, OP_POW, base, add_num(graph, exponent));
+}
+
+/**
+ * Restores congruence: e-nodes with equal operations and equal operand
+ * e-classes must belong to the same e-class. Groups nodes by e-classes
+ * afterwards.
+ */
+static void rebuild(egraph* graph)
+{
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+
+        for (size_t i = 0; i < graph->table_size; i++)
+            graph->table[i] = EGRAPH_NONE;
+
+        for (size_t i = 0; i < graph->size; i++)
+        {
+            egraph_node* node = &graph->nodes[i];
+            if (!node->alive) continue;
+
+            if (node->left  != EGRAPH_NONE) node->left  = find(graph, node->left);
+            if (node->right != EGRAPH_NONE) node->right = find(graph, node->right);
+
+            size_t existing = table_find(graph, node);
+            if (existing == EGRAPH_NONE)
+            {
+                table_insert(graph, i);
+                continue;
+            }
+
+            node->alive = 0;
+            if (find(graph, existing) != find(graph, i))
+            {
+                merge(graph, existing, i);
+                changed = 1;
+            }
+        }
+    }
+
+    free(graph->class_start);
+    free(graph->members);
+
+    graph->class_start = (size_t*) calloc(graph->size + 1, sizeof(size_t));
+    graph->members     = (size_t*) calloc(graph->size + 1, sizeof(size_t));
+
+    LOG_ASSERT_ERROR(graph->class_start != NULL && graph->members != NULL,
+        return, "Failed to allocate e-class lists", NULL);
+
+    /* Counting sort of alive nodes by their e-classes */
+    for (size_t i = 0; i < graph->size; i++)
+        if (graph->nodes[i].alive)
+            graph->class_start[find(graph, i) + 1]++;
+
+    for (size_t i = 0; i < graph->size; i++)
+        graph->class_start[i + 1] += graph->class_start[i];
+
+    size_t* position = (size_t*) calloc(graph->size + 1, sizeof(size_t));
+    LOG_ASSERT_ERROR(position != NULL, return,
+        "Failed to allocate e-class lists", NULL);
+
+    memcpy(position, graph->class_start, (graph->size + 1) * sizeof(size_t));
+    for (size_t i = 0; i < graph->size; i++)
+        if (graph->nodes[i].alive)
+            graph->members[position[find(graph, i)]++] = i;
+
+    free(position);
+}
+
+/**
+ * Finds next node of e-class `cls` with operation `op`, starting from
+ * `*pos`-th member. E-class must have been present at last rebuild.
+ */
+static int next_member(const egraph* graph, size_t cls, op_type op,
+                       size_t* pos, egraph_node* member)
+{
+    size_t start = graph->class_start[cls];
+    size_t end   = graph->class_start[cls + 1];
+
+    for (; start + *pos < end; (*pos)++)
+    {
+        const egraph_node* node = &graph->nodes[graph->members[start + *pos]];
+        if (node->type == NODE_OP && node->value.op == op)
+        {
+            *member = *node;
+            (*pos)++;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#define FOR_MEMBERS(member, cls, op)\
+    for (size_t member##_pos = 0; next_member(graph, cls, op, &member##_pos, &member); )
+
+static int same_class(egraph* graph, size_t cls1, size_t cls2)
+{
+    return find(graph, cls1) == find(graph, cls2);
+}
+
+static void rewrite_sum       (egraph* graph, size_t cls, op_type op, size_t left, size_t right);
+static void rewrite_product   (egraph* graph, size_t cls, size_t left, size_t right);
+static void rewrite_quotient  (egraph* graph, size_t cls, size_t left, size_t right);
+static void rewrite_power     (egraph* graph, size_t cls, size_t left, size_t right);
+static void rewrite_negation  (egraph* graph, size_t cls, size_t right);
+static void rewrite_function  (egraph* graph, size_t cls, op_type op, size_t right);
+
+static void rewrite_node(egraph* graph, size_t index)
+{
+    egraph_node node = graph->nodes[index];
+    if (node.type != NODE_OP) return;
+
+    size_t cls = find(graph, index);
+
+    /* Operands might have become constant after node was added */
+    double val = 0, left = 0, right = 0;
+    int is_const = get_constant(graph, cls, &val);
+    if (!is_const
+        && (node.left == EGRAPH_NONE || get_constant(graph, node.left, &left))
+        && get_constant(graph, node.right, &right))
+    {
+        val = apply_op(node.value.op, left, right);
+        is_const = isfinite(val);
+    }
+
+    if (is_const)
+    {
+        merge(graph, cls, add_num(graph, val));
+        return;
+    }
+
+    switch (node.value.op)
+    {
+    case OP_ADD:
+    case OP_SUB:
+        rewrite_sum(graph, cls, node.value.op, node.left, node.right);
+        break;
+    case OP_MUL:
+        rewrite_product(graph, cls, node.left, node.right);
+        break;
+    case OP_DIV:
+        rewrite_quotient(graph, cls, node.left, node.right);
+        break;
+    case OP_POW:
+        rewrite_power(graph, cls, node.left, node.right);
+        break;
+    case OP_NEG:
+        rewrite_negation(graph, cls, node.right);
+        break;
+    default:
+        rewrite_function(graph, cls, node.value.op, node.right);
+        break;
+    }
+}
+
+static void rewrite_sum(egraph* graph, size_t cls, op_type op, size_t left, size_t right)
+{
+    egraph_node lhs = {}, rhs = {};
+
+    if (is_constant(graph, right, 0))
+        merge(graph, cls, left);
+
+    if (op == OP_SUB)
+    {
+        /* a - a = 0 only where a is defined */
+        if (same_class(graph, left, right) && is_total(graph, left))
+            merge(graph, cls, add_num(graph, 0));
+
+        /* a - b = a + (-b) */
+        merge(graph, cls, add_binary(graph, OP_ADD, left, add_unary(graph, OP_NEG, right)));
+    }
+    else
+    {
+        /* a + b = b + a */
+        merge(graph, cls, add_binary(graph, OP_ADD, right, left));
+
+        /* a + (b + c) = (a + b) + c */
+        FOR_MEMBERS(rhs, right, OP_ADD)
+            merge(graph, cls, add_binary(graph, OP_ADD,
+                                         add_binary(graph, OP_ADD, left, rhs.left),
+                                         rhs.right));
+
+        /* a + (-b) = a - b */
+        FOR_MEMBERS(rhs, right, OP_NEG)
+            merge(graph, cls, add_binary(graph, OP_SUB, left, rhs.right));
+
+        /* sin^2 a + cos^2 a = 1 */
+        FOR_MEMBERS(lhs, left, OP_POW)
+        {
+            if (!is_constant(graph, lhs.right, 2)) continue;
+
+            FOR_MEMBERS(rhs, right, OP_POW)
+            {
+                if (!is_constant(graph, rhs.right, 2)) continue;
+
+                egraph_node sine = {}, cosine = {};
+                FOR_MEMBERS(sine, lhs.left, OP_SIN)
+                    FOR_MEMBERS(cosine, rhs.left, OP_COS)
+                        if (same_class(graph, sine.right, cosine.right)
+                            && is_total(graph, sine.right))
+                            merge(graph, cls, add_num(graph, 1));
+            }
+        }
+    }
+
+    /* a * b + a * c = a * (b + c) */
+    FOR_MEMBERS(lhs, left, OP_MUL)
+        FOR_MEMBERS(rhs, right, OP_MUL)
+            if (same_class(graph, lhs.left, rhs.left))
+                merge(graph, cls, add_binary(graph, OP_MUL, lhs.left,
+                                    add_binary(graph, op, lhs.right, rhs.right)));
+
+    /* a / c + b / c = (a + b) / c */
+    FOR_MEMBERS(lhs, left, OP_DIV)
+        FOR_MEMBERS(rhs, right, OP_DIV)
+            if (same_class(graph, lhs.right, rhs.right))
+                merge(graph, cls, add_binary(graph, OP_DIV,
+                                    add_binary(graph, op, lhs.left, rhs.left),
+                                    lhs.right));
+
+    /* ln a + ln b = ln (a * b) is not used: logarithm of product is also
+     * defined for two negative factors, and merged e-classes must be
+     * undefined for the same values of variables */
+}
+
+static void rewrite_product(egraph* graph, size_t cls, size_t left, size_t right)
+{
+    egraph_node lhs = {}, rhs = {};
+
+    if (is_constant(graph, right, 1))
+        merge(graph, cls, left);
+    if (is_constant(graph, right, 0) && is_total(graph, left))
+        merge(graph, cls, add_num(graph, 0));
+
+    /* a * b = b * a */
+    merge(graph, cls, add_binary(graph, OP_MUL, right, left));
+
+    /* a * (b * c) = (a * b) * c */
+    FOR_MEMBERS(rhs, right, OP_MUL)
+        merge(graph, cls, add_binary(graph, OP_MUL,
+                                     add_binary(graph, OP_MUL, left, rhs.left),
+                                     rhs.right));
+
+    /* a * (-b) = -(a * b) */
+    FOR_MEMBERS(rhs, right, OP_NEG)
+        merge(graph, cls, add_unary(graph, OP_NEG, add_binary(graph, OP_MUL, left, rhs.right)));
+
+    /* a * (b / c) = (a * b) / c */
+    FOR_MEMBERS(rhs, right, OP_DIV)
+        merge(graph, cls, add_binary(graph, OP_DIV,
+                                     add_binary(graph, OP_MUL, left, rhs.left),
+                                     rhs.right));
+
+    /* Powers with equal bases are only collected for whole exponents of
+     * the same sign, so that domain of expression does not change:
+     * a * a^(-1) is undefined at zero, unlike a^0 */
+    double exponent1 = 0, exponent2 = 0;
+
+    if (same_class(graph, left, right))
+        merge(graph, cls, add_power(graph, left, 2));
+
+    FOR_MEMBERS(rhs, right, OP_POW)
+    {
+        if (!get_constant(graph, rhs.right, &exponent2) || !is_whole(exponent2))
+            continue;
+
+        if (same_class(graph, left, rhs.left) && isgreaterequal(exponent2, 0))
+            merge(graph, cls, add_power(graph, left, exponent2 + 1));
+
+        FOR_MEMBERS(lhs, left, OP_POW)
+            if (same_class(graph, lhs.left, rhs.left)
+                && get_constant(graph, lhs.right, &exponent1) && is_whole(exponent1)
+                && isgreaterequal(exponent1 * exponent2, 0))
+                merge(graph, cls, add_power(graph, lhs.left, exponent1 + exponent2));
+    }
+}
+
+static void rewrite_quotient(egraph* graph, size_t cls, size_t left, size_t right)
+{
+    egraph_node lhs = {}, rhs = {};
+
+    /* a / a = 1 is not used, as a may be zero */
+
+    double divisor = 0;
+    if (get_constant(graph, right, &divisor))
+    {
+        /* Multiplication by reciprocal is only exact for powers of two */
+        int exponent = 0;
+        double mantissa = frexp(divisor, &exponent);
+        if (islessequal(fabs(mantissa), 0.5) && isgreaterequal(fabs(mantissa), 0.5))
+            merge(graph, cls, add_binary(graph, OP_MUL, left, add_num(graph, 1 / divisor)));
+    }
+
+    /* (a / b) / c = a / (b * c) */
+    FOR_MEMBERS(lhs, left, OP_DIV)
+        merge(graph, cls, add_binary(graph, OP_DIV, lhs.left,
+                                     add_binary(graph, OP_MUL, lhs.right, right)));
+
+    /* a / (b / c) = (a * c) / b */
+    FOR_MEMBERS(rhs, right, OP_DIV)
+        merge(graph, cls, add_binary(graph, OP_DIV,
+                                     add_binary(graph, OP_MUL, left, rhs.right),
+                                     rhs.left));
+
+    /* sin a / cos a = tan a, cos a / sin a = cot a */
+    FOR_MEMBERS(lhs, left, OP_SIN)
+        FOR_MEMBERS(rhs, right, OP_COS)
+            if (same_class(graph, lhs.right, rhs.right))
+                merge(graph, cls, add_unary(graph, OP_TAN, lhs.right));
+
+    FOR_MEMBERS(lhs, left, OP_COS)
+        FOR_MEMBERS(rhs, right, OP_SIN)
+            if (same_class(graph, lhs.right, rhs.right))
+                merge(graph, cls, add_unary(graph, OP_COT, lhs.right));
+
+    if (is_constant(graph, left, 1))
+    {
+        FOR_MEMBERS(rhs, right, OP_TAN)
+            merge(graph, cls, add_unary(graph, OP_COT, rhs.right));
+        FOR_MEMBERS(rhs, right, OP_COT)
+            merge(graph, cls, add_unary(graph, OP_TAN, rhs.right));
+    }
+}
+
+static void rewrite_power(egraph* graph, size_t cls, size_t left, size_t right)
+{
+    egraph_node lhs = {};
+
+    if (is_constant(graph, left, 1))
+        merge(graph, cls, add_num(graph, 1));
+
+    double exponent = 0;
+    if (!get_constant(graph, right, &exponent))
+        return;
+
+    if (is_constant(graph, right, 0))
+        merge(graph, cls, add_num(graph, 1));
+    if (is_constant(graph, right, 1))
+        merge(graph, cls, left);
+    if (is_constant(graph, right, 0.5))
+        merge(graph, cls, add_unary(graph, OP_SQRT, left));
+
+    if (!is_whole(exponent))
+        return;
+
+    /* Whole powers are computed by repeated squaring */
+    if (exponent >= 2 && exponent <= MAX_UNROLLED_POWER)
+    {
+        if (is_whole(exponent / 2))
+        {
+            size_t half = add_power(graph, left, exponent / 2);
+            merge(graph, cls, add_binary(graph, OP_MUL, half, half));
+        }
+        else
+            merge(graph, cls, add_binary(graph, OP_MUL,
+                                         add_power(graph, left, exponent - 1), left));
+    }
+
+    if (exponent < 0)
+        merge(graph, cls, add_binary(graph, OP_DIV, add_num(graph, 1),
+                                     add_power(graph, left, -exponent)));
+
+    /* (a^m)^n = a^(m*n) */
+    double inner = 0;
+    FOR_MEMBERS(lhs, left, OP_POW)
+        if (get_constant(graph, lhs.right, &inner) && is_whole(inner))
+            merge(graph, cls, add_power(graph, lhs.left, inner * exponent));
+}
+
+static void rewrite_negation(egraph* graph, size_t cls, size_t right)
+{
+    egraph_node rhs = {};
+
+    /* -(-a) = a */
+    FOR_MEMBERS(rhs, right, OP_NEG)
+        merge(graph, cls, rhs.right);
+
+    /* -(a - b) = b - a */
+    FOR_MEMBERS(rhs, right, OP_SUB)
+        merge(graph, cls, add_binary(graph, OP_SUB, rhs.right, rhs.left));
+}
+
+static void rewrite_function(egraph* graph, size_t cls, op_type op, size_t right)
+{
+    egraph_node rhs = {};
+
+    switch (op)
+    {
+    case OP_SIN:
+    case OP_TAN:
+    case OP_COT:
+    case OP_ARCSIN:
+    case OP_ARCTAN:
+        FOR_MEMBERS(rhs, right, OP_NEG)
+            merge(graph, cls, add_unary(graph, OP_NEG, add_unary(graph, op, rhs.right)));
+        break;
+    case OP_COS:
+        FOR_MEMBERS(rhs, right, OP_NEG)
+            merge(graph, cls, add_unary(graph, op, rhs.right));
+        break;
+    default:
+        break;
+    }
+}
+
+#undef FOR_MEMBERS
+
+static inline size_t hash_combine(size_t seed, size_t val)
+{
+    return seed ^ (val + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+static size_t hash_node(egraph* graph, const egraph_node* node)
+{
+    size_t hash = (size_t) node->type;
+
+    switch (node->type)
+    {
+    case NODE_NUM:
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &node->value.num, sizeof(bits));
+        return hash_combine(hash, bits);
+    }
+    case NODE_VAR:
+        return hash_combine(hash, (size_t) node->value.var);
+    case NODE_OP:
+        hash = hash_combine(hash, (size_t) node->value.op);
+        hash = hash_combine(hash, node->left == EGRAPH_NONE ? 0 : find(graph, node->left));
+        hash = hash_combine(hash, find(graph, node->right));
+        return hash;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return 0);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return 0);
+}
+
+static int equal_nodes(egraph* graph, const egraph_node* node1, const egraph_node* node2)
+{
+    if (node1->type != node2->type) return 0;
+
+    switch (node1->type)
+    {
+    case NODE_NUM:
+        return memcmp(&node1->value.num, &node2->value.num, sizeof(double)) == 0;
+    case NODE_VAR:
+        return node1->value.var == node2->value.var;
+    case NODE_OP:
+        if (node1->value.op != node2->value.op) return 0;
+        if ((node1->left == EGRAPH_NONE) != (node2->left == EGRAPH_NONE)) return 0;
+        if (node1->left != EGRAPH_NONE && !same_class(graph, node1->left, node2->left))
+            return 0;
+        return same_class(graph, node1->right, node2->right);
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return 0);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return 0);
+}
+
+static size_t table_find(egraph* graph, const egraph_node* node)
+{
+    size_t mask = graph->table_size - 1;
+    for (size_t slot = hash_node(graph, node) & mask; ; slot = (slot + 1) & mask)
+    {
+        size_t index = graph->table[slot];
+        if (index == EGRAPH_NONE)
+            return EGRAPH_NONE;
+        if (equal_nodes(graph, &graph->nodes[index], node))
+            return index;
+    }
+}
+
+static void table_insert(egraph* graph, size_t index)
+{
+    /* Load factor is kept below one half */
+    if (2 * graph->size > graph->table_size)
+        table_grow(graph);
+
+    size_t mask = graph->table_size - 1;
+    size_t slot = hash_node(graph, &graph->nodes[index]) & mask;
+    while (graph->table[slot] != EGRAPH_NONE)
+        slot = (slot + 1) & mask;
+
+    graph->table[slot] = index;
+}
+
+static void table_grow(egraph* graph)
+{
+    size_t new_size = 2 * graph->table_size;
+    size_t* new_table = (size_t*) calloc(new_size, sizeof(*new_table));
+    LOG_ASSERT_ERROR(new_table != NULL, return,
+                    "Failed to allocate e-graph table", NULL);
+
+    for (size_t i = 0; i < new_size; i++)
+        new_table[i] = EGRAPH_NONE;
+
+    size_t* old_table = graph->table;
+    size_t  old_size  = graph->table_size;
+
+    graph->table = new_table;
+    graph->table_size = new_size;
+
+    for (size_t i = 0; i < old_size; i++)
+    {
+        if (old_table[i] == EGRAPH_NONE) continue;
+
+        size_t slot = hash_node(graph, &graph->nodes[old_table[i]]) & (new_size - 1);
+        while (new_table[slot] != EGRAPH_NONE)
+            slot = (slot + 1) & (new_size - 1);
+        new_table[slot] = old_table[i];
+    }
+
+    free(old_table);
+}
+
+/**
+ * Whether node is finite for all finite values of variables, provided
+ * that its operands are
+ */
+static int is_total_node(egraph* graph, const egraph_node* node)
+{
+    switch (node->type)
+    {
+    case NODE_NUM:
+        return isfinite(node->value.num);
+    case NODE_VAR:
+        return 1;
+    case NODE_OP:
+        break;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return 0);
+    }
+
+    int right = is_total(graph, node->right);
+    double exponent = 0;
+
+    switch (node->value.op)
+    {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+        return right && is_total(graph, node->left);
+    case OP_NEG:
+    case OP_SIN:
+    case OP_COS:
+    case OP_ARCTAN:
+    case OP_ARCCOT:
+        return right;
+    case OP_POW:
+        return is_total(graph, node->left)
+            && get_constant(graph, node->right, &exponent)
+            && is_whole(exponent) && isgreaterequal(exponent, 0);
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Approximate cost of operation, relative to addition
+ */
+static double op_cost(op_type op)
+{
+    switch (op)
+    {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_NEG:
+        return 1;
+    case OP_DIV:
+    case OP_SQRT:
+        return 4;
+    case OP_POW:
+    case OP_LN:
+    case OP_SIN:
+    case OP_COS:
+        return 20;
+    case OP_TAN:
+        return 25;
+    case OP_COT:
+        return 26;
+    case OP_ARCSIN:
+    case OP_ARCCOS:
+    case OP_ARCTAN:
+    case OP_ARCCOT:
+        return 30;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return INFINITY);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return INFINITY);
+}
+
+static ast_node* build_tree(const egraph* graph, const size_t* best, size_t cls)
+{
+    LOG_ASSERT(best[cls] != EGRAPH_NONE, return NULL);
+
+    const egraph_node* node = &graph->nodes[best[cls]];
+    switch (node->type)
+    {
+    case NODE_NUM: return make_number_node(node->value.num);
+    case NODE_VAR: return make_var_node(node->value.var);
+    case NODE_OP:
+        if (node->left == EGRAPH_NONE)
+            return make_unary_node(node->value.op, build_tree(graph, best, node->right));
+        return make_binary_node(node->value.op,
+                                build_tree(graph, best, node->left),
+                                build_tree(graph, best, node->right));
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return NULL);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return NULL);
+}
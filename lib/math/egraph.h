@@ -0,0 +1,166 @@
+/**
+ * @file egraph.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Equality saturation over expression graphs
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note E-graph stores many equivalent expressions at once: every e-class
+ * is a set of e-nodes, which compute the same value, and operands of
+ * e-nodes are e-classes rather than single expressions. Rewrite rules only
+ * ever add equalities, so the cheapest expression can be chosen after all
+ * rules are applied. Every expression of e-class must be undefined for the
+ * same values of variables, so rules, which drop subexpressions (such as
+ * `a - a = 0`), only apply to subexpressions, defined everywhere.
+ */
+
+#ifndef EGRAPH_H
+#define EGRAPH_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+/**
+ * @brief Missing operand or e-class
+ */
+const size_t EGRAPH_NONE = (size_t) -1;
+
+/**
+ * @brief E-graph node. Node index is also an id of e-class, which was
+ * created together with node.
+ */
+struct egraph_node
+{
+    /**
+     * @brief Node type
+     */
+    node_type type;
+    /**
+     * @brief Stored value
+     */
+    node_value value;
+
+    /**
+     * @brief Left operand e-class, `EGRAPH_NONE` for unary operations and
+     * leaves
+     */
+    size_t left;
+    /**
+     * @brief Right operand e-class, `EGRAPH_NONE` for leaves
+     */
+    size_t right;
+
+    /**
+     * @brief Union-find parent of e-class with this id
+     */
+    size_t parent;
+    /**
+     * @brief Whether e-class with this id is known to be constant
+     */
+    int is_const;
+    /**
+     * @brief Value of constant e-class
+     */
+    double constant;
+    /**
+     * @brief Whether e-class with this id is finite for all finite values of
+     * variables. Overflow is not taken into account.
+     */
+    int is_total;
+    /**
+     * @brief Whether node is not a duplicate of another node
+     */
+    int alive;
+};
+
+/**
+ * @brief E-graph
+ */
+struct egraph
+{
+    /**
+     * @brief All e-nodes
+     */
+    egraph_node* nodes;
+    /**
+     * @brief Number of e-nodes
+     */
+    size_t size;
+    /**
+     * @brief Allocated e-nodes
+     */
+    size_t capacity;
+
+    /**
+     * @brief Open addressing hash table of e-node indices
+     */
+    size_t* table;
+    /**
+     * @brief Hash table size, power of two
+     */
+    size_t table_size;
+
+    /**
+     * @brief Offsets of e-class member lists in `members`, indexed by
+     * e-class id. Only valid for nodes present at last rebuild.
+     */
+    size_t* class_start;
+    /**
+     * @brief Alive nodes grouped by e-class
+     */
+    size_t* members;
+
+    /**
+     * @brief Number of changes made to the graph
+     */
+    size_t version;
+};
+
+/**
+ * @brief Create empty e-graph
+ *
+ * @param[out] graph E-graph
+ */
+void egraph_ctor(egraph* graph);
+
+/**
+ * @brief Destroy e-graph
+ *
+ * @param[inout] graph E-graph
+ */
+void egraph_dtor(egraph* graph);
+
+/**
+ * @brief Add expression to e-graph
+ *
+ * @param[inout] graph E-graph
+ * @param[in] node Expression
+ * @return E-class of expression
+ */
+size_t egraph_add_tree(egraph* graph, const ast_node* node);
+
+/**
+ * @brief Apply rewrite rules until no rule adds new equalities or limits are
+ * exceeded
+ *
+ * @param[inout] graph E-graph
+ * @param[in] max_iterations Maximal number of rule application rounds
+ * @param[in] max_nodes Rules are not applied after e-graph grows larger
+ * @return Number of performed iterations
+ */
+size_t egraph_saturate(egraph* graph, size_t max_iterations, size_t max_nodes);
+
+/**
+ * @brief Build expression with the lowest evaluation cost. Nodes are
+ * allocated in current arena.
+ *
+ * @param[inout] graph E-graph
+ * @param[in] root Expression e-class
+ * @return Cheapest expression
+ */
+ast_node* egraph_extract(egraph* graph, size_t root);
+
+#endif
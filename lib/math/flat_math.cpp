@@ -0,0 +1,282 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+#include "bytecode.h"
+#include "flat_math.h"
+
+struct flat_state
+{
+    flat_tree* tree;
+    uint8_t* depends;
+    uint32_t* result;
+    uint32_t zero;
+    uint32_t one;
+};
+
+static int state_ctor(flat_state* state, flat_tree* tree, uint32_t root);
+static void state_dtor(flat_state* state);
+
+static uint32_t differentiate_node(flat_state* state, uint32_t node);
+static uint32_t simplify_node(flat_state* state, uint32_t node);
+
+static inline int equals(double a, double b) { return islessequal(a, b) && isgreaterequal(a, b); }
+
+static inline int num_equals(const flat_tree* tree, uint32_t node, double val)
+{
+    return flat_is_num(tree, node) && equals(flat_get_num(tree, node), val);
+}
+
+uint32_t flat_differential(flat_tree* tree, uint32_t root, size_t var_id)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+    LOG_ASSERT(root < tree->size, return FLAT_NONE);
+
+    flat_state state = {};
+    if (state_ctor(&state, tree, root) != 0)
+        return FLAT_NONE;
+
+    flat_find_depends(tree, root, var_id, state.depends);
+
+    /* Children precede parents, so their derivatives are already known */
+    for (uint32_t node = 0; node <= root; node++)
+    {
+        if (!state.result[node])
+            continue;
+
+        if (!state.depends[node])
+            state.result[node] = state.zero;
+        else if (flat_is_var(tree, node))
+            state.result[node] = state.one;
+        else
+            state.result[node] = differentiate_node(&state, node);
+
+        if (state.result[node] == FLAT_NONE)
+        {
+            state_dtor(&state);
+            return FLAT_NONE;
+        }
+    }
+
+    uint32_t result = state.result[root];
+    state_dtor(&state);
+    return result;
+}
+
+uint32_t flat_simplify(flat_tree* tree, uint32_t root)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+    LOG_ASSERT(root < tree->size, return FLAT_NONE);
+
+    flat_state state = {};
+    if (state_ctor(&state, tree, root) != 0)
+        return FLAT_NONE;
+
+    for (uint32_t node = 0; node <= root; node++)
+    {
+        if (!state.result[node])
+            continue;
+
+        if (flat_is_op(tree, node))
+            state.result[node] = simplify_node(&state, node);
+        else
+            state.result[node] = node;
+
+        if (state.result[node] == FLAT_NONE)
+        {
+            state_dtor(&state);
+            return FLAT_NONE;
+        }
+    }
+
+    uint32_t result = state.result[root];
+    state_dtor(&state);
+    return result;
+}
+
+static int state_ctor(flat_state* state, flat_tree* tree, uint32_t root)
+{
+    *state = {
+        .tree    = tree,
+        .depends = (uint8_t*) calloc(root + 1, sizeof(*state->depends)),
+        .result  = (uint32_t*) calloc(root + 1, sizeof(*state->result)),
+        .zero    = flat_add_number(tree, 0),
+        .one     = flat_add_number(tree, 1)
+    };
+
+    LOG_ASSERT_ERROR(state->depends && state->result
+                     && state->zero != FLAT_NONE && state->one != FLAT_NONE,
+        { state_dtor(state); return -1; },
+        "Failed to allocate memory", NULL);
+
+    /* Nodes outside of subtree are left at zero and skipped */
+    flat_find_reachable(tree, root, state->depends);
+    for (uint32_t node = 0; node <= root; node++)
+        state->result[node] = state->depends[node];
+
+    return 0;
+}
+
+static void state_dtor(flat_state* state)
+{
+    free(state->depends);
+    free(state->result);
+    *state = {};
+}
+
+#define LEFT  tree->left [node]
+#define RIGHT tree->right[node]
+
+#define NUM(num)            flat_add_number(tree, num)
+#define ADD(left, right)    flat_add_binary(tree, OP_ADD, left, right)
+#define SUB(left, right)    flat_add_binary(tree, OP_SUB, left, right)
+#define MUL(left, right)    flat_add_binary(tree, OP_MUL, left, right)
+#define FRAC(left, right)   flat_add_binary(tree, OP_DIV, left, right)
+#define POW(left, right)    flat_add_binary(tree, OP_POW, left, right)
+#define NEG(right)          flat_add_unary (tree, OP_NEG,  right)
+#define SIN(right)          flat_add_unary (tree, OP_SIN,  right)
+#define COS(right)          flat_add_unary (tree, OP_COS,  right)
+#define SQRT(right)         flat_add_unary (tree, OP_SQRT, right)
+#define LN(right)           flat_add_unary (tree, OP_LN,   right)
+
+/* Subexpressions are shared, no copying needed */
+#define CPY(node) (node)
+
+#define D(node) state->result[node]
+
+static uint32_t differentiate_node(flat_state* state, uint32_t node)
+{
+    flat_tree* tree = state->tree;
+
+    #define MATH_FUNC(name, diff, ...)\
+        case OP_##name:\
+            return MUL(diff, D(RIGHT));
+
+    switch(flat_get_op(tree, node))
+    {
+        case OP_ADD:
+            return ADD(D(LEFT), D(RIGHT));
+        case OP_SUB:
+            return SUB(D(LEFT), D(RIGHT));
+        case OP_MUL:
+            return ADD(
+                MUL(D(LEFT), CPY(RIGHT)),
+                MUL(CPY(LEFT), D(RIGHT))
+            );
+        case OP_DIV:
+            return FRAC(
+                SUB(
+                    MUL(D(LEFT), CPY(RIGHT)),
+                    MUL(CPY(LEFT), D(RIGHT))
+                ),
+                POW(CPY(RIGHT), NUM(2))
+            );
+        case OP_POW:
+            if (!state->depends[LEFT])
+                return MUL(
+                    MUL(
+                        LN(CPY(LEFT)),
+                        CPY(node)
+                    ),
+                    D(RIGHT)
+                );
+            if (!state->depends[RIGHT])
+                return MUL(
+                    MUL(
+                        CPY(RIGHT),
+                        POW(
+                            CPY(LEFT),
+                            SUB(CPY(RIGHT), NUM(1))
+                        )
+                    ),
+                    D(LEFT)
+                );
+            return MUL(
+                CPY(node),
+                ADD(
+                    MUL(
+                        D(RIGHT),
+                        LN(CPY(LEFT))
+                    ),
+                    MUL(
+                        CPY(RIGHT),
+                        FRAC(
+                            D(LEFT),
+                            CPY(LEFT)
+                        )
+                    )
+                )
+            );
+        case OP_NEG:
+            return NEG(D(RIGHT));
+        #include "functions.h"
+
+        default:
+            LOG_ASSERT_ERROR(0, return FLAT_NONE,
+                "Unknown node", NULL);
+    }
+
+    #undef MATH_FUNC
+
+    LOG_ASSERT(0 && "Unreachable code", return FLAT_NONE);
+}
+
+#undef D
+
+static uint32_t simplify_node(flat_state* state, uint32_t node)
+{
+    flat_tree* tree = state->tree;
+
+    op_type  op    = flat_get_op(tree, node);
+    uint32_t left  = LEFT == FLAT_NONE ? FLAT_NONE : state->result[LEFT];
+    uint32_t right = state->result[RIGHT];
+
+    if ((left == FLAT_NONE || flat_is_num(tree, left)) && flat_is_num(tree, right)
+        && !(op == OP_NEG && !isless(flat_get_num(tree, right), 0)))
+    {
+        double l_val = left == FLAT_NONE ? 0 : flat_get_num(tree, left);
+        double val = apply_op(op, l_val, flat_get_num(tree, right));
+        if (isfinite(val))
+            return NUM(val);
+    }
+
+    switch (op)
+    {
+        case OP_ADD:
+            if (num_equals(tree, left,  0)) return right;
+            if (num_equals(tree, right, 0)) return left;
+            break;
+        case OP_SUB:
+            if (num_equals(tree, right, 0)) return left;
+            if (num_equals(tree, left,  0)) return NEG(right);
+            break;
+        case OP_MUL:
+            if (num_equals(tree, left, 0) || num_equals(tree, right, 0))
+                return state->zero;
+            if (num_equals(tree, left,  1)) return right;
+            if (num_equals(tree, right, 1)) return left;
+            break;
+        case OP_DIV:
+            if (num_equals(tree, left,  0)) return state->zero;
+            if (num_equals(tree, right, 1)) return left;
+            break;
+        case OP_POW:
+            if (num_equals(tree, right, 0)) return state->one;
+            if (num_equals(tree, right, 1)) return left;
+            if (num_equals(tree, left,  1)) return state->one;
+            break;
+        case OP_NEG:
+            if (flat_op_cmp(tree, right, OP_NEG))
+                return tree->right[right];
+            break;
+        default:
+            break;
+    }
+
+    if (left == LEFT && right == RIGHT)
+        return node;
+
+    return left == FLAT_NONE ? flat_add_unary (tree, op, right)
+                             : flat_add_binary(tree, op, left, right);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file flat_math.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Differentiation and simplification of flat trees
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef FLAT_MATH_H
+#define FLAT_MATH_H
+
+#include "flat_tree.h"
+
+/**
+ * @brief Differentiate subtree. Created nodes are appended to tree and
+ * share unchanged subexpressions with the original one.
+ *
+ * @param[inout] tree Flat tree
+ * @param[in] root Differentiated subtree
+ * @param[in] var_id Index of differentiation variable
+ * @return Derivative root, `FLAT_NONE` upon failure
+ */
+uint32_t flat_differential(flat_tree* tree, uint32_t root, size_t var_id);
+
+/**
+ * @brief Fold constants and remove neutral elements of operations in
+ * subtree. Unlike `dag_simplify`, like terms are not collected.
+ *
+ * @param[inout] tree Flat tree
+ * @param[in] root Simplified subtree
+ * @return Simplified subtree root, `FLAT_NONE` upon failure
+ */
+uint32_t flat_simplify(flat_tree* tree, uint32_t root);
+
+#endif
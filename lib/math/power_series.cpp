@@ -0,0 +1,332 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "power_series.h"
+
+/* All series below are truncated to `n` coefficients */
+
+static int  expand_subtree(const ast_node* node, var_name var, double point,
+                           size_t n, double* res);
+static int  apply_series_op(op_type op, const ast_node* node,
+                            const double* left, const double* right,
+                            size_t n, double* res);
+
+static void series_mul (const double* a, const double* b, size_t n, double* res);
+static void series_div (const double* a, const double* b, size_t n, double* res);
+static void series_exp (const double* a, size_t n, double* res);
+static void series_ln  (const double* a, size_t n, double* res);
+static void series_sqrt(const double* a, size_t n, double* res);
+static void series_sincos(const double* a, size_t n, double* sin_res, double* cos_res);
+static void series_pow_const(const double* a, double p, size_t n, double* res);
+static void series_antiderivative_ratio(const double* a, const double* q,
+                                        size_t n, double* res);
+
+int power_series_applicable(const ast_node* node, var_name var)
+{
+    if (!node) return 1;
+    if (is_var(node)) return var_cmp(node, var);
+
+    return power_series_applicable(node->left,  var)
+        && power_series_applicable(node->right, var);
+}
+
+int power_series_expand(const ast_node* node, var_name var, double point,
+                        size_t order, double* coeffs)
+{
+    LOG_ASSERT(node != NULL, return -1);
+    LOG_ASSERT(coeffs != NULL, return -1);
+
+    LOG_ASSERT_ERROR(power_series_applicable(node, var), return -1,
+        "Function depends on variables other than '%s'", symbol_name(var));
+
+    return expand_subtree(node, var, point, order + 1, coeffs);
+}
+
+static int expand_subtree(const ast_node* node, var_name var, double point,
+                          size_t n, double* res)
+{
+    memset(res, 0, n * sizeof(*res));
+
+    if (is_num(node))
+    {
+        res[0] = get_num(node);
+        return 0;
+    }
+
+    if (is_var(node))
+    {
+        res[0] = point;
+        if (n > 1) res[1] = 1;
+        return 0;
+    }
+
+    double* left  = (double*) calloc(n, sizeof(*left));
+    double* right = (double*) calloc(n, sizeof(*right));
+
+    int status = -1;
+    if (left && right
+        && (!node->left || expand_subtree(node->left, var, point, n, left) == 0)
+        && expand_subtree(node->right, var, point, n, right) == 0)
+        status = apply_series_op(get_op(node), node, left, right, n, res);
+
+    free(left);
+    free(right);
+    return status;
+}
+
+static int apply_series_op(op_type op, const ast_node* node,
+                           const double* left, const double* right,
+                           size_t n, double* res)
+{
+    if (op == OP_ADD || op == OP_SUB || op == OP_NEG)
+    {
+        for (size_t k = 0; k < n; k++)
+        {
+            switch (op)
+            {
+            case OP_ADD: res[k] = left[k] + right[k]; break;
+            case OP_SUB: res[k] = left[k] - right[k]; break;
+            case OP_NEG: res[k] = -right[k];          break;
+            default: break;
+            }
+        }
+        return 0;
+    }
+
+    switch (op)
+    {
+    case OP_MUL:
+        series_mul(left, right, n, res);
+        return 0;
+    case OP_DIV:
+        series_div(left, right, n, res);
+        return 0;
+    case OP_SQRT:
+        series_sqrt(right, n, res);
+        return 0;
+    case OP_LN:
+        series_ln(right, n, res);
+        return 0;
+    case OP_POW:
+        /* Constant exponent has dedicated recurrence, which also handles
+         * zero base */
+        if (power_series_applicable(node->right, SYMBOL_NONE))
+        {
+            series_pow_const(left, right[0], n, res);
+            return 0;
+        }
+        break;
+    default:
+        break;
+    }
+
+    double* tmp1 = (double*) calloc(n, sizeof(*tmp1));
+    double* tmp2 = (double*) calloc(n, sizeof(*tmp2));
+
+    LOG_ASSERT_ERROR(tmp1 != NULL && tmp2 != NULL,
+        { free(tmp1); free(tmp2); return -1; },
+        "Failed to allocate series", NULL);
+
+    int status = 0;
+    switch (op)
+    {
+    case OP_POW:            /* exp(right * ln(left)) */
+        series_ln(left, n, tmp1);
+        series_mul(right, tmp1, n, tmp2);
+        series_exp(tmp2, n, res);
+        break;
+    case OP_SIN:
+        series_sincos(right, n, res, tmp1);
+        break;
+    case OP_COS:
+        series_sincos(right, n, tmp1, res);
+        break;
+    case OP_TAN:
+        series_sincos(right, n, tmp1, tmp2);
+        series_div(tmp1, tmp2, n, res);
+        break;
+    case OP_COT:
+        series_sincos(right, n, tmp1, tmp2);
+        series_div(tmp2, tmp1, n, res);
+        break;
+    case OP_ARCTAN:
+    case OP_ARCCOT:         /* (arctan a)' = a' / (1 + a^2) */
+        series_mul(right, right, n, tmp1);
+        tmp1[0] += 1;
+        series_antiderivative_ratio(right, tmp1, n, res);
+        res[0] = atan(right[0]);
+        if (op == OP_ARCCOT)
+        {
+            res[0] = M_PI_2 - res[0];
+            for (size_t k = 1; k < n; k++)
+                res[k] = -res[k];
+        }
+        break;
+    case OP_ARCSIN:
+    case OP_ARCCOS:         /* (arcsin a)' = a' / sqrt(1 - a^2) */
+        series_mul(right, right, n, tmp1);
+        for (size_t k = 0; k < n; k++)
+            tmp1[k] = -tmp1[k];
+        tmp1[0] += 1;
+        series_sqrt(tmp1, n, tmp2);
+        series_antiderivative_ratio(right, tmp2, n, res);
+        res[0] = asin(right[0]);
+        if (op == OP_ARCCOS)
+        {
+            res[0] = acos(right[0]);
+            for (size_t k = 1; k < n; k++)
+                res[k] = -res[k];
+        }
+        break;
+    default:
+        LOG_ASSERT_ERROR(0, status = -1, "Unknown operation", NULL);
+        break;
+    }
+
+    free(tmp1);
+    free(tmp2);
+    return status;
+}
+
+static void series_mul(const double* a, const double* b, size_t n, double* res)
+{
+    for (size_t k = n; k > 0; k--)
+    {
+        double sum = 0;
+        for (size_t j = 0; j < k; j++)
+            sum += a[j] * b[k - 1 - j];
+        res[k - 1] = sum;
+    }
+}
+
+static void series_div(const double* a, const double* b, size_t n, double* res)
+{
+    for (size_t k = 0; k < n; k++)
+    {
+        double sum = a[k];
+        for (size_t j = 1; j <= k; j++)
+            sum -= b[j] * res[k - j];
+        res[k] = sum / b[0];
+    }
+}
+
+static void series_exp(const double* a, size_t n, double* res)
+{
+    res[0] = exp(a[0]);
+    for (size_t k = 1; k < n; k++)
+    {
+        double sum = 0;
+        for (size_t j = 1; j <= k; j++)
+            sum += (double) j * a[j] * res[k - j];
+        res[k] = sum / (double) k;
+    }
+}
+
+static void series_ln(const double* a, size_t n, double* res)
+{
+    series_antiderivative_ratio(a, a, n, res);
+    res[0] = log(a[0]);
+}
+
+static void series_sqrt(const double* a, size_t n, double* res)
+{
+    res[0] = sqrt(a[0]);
+    for (size_t k = 1; k < n; k++)
+    {
+        double sum = a[k];
+        for (size_t j = 1; j < k; j++)
+            sum -= res[j] * res[k - j];
+        res[k] = sum / (2 * res[0]);
+    }
+}
+
+static void series_sincos(const double* a, size_t n, double* sin_res, double* cos_res)
+{
+    sin_res[0] = sin(a[0]);
+    cos_res[0] = cos(a[0]);
+    for (size_t k = 1; k < n; k++)
+    {
+        double sin_sum = 0, cos_sum = 0;
+        for (size_t j = 1; j <= k; j++)
+        {
+            sin_sum += (double) j * a[j] * cos_res[k - j];
+            cos_sum += (double) j * a[j] * sin_res[k - j];
+        }
+        sin_res[k] =  sin_sum / (double) k;
+        cos_res[k] = -cos_sum / (double) k;
+    }
+}
+
+static void series_pow_const(const double* a, double p, size_t n, double* res)
+{
+    if (fpclassify(a[0]) != FP_ZERO)
+    {
+        res[0] = pow(a[0], p);
+        for (size_t k = 1; k < n; k++)
+        {
+            double sum = 0;
+            for (size_t j = 1; j <= k; j++)
+                sum += ((p + 1) * (double) j - (double) k) * a[j] * res[k - j];
+            res[k] = sum / ((double) k * a[0]);
+        }
+        return;
+    }
+
+    memset(res, 0, n * sizeof(*res));
+
+    /* Zero base is only analytic for whole non-negative exponents */
+    if (p < 0 || p > floor(p))
+    {
+        res[0] = pow(a[0], p);
+        for (size_t k = 1; k < n; k++)
+            res[k] = NAN;
+        return;
+    }
+
+    /* Series of zero base starts with (var - point)^p */
+    if (p >= (double) n)
+        return;
+
+    double* base = (double*) calloc(n, sizeof(*base));
+    double* tmp  = (double*) calloc(n, sizeof(*tmp));
+    LOG_ASSERT_ERROR(base != NULL && tmp != NULL,
+        { free(base); free(tmp); return; },
+        "Failed to allocate series", NULL);
+
+    memcpy(base, a, n * sizeof(*base));
+    res[0] = 1;
+
+    for (size_t exponent = (size_t) p; exponent > 0; exponent /= 2)
+    {
+        if (exponent % 2)
+        {
+            series_mul(res, base, n, tmp);
+            memcpy(res, tmp, n * sizeof(*res));
+        }
+        series_mul(base, base, n, tmp);
+        memcpy(base, tmp, n * sizeof(*base));
+    }
+
+    free(base);
+    free(tmp);
+}
+
+/**
+ * Coefficients of `res`, such that `res' * q = a'`. The constant term is
+ * left for caller.
+ */
+static void series_antiderivative_ratio(const double* a, const double* q,
+                                        size_t n, double* res)
+{
+    res[0] = 0;
+    for (size_t k = 1; k < n; k++)
+    {
+        double sum = (double) k * a[k];
+        for (size_t j = 1; j < k; j++)
+            sum -= (double) j * res[j] * q[k - j];
+        res[k] = sum / ((double) k * q[0]);
+    }
+}
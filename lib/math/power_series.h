@@ -0,0 +1,43 @@
+/**
+ * @file power_series.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Truncated power series arithmetic
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef POWER_SERIES_H
+#define POWER_SERIES_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+/**
+ * @brief Check if subtree contains variables other than `var`
+ *
+ * @param[in] node Subtree root
+ * @param[in] var Series variable
+ * @return 1 if subtree depends only on `var`, 0 otherwise
+ */
+int power_series_applicable(const ast_node* node, var_name var);
+
+/**
+ * @brief Compute Taylor series coefficients of function of one variable.
+ * Every operation is applied to truncated series of its operands, so the
+ * cost is quadratic in series order and linear in tree size.
+ *
+ * @param[in] node Expanded function
+ * @param[in] var Series variable
+ * @param[in] point Expansion point
+ * @param[in] order Maximal series order
+ * @param[out] coeffs Array of `order + 1` coefficients of `(var - point)^k`
+ * @return 0 upon success, -1 otherwise
+ */
+int power_series_expand(const ast_node* node, var_name var, double point,
+                        size_t order, double* coeffs);
+
+#endif
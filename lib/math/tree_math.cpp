@@ -1,15 +1,65 @@
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include "logger.h"
 
 #include "math_utils.h"
 #include "tree_math.h"
+#include "dag_math.h"
+#include "egraph.h"
+#include "bytecode.h"
+#include "power_series.h"
+#include "task_pool.h"
+
+/**
+ * @brief Number of points, at which optimized expression is compared to the
+ * original one
+ */
+static const size_t DOMAIN_SAMPLES = 256;
+/**
+ * @brief Values of variables at first sample points, near which
+ * expressions are usually undefined
+ */
+static const double DOMAIN_SPECIAL[] = {0, 1, -1, 0.5, -0.5, 2, -2, M_PI_2, -M_PI_2, M_PI, 10, -10};
+
+/**
+ * @brief Smaller subtrees are differentiated by single task
+ */
+static const size_t MIN_SPLIT_NODES = 256;
+/**
+ * @brief Smaller children are not worth a separate task
+ */
+static const size_t MIN_TASK_NODES = 8;
+
+/**
+ * @brief Differentiation of subtree by another worker
+ */
+struct diff_task
+{
+    ast_node* node;
+    var_name var;
+    int print;
+    /**
+     * @brief Narration, joined to article after left sibling
+     */
+    article_builder text;
+    /**
+     * @brief Arena for derivative nodes, merged to current arena after task
+     */
+    node_arena arena;
+    ast_node* result;
+};
 
 static ast_node* get_differential(ast_node* node, var_name var, article_builder* article, int no_print = 1);
-static void simplify_node(ast_node* node);
+static void differentiate_children(ast_node* node, var_name var, article_builder* article, int print,
+                                   ast_node** left, ast_node** right);
+static void run_diff_task(void* arg);
+static size_t count_nodes(ast_node* node, size_t limit);
 static int is_const(ast_node* node, var_name var);
-static ast_node* evaluate_partially(ast_node* node, var_name var, double val);
+static ast_node* expand_numeric (ast_node* root, var_name var, double point, int pow);
+static ast_node* expand_symbolic(ast_node* root, var_name var, double point, int pow,
+                                 article_builder* article);
 
 abstract_syntax_tree* derivative(abstract_syntax_tree * ast, const char * var, article_builder* article)
 {
@@ -25,6 +75,7 @@ abstract_syntax_tree* derivative(abstract_syntax_tree * ast, const char * var, a
     print_node(ast->root, &article->text);
     
     abstract_syntax_tree* result = tree_copy(ast);
+    node_arena* prev_arena = node_arena_use(&result->arena);
     
     result->root = get_differential(ast->root, v_name, article);
 
@@ -37,13 +88,104 @@ abstract_syntax_tree* derivative(abstract_syntax_tree * ast, const char * var, a
     simplify(result);
     print_node(result->root, &article->text);
 
-
+    node_arena_use(prev_arena);
     return result;
 }
 
 void simplify(abstract_syntax_tree* ast)
 {
-    simplify_node(ast->root);
+    expr_dag dag = {};
+    dag_ctor(&dag);
+
+    const dag_node* simplified = dag_simplify(&dag, dag_from_node(&dag, ast->root));
+
+    node_arena* prev_arena = node_arena_use(&ast->arena);
+    delete_subtree(ast->root);
+    ast->root = dag_to_node(simplified);
+    node_arena_use(prev_arena);
+
+    dag_dtor(&dag);
+}
+
+static int same_domain(const ast_node* original, const ast_node* optimized,
+                       const dynamic_array(var_name)* variables);
+
+void optimize(abstract_syntax_tree* ast, const optimize_limits* limits)
+{
+    static const optimize_limits DEFAULT_LIMITS = {
+        .max_iterations = 8,
+        .max_nodes = 20000
+    };
+    if (!limits) limits = &DEFAULT_LIMITS;
+
+    egraph graph = {};
+    egraph_ctor(&graph);
+
+    size_t root = egraph_add_tree(&graph, ast->root);
+    egraph_saturate(&graph, limits->max_iterations, limits->max_nodes);
+
+    node_arena* prev_arena = node_arena_use(&ast->arena);
+    ast_node* optimized = egraph_extract(&graph, root);
+    node_arena_use(prev_arena);
+
+    egraph_dtor(&graph);
+
+    if (!optimized) return;
+
+    /* Rewrite rules keep expression undefined wherever it was, this is
+     * checked at sample points, so that optimization never hides an error */
+    prev_arena = node_arena_use(&ast->arena);
+
+    int same = same_domain(ast->root, optimized, &ast->variables);
+    LOG_ASSERT_ERROR(same, { delete_subtree(optimized); node_arena_use(prev_arena); return; },
+        "Optimized expression has different domain, original one is kept", NULL);
+
+    delete_subtree(ast->root);
+    ast->root = optimized;
+    node_arena_use(prev_arena);
+}
+
+/**
+ * @brief Check that both expressions are undefined at the same sample
+ * points. Expressions, which cannot be compiled, are considered different
+ */
+static int same_domain(const ast_node* original, const ast_node* optimized,
+                       const dynamic_array(var_name)* variables)
+{
+    bytecode_program program1 = {}, program2 = {};
+    int compiled1 = bytecode_compile_node(&program1, original,  variables) == 0;
+    int compiled2 = bytecode_compile_node(&program2, optimized, variables) == 0;
+
+    size_t var_count = variables->size;
+    double* vars = (double*) calloc(var_count + 1, sizeof(*vars));
+
+    int same = compiled1 && compiled2 && vars != NULL;
+    const size_t SPECIAL_COUNT = sizeof(DOMAIN_SPECIAL) / sizeof(*DOMAIN_SPECIAL);
+
+    /* Fixed linear congruential sequence keeps the check reproducible */
+    unsigned long long state = 0x2545F4914F6CDD1DULL;
+    for (size_t sample = 0; same && sample < DOMAIN_SAMPLES; sample++)
+    {
+        for (size_t i = 0; i < var_count; i++)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            if (sample < SPECIAL_COUNT * SPECIAL_COUNT)
+                vars[i] = DOMAIN_SPECIAL[(sample + i * (sample / SPECIAL_COUNT + 1))
+                                                            % SPECIAL_COUNT];
+            else
+                vars[i] = 20.0 * (double) (state >> 11) / (double) (1ULL << 53) - 10.0;
+        }
+
+        int undefined1 = isnan(bytecode_evaluate(&program1, vars));
+        int undefined2 = isnan(bytecode_evaluate(&program2, vars));
+        same = undefined1 == undefined2;
+    }
+
+    free(vars);
+    if (compiled1) bytecode_dtor(&program1);
+    if (compiled2) bytecode_dtor(&program2);
+
+    return same;
 }
 
 #define LEFT node->left
@@ -87,44 +229,92 @@ abstract_syntax_tree* taylor_series(
     print_node(ast->root, &article->text);
 
     abstract_syntax_tree* result = tree_copy(ast);
-    result->root = make_number_node(0);
+    node_arena* prev_arena = node_arena_use(&result->arena);
 
     var_name v_name = *array_get_element(&ast->variables, var_id);
-    
-    ast_node* cur = CPY(ast->root);
+
+    result->root = NULL;
+    if (power_series_applicable(ast->root, v_name))
+        result->root = expand_numeric(ast->root, v_name, point, pow);
+    if (!result->root)
+        result->root = expand_symbolic(ast->root, v_name, point, pow, article);
+
+    string_builder_append_format(&article->text, "\nNow the proof that the Taylor series of this function"
+                                                 " at $%s = %g$ is equal to\n", var, point);
+    print_node(result->root, &article->text);
+    article_add_placeholder(article);
+
+    article_add_transition(article);
+    string_builder_append(&article->text, "if we simplify this we wil get\n");
+    simplify(result);
+    print_node(result->root, &article->text);
+
+    node_arena_use(prev_arena);
+    return result;
+}
+
+static ast_node* expand_numeric(ast_node* root, var_name var, double point, int pow)
+{
+    double* coeffs = (double*) calloc((size_t) pow + 1, sizeof(*coeffs));
+    if (!coeffs) return NULL;
+
+    if (power_series_expand(root, var, point, (size_t) pow, coeffs) != 0)
+    {
+        free(coeffs);
+        return NULL;
+    }
+
+    ast_node* result = NUM(0);
     for (int i = 0; i <= pow; i++)
     {
-        ast_node* at_zero = evaluate_partially(cur, v_name, point);
-        simplify_node(at_zero);
-        result->root =
+        if (fpclassify(coeffs[i]) == FP_ZERO)
+            continue;
+
+        result =
             ADD(
-                result->root,
+                result,
                 MUL(
-                    at_zero,
+                    NUM(coeffs[i]),
+                    POW(
+                        SUB(VAR(var), NUM(point)),
+                        NUM(i))
+                )
+            );
+    }
+
+    free(coeffs);
+    return result;
+}
+
+static ast_node* expand_symbolic(ast_node* root, var_name var, double point, int pow,
+                                 article_builder* article)
+{
+    ast_node* result = NUM(0);
+
+    /* Successive derivatives share most of their subexpressions */
+    expr_dag dag = {};
+    dag_ctor(&dag);
+
+    const dag_node* cur = dag_from_node(&dag, root);
+    for (int i = 0; i <= pow; i++)
+    {
+        const dag_node* at_point = dag_simplify(&dag, dag_substitute(&dag, cur, var, point));
+        result =
+            ADD(
+                result,
+                MUL(
+                    dag_to_node(at_point),
                     FRAC(
                         POW(
-                            SUB(VAR(v_name), NUM(point)),
+                            SUB(VAR(var), NUM(point)),
                             NUM(i)),
                         NUM(factorial(i))
                     )
                 )
             );
-        ast_node* nxt = get_differential(cur, v_name, article);
-        delete_subtree(cur);
-        cur = nxt;
-        simplify_node(cur);
+        cur = dag_simplify(&dag, dag_differential(&dag, cur, var, article));
     }
-    delete_subtree(cur);
-
-    string_builder_append_format(&article->text, "\nNow the proof that the Taylor series of this function"
-                                                 " at $%s = %g$ is equal to\n", var, point);
-    print_node(result->root, &article->text);
-    article_add_placeholder(article);
-
-    article_add_transition(article);
-    string_builder_append(&article->text, "if we simplify this we wil get\n");
-    simplify(result);
-    print_node(result->root, &article->text);
+    dag_dtor(&dag);
 
     return result;
 }
@@ -154,22 +344,29 @@ static ast_node* get_differential(ast_node * node, var_name var, article_builder
         case OP_##name:\
             return MUL(diff, D(RIGHT));
 
+    ast_node* dl = NULL;
+    ast_node* dr = NULL;
+
     switch(node->value.op)
     {
         case OP_ADD:
-            return ADD(D(LEFT), D(RIGHT));
+            differentiate_children(node, var, article, print, &dl, &dr);
+            return ADD(dl, dr);
         case OP_SUB:
-            return SUB(D(LEFT), D(RIGHT));
+            differentiate_children(node, var, article, print, &dl, &dr);
+            return SUB(dl, dr);
         case OP_MUL:
+            differentiate_children(node, var, article, print, &dl, &dr);
             return ADD(
-                MUL(D(LEFT), CPY(RIGHT)),
-                MUL(CPY(LEFT), D(RIGHT))
+                MUL(dl, CPY(RIGHT)),
+                MUL(CPY(LEFT), dr)
             );
         case OP_DIV:
+            differentiate_children(node, var, article, print, &dl, &dr);
             return FRAC(
                 SUB(
-                    MUL(D(LEFT), CPY(RIGHT)),
-                    MUL(CPY(LEFT), D(RIGHT))
+                    MUL(dl, CPY(RIGHT)),
+                    MUL(CPY(LEFT), dr)
                 ),
                 POW(CPY(RIGHT), NUM(2))
             );
@@ -193,17 +390,18 @@ static ast_node* get_differential(ast_node * node, var_name var, article_builder
                     ),
                     D(LEFT)
                 );
+            differentiate_children(node, var, article, print, &dl, &dr);
             return MUL(
                 CPY(node),
                 ADD(
                     MUL(
-                        D(RIGHT),
+                        dr,
                         LN(CPY(LEFT))
                     ),
                     MUL(
                         CPY(RIGHT),
                         FRAC(
-                            D(LEFT),
+                            dl,
                             CPY(LEFT)
                         )
                     )
@@ -223,365 +421,77 @@ static ast_node* get_differential(ast_node * node, var_name var, article_builder
     LOG_ASSERT(0 && "Unreachable code", return NULL);
 }
 
-static void replace_with(ast_node* dest, ast_node* src);
-
-static inline int is_neg (ast_node* node) { return op_cmp(node, OP_NEG); }
-static inline int is_zero(ast_node* node) { return num_cmp(node, 0); }
-static inline int is_one (ast_node* node) { return num_cmp(node, 1); }
-static inline int get_int(ast_node* node) { return (int) round(get_num(node)); }
-static inline int is_int (ast_node* node) { return num_cmp(node, get_int(node)); }
-
-static inline int is_same_var(ast_node* node1, ast_node* node2)
-{
-    return is_var(node1) && var_cmp(node2, get_var(node1));
-}
-
-static void extract_negative      (ast_node* node);
-static void extract_left_negative (ast_node* node);
-static void extract_right_negative(ast_node* node);
-static void extract_left_zero     (ast_node* node);
-static void extract_right_zero    (ast_node* node);
-static void extract_left_one      (ast_node* node);
-static void extract_right_one     (ast_node* node);
-static void collapse_var          (ast_node* node);
-static void collapse_const        (ast_node* node);
-
-static void simplify_node(ast_node * node)
-{
-    if (is_num(node)) extract_negative(node);
-    if (!is_op(node)) return;
-
-    simplify_node(node->left);
-    simplify_node(node->right);
-
-    if (is_neg(LEFT) && is_neg(RIGHT)) extract_negative      (node);
-    if (is_neg(LEFT))                  extract_left_negative (node);
-    if (is_neg(RIGHT))                 extract_right_negative(node);
-    if (is_zero(LEFT))                 extract_left_zero     (node);
-    if (is_zero(RIGHT))                extract_right_zero    (node);
-    if (is_one(LEFT))                  extract_left_one      (node);
-    if (is_one(RIGHT))                 extract_right_one     (node);
-    if (is_num(LEFT) && is_num(RIGHT)) collapse_const        (node);
-    if (is_same_var(LEFT, RIGHT))      collapse_var          (node);
-}
-
-static int is_const(ast_node * node, var_name var)
-{
-    if (!node) return 1; /* Vacuous truth */
-
-    if (is_num(node)) return 1;
-    if (is_var(node)) return !var_cmp(node, var);
-
-    return is_const(LEFT, var) && is_const(RIGHT, var);
-}
-
-ast_node* evaluate_partially(ast_node* node, var_name var, double val)
-{
-    if (!node) return NULL;
-    if (var_cmp(node, var))
-        return NUM(val);
-    
-    ast_node* copy = make_node(node->type, node->value);
-    copy-> left = evaluate_partially(node-> left, var, val);
-    copy->right = evaluate_partially(node->right, var, val);
-    if (copy-> left) copy-> left->parent = copy;
-    if (copy->right) copy->right->parent = copy;
-
-    return copy;
-}
-
-static void replace_with(ast_node* dest, ast_node* src)
-{
-    dest->left  = src->left;
-    dest->right = src->right;
-    if (dest->left)  dest->left ->parent = dest;
-    if (dest->right) dest->right->parent = dest;
-    dest->type = src->type;
-    dest->value = src->value;
-    src->left  = NULL;
-    src->right = NULL;
-
-    delete_node(src);
-}
-
-static inline void assign_num(ast_node* dest, double num)
-{
-    dest->value.num = num;
-    dest->type = NODE_NUM;
-    if (dest-> left) delete_subtree(dest-> left);
-    if (dest->right) delete_subtree(dest->right);
-    dest->left = NULL;
-    dest->right = NULL;
-}
-
-static void collapse_const(ast_node* node)
-{
-    #define ASSIGN_NODE(num) assign_num(node, num)
-    #define COMBINE_CHILDREN(op) ASSIGN_NODE(get_num(LEFT) op get_num(RIGHT))
-
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(is_num(LEFT), return);
-    LOG_ASSERT(is_num(RIGHT), return);
-
-    switch (get_op(node))
-    {
-    case OP_ADD: COMBINE_CHILDREN(+); break;
-    case OP_SUB: COMBINE_CHILDREN(-); break;
-    case OP_MUL: COMBINE_CHILDREN(*); break;
-    case OP_DIV: COMBINE_CHILDREN(/); break;
-    case OP_POW: ASSIGN_NODE(pow(get_num(LEFT), get_num(RIGHT))); break;
-    default:
-        break;
-    }
-
-    #undef COMBINE_CHILDREN
-    #undef ASSIGN_NODE
-}
-
-void extract_negative(ast_node* node)
+/**
+ * @brief Differentiate both children of node, right one by separate task if
+ * node is large enough. Narration is always in order of children.
+ *
+ * @note Long sums and products are left-deep, so spawning just the right
+ * child at every level still lets workers process the chain concurrently.
+ */
+static void differentiate_children(ast_node* node, var_name var, article_builder* article, int print,
+                                   ast_node** left, ast_node** right)
 {
-    LOG_ASSERT(node, return);
-    if (is_num(node))
+    if (!task_pool_active()
+        || count_nodes(node,  MIN_SPLIT_NODES) < MIN_SPLIT_NODES
+        || count_nodes(RIGHT, MIN_TASK_NODES)  < MIN_TASK_NODES)
     {
-        if (get_num(node) < 0)
-        {
-            node->right = make_number_node(-1 * get_num(node));
-            node->type = NODE_OP;
-            node->value.op = OP_NEG;
-        }
+        *left  = D(LEFT);
+        *right = D(RIGHT);
         return;
     }
 
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(op_cmp(LEFT,  OP_NEG), return);
-    LOG_ASSERT(op_cmp(RIGHT, OP_NEG), return);
-
-    switch(get_op(node))
-    {
-    case OP_ADD:
-    case OP_SUB:
-        replace_with(LEFT,  LEFT ->right);
-        replace_with(RIGHT, RIGHT->right);
-        replace_with(node, NEG(
-            make_binary_node(
-                get_op(node),
-                LEFT,
-                RIGHT)));
-        simplify_node(RIGHT);
-        break;
-    case OP_MUL:
-    case OP_DIV:
-        replace_with(LEFT,  LEFT ->right);
-        replace_with(RIGHT, RIGHT->right);
-        break;
-    default:
-        break;
-    }
+    diff_task right_task = {
+        .node   = RIGHT,
+        .var    = var,
+        .print  = print,
+        .text   = {},
+        .arena  = {},
+        .result = NULL
+    };
+    article_fork(article, &right_task.text);
+    node_arena_ctor(&right_task.arena);
+
+    task spawned = {};
+    task_spawn(&spawned, run_diff_task, &right_task);
+    *left = D(LEFT);
+    task_wait(&spawned);
+
+    node_arena_merge(node_arena_current(), &right_task.arena);
+    article_join(article, &right_task.text);
+    *right = right_task.result;
 }
 
-static void extract_left_negative(ast_node* node)
+static void run_diff_task(void* arg)
 {
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(op_cmp(LEFT, OP_NEG), return);
+    diff_task* job = (diff_task*) arg;
 
-    switch(get_op(node))
-    {
-    case OP_ADD:
-        replace_with(LEFT, LEFT->right);
-        replace_with(node, SUB(RIGHT, LEFT));
-        break;
-    case OP_SUB:
-        replace_with(LEFT, LEFT->right);
-        replace_with(node, NEG(ADD(LEFT, RIGHT)));
-        break;
-    case OP_MUL:
-    case OP_DIV:
-        replace_with(LEFT, LEFT->right);
-        replace_with(node, NEG(
-            make_binary_node(
-                get_op(node),
-                LEFT,
-                RIGHT)));
-        break;
-    case OP_POW:
-        if (!is_int(RIGHT)) break;
-        replace_with(LEFT, LEFT->right);
-        if (get_int(RIGHT) % 2 == 1)
-            replace_with(node, NEG(POW(LEFT, RIGHT)));
-        break;
-    default:
-        break;
-    }
+    node_arena* prev_arena = node_arena_use(&job->arena);
+    job->result = get_differential(job->node, job->var, &job->text, job->print);
+    node_arena_use(prev_arena);
 }
 
-static void extract_right_negative(ast_node* node)
+/**
+ * @return Number of nodes in subtree, but no more than `limit`
+ */
+static size_t count_nodes(ast_node* node, size_t limit)
 {
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(op_cmp(RIGHT, OP_NEG), return);
+    if (!node || limit == 0) return 0;
 
-    switch (get_op(node))
-    {
-    case OP_ADD:
-        replace_with(RIGHT, RIGHT->right);
-        replace_with(node, SUB(LEFT, RIGHT));
-        break;;
-    case OP_SUB:
-        replace_with(RIGHT, RIGHT->right);
-        replace_with(node, ADD(LEFT, RIGHT));
-        break;
-    case OP_MUL:
-    case OP_DIV:
-        replace_with(RIGHT, RIGHT->right);
-        replace_with(node, NEG(
-            make_binary_node(
-                get_op(node),
-                LEFT,
-                RIGHT)));
-        break;
-    case OP_NEG:
-        replace_with(RIGHT, RIGHT->right);
-        replace_with(node, RIGHT);
-        break;
-    case OP_SIN:
-    case OP_ARCSIN:
-    case OP_TAN:
-    case OP_ARCTAN:
-        replace_with(RIGHT, RIGHT->right);
-        replace_with(node, NEG(
-            make_unary_node(
-                get_op(node),
-                RIGHT)));
-        break;
-    case OP_COS:
-        replace_with(RIGHT, RIGHT->right);
-        break;
-    default:
-        break;
-    }
+    size_t count = 1 + count_nodes(LEFT, limit - 1);
+    if (count < limit)
+        count += count_nodes(RIGHT, limit - count);
 
+    return count;
 }
 
-static void extract_left_zero(ast_node* node)
-{
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(is_zero(LEFT), return);
-
-    switch(get_op(node))
-    {
-    case OP_ADD:
-        delete_node(LEFT);
-        replace_with(node, RIGHT);
-        break;
-    case OP_SUB:
-        delete_node(LEFT);
-        replace_with(node, NEG(RIGHT));
-        break;
-    case OP_MUL:
-    case OP_DIV:
-        assign_num  (node, 0);
-        break;
-    default:
-        break;
-    }
-}
-
-static void extract_right_zero(ast_node* node)
-{
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(is_zero(RIGHT), return);
-    LOG_ASSERT_ERROR(!op_cmp(node, OP_DIV), return, "Division by zero", NULL);
-    LOG_ASSERT_ERROR(!op_cmp(node, OP_LN), return, "Logarithm of zero is undefined", NULL);
-
-    switch (get_op(node))
-    {
-    case OP_ADD:
-    case OP_SUB:
-        delete_node(RIGHT);
-        replace_with(node, LEFT);
-        break;
-    case OP_MUL:
-    case OP_NEG:
-    case OP_SIN:
-    case OP_TAN:
-    case OP_SQRT:
-    case OP_ARCSIN:
-    case OP_ARCTAN:
-        assign_num(node, 0);
-        break;
-    case OP_POW:
-    case OP_COS:
-        assign_num(node, 1);
-        break;
-    default:
-        break;
-    }
-}
-
-static void extract_left_one(ast_node *node)
-{
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(is_one(LEFT), return);
-
-    switch (get_op(node))
-    {
-    case OP_MUL:
-        delete_node(LEFT);
-        replace_with(node, RIGHT);
-        break;
-    case OP_POW:
-        assign_num  (node, 1);
-        break;
-    default:
-        break;
-    }
-}
-
-static void extract_right_one(ast_node *node)
+static int is_const(ast_node * node, var_name var)
 {
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(is_one(RIGHT), return);
+    if (!may_depend(node, var)) return 1;
+    if (var < DEPENDS_EXACT_VARS) return 0;
 
-    switch (get_op(node))
-    {
-    case OP_MUL:
-    case OP_DIV:
-    case OP_POW:
-        delete_node(RIGHT);
-        replace_with(node, LEFT);
-        break;
-    case OP_LN:
-        assign_num(node, 0);
-        break;
-    case OP_SQRT:
-        assign_num(node, 1);
-        break;
-    default:
-        break;
-    }
-}
-
-static void collapse_var(ast_node *node)
-{
-    LOG_ASSERT(is_op(node), return);
-    LOG_ASSERT(is_same_var(LEFT, RIGHT), return);
+    if (is_var(node)) return !var_cmp(node, var);
 
-    switch (get_op(node))
-    {
-    case OP_ADD:
-        delete_node(LEFT);
-        replace_with(node, MUL(NUM(2), RIGHT));
-        break;
-    case OP_SUB:
-        assign_num(node, 0);
-        break;
-    case OP_MUL:
-        delete_node(RIGHT);
-        replace_with(node, POW(LEFT, NUM(2)));  break;
-        break;
-    case OP_DIV:
-        assign_num(node, 1);
-        break;
-    default:
-        break;
-    }
+    /* Bit is shared with other variables, only flagged children
+       are examined */
+    return is_const(LEFT, var) && is_const(RIGHT, var);
 }
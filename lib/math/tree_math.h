@@ -12,6 +12,34 @@ abstract_syntax_tree* derivative(abstract_syntax_tree* ast, const char* var, art
 
 void simplify(abstract_syntax_tree* ast);
 
+/**
+ * @brief Bounds on equality saturation performed by `optimize()`
+ */
+struct optimize_limits
+{
+    /**
+     * @brief Maximal number of rewrite rounds
+     */
+    size_t max_iterations;
+    /**
+     * @brief Maximal number of expressions stored during rewriting
+     */
+    size_t max_nodes;
+};
+
+/**
+ * @brief Replace expression with an equivalent one, which is the cheapest
+ * to evaluate. Unlike `simplify()`, considers every combination of rewrites
+ * (commutativity, associativity, distributivity, trigonometric identities,
+ * power laws) within given limits. Optimized expression is undefined for
+ * the same values of variables as the original one. This is also checked
+ * at sample points, original expression is kept if check fails.
+ *
+ * @param[inout] ast Optimized expression
+ * @param[in] limits Saturation limits, `NULL` for default ones
+ */
+void optimize(abstract_syntax_tree* ast, const optimize_limits* limits = NULL);
+
 abstract_syntax_tree* taylor_series(
                                 abstract_syntax_tree* ast,
                                 double point,
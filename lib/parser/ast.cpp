@@ -1,19 +1,25 @@
+#include <ctype.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "logger.h"
 
 #include "ast.h"
+#include "expr_dag.h"
 
 ast_node* make_node(node_type type, node_value val, ast_node* parent)
 {
-    ast_node* node = (ast_node*)calloc(1, sizeof(*node));
+    ast_node* node = node_arena_alloc(node_arena_current());
+    LOG_ASSERT(node != NULL, return NULL);
+
     *node = {
         .type = type,
         .value = val,
         .parent = parent,
         .left = NULL,
-        .right = NULL
+        .right = NULL,
+        .depends = type == NODE_VAR ? var_bit(val.var) : 0
     };
 
     return node;
@@ -26,6 +32,7 @@ ast_node* make_binary_node(op_type op, ast_node * left, ast_node * right)
     node->right = right;
     left->parent = node;
     right->parent = node;
+    node->depends = left->depends | right->depends;
     return node;
 }
 
@@ -34,6 +41,7 @@ ast_node * make_unary_node(op_type op, ast_node * right)
     ast_node* node = make_node(NODE_OP, {.op = op});
     node->right = right;
     right->parent = node;
+    node->depends = right->depends;
     return node;
 }
 
@@ -56,6 +64,7 @@ ast_node* copy_subtree(ast_node * node)
     res->right  = copy_subtree(node->right);
     if (res-> left) res-> left->parent = res;
     if (res->right) res->right->parent = res;
+    res->depends = node->depends;
 
     return res;
 }
@@ -66,7 +75,7 @@ void delete_node(ast_node* node)
     LOG_ASSERT(node->left == NULL, return);
     LOG_ASSERT(node->right == NULL, return);
 
-    free(node);
+    node_arena_free(node);
 }
 
 void delete_subtree(ast_node* node)
@@ -76,7 +85,7 @@ void delete_subtree(ast_node* node)
     if (node-> left) delete_subtree(node->left);
     if (node->right) delete_subtree(node->right);
 
-    free(node);
+    node_arena_free(node);
 }
 
 abstract_syntax_tree* tree_ctor(void)
@@ -84,6 +93,7 @@ abstract_syntax_tree* tree_ctor(void)
     abstract_syntax_tree* result = (abstract_syntax_tree*) calloc(1, sizeof(*result));
     result->root = NULL;
     array_ctor(&result->variables);
+    node_arena_ctor(&result->arena);
     return result;
 }
 
@@ -92,6 +102,7 @@ abstract_syntax_tree* tree_copy(const abstract_syntax_tree* src)
     abstract_syntax_tree* result = (abstract_syntax_tree*) calloc(1, sizeof(*result));
     result->root = NULL;
     array_copy(&result->variables, &src->variables);
+    node_arena_ctor(&result->arena);
     return result;
 }
 
@@ -99,8 +110,8 @@ void tree_dtor(abstract_syntax_tree *tree)
 {
     LOG_ASSERT(tree != NULL, return);
 
-    if (tree->root) delete_subtree(tree->root);
     tree->root = NULL;
+    node_arena_dtor(&tree->arena);
 
     array_dtor(&tree->variables);
 
@@ -176,202 +187,156 @@ tree_iterator tree_end(abstract_syntax_tree* tree)
     return node;
 }
 
-void plot_node(const ast_node *node, FILE *output)
-{
-    #define PLOT_INFIX(op) do\
-        {\
-            fputc('(', output); plot_node(node->left, output);\
-            fputs(")" #op "(", output); plot_node(node->right, output); fputc(')', output);\
-        } while(0)
-    #define PLOT_UNARY(op) do\
-        {\
-            fputs(#op "(", output); plot_node(node->right, output); fputc(')', output);\
-        } while(0)
-    #define PLOT_COMPOUND(op, plot) do\
-        {\
-            fputs("(" #op "(", output); plot; fputs("))", output);\
-        } while(0)
-    
-    if (is_num(node)) { fprintf(output, "%g", get_num(node)); return; }
-    if (is_var(node)) { fprintf(output, "%s", get_var(node)); return; }
-
-    switch(get_op(node))
-    {
-    case OP_ADD:    PLOT_INFIX(+);                          break;
-    case OP_SUB:    PLOT_INFIX(-);                          break;
-    case OP_MUL:    PLOT_INFIX(*);                          break;
-    case OP_DIV:    PLOT_INFIX(/);                          break;
-    case OP_NEG:    PLOT_UNARY(-);                          break;
-    case OP_LN:     PLOT_UNARY(log);                        break;
-    case OP_SQRT:   PLOT_UNARY(sqrt);                       break;
-    case OP_SIN:    PLOT_UNARY(sin);                        break;
-    case OP_COS:    PLOT_UNARY(cos);                        break;
-    case OP_TAN:    PLOT_UNARY(tan);                        break;
-    case OP_COT:    PLOT_COMPOUND(1/, PLOT_UNARY(tan));     break;
-    case OP_ARCSIN: PLOT_UNARY(asin);                       break;
-    case OP_ARCCOS: PLOT_COMPOUND(pi/2-, PLOT_UNARY(asin)); break;
-    case OP_ARCTAN: PLOT_UNARY(atan);                       break;
-    case OP_ARCCOT: PLOT_COMPOUND(pi/2, PLOT_UNARY(atan));  break;
-    case OP_POW:    PLOT_INFIX(**);                         break;
-    }
-
-    #undef PLOT_INFIX
-    #undef PLOT_UNARY
-    #undef PLOT_COMPOUND
-}
-
-void plot_tangent(const ast_node* func,
-                    const ast_node* tangent,
-                    const char* filename,
-                    double range_left,
-                    double range_right)
-{
-    FILE* plot = popen("gnuplot", "w");
-
-    fputs("set terminal png\n", plot);
-    fprintf(plot, "set output \"%s\"\n", filename);
-    fputs("set grid\n", plot);
-    fprintf(plot, "set xrange [%lg:%lg]\n", range_left, range_right);
-    fputs("set samples 400\n", plot);
-
-    fputs("plot ", plot);
-    plot_node(func, plot);
-    fputs(" title \"y = f(x)\", ", plot);
-    plot_node(tangent, plot);
-    fputs(" title \"tangent\"\n", plot);
-
-    pclose(plot);
-}
-
 static const int MAX_LABELS = 'Z'-'A'+1;
 
+struct label_state
+{
+    size_t* uses;
+    int* sizes;
+    const dag_node* labels[MAX_LABELS];
+};
 
 static void print_subtree(
-                        const ast_node* node,
-                        const ast_node* labels[MAX_LABELS],
+                        const dag_node* node,
+                        const dag_node* labels[MAX_LABELS],
                         string_builder* builder);
-static int requires_grouping(const ast_node* parent, const ast_node* child);
 static int is_unary(op_type op);
-static void print_op(op_type op, string_builder* builder);
-static int label_subtrees(const ast_node* node, const ast_node* labels[MAX_LABELS]);
-static char find_label(const ast_node* node, const ast_node* labels[MAX_LABELS]);
-void print_labels(const ast_node * labels[MAX_LABELS], string_builder* builder);
-static int add_label(const ast_node* node, const ast_node* labels[MAX_LABELS]);
-static inline int has_labels(const ast_node* labels[MAX_LABELS])
+static void count_uses(const dag_node* node, size_t* uses);
+static int label_subtrees(const dag_node* node, label_state* state);
+static char find_label(const dag_node* node, const dag_node* labels[MAX_LABELS]);
+void print_labels(const dag_node* labels[MAX_LABELS], string_builder* builder);
+static int add_label(const dag_node* node, const dag_node* labels[MAX_LABELS]);
+static inline int has_labels(const dag_node* labels[MAX_LABELS])
 {
     return labels[0] != NULL;
 }
-static inline const ast_node* get_node(
+static inline const dag_node* get_node(
                                         char label,
-                                        const ast_node* labels[MAX_LABELS])
+                                        const dag_node* labels[MAX_LABELS])
 {
     return labels[label - 'A'];
 }
 static inline void set_node(
                             char label,
-                            const ast_node* node,
-                            const ast_node* labels[MAX_LABELS])
+                            const dag_node* node,
+                            const dag_node* labels[MAX_LABELS])
 {
     labels[label - 'A'] = node;
 }
 
 void print_node(const ast_node* root, string_builder * builder)
 {
-    const ast_node* labels[MAX_LABELS] = {};
-    label_subtrees(root, labels);
+    /* Equal subtrees become the same graph node and share labels */
+    expr_dag dag = {};
+    dag_ctor(&dag);
+    const dag_node* dag_root = dag_from_node(&dag, root);
+
+    label_state state = {
+        .uses  = (size_t*) calloc(dag.size, sizeof(size_t)),
+        .sizes = (int*)    calloc(dag.size, sizeof(int)),
+        .labels = {}
+    };
+    const dag_node** labels = state.labels;
 
-    string_builder_append_format(builder, "\\begin{equation}\n");
-    print_subtree(root, labels, builder);
-    string_builder_append_format(builder, "\n\\end{equation}\n");
+    if (state.uses && state.sizes)
+    {
+        count_uses(dag_root, state.uses);
+        label_subtrees(dag_root, &state);
+    }
+    free(state.uses);
+    free(state.sizes);
+
+    string_builder_append(builder, "\\begin{equation}\n");
+    print_subtree(dag_root, labels, builder);
+    string_builder_append(builder, "\n\\end{equation}\n");
     if (has_labels(labels))
     {
-        string_builder_append_format(builder, "Where:\n"
+        string_builder_append(builder, "Where:\n"
                         "\\begin{itemize}\n");
         print_labels(labels, builder);
-        string_builder_append_format(builder, "\\end{itemize}\n\n");
+        string_builder_append(builder, "\\end{itemize}\n\n");
     }
+
+    dag_dtor(&dag);
 }
 
 static void print_subtree(
-                        const ast_node * node,
-                        const ast_node* labels[MAX_LABELS],
+                        const dag_node* node,
+                        const dag_node* labels[MAX_LABELS],
                         string_builder * builder)
 {
     char shorthand = find_label(node, labels);
     if (shorthand != '\0')
     {
-        string_builder_append_format(builder, "%c ", shorthand);
+        string_builder_append(builder, shorthand);
+        string_builder_append(builder, ' ');
         return;
     }
 
     if (is_num(node))
     {
-        string_builder_append_format(builder, "%g ", get_num(node));
+        string_builder_append_number(builder, get_num(node));
+        string_builder_append(builder, ' ');
         return;
     }
     if (is_var(node))
     {
-        string_builder_append_format(builder, "%s ", get_var(node));
+        string_builder_append(builder, symbol_name(get_var(node)));
+        string_builder_append(builder, ' ');
         return;
     }
 
     if (op_cmp(node, OP_DIV))
     {
-        string_builder_append_format(builder, "\\frac{");
+        string_builder_append(builder, "\\frac{");
         print_subtree(node->left, labels, builder);
-        string_builder_append_format(builder, "}{");
+        string_builder_append(builder, "}{");
         print_subtree(node->right, labels, builder);
-        string_builder_append_format(builder, "} ");
+        string_builder_append(builder, "} ");
         return;
     }
     
     int group = 0;
     if (!is_unary(node->value.op))
     {
-        group = requires_grouping(node, node->left);
-        if (group) string_builder_append_format(builder, "\\left( ");
+        group = is_op(node->left) && op_requires_grouping(get_op(node), get_op(node->left), 0);
+        if (group) string_builder_append(builder, "\\left( ");
         print_subtree(node->left, labels, builder);
-        if (group) string_builder_append_format(builder, "\\right) ");
+        if (group) string_builder_append(builder, "\\right) ");
     }
 
     print_op(get_op(node), builder);
 
     if (op_cmp(node, OP_POW) || op_cmp(node, OP_SQRT))
     {
-        string_builder_append_format(builder, "{");
+        string_builder_append(builder, "{");
         print_subtree(node->right, labels, builder);
-        string_builder_append_format(builder, "} ");
+        string_builder_append(builder, "} ");
         return;
     }
 
-    group = requires_grouping(node, node->right);
-    if (group) string_builder_append_format(builder, "\\left( ");
+    group = is_op(node->right) && op_requires_grouping(get_op(node), get_op(node->right), 1);
+    if (group) string_builder_append(builder, "\\left( ");
 
     print_subtree(node->right, labels, builder);
 
-    if (group) string_builder_append_format(builder, "\\right) ");
+    if (group) string_builder_append(builder, "\\right) ");
 }
 
-static int requires_grouping(const ast_node * parent, const ast_node * child)
+int op_requires_grouping(op_type parent_op, op_type child_op, int is_right)
 {
-    if (child->type != NODE_OP)
-        return 0;
-    LOG_ASSERT(parent->type == NODE_OP, return 0);
-
-    op_type child_op = get_op(child);
-
-    switch (get_op(parent))
+    switch (parent_op)
     {
     case OP_ADD:
         return 0;
     case OP_SUB:
-        return child == parent->right
+        return is_right
             && (child_op == OP_ADD || child_op == OP_SUB);
     case OP_MUL:
     case OP_DIV:
         return child_op == OP_ADD || child_op == OP_SUB;
     case OP_POW:
-        return child == parent->left;
+        return !is_right;
     case OP_SQRT:
         return 0;
     default:
@@ -390,72 +355,89 @@ static int is_unary(op_type op)
     );
 }
 
-static void print_op(op_type op, string_builder* builder)
+void print_op(op_type op, string_builder* builder)
 {
     switch (op)
     {
-        case OP_ADD:    string_builder_append_format(builder, "+ ");          return;
-        case OP_SUB:    string_builder_append_format(builder, "- ");          return;
-        case OP_MUL:    string_builder_append_format(builder, "\\cdot ");     return;
-        case OP_DIV:    string_builder_append_format(builder, "/ ");          return;
-        case OP_POW:    string_builder_append_format(builder, "^");           return;
-        case OP_NEG:    string_builder_append_format(builder, "-");           return;
-        case OP_LN:     string_builder_append_format(builder, "\\ln ");       return;
-        case OP_SQRT:   string_builder_append_format(builder, "\\sqrt ");     return;
-        case OP_SIN:    string_builder_append_format(builder, "\\sin ");      return;
-        case OP_COS:    string_builder_append_format(builder, "\\cos ");      return;
-        case OP_TAN:    string_builder_append_format(builder, "\\tan ");      return;
-        case OP_COT:    string_builder_append_format(builder, "\\cot ");      return;
-        case OP_ARCSIN: string_builder_append_format(builder, "\\arcsin ");   return;
-        case OP_ARCCOS: string_builder_append_format(builder, "\\arccos ");   return;
-        case OP_ARCTAN: string_builder_append_format(builder, "\\arctan ");   return;
-        case OP_ARCCOT: string_builder_append_format(builder, "\\arccot ");   return;
+        case OP_ADD:    string_builder_append(builder, "+ ");          return;
+        case OP_SUB:    string_builder_append(builder, "- ");          return;
+        case OP_MUL:    string_builder_append(builder, "\\cdot ");     return;
+        case OP_DIV:    string_builder_append(builder, "/ ");          return;
+        case OP_POW:    string_builder_append(builder, "^");           return;
+        case OP_NEG:    string_builder_append(builder, "-");           return;
+        case OP_LN:     string_builder_append(builder, "\\ln ");       return;
+        case OP_SQRT:   string_builder_append(builder, "\\sqrt ");     return;
+        case OP_SIN:    string_builder_append(builder, "\\sin ");      return;
+        case OP_COS:    string_builder_append(builder, "\\cos ");      return;
+        case OP_TAN:    string_builder_append(builder, "\\tan ");      return;
+        case OP_COT:    string_builder_append(builder, "\\cot ");      return;
+        case OP_ARCSIN: string_builder_append(builder, "\\arcsin ");   return;
+        case OP_ARCCOS: string_builder_append(builder, "\\arccos ");   return;
+        case OP_ARCTAN: string_builder_append(builder, "\\arctan ");   return;
+        case OP_ARCCOT: string_builder_append(builder, "\\arccot ");   return;
         default: LOG_ASSERT(0 && "Invalid enum value.", return);
     }
     LOG_ASSERT(0 && "Unreachable code", return);
 }
 
-int label_subtrees(const ast_node * node, const ast_node * labels[MAX_LABELS])
+static void count_uses(const dag_node* node, size_t* uses)
 {
-    const int MAX_TREE_SIZE = 24;
+    if (!node || uses[node->id]++ > 0) return;
+
+    count_uses(node->left,  uses);
+    count_uses(node->right, uses);
+}
+
+int label_subtrees(const dag_node* node, label_state* state)
+{
+    const int MAX_TREE_SIZE   = 24;
+    const int MIN_SHARED_SIZE = 5;
+
+    #define NEEDS_LABEL(child, size) \
+        (!find_label(child, state->labels) && \
+            ((size) > MAX_TREE_SIZE || \
+            ((size) >= MIN_SHARED_SIZE && state->uses[(child)->id] > 1)))
+
     if (!node) return 0;
-    int left_size  = label_subtrees(node-> left, labels);
-    int right_size = label_subtrees(node->right, labels);
-    if (left_size  > MAX_TREE_SIZE)
-    {
-        add_label(node-> left, labels);
+    if (find_label(node, state->labels)) return 1;
+    if (state->sizes[node->id]) return state->sizes[node->id];
+
+    int left_size  = label_subtrees(node-> left, state);
+    int right_size = label_subtrees(node->right, state);
+    if (node->left && NEEDS_LABEL(node->left, left_size)
+        && add_label(node-> left, state->labels) == 0)
         left_size  = 1;
-    }
-    if (right_size > MAX_TREE_SIZE)
-    {
-        add_label(node->right, labels);
+    if (node->right && NEEDS_LABEL(node->right, right_size)
+        && add_label(node->right, state->labels) == 0)
         right_size = 1;
-    }
-    
-    return left_size + 1 + right_size;
+
+    #undef NEEDS_LABEL
+
+    state->sizes[node->id] = left_size + 1 + right_size;
+    return state->sizes[node->id];
 }
 
-char find_label(const ast_node * node, const ast_node * labels[MAX_LABELS])
+char find_label(const dag_node* node, const dag_node* labels[MAX_LABELS])
 {
     for (char i = 'A'; i <= 'Z' && labels[i - 'A']; i++)
         if (labels[i - 'A'] == node) return i;
     return '\0';
 }
 
-void print_labels(const ast_node * labels[MAX_LABELS], string_builder* builder)
+void print_labels(const dag_node* labels[MAX_LABELS], string_builder* builder)
 {
     for (char i = 'A'; i <= 'Z' && get_node(i, labels) != NULL; i++)
     {
         string_builder_append_format(builder, "\t\\item $%c = ", i);
-        const ast_node* def = get_node(i, labels);
+        const dag_node* def = get_node(i, labels);
         set_node(i, NULL, labels);
         print_subtree(def, labels, builder);
         set_node(i, def, labels);
-        string_builder_append_format(builder, "$\n");
+        string_builder_append(builder, "$\n");
     }
 }
 
-int add_label(const ast_node * node, const ast_node * labels[MAX_LABELS])
+int add_label(const dag_node* node, const dag_node* labels[MAX_LABELS])
 {
     int found = 0;
     for (char i = 'A'; i <= 'Z'; i++)
@@ -469,3 +451,311 @@ int add_label(const ast_node * node, const ast_node * labels[MAX_LABELS])
                         "Too many attempted extractions.", NULL);
     return 0;
 }
+
+struct codegen_state
+{
+    const dynamic_array(var_name)* variables;
+    size_t* uses;
+    char* visited;
+    char* used_vars;
+    size_t* index;
+    const dag_node** temps;
+    size_t temp_count;
+    const dag_node** consts;
+    size_t const_count;
+};
+
+static void codegen_collect(const dag_node* node, codegen_state* state);
+static void codegen_signature(const char* name, FILE* output);
+static void codegen_constants(const codegen_state* state, FILE* output);
+static void codegen_body(const codegen_state* state,
+                         const dag_node* const* roots, size_t count,
+                         int batch, FILE* output);
+static int  codegen_power(const dag_node* node);
+static void codegen_ref(const codegen_state* state, const dag_node* node, FILE* output);
+static void codegen_op (const codegen_state* state, const dag_node* node, FILE* output);
+static void codegen_var(const char* var, FILE* output);
+static void codegen_num(double val, FILE* output);
+
+int codegen_nodes(const ast_node* const* roots, size_t count,
+                  const dynamic_array(var_name)* variables,
+                  const char* name, FILE* output, FILE* header)
+{
+    LOG_ASSERT(roots != NULL, return -1);
+    LOG_ASSERT(variables != NULL, return -1);
+    LOG_ASSERT(name != NULL, return -1);
+    LOG_ASSERT(output != NULL, return -1);
+
+    /* Equal subtrees become the same graph node and are computed once */
+    expr_dag dag = {};
+    dag_ctor(&dag);
+
+    const dag_node** dag_roots = (const dag_node**) calloc(count + 1, sizeof(*dag_roots));
+    LOG_ASSERT_ERROR(dag_roots != NULL, { dag_dtor(&dag); return -1; },
+                        "Failed to allocate memory", NULL);
+    for (size_t i = 0; i < count; i++)
+        dag_roots[i] = dag_from_node(&dag, roots[i]);
+
+    codegen_state state = {
+        .variables   = variables,
+        .uses        = (size_t*)          calloc(dag.size + 1, sizeof(size_t)),
+        .visited     = (char*)            calloc(dag.size + 1, sizeof(char)),
+        .used_vars   = (char*)            calloc(variables->size + 1, sizeof(char)),
+        .index       = (size_t*)          calloc(dag.size + 1, sizeof(size_t)),
+        .temps       = (const dag_node**) calloc(dag.size + 1, sizeof(const dag_node*)),
+        .temp_count  = 0,
+        .consts      = (const dag_node**) calloc(dag.size + 1, sizeof(const dag_node*)),
+        .const_count = 0
+    };
+
+    int result = -1;
+    LOG_ASSERT_ERROR(state.uses && state.visited && state.used_vars
+                        && state.index && state.temps && state.consts,
+                        goto cleanup, "Failed to allocate memory", NULL);
+
+    for (size_t i = 0; i < count; i++)
+        count_uses(dag_roots[i], state.uses);
+    for (size_t i = 0; i < count; i++)
+        codegen_collect(dag_roots[i], &state);
+
+    if (header)
+    {
+        codegen_signature(name, header);
+        fputs(";\n", header);
+    }
+
+    fprintf(output, "/* Computes %zu expressions at a single point */\n", count);
+    codegen_signature(name, output);
+    fputs("\n{\n", output);
+    codegen_constants(&state, output);
+    codegen_body(&state, dag_roots, count, 0, output);
+    fputs("}\n\n", output);
+
+    fputs("/* Computes expressions at `count` points, arguments and results are\n"
+          "   arrays of values (structure of arrays) */\n", output);
+    fprintf(output, "void %s_batch(const double* const* __restrict args, size_t count,\n"
+                    "        double* const* __restrict res)\n{\n", name);
+    codegen_constants(&state, output);
+
+    /* Arrays are accessed through restricted pointers, so that compiler
+       knows that stores to results do not change arguments */
+    for (size_t i = 0; i < variables->size; i++)
+        if (state.used_vars[i])
+            fprintf(output, "    const double* __restrict in%zu = args[%zu];\n", i, i);
+    for (size_t i = 0; i < count; i++)
+        fprintf(output, "    double* __restrict out%zu = res[%zu];\n", i, i);
+
+    fputs("\n    for (size_t i = 0; i < count; i++)\n    {\n", output);
+    codegen_body(&state, dag_roots, count, 1, output);
+    fputs("    }\n}\n\n", output);
+
+    if (header)
+        fprintf(header, "void %s_batch(const double* const* __restrict args, size_t count,\n"
+                        "        double* const* __restrict res);\n", name);
+
+    result = 0;
+
+cleanup:
+    free(state.uses);
+    free(state.visited);
+    free(state.used_vars);
+    free(state.index);
+    free(state.temps);
+    free(state.consts);
+    free(dag_roots);
+    dag_dtor(&dag);
+    return result;
+}
+
+static void codegen_collect(const dag_node* node, codegen_state* state)
+{
+    if (!node || state->visited[node->id]) return;
+    state->visited[node->id] = 1;
+
+    /* Base of expanded power is used several times, while its exponent
+       is not used at all */
+    int power = codegen_power(node);
+    if (power && is_op(node->left))
+        state->uses[node->left->id]++;
+
+    codegen_collect(node->left,  state);
+    if (!power) codegen_collect(node->right, state);
+
+    if (is_num(node))
+    {
+        state->index[node->id] = state->const_count;
+        state->consts[state->const_count++] = node;
+    }
+    else if (is_var(node))
+    {
+        size_t var_id = 0;
+        if (array_try_find_symbol(state->variables, get_var(node), &var_id))
+            state->used_vars[var_id] = 1;
+    }
+    else if (state->uses[node->id] > 1)
+    {
+        /* Operands are always collected first, so temporaries are
+           declared after everything they depend on */
+        state->index[node->id] = state->temp_count;
+        state->temps[state->temp_count++] = node;
+    }
+}
+
+static void codegen_signature(const char* name, FILE* output)
+{
+    fprintf(output, "void %s(const double* __restrict args, double* __restrict res)", name);
+}
+
+static void codegen_constants(const codegen_state* state, FILE* output)
+{
+    for (size_t i = 0; i < state->const_count; i++)
+    {
+        fprintf(output, "    constexpr double k%zu = ", i);
+        codegen_num(get_num(state->consts[i]), output);
+        fputs(";\n", output);
+    }
+}
+
+static void codegen_body(const codegen_state* state,
+                         const dag_node* const* roots, size_t count,
+                         int batch, FILE* output)
+{
+    const char* indent = batch ? "        " : "    ";
+
+    for (size_t i = 0; i < state->variables->size; i++)
+    {
+        if (!state->used_vars[i]) continue;
+
+        fprintf(output, "%sconst double ", indent);
+        codegen_var(symbol_name(*array_get_element(state->variables, i)), output);
+        if (batch) fprintf(output, " = in%zu[i];\n",   i);
+        else       fprintf(output, " = args[%zu];\n", i);
+    }
+
+    for (size_t i = 0; i < state->temp_count; i++)
+    {
+        fprintf(output, "%sconst double t%zu = ", indent, i);
+        codegen_op(state, state->temps[i], output);
+        fputs(";\n", output);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (batch) fprintf(output, "%sout%zu[i] = ",    indent, i);
+        else       fprintf(output, "%sres[%zu] = ",    indent, i);
+        codegen_ref(state, roots[i], output);
+        fputs(";\n", output);
+    }
+}
+
+static int codegen_power(const dag_node* node)
+{
+    const int MAX_EXPANDED_POWER = 4;
+
+    if (!op_cmp(node, OP_POW) || !is_num(node->right))
+        return 0;
+
+    for (int i = 2; i <= MAX_EXPANDED_POWER; i++)
+        if (num_cmp(node->right, i)) return i;
+
+    return 0;
+}
+static void codegen_ref(const codegen_state* state, const dag_node* node, FILE* output)
+{
+    if (is_num(node))
+        fprintf(output, "k%zu", state->index[node->id]);
+    else if (is_var(node))
+        codegen_var(symbol_name(get_var(node)), output);
+    else if (state->uses[node->id] > 1)
+        fprintf(output, "t%zu", state->index[node->id]);
+    else
+        codegen_op(state, node, output);
+}
+
+static void codegen_op(const codegen_state* state, const dag_node* node, FILE* output)
+{
+    #define CODEGEN_INFIX(op) do\
+        {\
+            fputc('(', output); codegen_ref(state, node->left, output);\
+            fputs(" " #op " ", output); codegen_ref(state, node->right, output);\
+            fputc(')', output);\
+        } while(0)
+    #define CODEGEN_CALL(func) do\
+        {\
+            fputs(#func "(", output); codegen_ref(state, node->right, output);\
+            fputc(')', output);\
+        } while(0)
+    #define CODEGEN_COMPOUND(op, code) do\
+        {\
+            fputs("(" #op " ", output); code; fputc(')', output);\
+        } while(0)
+
+    switch(get_op(node))
+    {
+    case OP_ADD:    CODEGEN_INFIX(+);                               break;
+    case OP_SUB:    CODEGEN_INFIX(-);                               break;
+    case OP_MUL:    CODEGEN_INFIX(*);                               break;
+    case OP_DIV:    CODEGEN_INFIX(/);                               break;
+    case OP_NEG:    CODEGEN_COMPOUND(-, codegen_ref(state, node->right, output)); break;
+    case OP_LN:     CODEGEN_CALL(log);                              break;
+    case OP_SQRT:   CODEGEN_CALL(sqrt);                             break;
+    case OP_SIN:    CODEGEN_CALL(sin);                              break;
+    case OP_COS:    CODEGEN_CALL(cos);                              break;
+    case OP_TAN:    CODEGEN_CALL(tan);                              break;
+    case OP_COT:    CODEGEN_COMPOUND(1.0 /, CODEGEN_CALL(tan));     break;
+    case OP_ARCSIN: CODEGEN_CALL(asin);                             break;
+    case OP_ARCCOS: CODEGEN_CALL(acos);                             break;
+    case OP_ARCTAN: CODEGEN_CALL(atan);                             break;
+    case OP_ARCCOT: CODEGEN_COMPOUND(M_PI_2 -, CODEGEN_CALL(atan)); break;
+    case OP_POW:
+        if (codegen_power(node))
+        {
+            /* Small whole powers are cheaper as products, which compiler
+               does not do by itself without -ffast-math */
+            fputc('(', output);
+            for (int i = 0; i < codegen_power(node); i++)
+            {
+                if (i > 0) fputs(" * ", output);
+                codegen_ref(state, node->left, output);
+            }
+            fputc(')', output);
+            break;
+        }
+        fputs("pow(", output); codegen_ref(state, node->left, output);
+        fputs(", ", output); codegen_ref(state, node->right, output);
+        fputc(')', output);
+        break;
+    default: LOG_ASSERT(0 && "Invalid enum value.", break);
+    }
+
+    #undef CODEGEN_INFIX
+    #undef CODEGEN_CALL
+    #undef CODEGEN_COMPOUND
+}
+
+static void codegen_var(const char* var, FILE* output)
+{
+    /* Variable names may contain characters not allowed in identifiers.
+     * Such characters (underscore included) become '_' followed by two hex
+     * digits, so that distinct names never produce the same identifier, and
+     * identifier never contains reserved "__". Prefix 'v' is reserved for
+     * variables: no other generated identifier starts with it */
+    fputc('v', output);
+    for (const char* c = var; *c; c++)
+    {
+        if (isalnum((unsigned char) *c))
+            fputc(*c, output);
+        else
+            fprintf(output, "_%02x", (unsigned char) *c);
+    }
+}
+
+static void codegen_num(double val, FILE* output)
+{
+    if (isnan(val))
+        fputs("NAN", output);
+    else if (isinf(val))
+        fputs(val > 0 ? "INFINITY" : "-INFINITY", output);
+    else
+        fprintf(output, "%.17g", val);
+}
@@ -13,11 +13,13 @@
 #define TREE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "math_utils.h"
 #include "string_builder.h"
 
 #include "var_name_array.h"
+#include "node_arena.h"
 
 /**
  * @brief AST node type
@@ -82,6 +84,12 @@ struct ast_node
      * @brief Pointer to right child
      */
     ast_node*   right;
+
+    /**
+     * @brief Variables, on which subtree depends. Contains `var_bit(var)`
+     * for every variable `var` in subtree, maintained by node constructors.
+     */
+    uint64_t    depends;
 };
 
 /* TODO: docs */
@@ -98,6 +106,26 @@ inline var_name get_var(const ast_node* node)               { return node->value
 inline int      is_var (const ast_node* node)               { return node && node->type == NODE_VAR; }
 inline int      var_cmp(const ast_node* node, var_name var) { return is_var(node) && get_var(node) == var; }
 
+/**
+ * @brief Variables with smaller ids have their own bit in `ast_node::depends`,
+ * others share the last bit.
+ */
+const var_name DEPENDS_EXACT_VARS = 63;
+
+/**
+ * @brief Bit representing variable in `ast_node::depends`
+ */
+inline uint64_t var_bit(var_name var)
+{
+    return 1ull << (var < DEPENDS_EXACT_VARS ? var : DEPENDS_EXACT_VARS);
+}
+
+/**
+ * @brief Check if subtree may depend on variable. Zero result is exact,
+ * non-zero result is exact for variables below `DEPENDS_EXACT_VARS`.
+ */
+inline int      may_depend(const ast_node* node, var_name var) { return node && (node->depends & var_bit(var)); }
+
 typedef ast_node* tree_iterator;
 
 /**
@@ -114,10 +142,18 @@ struct abstract_syntax_tree
      * @brief Array of variable names
      */
     dynamic_array(var_name) variables;
+
+    /**
+     * @brief Storage for tree nodes. Nodes are released together with tree,
+     * so they must be created while this arena is in use (see `node_arena_use`)
+     */
+    node_arena arena;
 };
 
 /**
  * @brief Create new tree node with specified parent and no children.
+ * Node is allocated from the arena currently in use. Children attached
+ * later must be added to `depends` by caller.
  * 
  * @param[in] data Data stored in node
  * @param[in] parent Parent node
@@ -195,7 +231,8 @@ abstract_syntax_tree* tree_ctor(void);
 abstract_syntax_tree* tree_copy(const abstract_syntax_tree* src);
 
 /**
- * @brief Destroy `abstract_syntax_tree`
+ * @brief Destroy `abstract_syntax_tree`. All nodes allocated from tree
+ * arena are released at once.
  * 
  * @param[inout] tree `abstract_syntax_tree` instance to be destroyed
  */
@@ -242,17 +279,40 @@ tree_iterator tree_end(abstract_syntax_tree* tree);
 void print_node(const ast_node* node, string_builder* builder);
 
 /**
- * @brief Output node such that gnuplot would understand it
- * 
- * @param[in] node Plotted node
- * @param[in] output Output stream
+ * @brief Output operation sign or function name in LaTeX format
+ *
+ * @param[in] op Printed operation
+ * @param[in] builder Output string
  */
-void plot_node(const ast_node* node, FILE* output);
+void print_op(op_type op, string_builder* builder);
 
-void plot_tangent(const ast_node* func,
-                    const ast_node* tangent,
-                    const char* filename,
-                    double range_left = -10,
-                    double range_right = 10);
+/**
+ * @brief Check, whether operand of operation must be put in parentheses
+ *
+ * @param[in] parent_op Operation
+ * @param[in] child_op Operation of operand
+ * @param[in] is_right Whether operand is right one
+ * @return Non-zero if parentheses are required, 0 otherwise
+ */
+int op_requires_grouping(op_type parent_op, op_type child_op, int is_right);
+
+/**
+ * @brief Output C++ functions, computing several expressions at once: one for
+ * a single point and one for arrays of points. Shared subexpressions are
+ * computed once, numbers become `constexpr` constants.
+ * 
+ * @param[in] roots Computed expressions
+ * @param[in] count Number of expressions
+ * @param[in] variables Function arguments, in the order of their values in
+ * `args`
+ * @param[in] name Function name, batch variant is named `<name>_batch`
+ * @param[in] output Output stream for definitions
+ * @param[in] header Output stream for declarations. Ignored if set to `NULL`
+ * @return 0 upon success, -1 otherwise
+ * @note Generated code requires `<math.h>` and `<stddef.h>`
+ */
+int codegen_nodes(const ast_node* const* roots, size_t count,
+                  const dynamic_array(var_name)* variables,
+                  const char* name, FILE* output, FILE* header = NULL);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,586 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#include "ast_binary.h"
+#include "node_arena.h"
+
+static const char TREE_MAGIC[8] = {'A', 'S', 'T', 'B', 'I', 'N', 'A', 'R'};
+static const uint32_t TREE_VERSION = 1;
+
+#define MATH_FUNC(name, ...) + 1
+
+static const size_t OP_COUNT = (size_t) OP_NEG + 1
+    #include "functions.h"
+    ;
+
+#undef MATH_FUNC
+
+/**
+ * @brief Opcodes of number and variable nodes. Operation `op` is stored
+ * as `OPC_OP + op`.
+ */
+enum tree_opcode
+{
+    OPC_NUM,
+    OPC_VAR,
+    OPC_OP
+};
+
+/**
+ * @brief Serialized tree header. Constant pool follows it immediately,
+ * then names and opcode stream.
+ */
+struct tree_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t var_count;
+    uint32_t const_count;
+    uint32_t node_count;
+    uint32_t names_size;
+    uint32_t stream_size;
+};
+
+/**
+ * @brief Serialization state
+ */
+struct tree_writer
+{
+    const abstract_syntax_tree* ast;
+
+    uint8_t* stream;
+    size_t stream_size;
+    size_t stream_capacity;
+
+    double* constants;
+    size_t const_count;
+    /**
+     * @brief Open addressing table of constant indices plus one, keyed by
+     * bit pattern, so that distinct zeros and NaNs are preserved
+     */
+    uint32_t* const_table;
+    size_t table_size;
+
+    size_t node_count;
+    int failed;
+};
+
+static void write_node    (tree_writer* writer, const ast_node* node);
+static void write_byte    (tree_writer* writer, uint8_t byte);
+static void write_varint  (tree_writer* writer, size_t value);
+static size_t add_constant(tree_writer* writer, double value);
+static int  grow_constants(tree_writer* writer);
+static size_t find_var    (const abstract_syntax_tree* ast, var_name var);
+
+static size_t get_arity    (const tree_view_node* node);
+static int    check_stream (const tree_view* view);
+
+static inline uint64_t get_bits(double value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* Small integers have zero low bits, so high ones are folded into them */
+static inline size_t hash_bits(uint64_t bits)
+{
+    uint64_t hash = (bits ^ (bits >> 32)) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+static inline int read_varint(const tree_view* view, size_t* pos, size_t* value)
+{
+    *value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (*pos >= view->stream_size)
+            return -1;
+
+        uint8_t byte = view->stream[(*pos)++];
+        *value |= (size_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return 0;
+    }
+
+    return -1;
+}
+
+static inline int decode_node(const tree_view* view, size_t* pos, tree_view_node* node)
+{
+    if (*pos >= view->stream_size)
+        return -1;
+
+    uint8_t opcode = view->stream[(*pos)++];
+    switch (opcode)
+    {
+    case OPC_NUM:
+        node->type = NODE_NUM;
+        if (read_varint(view, pos, &node->index) != 0 || node->index >= view->const_count)
+            return -1;
+
+        /* Pool is not necessarily aligned in memory */
+        memcpy(&node->num, view->constants + node->index, sizeof(double));
+        return 0;
+    case OPC_VAR:
+        node->type = NODE_VAR;
+        node->num  = 0;
+        if (read_varint(view, pos, &node->index) != 0 || node->index >= view->var_count)
+            return -1;
+        return 0;
+    default:
+        if ((size_t) opcode - OPC_OP >= OP_COUNT)
+            return -1;
+
+        node->type  = NODE_OP;
+        node->index = (size_t) opcode - OPC_OP;
+        node->num   = 0;
+        return 0;
+    }
+}
+
+uint8_t* tree_serialize(const abstract_syntax_tree* ast, size_t* size)
+{
+    LOG_ASSERT(ast != NULL, return NULL);
+    LOG_ASSERT(ast->root != NULL, return NULL);
+    LOG_ASSERT(size != NULL, return NULL);
+
+    tree_writer writer = {};
+    writer.ast = ast;
+
+    write_node(&writer, ast->root);
+
+    uint8_t* result = NULL;
+    size_t names_size = 0;
+    for (size_t i = 0; i < ast->variables.size; i++)
+        names_size += strlen(symbol_name(ast->variables.data[i])) + 1;
+
+    size_t total = sizeof(tree_header) + writer.const_count * sizeof(double)
+                 + names_size + writer.stream_size;
+
+    LOG_ASSERT_ERROR(!writer.failed, goto cleanup, "Failed to serialize tree", NULL);
+    LOG_ASSERT_ERROR(total <= UINT32_MAX, goto cleanup, "Tree is too large", NULL);
+
+    result = (uint8_t*) calloc(total, 1);
+    LOG_ASSERT_ERROR(result != NULL, goto cleanup, "Failed to allocate memory", NULL);
+
+    {
+        tree_header header = {
+            .magic       = {},
+            .version     = TREE_VERSION,
+            .var_count   = (uint32_t) ast->variables.size,
+            .const_count = (uint32_t) writer.const_count,
+            .node_count  = (uint32_t) writer.node_count,
+            .names_size  = (uint32_t) names_size,
+            .stream_size = (uint32_t) writer.stream_size
+        };
+        memcpy(header.magic, TREE_MAGIC, sizeof(TREE_MAGIC));
+        memcpy(result, &header, sizeof(header));
+
+        uint8_t* pos = result + sizeof(header);
+        if (writer.const_count > 0)
+            memcpy(pos, writer.constants, writer.const_count * sizeof(double));
+        pos += writer.const_count * sizeof(double);
+
+        for (size_t i = 0; i < ast->variables.size; i++)
+        {
+            const char* name = symbol_name(ast->variables.data[i]);
+            size_t length = strlen(name) + 1;
+            memcpy(pos, name, length);
+            pos += length;
+        }
+
+        memcpy(pos, writer.stream, writer.stream_size);
+        *size = total;
+    }
+
+cleanup:
+    free(writer.stream);
+    free(writer.constants);
+    free(writer.const_table);
+    return result;
+}
+
+abstract_syntax_tree* tree_deserialize(const uint8_t* data, size_t size)
+{
+    abstract_syntax_tree* ast = tree_ctor();
+    LOG_ASSERT(ast != NULL, return NULL);
+
+    if (tree_deserialize_into(ast, data, size) != 0)
+    {
+        tree_dtor(ast);
+        return NULL;
+    }
+
+    return ast;
+}
+
+int tree_deserialize_into(abstract_syntax_tree* ast, const uint8_t* data, size_t size)
+{
+    LOG_ASSERT(ast != NULL, return -1);
+    LOG_ASSERT(data != NULL, return -1);
+
+    tree_view view = {};
+    LOG_ASSERT_ERROR(tree_view_ctor(&view, data, size) == 0, return -1,
+        "Corrupted serialized tree", NULL);
+    LOG_ASSERT_ERROR(check_stream(&view) == 0, return -1,
+        "Corrupted serialized tree", NULL);
+
+    var_name* vars = (var_name*) calloc(view.var_count + 1, sizeof(*vars));
+    LOG_ASSERT_ERROR(vars != NULL, return -1, "Failed to allocate memory", NULL);
+
+    const char* name = view.names;
+    for (size_t i = 0; i < view.var_count; i++)
+    {
+        vars[i] = symbol_intern(name);
+        LOG_ASSERT_ERROR(vars[i] != SYMBOL_NONE, { free(vars); return -1; },
+            "Failed to allocate memory", NULL);
+
+        if (!array_try_find_symbol(&ast->variables, vars[i]))
+            array_push(&ast->variables, vars[i]);
+        name += strlen(name) + 1;
+    }
+
+    /* Stream was checked, so only allocation may fail from now on */
+    ast_node* root    = NULL;
+    ast_node* current = NULL;
+    ast_node* run     = NULL;
+    size_t run_size   = 0;
+    size_t pos        = 0;
+    int result        = 0;
+
+    for (size_t i = 0; i < view.node_count; i++)
+    {
+        if (run_size == 0)
+        {
+            run = node_arena_alloc_run(&ast->arena, view.node_count - i, &run_size);
+            if (!run)
+            {
+                result = -1;
+                break;
+            }
+        }
+
+        tree_view_node decoded = {};
+        decode_node(&view, &pos, &decoded);
+
+        ast_node* node = run++;
+        run_size--;
+
+        *node = {
+            .type    = decoded.type,
+            .value   = {},
+            .parent  = current,
+            .left    = NULL,
+            .right   = NULL,
+            .depends = 0
+        };
+        switch (decoded.type)
+        {
+        case NODE_NUM: node->value.num = decoded.num;               break;
+        case NODE_VAR: node->value.var = vars[decoded.index];
+                       node->depends   = var_bit(node->value.var);  break;
+        case NODE_OP:  node->value.op  = (op_type) decoded.index;   break;
+        default: LOG_ASSERT(0 && "Invalid enum value.", break);
+        }
+
+        if (!current)
+            root = node;
+        else if (current->left == NULL && get_op(current) < OP_NEG)
+            current->left = node;
+        else
+            current->right = node;
+
+        /* Operations receive following nodes as children, others complete
+           every ancestor, which has all of its children */
+        if (decoded.type == NODE_OP)
+            current = node;
+        else
+            while (current && current->right)
+            {
+                current->depends = current->right->depends
+                                 | (current->left ? current->left->depends : 0);
+                current = current->parent;
+            }
+    }
+
+    free(vars);
+
+    if (result != 0)
+        return -1;
+
+    if (ast->root)
+        delete_subtree(ast->root);
+    ast->root = root;
+    return 0;
+}
+
+int tree_write_binary(const abstract_syntax_tree* ast, const char* filename)
+{
+    LOG_ASSERT(ast != NULL, return -1);
+    LOG_ASSERT(filename != NULL, return -1);
+
+    size_t size = 0;
+    uint8_t* data = tree_serialize(ast, &size);
+    LOG_ASSERT(data != NULL, return -1);
+
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    LOG_ASSERT_ERROR(fd >= 0, { free(data); return -1; },
+        "Could not open file '%s'", filename);
+
+    ssize_t written = write(fd, data, size);
+    int failed = close(fd) != 0 || written < 0 || (size_t) written != size;
+    free(data);
+
+    LOG_ASSERT_ERROR(!failed, return -1, "Could not write file '%s'", filename);
+    return 0;
+}
+
+abstract_syntax_tree* tree_read_binary(const char* filename)
+{
+    LOG_ASSERT(filename != NULL, return NULL);
+
+    int fd = open(filename, O_RDONLY);
+    LOG_ASSERT_ERROR(fd >= 0, return NULL, "Could not open file '%s'", filename);
+
+    struct stat info = {};
+    LOG_ASSERT_ERROR(fstat(fd, &info) == 0 && info.st_size > 0, { close(fd); return NULL; },
+        "Could not read file '%s'", filename);
+
+    size_t size = (size_t) info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    LOG_ASSERT_ERROR(mapping != MAP_FAILED, return NULL,
+        "Could not map file '%s'", filename);
+
+    abstract_syntax_tree* ast = tree_deserialize((const uint8_t*) mapping, size);
+    munmap(mapping, size);
+
+    return ast;
+}
+
+int tree_view_ctor(tree_view* view, const uint8_t* data, size_t size)
+{
+    LOG_ASSERT(view != NULL, return -1);
+    LOG_ASSERT(data != NULL, return -1);
+
+    if (size < sizeof(tree_header))
+        return -1;
+
+    tree_header header = {};
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, TREE_MAGIC, sizeof(TREE_MAGIC)) != 0
+        || header.version != TREE_VERSION)
+        return -1;
+
+    uint64_t total = sizeof(header) + (uint64_t) header.const_count * sizeof(double)
+                   + header.names_size + header.stream_size;
+    if (total > size || header.node_count == 0
+        || header.node_count > header.stream_size)
+        return -1;
+
+    *view = {
+        .var_count   = header.var_count,
+        .const_count = header.const_count,
+        .node_count  = header.node_count,
+        .constants   = (const double*) (const void*) (data + sizeof(header)),
+        .names       = (const char*) (data + sizeof(header)
+                                           + header.const_count * sizeof(double)),
+        .stream      = data + total - header.stream_size,
+        .stream_size = header.stream_size
+    };
+
+    /* Every name must be terminated inside of its section */
+    size_t terminators = 0;
+    for (size_t i = 0; i < header.names_size; i++)
+        if (view->names[i] == '\0')
+            terminators++;
+
+    if (terminators != view->var_count
+        || (header.names_size > 0 && view->names[header.names_size - 1] != '\0'))
+        return -1;
+
+    return 0;
+}
+
+int tree_view_next(const tree_view* view, size_t* pos, tree_view_node* node)
+{
+    LOG_ASSERT(view != NULL, return -1);
+    LOG_ASSERT(pos  != NULL, return -1);
+    LOG_ASSERT(node != NULL, return -1);
+
+    return decode_node(view, pos, node);
+}
+
+const char* tree_view_get_var(const tree_view* view, size_t index)
+{
+    LOG_ASSERT(view != NULL, return NULL);
+
+    if (index >= view->var_count)
+        return NULL;
+
+    const char* name = view->names;
+    for (size_t i = 0; i < index; i++)
+        name += strlen(name) + 1;
+
+    return name;
+}
+
+static void write_node(tree_writer* writer, const ast_node* node)
+{
+    if (writer->failed) return;
+    LOG_ASSERT(node != NULL, { writer->failed = 1; return; });
+
+    writer->node_count++;
+
+    switch (node->type)
+    {
+    case NODE_NUM:
+        write_byte(writer, OPC_NUM);
+        write_varint(writer, add_constant(writer, get_num(node)));
+        return;
+    case NODE_VAR:
+    {
+        size_t var_id = find_var(writer->ast, get_var(node));
+        LOG_ASSERT_ERROR(var_id < writer->ast->variables.size,
+            { writer->failed = 1; return; },
+            "Variable '%s' was not defined", symbol_name(get_var(node)));
+
+        write_byte(writer, OPC_VAR);
+        write_varint(writer, var_id);
+        return;
+    }
+    case NODE_OP:
+        write_byte(writer, (uint8_t) ((int) OPC_OP + (int) get_op(node)));
+        if (get_op(node) < OP_NEG)
+            write_node(writer, node->left);
+        write_node(writer, node->right);
+        return;
+    default: LOG_ASSERT(0 && "Invalid enum value.", { writer->failed = 1; return; });
+    }
+}
+
+static void write_byte(tree_writer* writer, uint8_t byte)
+{
+    if (writer->stream_size == writer->stream_capacity)
+    {
+        size_t capacity = writer->stream_capacity ? writer->stream_capacity * 2 : 64;
+        uint8_t* stream = (uint8_t*) realloc(writer->stream, capacity);
+        LOG_ASSERT_ERROR(stream != NULL, { writer->failed = 1; return; },
+            "Failed to allocate memory", NULL);
+
+        writer->stream          = stream;
+        writer->stream_capacity = capacity;
+    }
+
+    writer->stream[writer->stream_size++] = byte;
+}
+
+static void write_varint(tree_writer* writer, size_t value)
+{
+    while (value >= 0x80)
+    {
+        write_byte(writer, (uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    write_byte(writer, (uint8_t) value);
+}
+
+static size_t add_constant(tree_writer* writer, double value)
+{
+    if ((writer->const_count + 1) * 2 > writer->table_size && grow_constants(writer) != 0)
+        return 0;
+
+    uint64_t bits = get_bits(value);
+    size_t mask = writer->table_size - 1;
+    size_t slot = hash_bits(bits) & mask;
+
+    while (writer->const_table[slot])
+    {
+        size_t index = writer->const_table[slot] - 1;
+        if (get_bits(writer->constants[index]) == bits)
+            return index;
+        slot = (slot + 1) & mask;
+    }
+
+    writer->constants[writer->const_count] = value;
+    writer->const_table[slot] = (uint32_t) ++writer->const_count;
+    return writer->const_count - 1;
+}
+
+static int grow_constants(tree_writer* writer)
+{
+    size_t table_size = writer->table_size ? writer->table_size * 2 : 16;
+
+    uint32_t* table = (uint32_t*) calloc(table_size, sizeof(*table));
+    double* constants = (double*) realloc(writer->constants, table_size / 2 * sizeof(*constants));
+    if (constants)
+        writer->constants = constants;
+
+    LOG_ASSERT_ERROR(table != NULL && constants != NULL,
+        { free(table); writer->failed = 1; return -1; },
+        "Failed to allocate memory", NULL);
+
+    size_t mask = table_size - 1;
+    for (size_t i = 0; i < writer->const_count; i++)
+    {
+        uint64_t bits = get_bits(writer->constants[i]);
+        size_t slot = hash_bits(bits) & mask;
+        while (table[slot])
+            slot = (slot + 1) & mask;
+        table[slot] = (uint32_t) (i + 1);
+    }
+
+    free(writer->const_table);
+    writer->const_table = table;
+    writer->table_size  = table_size;
+    return 0;
+}
+
+/**
+ * @return Index of variable in tree, number of tree variables if it is not found
+ */
+static size_t find_var(const abstract_syntax_tree* ast, var_name var)
+{
+    size_t var_id = 0;
+    if (array_try_find_symbol(&ast->variables, var, &var_id))
+        return var_id;
+
+    return ast->variables.size;
+}
+
+
+static size_t get_arity(const tree_view_node* node)
+{
+    if (node->type != NODE_OP)
+        return 0;
+    return node->index < OP_NEG ? 2 : 1;
+}
+
+/**
+ * @brief Check, that stream consists of exactly one tree with declared
+ * number of nodes
+ */
+static int check_stream(const tree_view* view)
+{
+    size_t pos = 0;
+    size_t missing = 1;
+
+    for (size_t i = 0; i < view->node_count; i++)
+    {
+        tree_view_node node = {};
+        if (missing == 0 || decode_node(view, &pos, &node) != 0)
+            return -1;
+
+        missing += get_arity(&node) - 1;
+    }
+
+    return missing == 0 && pos == view->stream_size ? 0 : -1;
+}
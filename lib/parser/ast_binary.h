@@ -0,0 +1,143 @@
+/**
+ * @file ast_binary.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Compact binary format of syntax trees
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Serialized tree consists of fixed header, pool of distinct number
+ * constants, table of null-terminated variable names and pre-order stream
+ * of node opcodes. Number and variable opcodes are followed by varint index
+ * into pool or table. Pool is aligned to 8 bytes and names are stored as C
+ * strings, so that mapped tree may be traversed without copying (see
+ * `tree_view`). Format uses byte order of host machine.
+ */
+
+#ifndef AST_BINARY_H
+#define AST_BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+/**
+ * @brief Serialized tree, which is read in place
+ */
+struct tree_view
+{
+    size_t var_count;
+    size_t const_count;
+    size_t node_count;
+
+    /**
+     * @brief Number constants, `const_count` values
+     */
+    const double* constants;
+    /**
+     * @brief Variable names, `var_count` null-terminated strings
+     */
+    const char* names;
+    /**
+     * @brief Node opcodes in pre-order
+     */
+    const uint8_t* stream;
+    size_t stream_size;
+};
+
+/**
+ * @brief Node decoded from `tree_view`
+ */
+struct tree_view_node
+{
+    node_type type;
+    /**
+     * @brief Operation for `NODE_OP`, variable index for `NODE_VAR`,
+     * constant index for `NODE_NUM`
+     */
+    size_t index;
+    /**
+     * @brief Constant value for `NODE_NUM`
+     */
+    double num;
+};
+
+/**
+ * @brief Serialize tree
+ *
+ * @param[in] ast Serialized tree
+ * @param[out] size Size of serialized tree in bytes
+ * @return Serialized tree, allocated with `malloc`. `NULL` upon failure
+ */
+uint8_t* tree_serialize(const abstract_syntax_tree* ast, size_t* size);
+
+/**
+ * @brief Build tree from serialized data
+ *
+ * @param[in] data Serialized tree
+ * @param[in] size Size of serialized tree in bytes
+ * @return Constructed tree, `NULL` if data is corrupted
+ */
+abstract_syntax_tree* tree_deserialize(const uint8_t* data, size_t size);
+
+/**
+ * @brief Replace root of existing tree with serialized one. Variables are
+ * matched by name, missing ones are added to tree.
+ *
+ * @param[inout] ast Tree, which receives nodes
+ * @param[in] data Serialized tree
+ * @param[in] size Size of serialized tree in bytes
+ * @return 0 upon success, -1 if data is corrupted. Tree is not changed
+ * upon failure, except for variables added to it
+ */
+int tree_deserialize_into(abstract_syntax_tree* ast, const uint8_t* data, size_t size);
+
+/**
+ * @brief Write serialized tree to file
+ *
+ * @param[in] ast Written tree
+ * @param[in] filename Output file
+ * @return 0 upon success, -1 otherwise
+ */
+int tree_write_binary(const abstract_syntax_tree* ast, const char* filename);
+
+/**
+ * @brief Read serialized tree from file
+ *
+ * @param[in] filename Input file
+ * @return Constructed tree, `NULL` upon failure
+ */
+abstract_syntax_tree* tree_read_binary(const char* filename);
+
+/**
+ * @brief Check serialized tree header and sections
+ *
+ * @param[out] view Constructed view. Pointers refer to `data`
+ * @param[in] data Serialized tree, aligned to 8 bytes
+ * @param[in] size Size of serialized tree in bytes
+ * @return 0 upon success, -1 if data is corrupted
+ */
+int tree_view_ctor(tree_view* view, const uint8_t* data, size_t size);
+
+/**
+ * @brief Decode node at given position of opcode stream
+ *
+ * @param[in] view Serialized tree
+ * @param[inout] pos Position in stream, moved to next node in pre-order
+ * @param[out] node Decoded node
+ * @return 0 upon success, -1 if stream is corrupted or exhausted
+ */
+int tree_view_next(const tree_view* view, size_t* pos, tree_view_node* node);
+
+/**
+ * @brief Get name of variable
+ *
+ * @param[in] view Serialized tree
+ * @param[in] index Variable index
+ * @return Null-terminated variable name, `NULL` if index is invalid
+ */
+const char* tree_view_get_var(const tree_view* view, size_t index);
+
+#endif
@@ -0,0 +1,298 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "expr_dag.h"
+
+static const size_t DAG_CHUNK_SIZE = 1024;
+static const size_t DEFAULT_BUCKETS = 256;
+
+struct dag_chunk
+{
+    dag_chunk* prev;
+    size_t used;
+    dag_node nodes[DAG_CHUNK_SIZE];
+};
+
+static const dag_node* intern(expr_dag* dag, const dag_node* pattern);
+static void rehash(expr_dag* dag);
+static size_t hash_node(const dag_node* node);
+static int equal_nodes(const dag_node* node1, const dag_node* node2);
+static size_t count_unvisited(const dag_node* node, char* visited);
+
+void dag_ctor(expr_dag* dag)
+{
+    LOG_ASSERT(dag != NULL, return);
+
+    *dag = {
+        .buckets = (dag_node**) calloc(DEFAULT_BUCKETS, sizeof(dag_node*)),
+        .bucket_count = DEFAULT_BUCKETS,
+        .size = 0,
+        .chunks = NULL
+    };
+}
+
+void dag_dtor(expr_dag* dag)
+{
+    LOG_ASSERT(dag != NULL, return);
+
+    dag_chunk* chunk = dag->chunks;
+    while (chunk)
+    {
+        dag_chunk* prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+
+    free(dag->buckets);
+    *dag = {};
+}
+
+const dag_node* dag_make_number(expr_dag* dag, double val)
+{
+    dag_node pattern = {.type = NODE_NUM, .value = {.num = val}};
+    return intern(dag, &pattern);
+}
+
+const dag_node* dag_make_var(expr_dag* dag, var_name var)
+{
+    dag_node pattern = {.type = NODE_VAR, .value = {.var = var}};
+    return intern(dag, &pattern);
+}
+
+const dag_node* dag_make_binary(expr_dag* dag, op_type op,
+                                const dag_node* left, const dag_node* right)
+{
+    LOG_ASSERT(left != NULL, return NULL);
+    LOG_ASSERT(right != NULL, return NULL);
+
+    dag_node pattern = {
+        .type = NODE_OP,
+        .value = {.op = op},
+        .left = left,
+        .right = right
+    };
+    return intern(dag, &pattern);
+}
+
+const dag_node* dag_make_unary(expr_dag* dag, op_type op, const dag_node* right)
+{
+    LOG_ASSERT(right != NULL, return NULL);
+
+    dag_node pattern = {
+        .type = NODE_OP,
+        .value = {.op = op},
+        .left = NULL,
+        .right = right
+    };
+    return intern(dag, &pattern);
+}
+
+const dag_node* dag_from_node(expr_dag* dag, const ast_node* node)
+{
+    LOG_ASSERT(node != NULL, return NULL);
+
+    switch (node->type)
+    {
+    case NODE_NUM: return dag_make_number(dag, get_num(node));
+    case NODE_VAR: return dag_make_var(dag, get_var(node));
+    case NODE_OP:
+        if (!node->left)
+            return dag_make_unary(dag, get_op(node), dag_from_node(dag, node->right));
+        return dag_make_binary(dag, get_op(node),
+                                dag_from_node(dag, node->left),
+                                dag_from_node(dag, node->right));
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return NULL);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return NULL);
+}
+
+ast_node* dag_to_node(const dag_node* node)
+{
+    LOG_ASSERT(node != NULL, return NULL);
+
+    if (is_num(node)) return make_number_node(get_num(node));
+    if (is_var(node)) return make_var_node(get_var(node));
+
+    if (!node->left)
+        return make_unary_node(get_op(node), dag_to_node(node->right));
+
+    return make_binary_node(get_op(node),
+                            dag_to_node(node->left),
+                            dag_to_node(node->right));
+}
+
+size_t dag_count_nodes(const expr_dag* dag, const dag_node* node)
+{
+    char* visited = (char*) calloc(dag->size, sizeof(*visited));
+    size_t count = count_unvisited(node, visited);
+    free(visited);
+
+    return count;
+}
+
+void dag_memo_ctor(dag_memo* memo)
+{
+    LOG_ASSERT(memo != NULL, return);
+
+    *memo = {
+        .results = NULL,
+        .capacity = 0
+    };
+}
+
+void dag_memo_dtor(dag_memo* memo)
+{
+    LOG_ASSERT(memo != NULL, return);
+
+    free(memo->results);
+    *memo = {};
+}
+
+const dag_node* dag_memo_get(const dag_memo* memo, const dag_node* node)
+{
+    if (node->id >= memo->capacity) return NULL;
+    return memo->results[node->id];
+}
+
+void dag_memo_set(dag_memo* memo, const dag_node* node, const dag_node* result)
+{
+    if (node->id >= memo->capacity)
+    {
+        size_t new_cap = memo->capacity ? memo->capacity : DEFAULT_BUCKETS;
+        while (new_cap <= node->id)
+            new_cap *= 2;
+
+        /* Result is not stored upon failure, it will be computed again */
+        const dag_node** results = (const dag_node**) reallocarray(memo->results, new_cap,
+                                                                   sizeof(*results));
+        LOG_ASSERT_ERROR(results != NULL, return, "Failed to allocate memory", NULL);
+
+        memset(results + memo->capacity, 0, (new_cap - memo->capacity) * sizeof(*results));
+        memo->results  = results;
+        memo->capacity = new_cap;
+    }
+
+    memo->results[node->id] = result;
+}
+
+static const dag_node* intern(expr_dag* dag, const dag_node* pattern)
+{
+    size_t hash = hash_node(pattern);
+
+    for (dag_node* node = dag->buckets[hash % dag->bucket_count]; node; node = node->next)
+        if (node->hash == hash && equal_nodes(node, pattern))
+            return node;
+
+    if (!dag->chunks || dag->chunks->used == DAG_CHUNK_SIZE)
+    {
+        dag_chunk* chunk = (dag_chunk*) calloc(1, sizeof(*chunk));
+        LOG_ASSERT_ERROR(chunk != NULL, return NULL,
+                        "Failed to allocate graph nodes", NULL);
+        chunk->prev = dag->chunks;
+        dag->chunks = chunk;
+    }
+
+    dag_node* node = &dag->chunks->nodes[dag->chunks->used++];
+    *node = *pattern;
+    node->hash = hash;
+    node->id   = dag->size++;
+
+    dag_node** bucket = &dag->buckets[hash % dag->bucket_count];
+    node->next = *bucket;
+    *bucket = node;
+
+    if (dag->size > dag->bucket_count)
+        rehash(dag);
+
+    return node;
+}
+
+static void rehash(expr_dag* dag)
+{
+    size_t new_count = dag->bucket_count * 2;
+    dag_node** new_buckets = (dag_node**) calloc(new_count, sizeof(dag_node*));
+
+    /* Old table stays valid, only its chains get longer */
+    LOG_ASSERT_ERROR(new_buckets != NULL, return, "Failed to allocate graph buckets", NULL);
+
+    for (size_t i = 0; i < dag->bucket_count; i++)
+    {
+        dag_node* node = dag->buckets[i];
+        while (node)
+        {
+            dag_node* next = node->next;
+            node->next = new_buckets[node->hash % new_count];
+            new_buckets[node->hash % new_count] = node;
+            node = next;
+        }
+    }
+
+    free(dag->buckets);
+    dag->buckets = new_buckets;
+    dag->bucket_count = new_count;
+}
+
+static inline size_t hash_combine(size_t seed, size_t val)
+{
+    return seed ^ (val + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+static size_t hash_node(const dag_node* node)
+{
+    size_t hash = (size_t) node->type;
+
+    switch (node->type)
+    {
+    case NODE_NUM:
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &node->value.num, sizeof(bits));
+        return hash_combine(hash, bits);
+    }
+    case NODE_VAR:
+        return hash_combine(hash, (size_t) node->value.var);
+    case NODE_OP:
+        hash = hash_combine(hash, (size_t) node->value.op);
+        hash = hash_combine(hash, node->left  ? node->left ->hash : 0);
+        hash = hash_combine(hash, node->right ? node->right->hash : 0);
+        return hash;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return 0);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return 0);
+}
+
+static int equal_nodes(const dag_node* node1, const dag_node* node2)
+{
+    if (node1->type != node2->type) return 0;
+
+    switch (node1->type)
+    {
+    case NODE_NUM:
+        return memcmp(&node1->value.num, &node2->value.num, sizeof(double)) == 0;
+    case NODE_VAR:
+        return node1->value.var == node2->value.var;
+    case NODE_OP:
+        return node1->value.op == node2->value.op
+            && node1->left  == node2->left
+            && node1->right == node2->right;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return 0);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return 0);
+}
+
+static size_t count_unvisited(const dag_node* node, char* visited)
+{
+    if (!node || visited[node->id]) return 0;
+
+    visited[node->id] = 1;
+    return 1 + count_unvisited(node->left, visited) + count_unvisited(node->right, visited);
+}
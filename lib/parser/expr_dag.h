@@ -0,0 +1,190 @@
+/**
+ * @file expr_dag.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Hash-consed expression graph with shared subexpressions
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Nodes of `expr_dag` are immutable and unique: structurally equal
+ * expressions are always represented by the same node, so equality of
+ * subexpressions is a pointer comparison.
+ */
+
+#ifndef EXPR_DAG_H
+#define EXPR_DAG_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+/**
+ * @brief Shared expression node
+ */
+struct dag_node
+{
+    /**
+     * @brief Node type
+     */
+    node_type type;
+    /**
+     * @brief Stored value
+     */
+    node_value value;
+
+    /**
+     * @brief Left operand, `NULL` for unary operations and leaves
+     */
+    const dag_node* left;
+    /**
+     * @brief Right operand, `NULL` for leaves
+     */
+    const dag_node* right;
+
+    /**
+     * @brief Structural hash, independent of node addresses
+     */
+    size_t hash;
+    /**
+     * @brief Sequential node index in its graph
+     */
+    size_t id;
+
+    /**
+     * @brief Next node in hash table bucket
+     */
+    dag_node* next;
+};
+
+struct dag_chunk;
+
+/**
+ * @brief Expression graph
+ */
+struct expr_dag
+{
+    /**
+     * @brief Hash table of all nodes
+     */
+    dag_node** buckets;
+    /**
+     * @brief Hash table size
+     */
+    size_t bucket_count;
+    /**
+     * @brief Number of nodes in graph
+     */
+    size_t size;
+    /**
+     * @brief Node storage
+     */
+    dag_chunk* chunks;
+};
+
+/**
+ * @brief Table of results computed for graph nodes, indexed by node id
+ */
+struct dag_memo
+{
+    const dag_node** results;
+    size_t capacity;
+};
+
+/* Node accessors. Type checks accept `NULL` and return 0 for it, getters
+ * require node of matching type. `num_cmp()` and `op_cmp()` check node type
+ * and value at once, numbers are compared with `compare_double()` */
+
+inline int is_num(const dag_node* node) { return node && node->type == NODE_NUM; }
+inline int is_var(const dag_node* node) { return node && node->type == NODE_VAR; }
+inline int is_op (const dag_node* node) { return node && node->type == NODE_OP;  }
+
+inline double   get_num(const dag_node* node) { return node->value.num; }
+inline var_name get_var(const dag_node* node) { return node->value.var; }
+inline op_type  get_op (const dag_node* node) { return node->value.op;  }
+
+inline int num_cmp(const dag_node* node, double num) { return is_num(node) && compare_double(get_num(node), num) == 0; }
+inline int op_cmp (const dag_node* node, op_type op) { return is_op(node) && get_op(node) == op; }
+
+/**
+ * @brief Create empty `expr_dag`
+ *
+ * @param[out] dag Constructed graph
+ */
+void dag_ctor(expr_dag* dag);
+
+/**
+ * @brief Destroy `expr_dag` and all its nodes
+ *
+ * @param[inout] dag `expr_dag` instance to be destroyed
+ */
+void dag_dtor(expr_dag* dag);
+
+/**
+ * @brief Get unique node for number constant
+ */
+const dag_node* dag_make_number(expr_dag* dag, double val);
+
+/**
+ * @brief Get unique node for variable
+ */
+const dag_node* dag_make_var(expr_dag* dag, var_name var);
+
+/**
+ * @brief Get unique node for binary operation
+ */
+const dag_node* dag_make_binary(expr_dag* dag, op_type op,
+                                const dag_node* left, const dag_node* right);
+
+/**
+ * @brief Get unique node for unary operation
+ */
+const dag_node* dag_make_unary(expr_dag* dag, op_type op, const dag_node* right);
+
+/**
+ * @brief Add tree to graph
+ *
+ * @param[inout] dag Expression graph
+ * @param[in] node Tree root
+ * @return Graph node, equal to tree
+ */
+const dag_node* dag_from_node(expr_dag* dag, const ast_node* node);
+
+/**
+ * @brief Expand graph node into tree. Nodes are allocated from current arena.
+ *
+ * @param[in] node Graph node
+ * @return Created tree
+ * @warning Resulting tree size is exponential in the number of nested
+ * shared subexpressions
+ */
+ast_node* dag_to_node(const dag_node* node);
+
+/**
+ * @brief Count distinct nodes reachable from graph node
+ */
+size_t dag_count_nodes(const expr_dag* dag, const dag_node* node);
+
+/**
+ * @brief Create empty `dag_memo`
+ */
+void dag_memo_ctor(dag_memo* memo);
+
+/**
+ * @brief Destroy `dag_memo`
+ */
+void dag_memo_dtor(dag_memo* memo);
+
+/**
+ * @brief Get result stored for node
+ *
+ * @return Stored result, `NULL` if there is none
+ */
+const dag_node* dag_memo_get(const dag_memo* memo, const dag_node* node);
+
+/**
+ * @brief Store result for node
+ */
+void dag_memo_set(dag_memo* memo, const dag_node* node, const dag_node* result);
+
+#endif
@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "flat_tree.h"
+
+static uint32_t add_node(flat_tree* tree, uint8_t kind, uint32_t left, uint32_t right);
+static int grow_nodes(flat_tree* tree);
+static void print_subtree(const flat_tree* tree, uint32_t node,
+                          const dynamic_array(var_name)* variables, string_builder* builder);
+
+void flat_tree_ctor(flat_tree* tree)
+{
+    LOG_ASSERT(tree != NULL, return);
+
+    *tree = {
+        .kinds          = NULL,
+        .left           = NULL,
+        .right          = NULL,
+        .size           = 0,
+        .capacity       = 0,
+        .constants      = NULL,
+        .const_count    = 0,
+        .const_capacity = 0
+    };
+}
+
+void flat_tree_dtor(flat_tree* tree)
+{
+    LOG_ASSERT(tree != NULL, return);
+
+    free(tree->kinds);
+    free(tree->left);
+    free(tree->right);
+    free(tree->constants);
+
+    *tree = {};
+}
+
+uint32_t flat_add_number(flat_tree* tree, double val)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+
+    if (tree->const_count == tree->const_capacity)
+    {
+        size_t capacity = tree->const_capacity ? tree->const_capacity * 2 : 64;
+        double* constants = (double*) realloc(tree->constants, capacity * sizeof(*constants));
+        LOG_ASSERT_ERROR(constants != NULL, return FLAT_NONE,
+            "Failed to allocate memory", NULL);
+
+        tree->constants      = constants;
+        tree->const_capacity = capacity;
+    }
+
+    uint32_t node = add_node(tree, FLAT_NUM, (uint32_t) tree->const_count, FLAT_NONE);
+    if (node != FLAT_NONE)
+        tree->constants[tree->const_count++] = val;
+
+    return node;
+}
+
+uint32_t flat_add_var(flat_tree* tree, size_t var_id)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+
+    return add_node(tree, FLAT_VAR, (uint32_t) var_id, FLAT_NONE);
+}
+
+uint32_t flat_add_binary(flat_tree* tree, op_type op, uint32_t left, uint32_t right)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+
+    if (left == FLAT_NONE || right == FLAT_NONE)
+        return FLAT_NONE;
+
+    return add_node(tree, (uint8_t) ((int) FLAT_OP + (int) op), left, right);
+}
+
+uint32_t flat_add_unary(flat_tree* tree, op_type op, uint32_t right)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+
+    if (right == FLAT_NONE)
+        return FLAT_NONE;
+
+    return add_node(tree, (uint8_t) ((int) FLAT_OP + (int) op), FLAT_NONE, right);
+}
+
+uint32_t flat_from_node(flat_tree* tree, const ast_node* node,
+                        const dynamic_array(var_name)* variables)
+{
+    LOG_ASSERT(tree != NULL, return FLAT_NONE);
+    LOG_ASSERT(node != NULL, return FLAT_NONE);
+
+    switch (node->type)
+    {
+    case NODE_NUM:
+        return flat_add_number(tree, get_num(node));
+    case NODE_VAR:
+    {
+        size_t var_id = 0;
+        LOG_ASSERT_ERROR(array_try_find_symbol(variables, get_var(node), &var_id),
+            return FLAT_NONE,
+            "Variable '%s' was not defined", symbol_name(get_var(node)));
+        return flat_add_var(tree, var_id);
+    }
+    case NODE_OP:
+        if (!node->left)
+            return flat_add_unary(tree, get_op(node),
+                                  flat_from_node(tree, node->right, variables));
+        else
+        {
+            /* Children must be added in order, so that layout is post-order */
+            uint32_t left = flat_from_node(tree, node->left, variables);
+            return flat_add_binary(tree, get_op(node), left,
+                                   flat_from_node(tree, node->right, variables));
+        }
+    default: LOG_ASSERT(0 && "Invalid enum value.", return FLAT_NONE);
+    }
+
+    LOG_ASSERT(0 && "Unreachable code", return FLAT_NONE);
+}
+
+ast_node* flat_to_node(const flat_tree* tree, uint32_t root,
+                       const dynamic_array(var_name)* variables)
+{
+    LOG_ASSERT(tree != NULL, return NULL);
+    LOG_ASSERT(root < tree->size, return NULL);
+
+    if (flat_is_num(tree, root))
+        return make_number_node(flat_get_num(tree, root));
+
+    if (flat_is_var(tree, root))
+        return make_var_node(variables->data[flat_get_var(tree, root)]);
+
+    ast_node* right = flat_to_node(tree, tree->right[root], variables);
+    if (tree->left[root] == FLAT_NONE)
+        return make_unary_node(flat_get_op(tree, root), right);
+
+    return make_binary_node(flat_get_op(tree, root),
+                            flat_to_node(tree, tree->left[root], variables), right);
+}
+
+void flat_find_depends(const flat_tree* tree, uint32_t root, size_t var_id, uint8_t* depends)
+{
+    LOG_ASSERT(tree != NULL, return);
+    LOG_ASSERT(depends != NULL, return);
+    LOG_ASSERT(root < tree->size, return);
+
+    for (uint32_t node = 0; node <= root; node++)
+    {
+        uint8_t kind = tree->kinds[node];
+        if (kind == FLAT_NUM)
+            depends[node] = 0;
+        else if (kind == FLAT_VAR)
+            depends[node] = tree->left[node] == var_id;
+        else if (tree->left[node] == FLAT_NONE)
+            depends[node] = depends[tree->right[node]];
+        else
+            depends[node] = depends[tree->left[node]] | depends[tree->right[node]];
+    }
+}
+
+void flat_find_reachable(const flat_tree* tree, uint32_t root, uint8_t* reachable)
+{
+    LOG_ASSERT(tree != NULL, return);
+    LOG_ASSERT(reachable != NULL, return);
+    LOG_ASSERT(root < tree->size, return);
+
+    memset(reachable, 0, root + 1);
+    reachable[root] = 1;
+
+    /* Parents precede children in reverse order */
+    for (uint32_t node = root + 1; node-- > 0;)
+    {
+        if (!reachable[node] || tree->kinds[node] < FLAT_OP)
+            continue;
+
+        if (tree->left[node] != FLAT_NONE)
+            reachable[tree->left[node]] = 1;
+        reachable[tree->right[node]] = 1;
+    }
+}
+
+size_t flat_count_nodes(const flat_tree* tree, uint32_t root)
+{
+    LOG_ASSERT(tree != NULL, return 0);
+    LOG_ASSERT(root < tree->size, return 0);
+
+    size_t* counts = (size_t*) calloc(root + 1, sizeof(*counts));
+    LOG_ASSERT_ERROR(counts != NULL, return 0, "Failed to allocate memory", NULL);
+
+    for (uint32_t node = 0; node <= root; node++)
+    {
+        counts[node] = 1;
+        if (tree->kinds[node] < FLAT_OP)
+            continue;
+
+        if (tree->left[node] != FLAT_NONE)
+            counts[node] += counts[tree->left[node]];
+        counts[node] += counts[tree->right[node]];
+    }
+
+    size_t result = counts[root];
+    free(counts);
+    return result;
+}
+
+void flat_print(const flat_tree* tree, uint32_t root,
+                const dynamic_array(var_name)* variables, string_builder* builder)
+{
+    LOG_ASSERT(tree != NULL, return);
+    LOG_ASSERT(builder != NULL, return);
+    LOG_ASSERT(root < tree->size, return);
+
+    string_builder_append(builder, "\\begin{equation}\n");
+    print_subtree(tree, root, variables, builder);
+    string_builder_append(builder, "\n\\end{equation}\n");
+}
+
+static uint32_t add_node(flat_tree* tree, uint8_t kind, uint32_t left, uint32_t right)
+{
+    if (tree->size == tree->capacity && grow_nodes(tree) != 0)
+        return FLAT_NONE;
+
+    LOG_ASSERT_ERROR(tree->size < FLAT_NONE, return FLAT_NONE,
+        "Too many nodes in tree", NULL);
+
+    tree->kinds[tree->size] = kind;
+    tree->left [tree->size] = left;
+    tree->right[tree->size] = right;
+
+    return (uint32_t) tree->size++;
+}
+
+static int grow_nodes(flat_tree* tree)
+{
+    size_t capacity = tree->capacity ? tree->capacity * 2 : 256;
+
+    /* Arrays are reallocated one by one, so that failure leaves tree valid */
+    uint8_t* kinds = (uint8_t*) realloc(tree->kinds, capacity * sizeof(*kinds));
+    if (kinds) tree->kinds = kinds;
+    uint32_t* left = kinds ? (uint32_t*) realloc(tree->left, capacity * sizeof(*left)) : NULL;
+    if (left) tree->left = left;
+    uint32_t* right = left ? (uint32_t*) realloc(tree->right, capacity * sizeof(*right)) : NULL;
+    if (right) tree->right = right;
+
+    LOG_ASSERT_ERROR(right != NULL, return -1, "Failed to allocate memory", NULL);
+
+    tree->capacity = capacity;
+    return 0;
+}
+
+static void print_subtree(const flat_tree* tree, uint32_t node,
+                          const dynamic_array(var_name)* variables, string_builder* builder)
+{
+    if (flat_is_num(tree, node))
+    {
+        string_builder_append_number(builder, flat_get_num(tree, node));
+        string_builder_append(builder, ' ');
+        return;
+    }
+    if (flat_is_var(tree, node))
+    {
+        string_builder_append(builder, symbol_name(variables->data[flat_get_var(tree, node)]));
+        string_builder_append(builder, ' ');
+        return;
+    }
+
+    op_type op = flat_get_op(tree, node);
+    uint32_t left  = tree->left [node];
+    uint32_t right = tree->right[node];
+
+    if (op == OP_DIV)
+    {
+        string_builder_append(builder, "\\frac{");
+        print_subtree(tree, left, variables, builder);
+        string_builder_append(builder, "}{");
+        print_subtree(tree, right, variables, builder);
+        string_builder_append(builder, "} ");
+        return;
+    }
+
+    int group = 0;
+    if (left != FLAT_NONE)
+    {
+        group = flat_is_op(tree, left)
+             && op_requires_grouping(op, flat_get_op(tree, left), 0);
+        if (group) string_builder_append(builder, "\\left( ");
+        print_subtree(tree, left, variables, builder);
+        if (group) string_builder_append(builder, "\\right) ");
+    }
+
+    print_op(op, builder);
+
+    if (op == OP_POW || op == OP_SQRT)
+    {
+        string_builder_append(builder, "{");
+        print_subtree(tree, right, variables, builder);
+        string_builder_append(builder, "} ");
+        return;
+    }
+
+    group = flat_is_op(tree, right)
+         && op_requires_grouping(op, flat_get_op(tree, right), 1);
+    if (group) string_builder_append(builder, "\\left( ");
+
+    print_subtree(tree, right, variables, builder);
+
+    if (group) string_builder_append(builder, "\\right) ");
+}
@@ -0,0 +1,190 @@
+/**
+ * @file flat_tree.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Expression trees stored in contiguous arrays
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Nodes are identified by their indices and stored as parallel
+ * arrays of kinds and child indices, constants are kept in separate pool.
+ * Children always precede their parents, so most algorithms are single
+ * pass over arrays instead of recursion. Nodes are never modified after
+ * creation, so subtrees may be shared by several parents and copying them
+ * is free.
+ */
+
+#ifndef FLAT_TREE_H
+#define FLAT_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+/**
+ * @brief Missing child or invalid node
+ */
+const uint32_t FLAT_NONE = UINT32_MAX;
+
+/**
+ * @brief Node kinds. Operation `op` has kind `FLAT_OP + op`.
+ */
+enum flat_kind
+{
+    FLAT_NUM,
+    FLAT_VAR,
+    FLAT_OP
+};
+
+struct flat_tree
+{
+    /**
+     * @brief Kinds of nodes
+     */
+    uint8_t*  kinds;
+    /**
+     * @brief Left children. Constant index for numbers, variable index for
+     * variables, `FLAT_NONE` for unary operations
+     */
+    uint32_t* left;
+    /**
+     * @brief Right children, `FLAT_NONE` for leaves
+     */
+    uint32_t* right;
+    size_t size;
+    size_t capacity;
+
+    double* constants;
+    size_t const_count;
+    size_t const_capacity;
+};
+
+/* Node accessors. `node` must be a valid index, getters require node of
+ * matching type. Numbers are read from `constants`, variables are returned
+ * as their index in array of variables, passed to `flat_from_node()` */
+
+inline int      flat_is_num(const flat_tree* tree, uint32_t node) { return tree->kinds[node] == FLAT_NUM; }
+inline int      flat_is_var(const flat_tree* tree, uint32_t node) { return tree->kinds[node] == FLAT_VAR; }
+inline int      flat_is_op (const flat_tree* tree, uint32_t node) { return tree->kinds[node] >= FLAT_OP;  }
+
+inline double   flat_get_num(const flat_tree* tree, uint32_t node) { return tree->constants[tree->left[node]]; }
+inline size_t   flat_get_var(const flat_tree* tree, uint32_t node) { return tree->left[node]; }
+inline op_type  flat_get_op (const flat_tree* tree, uint32_t node) { return (op_type) (tree->kinds[node] - FLAT_OP); }
+
+inline int      flat_op_cmp (const flat_tree* tree, uint32_t node, op_type op)
+{
+    return flat_is_op(tree, node) && flat_get_op(tree, node) == op;
+}
+
+/**
+ * @brief Create empty `flat_tree`
+ *
+ * @param[out] tree Constructed tree
+ */
+void flat_tree_ctor(flat_tree* tree);
+
+/**
+ * @brief Destroy `flat_tree`
+ *
+ * @param[inout] tree `flat_tree` instance to be destroyed
+ */
+void flat_tree_dtor(flat_tree* tree);
+
+/**
+ * @brief Add number node
+ *
+ * @return Node index, `FLAT_NONE` upon failure
+ */
+uint32_t flat_add_number(flat_tree* tree, double val);
+
+/**
+ * @brief Add variable node
+ *
+ * @param[in] var_id Index of variable in tree variables
+ * @return Node index, `FLAT_NONE` upon failure
+ */
+uint32_t flat_add_var(flat_tree* tree, size_t var_id);
+
+/**
+ * @brief Add binary operation node
+ *
+ * @return Node index, `FLAT_NONE` upon failure or if any child is `FLAT_NONE`
+ */
+uint32_t flat_add_binary(flat_tree* tree, op_type op, uint32_t left, uint32_t right);
+
+/**
+ * @brief Add unary operation node
+ *
+ * @return Node index, `FLAT_NONE` upon failure or if child is `FLAT_NONE`
+ */
+uint32_t flat_add_unary(flat_tree* tree, op_type op, uint32_t right);
+
+/**
+ * @brief Add copy of pointer-linked subtree
+ *
+ * @param[inout] tree Receiving tree
+ * @param[in] node Subtree root
+ * @param[in] variables Variables, whose indices are stored in tree
+ * @return Index of subtree root, `FLAT_NONE` upon failure
+ */
+uint32_t flat_from_node(flat_tree* tree, const ast_node* node,
+                        const dynamic_array(var_name)* variables);
+
+/**
+ * @brief Expand subtree into pointer-linked one. Nodes are allocated from
+ * current arena.
+ *
+ * @param[in] tree Flat tree
+ * @param[in] root Subtree root
+ * @param[in] variables Variables, whose indices are stored in tree
+ * @return Created tree
+ * @warning Shared subtrees are copied for every parent
+ */
+ast_node* flat_to_node(const flat_tree* tree, uint32_t root,
+                       const dynamic_array(var_name)* variables);
+
+/**
+ * @brief Find nodes, which depend on variable
+ *
+ * @param[in] tree Flat tree
+ * @param[in] root Last examined node
+ * @param[in] var_id Variable index
+ * @param[out] depends Array of at least `root + 1` flags, non-zero for
+ * nodes, which depend on variable
+ */
+void flat_find_depends(const flat_tree* tree, uint32_t root, size_t var_id, uint8_t* depends);
+
+/**
+ * @brief Find nodes of subtree
+ *
+ * @param[in] tree Flat tree
+ * @param[in] root Subtree root
+ * @param[out] reachable Array of at least `root + 1` flags, non-zero for
+ * nodes of subtree
+ */
+void flat_find_reachable(const flat_tree* tree, uint32_t root, uint8_t* reachable);
+
+/**
+ * @brief Count nodes in subtree as if it was not shared
+ *
+ * @param[in] tree Flat tree
+ * @param[in] root Subtree root
+ * @return Number of nodes in expanded subtree
+ */
+size_t flat_count_nodes(const flat_tree* tree, uint32_t root);
+
+/**
+ * @brief Output subtree to specified `string_builder` in LaTeX format.
+ * Unlike `print_node`, shared subexpressions are not extracted.
+ *
+ * @param[in] tree Flat tree
+ * @param[in] root Printed subtree
+ * @param[in] variables Variables, whose indices are stored in tree
+ * @param[in] builder Output string
+ */
+void flat_print(const flat_tree* tree, uint32_t root,
+                const dynamic_array(var_name)* variables, string_builder* builder);
+
+#endif
@@ -0,0 +1,301 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#include "formula_stream.h"
+#include "parser.h"
+
+static const size_t CHUNK_SIZE = 64 * 1024;
+static const size_t MIN_FORMULA_CAPACITY = 256;
+static const size_t MAX_FORMULA_LENGTH = 1024 * 1024;
+static const size_t RELEASE_STEP = 16 * 1024 * 1024;
+
+static void stream_init(formula_stream* stream, int fd, formula_format format);
+static int  fill(formula_stream* stream);
+static int  scan(formula_stream* stream);
+static void append(formula_stream* stream, char c);
+static abstract_syntax_tree* finish_formula(formula_stream* stream);
+static void release_mapping(formula_stream* stream);
+
+int formula_stream_open(formula_stream* stream, int fd, formula_format format)
+{
+    LOG_ASSERT(stream != NULL, return -1);
+    LOG_ASSERT(fd >= 0, return -1);
+
+    stream_init(stream, fd, format);
+    stream->buffer = (char*) calloc(CHUNK_SIZE, sizeof(char));
+    LOG_ASSERT_ERROR(stream->buffer && stream->formula,
+        { formula_stream_close(stream); return -1; },
+        "Failed to allocate memory", NULL);
+    stream->data = stream->buffer;
+
+    return 0;
+}
+
+int formula_stream_map(formula_stream* stream, const char* filename, formula_format format)
+{
+    LOG_ASSERT(stream != NULL, return -1);
+    LOG_ASSERT(filename != NULL, return -1);
+
+    stream_init(stream, -1, format);
+    LOG_ASSERT_ERROR(stream->formula, { formula_stream_close(stream); return -1; },
+        "Failed to allocate memory", NULL);
+
+    int fd = open(filename, O_RDONLY);
+    LOG_ASSERT_ERROR(fd >= 0, { formula_stream_close(stream); return -1; },
+        "Could not open file '%s'", filename);
+
+    struct stat info = {};
+    LOG_ASSERT_ERROR(fstat(fd, &info) == 0,
+        { close(fd); formula_stream_close(stream); return -1; },
+        "Could not get size of file '%s'", filename);
+
+    stream->mapped_size = (size_t) info.st_size;
+    if (stream->mapped_size > 0)
+    {
+        void* mapped = mmap(NULL, stream->mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        LOG_ASSERT_ERROR(mapped != MAP_FAILED,
+            { close(fd); formula_stream_close(stream); return -1; },
+            "Could not map file '%s'", filename);
+
+        stream->mapped = (char*) mapped;
+        madvise(stream->mapped, stream->mapped_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    /* Whole file is a single chunk */
+    stream->data = stream->mapped;
+    stream->size = stream->mapped_size;
+    stream->eof  = 1;
+
+    return 0;
+}
+
+void formula_stream_close(formula_stream* stream)
+{
+    LOG_ASSERT(stream != NULL, return);
+
+    if (stream->mapped)
+        munmap(stream->mapped, stream->mapped_size);
+    free(stream->buffer);
+    free(stream->formula);
+
+    *stream = {};
+    stream->fd = -1;
+}
+
+abstract_syntax_tree* formula_stream_next(formula_stream* stream)
+{
+    LOG_ASSERT(stream != NULL, return NULL);
+
+    while (true)
+    {
+        if (stream->pos == stream->size && fill(stream) <= 0)
+        {
+            if (stream->state == SCAN_FORMULA && stream->length > 0)
+            {
+                /* Formula is cut off by the end of input */
+                stream->state = SCAN_TEXT;
+                if (stream->format == FORMULA_LINES)
+                    return finish_formula(stream);
+
+                stream->count++;
+                stream->skipped++;
+                stream->length = 0;
+                LOG_ASSERT_ERROR(0, return NULL,
+                    "Formula %zu is not terminated", stream->count);
+            }
+            return NULL;
+        }
+
+        if (!scan(stream))
+            continue;
+
+        release_mapping(stream);
+
+        abstract_syntax_tree* tree = finish_formula(stream);
+        if (tree) return tree;
+    }
+}
+
+static void stream_init(formula_stream* stream, int fd, formula_format format)
+{
+    *stream = {
+        .fd          = fd,
+        .format      = format,
+        .state       = format == FORMULA_LINES ? SCAN_FORMULA : SCAN_TEXT,
+        .display     = 0,
+        .data        = NULL,
+        .size        = 0,
+        .pos         = 0,
+        .eof         = 0,
+        .buffer      = NULL,
+        .mapped      = NULL,
+        .mapped_size = 0,
+        .released    = 0,
+        .formula     = (char*) calloc(MIN_FORMULA_CAPACITY, sizeof(char)),
+        .length      = 0,
+        .capacity    = MIN_FORMULA_CAPACITY,
+        .too_long    = 0,
+        .count       = 0,
+        .skipped     = 0
+    };
+}
+
+/**
+ * @return Number of read bytes, 0 at the end of input, -1 upon error
+ */
+static int fill(formula_stream* stream)
+{
+    if (stream->eof) return 0;
+
+    ssize_t n_read = 0;
+    do
+        n_read = read(stream->fd, stream->buffer, CHUNK_SIZE);
+    while (n_read < 0 && errno == EINTR);
+
+    LOG_ASSERT_ERROR(n_read >= 0, { stream->eof = 1; return -1; },
+        "Could not read input: %s", strerror(errno));
+
+    stream->size = (size_t) n_read;
+    stream->pos  = 0;
+    if (n_read == 0) stream->eof = 1;
+
+    return (int) (n_read > 0);
+}
+
+/**
+ * @brief Scan current chunk until the end of formula
+ *
+ * @return 1 if formula ends in current chunk, 0 otherwise
+ */
+static int scan(formula_stream* stream)
+{
+    const char* data = stream->data;
+    char delimiter = stream->format == FORMULA_LINES ? '\n' : '$';
+
+    while (stream->pos < stream->size)
+    {
+        char c = data[stream->pos++];
+
+        switch (stream->state)
+        {
+        case SCAN_TEXT:
+            if      (c == '\\') stream->state = SCAN_TEXT_ESCAPE;
+            else if (c == '%')  stream->state = SCAN_TEXT_COMMENT;
+            else if (c == '$')  stream->state = SCAN_OPENING;
+            break;
+
+        case SCAN_TEXT_ESCAPE:
+            stream->state = SCAN_TEXT;
+            break;
+
+        case SCAN_TEXT_COMMENT:
+            /* Comment lasts until the end of line */
+            if (c == '\n') stream->state = SCAN_TEXT;
+            break;
+
+        case SCAN_OPENING:
+            stream->state   = SCAN_FORMULA;
+            stream->display = c == '$';
+            if (!stream->display) append(stream, c);
+            break;
+
+        case SCAN_FORMULA:
+            if (c != delimiter)
+            {
+                append(stream, c);
+                break;
+            }
+            if (stream->format == FORMULA_LATEX)
+                stream->state = stream->display ? SCAN_CLOSING : SCAN_TEXT;
+            if (stream->state != SCAN_CLOSING)
+                return 1;
+            break;
+
+        case SCAN_CLOSING:
+            /* Second '$' of "$$" */
+            stream->state = SCAN_TEXT;
+            if (c != '$') stream->pos--;
+            return 1;
+
+        default:
+            LOG_ASSERT(0 && "Invalid enum value.", return 0);
+        }
+    }
+
+    return 0;
+}
+
+static void append(formula_stream* stream, char c)
+{
+    if (stream->too_long) return;
+
+    if (stream->length + 1 >= stream->capacity)
+    {
+        char* grown = stream->capacity < MAX_FORMULA_LENGTH
+                    ? (char*) realloc(stream->formula, stream->capacity * 2)
+                    : NULL;
+        if (!grown)
+        {
+            stream->too_long = 1;
+            return;
+        }
+        stream->formula   = grown;
+        stream->capacity *= 2;
+    }
+
+    stream->formula[stream->length++] = c;
+}
+
+static abstract_syntax_tree* finish_formula(formula_stream* stream)
+{
+    stream->formula[stream->length] = '\0';
+    size_t length = stream->length;
+    int too_long  = stream->too_long;
+    stream->length   = 0;
+    stream->too_long = 0;
+
+    if (strspn(stream->formula, " \t\r\n") == length && !too_long)
+        return NULL;
+
+    stream->count++;
+    if (too_long)
+    {
+        stream->skipped++;
+        LOG_ASSERT_ERROR(0, return NULL,
+            "Formula %zu is longer than %zu bytes", stream->count, MAX_FORMULA_LENGTH);
+    }
+
+    abstract_syntax_tree* tree = build_tree(stream->formula);
+    if (!tree)
+    {
+        stream->skipped++;
+        LOG_ASSERT_ERROR(0, return NULL,
+            "Formula %zu is invalid: '%s'", stream->count, stream->formula);
+    }
+
+    return tree;
+}
+
+/**
+ * @brief Release pages of mapped file, which will not be read again, so that
+ * they do not accumulate in memory
+ */
+static void release_mapping(formula_stream* stream)
+{
+    if (!stream->mapped || stream->pos - stream->released < RELEASE_STEP)
+        return;
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t end  = stream->pos / page * page;
+
+    madvise(stream->mapped + stream->released, end - stream->released, MADV_DONTNEED);
+    stream->released = end;
+}
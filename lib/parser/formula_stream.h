@@ -0,0 +1,155 @@
+/**
+ * @file formula_stream.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Reading sequence of formulas from file
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Input is read in fixed-size chunks (or mapped and released behind
+ * the reading position), only the current formula is copied, so memory
+ * usage does not depend on input size.
+ */
+
+#ifndef FORMULA_STREAM_H
+#define FORMULA_STREAM_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+/**
+ * @brief Way formulas are separated in input
+ */
+enum formula_format
+{
+    /**
+     * @brief One formula per line, empty lines are skipped
+     */
+    FORMULA_LINES,
+    /**
+     * @brief Formulas are delimited by `$...$` or `$$...$$`, text outside
+     * of them and `%` comments are ignored
+     */
+    FORMULA_LATEX
+};
+
+/**
+ * @brief Scanner state, persistent between chunks
+ */
+enum formula_scan_state
+{
+    SCAN_TEXT,
+    SCAN_TEXT_ESCAPE,
+    SCAN_TEXT_COMMENT,
+    SCAN_OPENING,
+    SCAN_FORMULA,
+    SCAN_CLOSING
+};
+
+/**
+ * @brief Formula reader
+ */
+struct formula_stream
+{
+    /**
+     * @brief Input file descriptor, -1 for mapped files
+     */
+    int fd;
+    formula_format format;
+    formula_scan_state state;
+    /**
+     * @brief Whether current formula is delimited by `$$`
+     */
+    int display;
+
+    /**
+     * @brief Current chunk of input
+     */
+    const char* data;
+    /**
+     * @brief Number of bytes in current chunk
+     */
+    size_t size;
+    /**
+     * @brief Offset of first unread byte in current chunk
+     */
+    size_t pos;
+    /**
+     * @brief Whether input is exhausted
+     */
+    int eof;
+
+    /**
+     * @brief Chunk buffer for file descriptors
+     */
+    char* buffer;
+
+    /**
+     * @brief Mapped file, `NULL` for file descriptors
+     */
+    char* mapped;
+    size_t mapped_size;
+    /**
+     * @brief Size of already released prefix of mapping
+     */
+    size_t released;
+
+    /**
+     * @brief Text of current formula
+     */
+    char* formula;
+    size_t length;
+    size_t capacity;
+    /**
+     * @brief Whether current formula exceeds maximal length
+     */
+    int too_long;
+
+    /**
+     * @brief Number of formulas found in input
+     */
+    size_t count;
+    /**
+     * @brief Number of formulas skipped because of errors
+     */
+    size_t skipped;
+};
+
+/**
+ * @brief Read formulas from file descriptor
+ *
+ * @param[out] stream Constructed stream
+ * @param[in] fd Input file descriptor. Not closed by stream.
+ * @param[in] format Formula separation
+ * @return 0 upon success, -1 otherwise
+ */
+int formula_stream_open(formula_stream* stream, int fd, formula_format format);
+
+/**
+ * @brief Read formulas from mapped file
+ *
+ * @param[out] stream Constructed stream
+ * @param[in] filename Input file name
+ * @param[in] format Formula separation
+ * @return 0 upon success, -1 otherwise
+ */
+int formula_stream_map(formula_stream* stream, const char* filename, formula_format format);
+
+/**
+ * @brief Destroy stream
+ *
+ * @param[inout] stream `formula_stream` instance to be destroyed
+ */
+void formula_stream_close(formula_stream* stream);
+
+/**
+ * @brief Parse next formula. Invalid formulas are reported and skipped.
+ *
+ * @param[inout] stream Formula stream
+ * @return Parsed formula, owned by caller. `NULL` at the end of input.
+ */
+abstract_syntax_tree* formula_stream_next(formula_stream* stream);
+
+#endif
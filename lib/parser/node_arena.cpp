@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+#include "ast.h"
+#include "node_arena.h"
+
+/* Chunks are aligned to their size, so that chunk header can be found
+ * from any node address */
+static const size_t CHUNK_BYTES = 16384;
+
+struct node_chunk
+{
+    node_arena* owner;
+    node_chunk* prev;
+    size_t      used;
+};
+
+static const size_t CHUNK_CAPACITY =
+                        (CHUNK_BYTES - sizeof(node_chunk)) / sizeof(ast_node);
+
+/**
+ * @brief Default arena of thread, destroyed when thread exits
+ */
+struct thread_arena
+{
+    node_arena arena;
+
+    ~thread_arena();
+};
+
+static thread_local thread_arena default_arena_ = {};
+static thread_local node_arena*  current_arena_ = NULL;
+
+static inline ast_node* get_chunk_nodes(node_chunk* chunk)
+{
+    return (ast_node*) (chunk + 1);
+}
+
+static inline node_chunk* get_owner_chunk(ast_node* node)
+{
+    return (node_chunk*) ((uintptr_t) node & ~(CHUNK_BYTES - 1));
+}
+
+static int add_chunk(node_arena* arena)
+{
+    node_chunk* chunk = (node_chunk*) aligned_alloc(CHUNK_BYTES, CHUNK_BYTES);
+    LOG_ASSERT_ERROR(chunk != NULL, return -1,
+                    "Failed to allocate node chunk", NULL);
+
+    *chunk = {
+        .owner = arena,
+        .prev  = arena->chunks,
+        .used  = 0
+    };
+    arena->chunks = chunk;
+    return 0;
+}
+
+void node_arena_ctor(node_arena* arena)
+{
+    LOG_ASSERT(arena != NULL, return);
+
+    *arena = {
+        .chunks = NULL,
+        .free_list = NULL
+    };
+}
+
+void node_arena_dtor(node_arena* arena)
+{
+    LOG_ASSERT(arena != NULL, return);
+
+    /* Destroyed arena must not stay in use */
+    if (arena == current_arena_)
+        node_arena_use(NULL);
+
+    node_chunk* chunk = arena->chunks;
+    while (chunk)
+    {
+        node_chunk* prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+
+    *arena = {};
+}
+
+ast_node* node_arena_alloc(node_arena* arena)
+{
+    LOG_ASSERT(arena != NULL, return NULL);
+
+    if (arena->free_list)
+    {
+        ast_node* node = arena->free_list;
+        arena->free_list = node->parent;
+        return node;
+    }
+
+    if (!arena->chunks || arena->chunks->used == CHUNK_CAPACITY)
+        LOG_ASSERT(add_chunk(arena) == 0, return NULL);
+
+    return get_chunk_nodes(arena->chunks) + arena->chunks->used++;
+}
+
+ast_node* node_arena_alloc_run(node_arena* arena, size_t max_count, size_t* count)
+{
+    LOG_ASSERT(arena != NULL, return NULL);
+    LOG_ASSERT(count != NULL, return NULL);
+    LOG_ASSERT(max_count > 0, return NULL);
+
+    /* Free list is bypassed, since its nodes are scattered */
+    if (!arena->chunks || arena->chunks->used == CHUNK_CAPACITY)
+        LOG_ASSERT(add_chunk(arena) == 0, return NULL);
+
+    node_chunk* chunk = arena->chunks;
+    size_t available = CHUNK_CAPACITY - chunk->used;
+    *count = max_count < available ? max_count : available;
+
+    ast_node* run = get_chunk_nodes(chunk) + chunk->used;
+    chunk->used += *count;
+    return run;
+}
+
+void node_arena_free(ast_node* node)
+{
+    LOG_ASSERT(node != NULL, return);
+
+    node_arena* arena = get_owner_chunk(node)->owner;
+
+    node->parent = arena->free_list;
+    arena->free_list = node;
+}
+
+void node_arena_merge(node_arena* arena, node_arena* other)
+{
+    LOG_ASSERT(arena != NULL, return);
+    LOG_ASSERT(other != NULL, return);
+    LOG_ASSERT(arena != other, return);
+
+    if (!other->chunks) return;
+
+    node_chunk* last = other->chunks;
+    last->owner = arena;
+    while (last->prev)
+    {
+        last = last->prev;
+        last->owner = arena;
+    }
+
+    /* Merged chunks go after the current one, which is still used for
+       allocation */
+    if (arena->chunks)
+    {
+        last->prev = arena->chunks->prev;
+        arena->chunks->prev = other->chunks;
+    }
+    else
+        arena->chunks = other->chunks;
+
+    if (other->free_list)
+    {
+        ast_node* free_last = other->free_list;
+        while (free_last->parent)
+            free_last = free_last->parent;
+        free_last->parent = arena->free_list;
+        arena->free_list  = other->free_list;
+    }
+
+    *other = {};
+}
+
+node_arena* node_arena_use(node_arena* arena)
+{
+    node_arena* prev = node_arena_current();
+    current_arena_ = arena;
+    return prev;
+}
+
+node_arena* node_arena_current(void)
+{
+    return current_arena_ ? current_arena_ : &default_arena_.arena;
+}
+
+thread_arena::~thread_arena()
+{
+    node_arena_dtor(&arena);
+}
@@ -0,0 +1,105 @@
+/**
+ * @file node_arena.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Chunked allocator for syntax tree nodes
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Nodes are bump-allocated from large aligned chunks. Every chunk
+ * knows its arena, so freed nodes always return to the free list of the
+ * arena they were allocated from. Memory is returned to system only when
+ * the whole arena is destroyed.
+ */
+
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+#include <stddef.h>
+
+struct ast_node;
+struct node_chunk;
+
+/**
+ * @brief Node allocator
+ * @warning Arena MUST NOT be moved after construction
+ */
+struct node_arena
+{
+    /**
+     * @brief Most recently allocated chunk
+     */
+    node_chunk* chunks;
+    /**
+     * @brief Freed nodes available for reuse
+     */
+    ast_node*   free_list;
+};
+
+/**
+ * @brief Create empty `node_arena`
+ *
+ * @param[out] arena Constructed arena
+ */
+void node_arena_ctor(node_arena* arena);
+
+/**
+ * @brief Destroy `node_arena`, releasing all nodes allocated from it at once
+ *
+ * @param[inout] arena `node_arena` instance to be destroyed
+ */
+void node_arena_dtor(node_arena* arena);
+
+/**
+ * @brief Allocate uninitialized node
+ *
+ * @param[inout] arena Arena used for allocation
+ * @return Allocated node, `NULL` upon failure
+ */
+ast_node* node_arena_alloc(node_arena* arena);
+
+/**
+ * @brief Allocate contiguous run of uninitialized nodes. Run ends at the
+ * end of current chunk, so it may be shorter than requested.
+ *
+ * @param[inout] arena Arena used for allocation
+ * @param[in] max_count Maximal number of allocated nodes
+ * @param[out] count Number of allocated nodes
+ * @return First allocated node, `NULL` upon failure
+ */
+ast_node* node_arena_alloc_run(node_arena* arena, size_t max_count, size_t* count);
+
+/**
+ * @brief Return node to the arena it was allocated from
+ *
+ * @param[in] node Freed node
+ */
+void node_arena_free(ast_node* node);
+
+/**
+ * @brief Move all nodes of one arena to another, so that they are released
+ * together with it
+ *
+ * @param[inout] arena Receiving arena
+ * @param[inout] other Merged arena, empty after call
+ */
+void node_arena_merge(node_arena* arena, node_arena* other);
+
+/**
+ * @brief Make arena used by `make_node` in current thread
+ *
+ * @param[in] arena Used arena, `NULL` selects thread default arena. Default
+ * arena is destroyed when thread exits, along with all of its nodes
+ * @return Previously used arena
+ */
+node_arena* node_arena_use(node_arena* arena);
+
+/**
+ * @brief Get arena used by `make_node` in current thread
+ *
+ * @return Current arena. Never `NULL`
+ */
+node_arena* node_arena_current(void);
+
+#endif
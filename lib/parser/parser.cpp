@@ -6,8 +6,9 @@
 
 struct parsing_state
 {
-    const dynamic_array(token)* tokens;
-    size_t pos;
+    lexer lex;
+    token current;
+    token last;
     dynamic_array(var_name)* variables;
 };
 
@@ -21,41 +22,47 @@ static ast_node* parse_atom(parsing_state* state);
 
 static inline token* current_token(parsing_state* state)
 {
-    return array_get_element(state->tokens, state->pos);
+    return &state->current;
 }
 
 static inline token* last_token(parsing_state* state)
 {
-    return array_get_element(state->tokens, state->pos - 1);
+    return &state->last;
 }
 
 static inline void advance(parsing_state* state)
 {
-    state->pos++;
-}
-
-static inline token* consume(parsing_state* state, token_type expected)
-{
-    token* cur = current_token(state);
-    if (cur->type == expected)
-        advance(state);
-    return cur;
+    /* Tokens are only read when parser needs them */
+    state->last = state->current;
+    state->current = lexer_next(&state->lex);
 }
 
 static inline int consume_check(parsing_state* state, token_type expected)
 {
-    return consume(state, expected)->type == expected;
+    if (current_token(state)->type != expected)
+        return 0;
+    advance(state);
+    return 1;
 }
 
-abstract_syntax_tree* build_tree(const dynamic_array(token)* tokens)
+abstract_syntax_tree* build_tree(const char* str)
 {
+    LOG_ASSERT(str != NULL, return NULL);
+
     abstract_syntax_tree* ast = tree_ctor();
     parsing_state state = {
-        .tokens    = tokens,
-        .pos       = 0,
+        .lex       = {},
+        .current   = {},
+        .last      = {},
         .variables = &ast->variables
     };
+    lexer_ctor(&state.lex, str);
+    state.current = lexer_next(&state.lex);
+
+    node_arena* prev_arena = node_arena_use(&ast->arena);
     ast->root = parse_expression(&state);
+    node_arena_use(prev_arena);
+
     LOG_ASSERT(ast->root,
     {
         tree_dtor(ast);
@@ -72,13 +79,15 @@ abstract_syntax_tree* build_tree(const dynamic_array(token)* tokens)
 static ast_node* parse_expression(parsing_state* state)
 {
     ast_node* left = parse_product(state);
+    if (!left) return NULL;
+
     while(consume_check(state, TOK_PLUS) || consume_check(state, TOK_MINUS))
     {
-        token* tok = last_token(state);
+        token_type op = last_token(state)->type;
         ast_node* right = parse_product(state);
         LOG_ASSERT(right != NULL, return NULL);
 
-        if (tok->type == TOK_PLUS)
+        if (op == TOK_PLUS)
             left = make_binary_node(OP_ADD, left, right);
         else
             left = make_binary_node(OP_SUB, left, right);
@@ -89,6 +98,8 @@ static ast_node* parse_expression(parsing_state* state)
 static ast_node * parse_product(parsing_state * state)
 {
     ast_node* left = parse_unary(state);
+    if (!left) return NULL;
+
     while(consume_check(state, TOK_CDOT))   /* TODO: handle implicit multiplication */
     {
         ast_node* right = parse_unary(state);
@@ -103,13 +114,16 @@ ast_node * parse_unary(parsing_state * state)
     #define MATH_FUNC(name, ...)                                    \
         case TOK_##name:                                            \
             advance(state);                                         \
-            return make_unary_node(OP_##name, parse_unary(state));
+            arg = parse_unary(state);                               \
+            return arg ? make_unary_node(OP_##name, arg) : NULL;
 
+    ast_node* arg = NULL;
     switch (current_token(state)->type)
     {
     case TOK_MINUS:
         advance(state);
-        return make_unary_node(OP_NEG, parse_unary(state));
+        arg = parse_unary(state);
+        return arg ? make_unary_node(OP_NEG, arg) : NULL;
 
     #include "functions.h"
     
@@ -129,6 +143,7 @@ ast_node * parse_fraction(parsing_state * state)
         "Expected '{' after '\\frac'", NULL);
     
     ast_node* left = parse_expression(state);
+    if (!left) return NULL;
 
     LOG_ASSERT_ERROR(consume_check(state, TOK_RBRACKET),
         {delete_subtree(left); return NULL;},
@@ -139,6 +154,7 @@ ast_node * parse_fraction(parsing_state * state)
         "Expected '{' before second argument of '\\frac'", NULL);
 
     ast_node* right = parse_expression(state);
+    if (!right) return NULL;
 
     LOG_ASSERT_ERROR(consume_check(state, TOK_RBRACKET),
         {delete_subtree(left); delete_subtree(right); return NULL;},
@@ -151,10 +167,17 @@ ast_node * parse_power(parsing_state * state)
 {
     ast_node* left = parse_group(state);
 
-    if (consume_check(state, TOK_CARET))
-        return make_binary_node(OP_POW, left, parse_power(state));
-    
-    return left;
+    if (!left || !consume_check(state, TOK_CARET))
+        return left;
+
+    /* Sign is not a part of number, but "x^-1" is still a power */
+    int negate = consume_check(state, TOK_MINUS);
+
+    ast_node* right = parse_power(state);
+    if (!right) return NULL;
+    if (negate) right = make_unary_node(OP_NEG, right);
+
+    return make_binary_node(OP_POW, left, right);
 }
 
 ast_node * parse_group(parsing_state * state)
@@ -165,6 +188,7 @@ ast_node * parse_group(parsing_state * state)
     token_type left_paren = last_token(state)->type;
 
     ast_node* expr = parse_expression(state);
+    if (!expr) return NULL;
 
     token_type right_paren = left_paren == TOK_LBRACKET ? TOK_RBRACKET : TOK_RPAREN;
 
@@ -182,11 +206,16 @@ ast_node * parse_atom(parsing_state * state)
     
     if (consume_check(state, TOK_VAR))
     {
-        var_name name = last_token(state)->value.name;
+        token_view view = last_token(state)->value.name;
+        const char* name = state->lex.str + view.offset;
         size_t var_id = 0;
-        if (!array_try_find_variable(state->variables, name, &var_id))
+        if (!array_try_find_variable_n(state->variables, name, view.length, &var_id))
         {
-            array_push(state->variables, name);
+            /* Only the first occurrence of variable is interned */
+            var_name var = symbol_intern_n(name, view.length);
+            LOG_ASSERT_ERROR(var != SYMBOL_NONE, return NULL,
+                "Failed to allocate memory", NULL);
+            array_push(state->variables, var);
             var_id = state->variables->size - 1;
         }
         return make_var_node(*array_get_element(state->variables, var_id));
@@ -1,15 +1,16 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include "token_array.h"
+#include "lexer.h"
 
 #include "ast.h"
 
 /**
- * @brief Build abstract syntax tree from list of tokens
- * @param[in] tokens Token list
+ * @brief Build abstract syntax tree from string. String is lexed lazily,
+ * while it is parsed.
+ * @param[in] str Parsed string
  * @return Built AST
  */
-abstract_syntax_tree* build_tree(const dynamic_array(token)* tokens);
+abstract_syntax_tree* build_tree(const char* str);
 
 #endif
\ No newline at end of file
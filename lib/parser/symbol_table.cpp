@@ -0,0 +1,171 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "symbol_table.h"
+
+/**
+ * @brief Names are stored in chunks, which never move, so that names of
+ * existing symbols may be read while table grows. Directory of chunks is
+ * allocated with the first symbol and never moves either
+ */
+static const size_t CHUNK_SIZE  = 1024;
+static const size_t CHUNK_COUNT = 4096;
+
+static const size_t MIN_CAPACITY = 64;
+
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static char***  name_chunks = NULL;
+static size_t   symbol_count = 0;
+
+/**
+ * @brief Open addressing hash table of symbol ids, `SYMBOL_NONE` marks
+ * empty buckets
+ */
+static var_name* buckets = NULL;
+static size_t    bucket_capacity = 0;
+
+static size_t hash_name(const char* name, size_t length);
+static size_t find_bucket(const char* name, size_t length, size_t hash);
+static var_name add_symbol(const char* name, size_t length, size_t bucket);
+static int grow_buckets(void);
+
+var_name symbol_intern(const char* name)
+{
+    LOG_ASSERT(name != NULL, return SYMBOL_NONE);
+
+    return symbol_intern_n(name, strlen(name));
+}
+
+var_name symbol_intern_n(const char* name, size_t length)
+{
+    LOG_ASSERT(name != NULL, return SYMBOL_NONE);
+
+    size_t hash = hash_name(name, length);
+
+    pthread_mutex_lock(&table_lock);
+
+    var_name symbol = SYMBOL_NONE;
+    if (2 * (symbol_count + 1) <= bucket_capacity || grow_buckets() == 0)
+    {
+        size_t bucket = find_bucket(name, length, hash);
+        symbol = buckets[bucket];
+        if (symbol == SYMBOL_NONE)
+            symbol = add_symbol(name, length, bucket);
+    }
+
+    pthread_mutex_unlock(&table_lock);
+    return symbol;
+}
+
+var_name symbol_find(const char* name)
+{
+    LOG_ASSERT(name != NULL, return SYMBOL_NONE);
+
+    return symbol_find_n(name, strlen(name));
+}
+
+var_name symbol_find_n(const char* name, size_t length)
+{
+    LOG_ASSERT(name != NULL, return SYMBOL_NONE);
+
+    size_t hash = hash_name(name, length);
+
+    pthread_mutex_lock(&table_lock);
+
+    var_name symbol = SYMBOL_NONE;
+    if (bucket_capacity > 0)
+        symbol = buckets[find_bucket(name, length, hash)];
+
+    pthread_mutex_unlock(&table_lock);
+    return symbol;
+}
+
+const char* symbol_name(var_name symbol)
+{
+    LOG_ASSERT(symbol != SYMBOL_NONE, return NULL);
+
+    /* Symbol was obtained after its name was stored, no locking needed */
+    return name_chunks[symbol / CHUNK_SIZE][symbol % CHUNK_SIZE];
+}
+
+static size_t hash_name(const char* name, size_t length)
+{
+    size_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) name[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static size_t find_bucket(const char* name, size_t length, size_t hash)
+{
+    size_t mask = bucket_capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        if (buckets[i] == SYMBOL_NONE)
+            return i;
+
+        const char* stored = symbol_name(buckets[i]);
+        if (strncmp(stored, name, length) == 0 && stored[length] == '\0')
+            return i;
+    }
+}
+
+static var_name add_symbol(const char* name, size_t length, size_t bucket)
+{
+    size_t chunk = symbol_count / CHUNK_SIZE;
+    LOG_ASSERT_ERROR(chunk < CHUNK_COUNT, return SYMBOL_NONE,
+        "Too many variables", NULL);
+
+    if (!name_chunks)
+    {
+        name_chunks = (char***) calloc(CHUNK_COUNT, sizeof(*name_chunks));
+        LOG_ASSERT_ERROR(name_chunks != NULL, return SYMBOL_NONE,
+            "Failed to allocate memory", NULL);
+    }
+
+    if (!name_chunks[chunk])
+    {
+        name_chunks[chunk] = (char**) calloc(CHUNK_SIZE, sizeof(*name_chunks[chunk]));
+        LOG_ASSERT_ERROR(name_chunks[chunk] != NULL, return SYMBOL_NONE,
+            "Failed to allocate memory", NULL);
+    }
+
+    char* copy = strndup(name, length);
+    LOG_ASSERT_ERROR(copy != NULL, return SYMBOL_NONE,
+        "Failed to allocate memory", NULL);
+
+    var_name symbol = (var_name) symbol_count++;
+    name_chunks[chunk][symbol % CHUNK_SIZE] = copy;
+    buckets[bucket] = symbol;
+
+    return symbol;
+}
+
+static int grow_buckets(void)
+{
+    size_t capacity = bucket_capacity ? bucket_capacity * 2 : MIN_CAPACITY;
+
+    var_name* new_buckets = (var_name*) malloc(capacity * sizeof(*new_buckets));
+    LOG_ASSERT_ERROR(new_buckets != NULL, return -1,
+        "Failed to allocate memory", NULL);
+    memset(new_buckets, 0xFF, capacity * sizeof(*new_buckets));
+
+    free(buckets);
+    buckets         = new_buckets;
+    bucket_capacity = capacity;
+
+    for (size_t i = 0; i < symbol_count; i++)
+    {
+        const char* name = symbol_name((var_name) i);
+        size_t length = strlen(name);
+        buckets[find_bucket(name, length, hash_name(name, length))] = (var_name) i;
+    }
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file symbol_table.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Global table of interned variable names
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Every distinct name receives small integer id, ids are assigned
+ * sequentially from 0 and are never released, so equal names always have
+ * equal ids. Interning is thread-safe, name lookup by id does not lock.
+ */
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Interned variable name
+ */
+typedef uint32_t var_name;
+
+/**
+ * @brief Invalid symbol
+ */
+const var_name SYMBOL_NONE = UINT32_MAX;
+
+/**
+ * @brief Get id of name, adding name to table if needed
+ *
+ * @param[in] name Null-terminated name
+ * @return Symbol id, `SYMBOL_NONE` upon failure
+ */
+var_name symbol_intern(const char* name);
+
+/**
+ * @brief Get id of first `length` characters of name, adding it to table if
+ * needed
+ *
+ * @param[in] name Name, not necessarily null-terminated
+ * @param[in] length Name length
+ * @return Symbol id, `SYMBOL_NONE` upon failure
+ */
+var_name symbol_intern_n(const char* name, size_t length);
+
+/**
+ * @brief Get id of name without adding it to table
+ *
+ * @param[in] name Null-terminated name
+ * @return Symbol id, `SYMBOL_NONE` if name was never interned
+ */
+var_name symbol_find(const char* name);
+
+/**
+ * @brief Get id of first `length` characters of name without adding it
+ * to table
+ *
+ * @param[in] name Name, not necessarily null-terminated
+ * @param[in] length Name length
+ * @return Symbol id, `SYMBOL_NONE` if name was never interned
+ */
+var_name symbol_find_n(const char* name, size_t length);
+
+/**
+ * @brief Get name of symbol
+ *
+ * @param[in] symbol Symbol id
+ * @return Null-terminated name, valid until program exit
+ */
+const char* symbol_name(var_name symbol);
+
+#endif
@@ -1,16 +1,42 @@
 #include "var_name_array.h"
 
-#define ARRAY_ELEMENT var_name
-
-#include "dynamic_array_impl.h"
+/* Arrays are short, so names are compared directly instead of locking
+   symbol table */
 
 int array_try_find_variable(const dynamic_array(var_name)* array, const char* var, size_t* var_id)
 {
     for (size_t i = 0; i < array->size; i++)
-        if (strcmp(*array_get_element(array, i), var) == 0)
+        if (strcmp(symbol_name(*array_get_element(array, i)), var) == 0)
+        {
+            if (var_id) *var_id = i;
+            return 1;
+        }
+    return 0;
+}
+
+int array_try_find_variable_n(const dynamic_array(var_name)* array, const char* var,
+                              size_t length, size_t* var_id)
+{
+    for (size_t i = 0; i < array->size; i++)
+    {
+        const char* name = symbol_name(*array_get_element(array, i));
+        if (strncmp(name, var, length) == 0 && name[length] == '\0')
+        {
+            if (var_id) *var_id = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int array_try_find_symbol(const dynamic_array(var_name)* array, var_name var,
+                          size_t* var_id)
+{
+    for (size_t i = 0; i < array->size; i++)
+        if (*array_get_element(array, i) == var)
         {
             if (var_id) *var_id = i;
             return 1;
         }
     return 0;
-}
\ No newline at end of file
+}
@@ -5,14 +5,11 @@
 #include <string.h>
 #include <stdlib.h>
 
-typedef char* var_name;
+#include "symbol_table.h"
+#include "typed_array.h"
 
-#define ARRAY_ELEMENT var_name
-
-inline void copy_element(ARRAY_ELEMENT* dest, const ARRAY_ELEMENT* src) { *dest = strdup(*src); }
-inline void delete_element(ARRAY_ELEMENT* element) { free(*element); *element = NULL; }
-
-#include "dynamic_array.h"
+/* Most expressions have only a few variables */
+typedef typed_array<var_name, 4> dynamic_array(var_name);
 
 /**
  * @brief Attempt to find variable by its name
@@ -24,6 +21,27 @@ inline void delete_element(ARRAY_ELEMENT* element) { free(*element); *element =
  */
 int array_try_find_variable(const dynamic_array(var_name)* array, const char* var, size_t* var_id = NULL);
 
-#undef ARRAY_ELEMENT
+/**
+ * @brief Attempt to find variable by first `length` characters of its name
+ * 
+ * @param[in] array Array, containing variable name
+ * @param[in] var Variable name, not necessarily null-terminated
+ * @param[in] length Variable name length
+ * @param[out] var_id Variable id. Ignored if set to `NULL`
+ * @return 0 if variable with given name does not, non-zero otherwise
+ */
+int array_try_find_variable_n(const dynamic_array(var_name)* array, const char* var,
+                              size_t length, size_t* var_id = NULL);
+
+/**
+ * @brief Attempt to find interned variable
+ * 
+ * @param[in] array Array, containing variable
+ * @param[in] var Variable symbol
+ * @param[out] var_id Variable id. Ignored if set to `NULL`
+ * @return 0 if variable is not in array, non-zero otherwise
+ */
+int array_try_find_symbol(const dynamic_array(var_name)* array, var_name var,
+                          size_t* var_id = NULL);
 
 #endif
\ No newline at end of file
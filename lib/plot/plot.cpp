@@ -0,0 +1,308 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "logger.h"
+
+#include "bytecode.h"
+#include "plot.h"
+#include "png.h"
+#include "raster.h"
+#include "sampler.h"
+
+static const size_t IMAGE_WIDTH  = 640;
+static const size_t IMAGE_HEIGHT = 480;
+
+static const long MARGIN_LEFT   = 70;
+static const long MARGIN_RIGHT  = 20;
+static const long MARGIN_TOP    = 20;
+static const long MARGIN_BOTTOM = 30;
+
+/**
+ * @brief Initial samples per pixel column
+ */
+static const size_t SAMPLES_PER_PIXEL = 4;
+/**
+ * @brief Allowed deviation of curve from straight line, in pixels
+ */
+static const double TOLERANCE_PIXELS = 0.25;
+/**
+ * @brief Intervals are not bisected below this fraction of pixel
+ */
+static const double MIN_STEP_PIXELS = 1.0 / 256;
+
+static const size_t TICK_COUNT = 8;
+static const size_t MAX_TICKS  = 32;
+static const long TICK_LENGTH = 5;
+
+static const plot_color BACKGROUND_COLOR = {255, 255, 255};
+static const plot_color GRID_COLOR       = {220, 220, 220};
+static const plot_color FRAME_COLOR      = {  0,   0,   0};
+static const plot_color FUNC_COLOR       = {148,   0, 211};
+static const plot_color TANGENT_COLOR    = {  0, 158, 115};
+
+/**
+ * @brief Mapping from function coordinates to pixels
+ */
+struct plot_view
+{
+    double x_min;
+    double x_max;
+    double y_min;
+    double y_max;
+
+    long left;
+    long top;
+    long width;
+    long height;
+};
+
+static int  sample_curve(const abstract_syntax_tree* tree, plot_view* view, int fit_range,
+                         dynamic_array(plot_point)* points);
+static void fit_value_range(plot_view* view, const dynamic_array(plot_point)* samples);
+static void draw_curve (raster* image, const plot_view* view,
+                        const dynamic_array(plot_point)* points, plot_color color);
+static void draw_grid  (raster* image, const plot_view* view);
+static void draw_frame (raster* image, const plot_view* view);
+static void draw_legend(raster* image, const plot_view* view, long row,
+                        const char* title, plot_color color);
+static size_t make_ticks(double min, double max, double* ticks);
+
+static inline double to_pixel_x(const plot_view* view, double x)
+{
+    return (double) view->left
+         + (x - view->x_min) / (view->x_max - view->x_min) * (double) (view->width - 1);
+}
+
+static inline double to_pixel_y(const plot_view* view, double y)
+{
+    return (double) view->top
+         + (view->y_max - y) / (view->y_max - view->y_min) * (double) (view->height - 1);
+}
+
+int plot_tangent(const abstract_syntax_tree* func,
+                 const abstract_syntax_tree* tangent,
+                 const char* filename,
+                 double range_left,
+                 double range_right)
+{
+    LOG_ASSERT(func != NULL, return -1);
+    LOG_ASSERT(tangent != NULL, return -1);
+    LOG_ASSERT(filename != NULL, return -1);
+    LOG_ASSERT_ERROR(isless(range_left, range_right), return -1,
+        "Invalid plot range [%lg, %lg]", range_left, range_right);
+
+    plot_view view = {
+        .x_min  = range_left,
+        .x_max  = range_right,
+        .y_min  = -1,
+        .y_max  =  1,
+        .left   = MARGIN_LEFT,
+        .top    = MARGIN_TOP,
+        .width  = (long) IMAGE_WIDTH  - MARGIN_LEFT - MARGIN_RIGHT,
+        .height = (long) IMAGE_HEIGHT - MARGIN_TOP  - MARGIN_BOTTOM
+    };
+
+    dynamic_array(plot_point) func_points    = {};
+    dynamic_array(plot_point) tangent_points = {};
+    raster image = {};
+    int result = -1;
+
+    /* Value range is chosen by function, tangent is clipped */
+    if (sample_curve(func, &view, 1, &func_points) != 0)
+        goto cleanup;
+    if (sample_curve(tangent, &view, 0, &tangent_points) != 0)
+        goto cleanup;
+
+    if (raster_ctor(&image, IMAGE_WIDTH, IMAGE_HEIGHT, BACKGROUND_COLOR) != 0)
+        goto cleanup;
+
+    draw_grid (&image, &view);
+    draw_curve(&image, &view, &func_points,    FUNC_COLOR);
+    draw_curve(&image, &view, &tangent_points, TANGENT_COLOR);
+
+    /* Curves are drawn over whole image, margins are cleared afterwards */
+    raster_fill(&image, 0, 0, (long) IMAGE_WIDTH, MARGIN_TOP, BACKGROUND_COLOR);
+    raster_fill(&image, 0, view.top + view.height,
+                (long) IMAGE_WIDTH, MARGIN_BOTTOM, BACKGROUND_COLOR);
+    raster_fill(&image, 0, 0, MARGIN_LEFT, (long) IMAGE_HEIGHT, BACKGROUND_COLOR);
+    raster_fill(&image, view.left + view.width, 0,
+                MARGIN_RIGHT, (long) IMAGE_HEIGHT, BACKGROUND_COLOR);
+
+    draw_frame (&image, &view);
+    draw_legend(&image, &view, 0, "y = f(x)", FUNC_COLOR);
+    draw_legend(&image, &view, 1, "tangent",  TANGENT_COLOR);
+
+    result = png_write(&image, filename);
+
+cleanup:
+    if (func_points.data)    array_dtor(&func_points);
+    if (tangent_points.data) array_dtor(&tangent_points);
+    if (image.pixels)        raster_dtor(&image);
+    return result;
+}
+
+/**
+ * @brief Sample curve with precision of one pixel of view
+ *
+ * @param[in] fit_range Whether value range of view is chosen by this curve
+ */
+static int sample_curve(const abstract_syntax_tree* tree, plot_view* view, int fit_range,
+                        dynamic_array(plot_point)* points)
+{
+    bytecode_program program = {};
+    LOG_ASSERT(bytecode_compile(&program, tree) == 0, return -1);
+
+    dynamic_array(plot_point) uniform = {};
+    size_t count = (size_t) view->width * SAMPLES_PER_PIXEL + 1;
+    if (sample_uniform(&program, view->x_min, view->x_max, count, &uniform) != 0)
+    {
+        bytecode_dtor(&program);
+        return -1;
+    }
+
+    if (fit_range)
+        fit_value_range(view, &uniform);
+
+    double pixel_height = (view->y_max - view->y_min) / (double) view->height;
+    double pixel_width  = (view->x_max - view->x_min) / (double) view->width;
+
+    int result = sample_refine(tree, &program, &uniform, pixel_height * TOLERANCE_PIXELS,
+                               pixel_width * MIN_STEP_PIXELS, points);
+
+    array_dtor(&uniform);
+    bytecode_dtor(&program);
+    return result;
+}
+
+static void fit_value_range(plot_view* view, const dynamic_array(plot_point)* samples)
+{
+    double low = 0, high = 0;
+    if (sample_value_range(samples, &low, &high) != 0)
+        return;
+
+    double spread = high - low;
+    if (islessequal(spread, 1e-9 * fmax(fabs(low), fabs(high))) || islessequal(spread, 0))
+    {
+        view->y_min = low - 1;
+        view->y_max = high + 1;
+        return;
+    }
+
+    view->y_min = low  - spread * 0.05;
+    view->y_max = high + spread * 0.05;
+}
+
+static void draw_curve(raster* image, const plot_view* view,
+                       const dynamic_array(plot_point)* points, plot_color color)
+{
+    for (size_t i = 1; i < points->size; i++)
+    {
+        plot_point from = points->data[i - 1];
+        plot_point to   = points->data[i];
+
+        raster_line(image, to_pixel_x(view, from.x), to_pixel_y(view, from.y),
+                           to_pixel_x(view, to.x),   to_pixel_y(view, to.y), color);
+    }
+}
+
+static void draw_grid(raster* image, const plot_view* view)
+{
+    double bottom = (double) (view->top + view->height - 1);
+    double right  = (double) (view->left + view->width - 1);
+
+    double ticks[MAX_TICKS] = {};
+    size_t count = make_ticks(view->x_min, view->x_max, ticks);
+    for (size_t i = 0; i < count; i++)
+    {
+        double px = round(to_pixel_x(view, ticks[i]));
+        raster_line(image, px, (double) view->top, px, bottom, GRID_COLOR);
+    }
+
+    count = make_ticks(view->y_min, view->y_max, ticks);
+    for (size_t i = 0; i < count; i++)
+    {
+        double py = round(to_pixel_y(view, ticks[i]));
+        raster_line(image, (double) view->left, py, right, py, GRID_COLOR);
+    }
+}
+
+static void draw_frame(raster* image, const plot_view* view)
+{
+    double left   = (double) view->left;
+    double top    = (double) view->top;
+    double bottom = (double) (view->top + view->height - 1);
+    double right  = (double) (view->left + view->width - 1);
+
+    raster_line(image, left,  top,    right, top,    FRAME_COLOR);
+    raster_line(image, left,  bottom, right, bottom, FRAME_COLOR);
+    raster_line(image, left,  top,    left,  bottom, FRAME_COLOR);
+    raster_line(image, right, top,    right, bottom, FRAME_COLOR);
+
+    double ticks[MAX_TICKS] = {};
+    char label[32] = "";
+
+    size_t count = make_ticks(view->x_min, view->x_max, ticks);
+    for (size_t i = 0; i < count; i++)
+    {
+        double px = round(to_pixel_x(view, ticks[i]));
+        raster_line(image, px, bottom, px, bottom - TICK_LENGTH, FRAME_COLOR);
+
+        snprintf(label, sizeof(label), "%g", ticks[i]);
+        raster_text(image, (long) px - raster_text_width(label) / 2,
+                    (long) bottom + TICK_LENGTH + 2, label, FRAME_COLOR);
+    }
+
+    count = make_ticks(view->y_min, view->y_max, ticks);
+    for (size_t i = 0; i < count; i++)
+    {
+        double py = round(to_pixel_y(view, ticks[i]));
+        raster_line(image, left, py, left + TICK_LENGTH, py, FRAME_COLOR);
+
+        snprintf(label, sizeof(label), "%g", ticks[i]);
+        raster_text(image, view->left - TICK_LENGTH - 2 - raster_text_width(label),
+                    (long) py - RASTER_TEXT_HEIGHT / 2, label, FRAME_COLOR);
+    }
+}
+
+static void draw_legend(raster* image, const plot_view* view, long row,
+                        const char* title, plot_color color)
+{
+    const long sample_length = 30;
+    const long padding = 10;
+
+    long right = view->left + view->width - padding;
+    long top   = view->top + padding + row * (RASTER_TEXT_HEIGHT + 6);
+    double line_y = (double) (top + RASTER_TEXT_HEIGHT / 2);
+
+    raster_line(image, (double) (right - sample_length), line_y, (double) right, line_y, color);
+    raster_text(image, right - sample_length - padding - raster_text_width(title), top,
+                title, FRAME_COLOR);
+}
+
+/**
+ * @brief Place about `TICK_COUNT` ticks at multiples of 1, 2 or 5 times
+ * power of ten
+ *
+ * @return Number of ticks
+ */
+static size_t make_ticks(double min, double max, double* ticks)
+{
+    double raw = (max - min) / (double) TICK_COUNT;
+    double step = pow(10, floor(log10(raw)));
+    double normalized = raw / step;
+
+    if      (isgreater(normalized, 5)) step *= 10;
+    else if (isgreater(normalized, 2)) step *= 5;
+    else if (isgreater(normalized, 1)) step *= 2;
+
+    size_t count = 0;
+    for (double index = ceil(min / step);
+         islessequal(index, floor(max / step)) && count < MAX_TICKS; index++)
+    {
+        /* Avoid "-0" and rounding noise near zero */
+        double tick = index * step;
+        ticks[count++] = fabs(tick) < step * 1e-9 ? 0 : tick;
+    }
+
+    return count;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file plot.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Function graphs
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef PLOT_H
+#define PLOT_H
+
+#include "ast.h"
+
+/**
+ * @brief Plot function together with its tangent into PNG image
+ *
+ * @param[in] func Function of at most one variable
+ * @param[in] tangent Tangent, with the same variable as function
+ * @param[in] filename Output file name
+ * @param[in] range_left Start of plotted range
+ * @param[in] range_right End of plotted range
+ * @return 0 upon success, -1 otherwise
+ */
+int plot_tangent(const abstract_syntax_tree* func,
+                 const abstract_syntax_tree* tangent,
+                 const char* filename,
+                 double range_left = -10,
+                 double range_right = 10);
+
+#endif
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "png.h"
+
+static const size_t MIN_RUN = 3;
+static const size_t MAX_RUN = 258;
+static const uint32_t ADLER_MODULO = 65521;
+/* Largest number of bytes, whose sums do not overflow before modulo */
+static const size_t ADLER_BLOCK = 5552;
+
+/**
+ * @brief Growing byte buffer with LSB-first bit output
+ */
+struct byte_buffer
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    uint64_t bits;
+    int bit_count;
+};
+
+struct crc_table
+{
+    uint32_t entries[256];
+};
+
+static constexpr crc_table make_crc_table(void)
+{
+    crc_table table = {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        table.entries[i] = crc;
+    }
+    return table;
+}
+
+static constexpr crc_table CRC_TABLE = make_crc_table();
+
+static int  buffer_reserve(byte_buffer* buffer, size_t extra);
+static void put_byte (byte_buffer* buffer, uint8_t byte);
+static void put_be32 (byte_buffer* buffer, uint32_t value);
+static void put_bits (byte_buffer* buffer, uint32_t value, int count);
+static void put_code (byte_buffer* buffer, uint32_t code, int length);
+static void flush_bits(byte_buffer* buffer);
+
+static void put_literal(byte_buffer* buffer, unsigned symbol);
+static void put_run    (byte_buffer* buffer, size_t length);
+static int  deflate_rle(byte_buffer* buffer, const uint8_t* data, size_t size);
+
+static int  filter_rows(const raster* image, uint8_t** filtered, size_t* size);
+static void put_chunk(byte_buffer* buffer, const char* type, const uint8_t* data, size_t size);
+static uint32_t update_crc(uint32_t crc, const uint8_t* data, size_t size);
+static uint32_t adler32(const uint8_t* data, size_t size);
+
+int png_write(const raster* image, const char* filename)
+{
+    LOG_ASSERT(image != NULL, return -1);
+    LOG_ASSERT(filename != NULL, return -1);
+
+    uint8_t* filtered = NULL;
+    size_t filtered_size = 0;
+    if (filter_rows(image, &filtered, &filtered_size) != 0)
+        return -1;
+
+    byte_buffer stream = {};
+    byte_buffer file   = {};
+    int result = -1;
+
+    /* zlib stream: header, deflate data, checksum of uncompressed data */
+    put_byte(&stream, 0x78);
+    put_byte(&stream, 0x01);
+    if (deflate_rle(&stream, filtered, filtered_size) != 0)
+        goto cleanup;
+    put_be32(&stream, adler32(filtered, filtered_size));
+
+    {
+        static const uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        for (size_t i = 0; i < sizeof(SIGNATURE); i++)
+            put_byte(&file, SIGNATURE[i]);
+
+        uint8_t header[13] = {};
+        for (int i = 0; i < 4; i++)
+        {
+            header[i]     = (uint8_t) (image->width  >> (24 - 8 * i));
+            header[4 + i] = (uint8_t) (image->height >> (24 - 8 * i));
+        }
+        header[8] = 8;  /* Bits per channel */
+        header[9] = 2;  /* Truecolor */
+
+        put_chunk(&file, "IHDR", header, sizeof(header));
+        put_chunk(&file, "IDAT", stream.data, stream.size);
+        put_chunk(&file, "IEND", NULL, 0);
+    }
+    LOG_ASSERT_ERROR(file.data != NULL, goto cleanup, "Failed to allocate memory", NULL);
+
+    {
+        FILE* output = fopen(filename, "wb");
+        LOG_ASSERT_ERROR(output != NULL, goto cleanup, "Could not open file '%s'", filename);
+        size_t written = fwrite(file.data, 1, file.size, output);
+        fclose(output);
+        LOG_ASSERT_ERROR(written == file.size, goto cleanup, "Could not write file '%s'", filename);
+    }
+    result = 0;
+
+cleanup:
+    free(filtered);
+    free(stream.data);
+    free(file.data);
+    return result;
+}
+
+/**
+ * @brief Prepend every row with filter type and replace bytes with their
+ * differences from the row above ("Up" filter)
+ */
+static int filter_rows(const raster* image, uint8_t** filtered, size_t* size)
+{
+    size_t stride = image->width * 3;
+    *size = (stride + 1) * image->height;
+    *filtered = (uint8_t*) calloc(*size, sizeof(uint8_t));
+    LOG_ASSERT_ERROR(*filtered != NULL, return -1, "Failed to allocate memory", NULL);
+
+    for (size_t row = 0; row < image->height; row++)
+    {
+        const uint8_t* current = image->pixels + row * stride;
+        uint8_t* output = *filtered + row * (stride + 1);
+
+        output[0] = 2;
+        if (row == 0)
+        {
+            memcpy(output + 1, current, stride);
+            continue;
+        }
+
+        const uint8_t* above = current - stride;
+        for (size_t i = 0; i < stride; i++)
+            output[i + 1] = (uint8_t) (current[i] - above[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Single fixed Huffman block, where repeated bytes are encoded as
+ * matches at distance 1
+ */
+static int deflate_rle(byte_buffer* buffer, const uint8_t* data, size_t size)
+{
+    put_bits(buffer, 1, 1); /* Final block */
+    put_bits(buffer, 1, 2); /* Fixed Huffman codes */
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        size_t run = 0;
+        if (pos > 0)
+            while (run < MAX_RUN && pos + run < size && data[pos + run] == data[pos - 1])
+                run++;
+
+        if (run >= MIN_RUN)
+        {
+            put_run(buffer, run);
+            pos += run;
+        }
+        else
+            put_literal(buffer, data[pos++]);
+    }
+
+    put_literal(buffer, 256); /* End of block */
+    flush_bits(buffer);
+
+    LOG_ASSERT_ERROR(buffer->data != NULL, return -1, "Failed to allocate memory", NULL);
+    return 0;
+}
+
+static void put_literal(byte_buffer* buffer, unsigned symbol)
+{
+    if      (symbol < 144) put_code(buffer, 0x30  + symbol,         8);
+    else if (symbol < 256) put_code(buffer, 0x190 + (symbol - 144), 9);
+    else if (symbol < 280) put_code(buffer,          symbol - 256,  7);
+    else                   put_code(buffer, 0xC0  + (symbol - 280), 8);
+}
+
+static void put_run(byte_buffer* buffer, size_t length)
+{
+    static const uint16_t BASE[] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const uint8_t EXTRA[] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    const size_t code_count = sizeof(BASE) / sizeof(*BASE);
+
+    size_t code = code_count - 1;
+    while (BASE[code] > length)
+        code--;
+
+    put_literal(buffer, (unsigned) (257 + code));
+    put_bits(buffer, (uint32_t) (length - BASE[code]), EXTRA[code]);
+
+    /* Distance 1 has code 0 of fixed 5-bit distance codes */
+    put_code(buffer, 0, 5);
+}
+
+static void put_chunk(byte_buffer* buffer, const char* type, const uint8_t* data, size_t size)
+{
+    put_be32(buffer, (uint32_t) size);
+
+    size_t start = buffer->size;
+    for (int i = 0; i < 4; i++)
+        put_byte(buffer, (uint8_t) type[i]);
+    if (size > 0 && buffer_reserve(buffer, size) == 0)
+    {
+        memcpy(buffer->data + buffer->size, data, size);
+        buffer->size += size;
+    }
+
+    if (!buffer->data) return;
+
+    /* Checksum covers type and data */
+    uint32_t crc = update_crc(0xFFFFFFFFu, buffer->data + start, buffer->size - start);
+    put_be32(buffer, crc ^ 0xFFFFFFFFu);
+}
+
+static uint32_t update_crc(uint32_t crc, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        crc = CRC_TABLE.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size)
+{
+    uint32_t low = 1;
+    uint32_t high = 0;
+
+    while (size > 0)
+    {
+        size_t block = size < ADLER_BLOCK ? size : ADLER_BLOCK;
+        for (size_t i = 0; i < block; i++)
+        {
+            low  += data[i];
+            high += low;
+        }
+        low  %= ADLER_MODULO;
+        high %= ADLER_MODULO;
+
+        data += block;
+        size -= block;
+    }
+
+    return high << 16 | low;
+}
+
+static int buffer_reserve(byte_buffer* buffer, size_t extra)
+{
+    if (buffer->size + extra <= buffer->capacity)
+        return 0;
+
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity < buffer->size + extra)
+        capacity *= 2;
+
+    uint8_t* data = (uint8_t*) realloc(buffer->data, capacity);
+    if (!data)
+    {
+        free(buffer->data);
+        *buffer = {};
+        return -1;
+    }
+
+    buffer->data     = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+static void put_byte(byte_buffer* buffer, uint8_t byte)
+{
+    if (buffer_reserve(buffer, 1) != 0) return;
+    buffer->data[buffer->size++] = byte;
+}
+
+static void put_be32(byte_buffer* buffer, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        put_byte(buffer, (uint8_t) (value >> shift));
+}
+
+static void put_bits(byte_buffer* buffer, uint32_t value, int count)
+{
+    buffer->bits |= (uint64_t) value << buffer->bit_count;
+    buffer->bit_count += count;
+
+    while (buffer->bit_count >= 8)
+    {
+        put_byte(buffer, (uint8_t) buffer->bits);
+        buffer->bits >>= 8;
+        buffer->bit_count -= 8;
+    }
+}
+
+/**
+ * @brief Output Huffman code, which is stored starting from its most
+ * significant bit
+ */
+static void put_code(byte_buffer* buffer, uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++)
+        reversed |= (code >> i & 1) << (length - 1 - i);
+    put_bits(buffer, reversed, length);
+}
+
+static void flush_bits(byte_buffer* buffer)
+{
+    if (buffer->bit_count > 0)
+        put_bits(buffer, 0, 8 - buffer->bit_count);
+}
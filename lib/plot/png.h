@@ -0,0 +1,29 @@
+/**
+ * @file png.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief PNG encoder for RGB images
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Rows are stored as differences from the previous row, which makes
+ * plots consist mostly of zero runs. Runs are compressed by deflate with
+ * fixed Huffman codes, so that no external library is required.
+ */
+
+#ifndef PNG_H
+#define PNG_H
+
+#include "raster.h"
+
+/**
+ * @brief Write image to PNG file
+ *
+ * @param[in] image Written image
+ * @param[in] filename Output file name
+ * @return 0 upon success, -1 otherwise
+ */
+int png_write(const raster* image, const char* filename);
+
+#endif
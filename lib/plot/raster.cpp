@@ -0,0 +1,262 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "raster.h"
+
+/**
+ * @brief Coordinates are clamped to this magnitude before clipping, so that
+ * huge values do not overflow
+ */
+static const double MAX_COORDINATE = 1e7;
+
+/**
+ * @brief Glyph of 3x5 pixel font, rows from top to bottom, 3 bits per row,
+ * most significant bit is left
+ */
+struct glyph
+{
+    char symbol;
+    uint16_t rows;
+};
+
+#define GLYPH(symbol, r0, r1, r2, r3, r4) \
+    { symbol, (uint16_t) (0##r0 << 12 | 0##r1 << 9 | 0##r2 << 6 | 0##r3 << 3 | 0##r4) }
+
+/* Rows are written as octal digits of 3 bits each */
+static const glyph FONT[] = {
+    GLYPH('0', 7, 5, 5, 5, 7),
+    GLYPH('1', 2, 6, 2, 2, 7),
+    GLYPH('2', 7, 1, 7, 4, 7),
+    GLYPH('3', 7, 1, 7, 1, 7),
+    GLYPH('4', 5, 5, 7, 1, 1),
+    GLYPH('5', 7, 4, 7, 1, 7),
+    GLYPH('6', 7, 4, 7, 5, 7),
+    GLYPH('7', 7, 1, 2, 2, 2),
+    GLYPH('8', 7, 5, 7, 5, 7),
+    GLYPH('9', 7, 5, 7, 1, 7),
+    GLYPH('-', 0, 0, 7, 0, 0),
+    GLYPH('+', 0, 2, 7, 2, 0),
+    GLYPH('.', 0, 0, 0, 0, 2),
+    GLYPH('=', 0, 7, 0, 7, 0),
+    GLYPH('(', 2, 4, 4, 4, 2),
+    GLYPH(')', 2, 1, 1, 1, 2),
+    GLYPH('e', 2, 5, 7, 4, 3),
+    GLYPH('f', 3, 4, 6, 4, 4),
+    GLYPH('g', 3, 5, 3, 1, 6),
+    GLYPH('n', 0, 6, 5, 5, 5),
+    GLYPH('a', 0, 3, 5, 5, 3),
+    GLYPH('x', 0, 5, 2, 5, 0),
+    GLYPH('t', 2, 7, 2, 2, 3),
+    GLYPH('y', 5, 5, 3, 1, 6),
+};
+
+#undef GLYPH
+
+static const long GLYPH_WIDTH  = 3;
+static const long GLYPH_HEIGHT = 5;
+static const long FONT_SCALE   = 2;
+static const long GLYPH_ADVANCE = (GLYPH_WIDTH + 1) * FONT_SCALE;
+
+static_assert(GLYPH_HEIGHT * FONT_SCALE == RASTER_TEXT_HEIGHT,
+              "Text height does not match font");
+
+static void blend(raster* image, long x, long y, plot_color color, double alpha);
+static int  clip_line(const raster* image, double* x0, double* y0, double* x1, double* y1);
+static inline double fraction(double value) { return value - floor(value); }
+
+static inline uint8_t mix(uint8_t from, uint8_t to, double alpha)
+{
+    return (uint8_t) lround(from + (to - from) * alpha);
+}
+
+int raster_ctor(raster* image, size_t width, size_t height, plot_color background)
+{
+    LOG_ASSERT(image != NULL, return -1);
+
+    *image = {
+        .width  = width,
+        .height = height,
+        .pixels = (uint8_t*) calloc(width * height * 3, sizeof(uint8_t))
+    };
+    LOG_ASSERT_ERROR(image->pixels != NULL, return -1, "Failed to allocate memory", NULL);
+
+    for (size_t i = 0; i < width * height; i++)
+    {
+        image->pixels[3 * i + 0] = background.red;
+        image->pixels[3 * i + 1] = background.green;
+        image->pixels[3 * i + 2] = background.blue;
+    }
+
+    return 0;
+}
+
+void raster_dtor(raster* image)
+{
+    LOG_ASSERT(image != NULL, return);
+
+    free(image->pixels);
+    *image = {};
+}
+
+void raster_fill(raster* image, long x, long y, long width, long height, plot_color color)
+{
+    LOG_ASSERT(image != NULL, return);
+
+    for (long row = y; row < y + height; row++)
+        for (long col = x; col < x + width; col++)
+            blend(image, col, row, color, 1);
+}
+
+void raster_line(raster* image, double x0, double y0, double x1, double y1, plot_color color)
+{
+    LOG_ASSERT(image != NULL, return);
+
+    if (!isfinite(x0) || !isfinite(y0) || !isfinite(x1) || !isfinite(y1))
+        return;
+    if (!clip_line(image, &x0, &y0, &x1, &y1))
+        return;
+
+    /* Xiaolin Wu's algorithm: two pixels across the line are covered
+       proportionally to their distance from it */
+    int steep = isgreater(fabs(y1 - y0), fabs(x1 - x0));
+    if (steep)
+    {
+        double tmp = x0; x0 = y0; y0 = tmp;
+        tmp = x1; x1 = y1; y1 = tmp;
+    }
+    if (isgreater(x0, x1))
+    {
+        double tmp = x0; x0 = x1; x1 = tmp;
+        tmp = y0; y0 = y1; y1 = tmp;
+    }
+
+    double dx = x1 - x0;
+    double gradient = isgreater(dx, 0) ? (y1 - y0) / dx : 0;
+
+    #define PLOT(x, y, alpha) \
+        (steep ? blend(image, (y), (x), color, (alpha)) : blend(image, (x), (y), color, (alpha)))
+
+    double x_end  = round(x0);
+    double y_end  = y0 + gradient * (x_end - x0);
+    double x_gap  = 1 - fraction(x0 + 0.5);
+    long   first  = (long) x_end;
+    long   y_px   = (long) floor(y_end);
+    PLOT(first, y_px,     (1 - fraction(y_end)) * x_gap);
+    PLOT(first, y_px + 1,      fraction(y_end)  * x_gap);
+    double y_inter = y_end + gradient;
+
+    x_end = round(x1);
+    y_end = y1 + gradient * (x_end - x1);
+    x_gap = fraction(x1 + 0.5);
+    long last = (long) x_end;
+    y_px = (long) floor(y_end);
+    if (last != first)
+    {
+        PLOT(last, y_px,     (1 - fraction(y_end)) * x_gap);
+        PLOT(last, y_px + 1,      fraction(y_end)  * x_gap);
+    }
+
+    for (long x = first + 1; x < last; x++, y_inter += gradient)
+    {
+        long y = (long) floor(y_inter);
+        PLOT(x, y,     1 - fraction(y_inter));
+        PLOT(x, y + 1,     fraction(y_inter));
+    }
+
+    #undef PLOT
+}
+
+void raster_text(raster* image, long x, long y, const char* text, plot_color color)
+{
+    LOG_ASSERT(image != NULL, return);
+    LOG_ASSERT(text != NULL, return);
+
+    for (; *text; text++, x += GLYPH_ADVANCE)
+    {
+        const glyph* found = NULL;
+        for (size_t i = 0; i < sizeof(FONT) / sizeof(*FONT) && !found; i++)
+            if (FONT[i].symbol == *text)
+                found = &FONT[i];
+        if (!found) continue;
+
+        for (long row = 0; row < GLYPH_HEIGHT * FONT_SCALE; row++)
+            for (long col = 0; col < GLYPH_WIDTH * FONT_SCALE; col++)
+            {
+                long bit = (GLYPH_HEIGHT - 1 - row / FONT_SCALE) * GLYPH_WIDTH
+                         + (GLYPH_WIDTH  - 1 - col / FONT_SCALE);
+                if (found->rows >> bit & 1)
+                    blend(image, x + col, y + row, color, 1);
+            }
+    }
+}
+
+long raster_text_width(const char* text)
+{
+    LOG_ASSERT(text != NULL, return 0);
+
+    long length = (long) strlen(text);
+    return length > 0 ? length * GLYPH_ADVANCE - FONT_SCALE : 0;
+}
+
+static void blend(raster* image, long x, long y, plot_color color, double alpha)
+{
+    if (x < 0 || y < 0 || (size_t) x >= image->width || (size_t) y >= image->height)
+        return;
+
+    uint8_t* pixel = image->pixels + ((size_t) y * image->width + (size_t) x) * 3;
+    pixel[0] = mix(pixel[0], color.red,   alpha);
+    pixel[1] = mix(pixel[1], color.green, alpha);
+    pixel[2] = mix(pixel[2], color.blue,  alpha);
+}
+
+/**
+ * @brief Liang-Barsky clipping to image bounds
+ *
+ * @return 1 if some part of segment is visible, 0 otherwise
+ */
+static int clip_line(const raster* image, double* x0, double* y0, double* x1, double* y1)
+{
+    *x0 = fmax(-MAX_COORDINATE, fmin(*x0, MAX_COORDINATE));
+    *y0 = fmax(-MAX_COORDINATE, fmin(*y0, MAX_COORDINATE));
+    *x1 = fmax(-MAX_COORDINATE, fmin(*x1, MAX_COORDINATE));
+    *y1 = fmax(-MAX_COORDINATE, fmin(*y1, MAX_COORDINATE));
+
+    double dx = *x1 - *x0;
+    double dy = *y1 - *y0;
+
+    /* One pixel margin, as anti-aliasing covers neighbours */
+    const double p[] = { -dx, dx, -dy, dy };
+    const double q[] = {
+        *x0 + 1, (double) image->width  - *x0,
+        *y0 + 1, (double) image->height - *y0
+    };
+
+    double t0 = 0;
+    double t1 = 1;
+    for (int i = 0; i < 4; i++)
+    {
+        if (fpclassify(p[i]) == FP_ZERO)
+        {
+            if (isless(q[i], 0)) return 0;
+            continue;
+        }
+
+        double t = q[i] / p[i];
+        if (isless(p[i], 0))
+            t0 = fmax(t0, t);
+        else
+            t1 = fmin(t1, t);
+    }
+    if (isgreater(t0, t1)) return 0;
+
+    double start_x = *x0;
+    double start_y = *y0;
+    *x0 = start_x + t0 * dx;
+    *y0 = start_y + t0 * dy;
+    *x1 = start_x + t1 * dx;
+    *y1 = start_y + t1 * dy;
+    return 1;
+}
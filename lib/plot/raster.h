@@ -0,0 +1,104 @@
+/**
+ * @file raster.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief RGB image buffer with line and text drawing
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Coordinates are in pixels, `(0, 0)` is the center of top left pixel.
+ * Parts of lines and text outside of image are clipped.
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct plot_color
+{
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+/**
+ * @brief Image, stored row by row, 3 bytes per pixel
+ */
+struct raster
+{
+    size_t width;
+    size_t height;
+    uint8_t* pixels;
+};
+
+/**
+ * @brief Create image filled with one color
+ *
+ * @param[out] image Constructed image
+ * @param[in] width Image width
+ * @param[in] height Image height
+ * @param[in] background Fill color
+ * @return 0 upon success, -1 otherwise
+ */
+int raster_ctor(raster* image, size_t width, size_t height, plot_color background);
+
+/**
+ * @brief Destroy image
+ *
+ * @param[inout] image `raster` instance to be destroyed
+ */
+void raster_dtor(raster* image);
+
+/**
+ * @brief Fill rectangle with one color
+ *
+ * @param[inout] image Image
+ * @param[in] x Left edge
+ * @param[in] y Top edge
+ * @param[in] width Rectangle width
+ * @param[in] height Rectangle height
+ * @param[in] color Fill color
+ */
+void raster_fill(raster* image, long x, long y, long width, long height, plot_color color);
+
+/**
+ * @brief Draw anti-aliased line segment
+ *
+ * @param[inout] image Image
+ * @param[in] x0 First end `x`
+ * @param[in] y0 First end `y`
+ * @param[in] x1 Second end `x`
+ * @param[in] y1 Second end `y`
+ * @param[in] color Line color
+ */
+void raster_line(raster* image, double x0, double y0, double x1, double y1, plot_color color);
+
+/**
+ * @brief Draw text using built-in font, which contains digits, `+-.=()`
+ * and letters of `"efgnaxty"`. Other characters are drawn as spaces.
+ *
+ * @param[inout] image Image
+ * @param[in] x Left edge of text
+ * @param[in] y Top edge of text
+ * @param[in] text Drawn text
+ * @param[in] color Text color
+ */
+void raster_text(raster* image, long x, long y, const char* text, plot_color color);
+
+/**
+ * @brief Get width of text drawn by `raster_text`
+ *
+ * @param[in] text Measured text
+ * @return Text width in pixels
+ */
+long raster_text_width(const char* text);
+
+/**
+ * @brief Height of text drawn by `raster_text`
+ */
+const long RASTER_TEXT_HEIGHT = 10;
+
+#endif
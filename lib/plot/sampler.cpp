@@ -0,0 +1,195 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+#include "batch_eval.h"
+#include "sampler.h"
+
+#define ARRAY_ELEMENT plot_point
+#include "dynamic_array_impl.h"
+
+/**
+ * @brief Interval, which does not become straight down to minimal step, is
+ * a jump if its ends differ by more than this number of tolerances
+ */
+static const double JUMP_TOLERANCES = 8;
+
+/**
+ * @brief Straight interval is still bisected, if its value bounds are this
+ * many times wider than change of function between its ends, since there may
+ * be a spike between samples
+ */
+static const double SPIKE_RATIO = 4;
+/**
+ * @brief Spikes are only looked for in intervals longer than this number of
+ * minimal steps, since bounds may stay wide due to overestimation
+ */
+static const double SPIKE_MIN_STEPS = 16;
+
+/**
+ * @brief Fraction of values on each side, which may be cut off as outliers
+ */
+static const double OUTLIER_FRACTION = 0.01;
+
+struct refine_state
+{
+    const abstract_syntax_tree* func;
+    const bytecode_program* program;
+    double tolerance;
+    double min_step;
+    dynamic_array(plot_point)* points;
+};
+
+static void refine(const refine_state* state, plot_point left, plot_point right);
+static double evaluate_at(const bytecode_program* program, double x);
+static int compare_doubles(const void* first, const void* second);
+
+int sample_uniform(const bytecode_program* program, double left, double right,
+                   size_t count, dynamic_array(plot_point)* points)
+{
+    LOG_ASSERT(program != NULL, return -1);
+    LOG_ASSERT(points != NULL, return -1);
+
+    double* xs = (double*) calloc(count, sizeof(*xs));
+    double* ys = (double*) calloc(count, sizeof(*ys));
+    LOG_ASSERT_ERROR(xs && ys, { free(xs); free(ys); return -1; },
+        "Failed to allocate memory", NULL);
+
+    int result = batch_sample_range(program, left, right, count, xs, ys);
+    if (result == 0)
+    {
+        array_ctor(points);
+        for (size_t i = 0; i < count; i++)
+            array_push(points, {.x = xs[i], .y = ys[i]});
+    }
+
+    free(xs);
+    free(ys);
+    return result;
+}
+
+int sample_refine(const abstract_syntax_tree* func, const bytecode_program* program,
+                  const dynamic_array(plot_point)* samples,
+                  double tolerance, double min_step, dynamic_array(plot_point)* points)
+{
+    LOG_ASSERT(func != NULL, return -1);
+    LOG_ASSERT(program != NULL, return -1);
+    LOG_ASSERT(samples != NULL, return -1);
+    LOG_ASSERT(points != NULL, return -1);
+    LOG_ASSERT(samples->size > 0, return -1);
+    LOG_ASSERT(func->variables.size <= 1, return -1);
+
+    array_ctor(points);
+
+    refine_state state = {
+        .func      = func,
+        .program   = program,
+        .tolerance = tolerance,
+        .min_step  = min_step,
+        .points    = points
+    };
+
+    array_push(points, samples->data[0]);
+    for (size_t i = 1; i < samples->size; i++)
+    {
+        refine(&state, samples->data[i - 1], samples->data[i]);
+        array_push(points, samples->data[i]);
+    }
+
+    return 0;
+}
+
+int sample_value_range(const dynamic_array(plot_point)* points, double* low, double* high)
+{
+    LOG_ASSERT(points != NULL, return -1);
+    LOG_ASSERT(low != NULL, return -1);
+    LOG_ASSERT(high != NULL, return -1);
+
+    double* values = (double*) calloc(points->size + 1, sizeof(*values));
+    LOG_ASSERT_ERROR(values != NULL, return -1, "Failed to allocate memory", NULL);
+
+    size_t count = 0;
+    for (size_t i = 0; i < points->size; i++)
+        if (isfinite(points->data[i].y))
+            values[count++] = points->data[i].y;
+
+    if (count == 0)
+    {
+        free(values);
+        return -1;
+    }
+
+    qsort(values, count, sizeof(*values), compare_doubles);
+
+    size_t cut = (size_t) ((double) count * OUTLIER_FRACTION);
+    double inner_low  = values[cut];
+    double inner_high = values[count - 1 - cut];
+    double spread = inner_high - inner_low;
+
+    /* Extremes are kept, unless they are far away from the rest of values,
+       as it happens near poles */
+    *low  = inner_low  - values[0]         <= spread ? values[0]         : inner_low;
+    *high = values[count - 1] - inner_high <= spread ? values[count - 1] : inner_high;
+
+    free(values);
+    return 0;
+}
+
+static void refine(const refine_state* state, plot_point left, plot_point right)
+{
+    int left_finite  = isfinite(left.y);
+    int right_finite = isfinite(right.y);
+    double tolerance = state->tolerance;
+
+    if (right.x - left.x <= state->min_step)
+    {
+        if (left_finite && right_finite
+            && isgreater(fabs(right.y - left.y), JUMP_TOLERANCES * tolerance))
+            array_push(state->points, {.x = (left.x + right.x) / 2, .y = NAN});
+        return;
+    }
+
+    plot_point middle = {.x = (left.x + right.x) / 2, .y = 0};
+    middle.y = evaluate_at(state->program, middle.x);
+    int middle_finite = isfinite(middle.y);
+
+    int straight = left_finite && right_finite && middle_finite
+        && islessequal(fabs(middle.y - (left.y + right.y) / 2), tolerance);
+
+    /* Samples are confirmed by bounds, only when they would stop bisection */
+    if (straight || (!left_finite && !right_finite && !middle_finite))
+    {
+        const interval range = {.low = left.x, .high = right.x, .domain = IV_DEFINED};
+        interval bounds = interval_evaluate(state->func, &range);
+
+        /* Nothing to draw here */
+        if (bounds.domain == IV_UNDEFINED)
+            return;
+
+        int spike_possible = isgreater(right.x - left.x, SPIKE_MIN_STEPS * state->min_step)
+            && isgreater(bounds.high - bounds.low,
+                         SPIKE_RATIO * (fabs(right.y - left.y) + tolerance));
+
+        /* Otherwise function may have hole or spike, which samples do not show */
+        if (straight && bounds.domain == IV_DEFINED && !spike_possible)
+            return;
+    }
+
+    refine(state, left, middle);
+    array_push(state->points, middle);
+    refine(state, middle, right);
+}
+
+static double evaluate_at(const bytecode_program* program, double x)
+{
+    const double vars[] = { x };
+    return bytecode_evaluate(program, vars);
+}
+
+static int compare_doubles(const void* first, const void* second)
+{
+    double a = *(const double*) first;
+    double b = *(const double*) second;
+    return isless(a, b) ? -1 : isgreater(a, b) ? 1 : 0;
+}
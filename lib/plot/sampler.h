@@ -0,0 +1,83 @@
+/**
+ * @file sampler.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Adaptive sampling of functions of one variable
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Function is first sampled on a uniform grid, then intervals, where
+ * function deviates from a straight line, are bisected until it becomes
+ * visually straight. Interval arithmetic is used to skip parts, where
+ * function is undefined, and to look for holes and spikes between samples,
+ * which look straight. Points, where function is undefined or jumps, are separated by
+ * NaN points, so that they are not connected when drawn.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stddef.h>
+
+#include "bytecode.h"
+#include "interval.h"
+
+/**
+ * @brief Sampled point of function graph
+ */
+struct plot_point
+{
+    double x;
+    double y;
+};
+
+#define ARRAY_ELEMENT plot_point
+
+inline void copy_element(ARRAY_ELEMENT* dest, const ARRAY_ELEMENT* src) { *dest = *src; }
+inline void delete_element(ARRAY_ELEMENT* element) { *element = {}; }
+
+#include "dynamic_array.h"
+
+#undef ARRAY_ELEMENT
+
+/**
+ * @brief Sample function at evenly spaced points
+ *
+ * @param[in] program Compiled function of at most one variable
+ * @param[in] left Range start
+ * @param[in] right Range end
+ * @param[in] count Number of points, at least 2
+ * @param[out] points Constructed array of samples
+ * @return 0 upon success, -1 otherwise
+ */
+int sample_uniform(const bytecode_program* program, double left, double right,
+                   size_t count, dynamic_array(plot_point)* points);
+
+/**
+ * @brief Refine samples where function is not straight within tolerance
+ *
+ * @param[in] func Function of at most one variable
+ * @param[in] program Compiled `func`
+ * @param[in] samples Samples, ordered by `x`
+ * @param[in] tolerance Maximal allowed deviation of `y` from chord
+ * @param[in] min_step Intervals shorter than this are not bisected
+ * @param[out] points Constructed array of refined samples
+ * @return 0 upon success, -1 otherwise
+ */
+int sample_refine(const abstract_syntax_tree* func, const bytecode_program* program,
+                  const dynamic_array(plot_point)* samples,
+                  double tolerance, double min_step, dynamic_array(plot_point)* points);
+
+/**
+ * @brief Find range of function values, ignoring rare outliers, such as
+ * values near poles
+ *
+ * @param[in] points Samples
+ * @param[out] low Range start
+ * @param[out] high Range end
+ * @return 0 upon success, -1 if there are no finite values
+ */
+int sample_value_range(const dynamic_array(plot_point)* points, double* low, double* high);
+
+#endif
@@ -0,0 +1,727 @@
+/**
+ * @file static_expr.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Expressions, known at compile time
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Every expression is an empty object, whose type encodes the whole
+ * expression tree. Differentiation and simplification only produce new
+ * types, so they are done entirely by compiler, and evaluation compiles
+ * into straight-line code without parsing or allocations:
+ *
+ *     using namespace static_expr;
+ *     constexpr auto f  = "\\sin{x^3} + (\\cos{15 \\cdot x})^4"_latex;
+ *     constexpr auto df = derivative(f);
+ *     double value = evaluate(df, &x);
+ *
+ * Operations and derivatives of functions are generated from "functions.h",
+ * derivatives follow the same rules as `derivative()` from "tree_math.h".
+ */
+
+#ifndef STATIC_EXPR_H
+#define STATIC_EXPR_H
+
+#include <math.h>
+#include <stddef.h>
+
+#include <type_traits>
+
+#include "ast.h"
+
+namespace static_expr
+{
+
+/**
+ * @brief Number constant
+ */
+template <double Value>
+struct num
+{
+    static constexpr double value = Value;
+};
+
+/**
+ * @brief Variable, evaluated as `vars[Index]`
+ */
+template <size_t Index>
+struct var
+{
+    static constexpr size_t index = Index;
+};
+
+/**
+ * @brief Missing operand of unary operation
+ */
+struct none {};
+
+/**
+ * @brief Operation. `Left` is `none` for unary operations.
+ */
+template <op_type Op, class Left, class Right>
+struct expr
+{
+    static constexpr op_type op = Op;
+};
+
+template <class T> struct is_expression : std::false_type {};
+template <double V> struct is_expression<num<V>> : std::true_type {};
+template <size_t I> struct is_expression<var<I>> : std::true_type {};
+template <op_type Op, class L, class R>
+struct is_expression<expr<Op, L, R>> : std::true_type {};
+
+template <class T>
+concept expression = is_expression<T>::value;
+
+template <class T> struct is_number : std::false_type {};
+template <double V> struct is_number<num<V>> : std::true_type {};
+
+template <class T>
+constexpr bool is_zero = std::is_same_v<T, num<0.0>> || std::is_same_v<T, num<-0.0>>;
+
+template <class T>
+constexpr bool is_one = std::is_same_v<T, num<1.0>>;
+
+/**
+ * @brief Whether expression depends on variable `vars[Var]`
+ */
+template <size_t Var, class E>
+struct depends_on : std::false_type {};
+template <size_t Var>
+struct depends_on<Var, var<Var>> : std::true_type {};
+template <size_t Var, op_type Op, class L, class R>
+struct depends_on<Var, expr<Op, L, R>>
+    : std::bool_constant<depends_on<Var, L>::value || depends_on<Var, R>::value> {};
+
+/**
+ * @brief Apply operation to operands values
+ */
+constexpr double apply(op_type op, double left, double right)
+{
+    switch (op)
+    {
+    case OP_ADD:    return left + right;
+    case OP_SUB:    return left - right;
+    case OP_MUL:    return left * right;
+    case OP_DIV:    return left / right;
+    case OP_POW:    return ::pow(left, right);
+    case OP_NEG:    return -right;
+    case OP_SQRT:   return ::sqrt(right);
+    case OP_LN:     return ::log(right);
+    case OP_SIN:    return ::sin(right);
+    case OP_COS:    return ::cos(right);
+    case OP_TAN:    return ::tan(right);
+    case OP_COT:    return 1 / ::tan(right);
+    case OP_ARCSIN: return ::asin(right);
+    case OP_ARCCOS: return ::acos(right);
+    case OP_ARCTAN: return ::atan(right);
+    case OP_ARCCOT: return M_PI_2 - ::atan(right);
+    default:        return NAN;
+    }
+}
+
+/**
+ * @brief Raise number to whole power without calling `pow()`, which is not
+ * usable in constant expressions
+ */
+constexpr double whole_power(double base, long long power)
+{
+    double result = 1;
+    for (long long i = 0; i < (power < 0 ? -power : power); i++)
+        result *= base;
+    return power < 0 ? 1 / result : result;
+}
+
+/**
+ * @brief Whether operation on numbers can be computed at compile time
+ */
+constexpr int can_fold(op_type op, double left, double right)
+{
+    const double MAX_FOLDED_POWER = 64;
+
+    switch (op)
+    {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+        return 1;
+    case OP_DIV:
+        return right < 0 || right > 0;
+    case OP_POW:
+        return (long long) right <= right && (long long) right >= right
+            && right <= MAX_FOLDED_POWER && right >= -MAX_FOLDED_POWER
+            && (right > 0 || left < 0 || left > 0);
+    default:
+        return 0;
+    }
+}
+
+constexpr double fold(op_type op, double left, double right)
+{
+    if (op == OP_POW)
+        return whole_power(left, (long long) right);
+    return apply(op, left, right);
+}
+
+/**
+ * @brief Make binary operation, simplifying it where possible
+ */
+template <op_type Op, expression L, expression R>
+constexpr auto make_binary(L, R)
+{
+    if constexpr (is_number<L>::value && is_number<R>::value)
+    {
+        if constexpr (can_fold(Op, L::value, R::value))
+            return num<fold(Op, L::value, R::value)>{};
+        else
+            return expr<Op, L, R>{};
+    }
+    else if constexpr (Op == OP_ADD && is_zero<L>) return R{};
+    else if constexpr (Op == OP_ADD && is_zero<R>) return L{};
+    else if constexpr (Op == OP_SUB && is_zero<R>) return L{};
+    else if constexpr (Op == OP_SUB && is_zero<L>) return expr<OP_NEG, none, R>{};
+    else if constexpr (Op == OP_SUB && std::is_same_v<L, R>) return num<0.0>{};
+    else if constexpr (Op == OP_MUL && (is_zero<L> || is_zero<R>)) return num<0.0>{};
+    else if constexpr (Op == OP_MUL && is_one<L>) return R{};
+    else if constexpr (Op == OP_MUL && is_one<R>) return L{};
+    else if constexpr (Op == OP_DIV && is_zero<L>) return num<0.0>{};
+    else if constexpr (Op == OP_DIV && is_one<R>) return L{};
+    else if constexpr (Op == OP_POW && is_zero<R>) return num<1.0>{};
+    else if constexpr (Op == OP_POW && is_one<R>) return L{};
+    else return expr<Op, L, R>{};
+}
+
+/**
+ * @brief Make unary operation, simplifying it where possible
+ */
+template <op_type Op, expression R>
+constexpr auto make_unary(R)
+{
+    if constexpr (Op == OP_NEG && is_number<R>::value)
+        return num<-R::value>{};
+    else
+        return expr<Op, none, R>{};
+}
+
+template <double V>
+constexpr double evaluate(num<V>, const double*) { return V; }
+
+template <size_t I>
+constexpr double evaluate(var<I>, const double* vars) { return vars[I]; }
+
+/**
+ * @brief Evaluate expression
+ *
+ * @param[in] vars Variable values, indexed by variable index
+ * @return Expression value
+ */
+template <op_type Op, class L, class R>
+constexpr double evaluate(expr<Op, L, R>, const double* vars)
+{
+    if constexpr (std::is_same_v<L, none>)
+        return apply(Op, 0, evaluate(R{}, vars));
+    else
+        return apply(Op, evaluate(L{}, vars), evaluate(R{}, vars));
+}
+
+template <size_t Var, double V>
+constexpr auto derivative(num<V>) { return num<0.0>{}; }
+
+template <size_t Var, size_t I>
+constexpr auto derivative(var<I>) { return num<I == Var ? 1.0 : 0.0>{}; }
+
+/**
+ * @brief Differentiate expression by variable `vars[Var]`
+ */
+template <size_t Var, op_type Op, class L, class R>
+constexpr auto derivative(expr<Op, L, R> node)
+{
+    #define LEFT  L{}
+    #define RIGHT R{}
+    #define D(operand) derivative<Var>(operand)
+    #define CPY(operand) operand
+    #define NUM(val) num<(double) (val)>{}
+
+    #define ADD(left, right)  make_binary<OP_ADD>(left, right)
+    #define SUB(left, right)  make_binary<OP_SUB>(left, right)
+    #define MUL(left, right)  make_binary<OP_MUL>(left, right)
+    #define FRAC(left, right) make_binary<OP_DIV>(left, right)
+    #define POW(left, right)  make_binary<OP_POW>(left, right)
+
+    #define NEG(right)  make_unary<OP_NEG> (right)
+    #define SIN(right)  make_unary<OP_SIN> (right)
+    #define COS(right)  make_unary<OP_COS> (right)
+    #define SQRT(right) make_unary<OP_SQRT>(right)
+    #define LN(right)   make_unary<OP_LN>  (right)
+
+    #define MATH_FUNC(name, diff, ...)                      \
+        else if constexpr (Op == OP_##name)                 \
+            return MUL(diff, D(RIGHT));
+
+    if constexpr (!depends_on<Var, expr<Op, L, R>>::value)
+        return num<0.0>{};
+    else if constexpr (Op == OP_ADD)
+        return ADD(D(LEFT), D(RIGHT));
+    else if constexpr (Op == OP_SUB)
+        return SUB(D(LEFT), D(RIGHT));
+    else if constexpr (Op == OP_MUL)
+        return ADD(MUL(D(LEFT), CPY(RIGHT)), MUL(CPY(LEFT), D(RIGHT)));
+    else if constexpr (Op == OP_DIV)
+        return FRAC(
+            SUB(MUL(D(LEFT), CPY(RIGHT)), MUL(CPY(LEFT), D(RIGHT))),
+            POW(CPY(RIGHT), NUM(2)));
+    else if constexpr (Op == OP_POW && !depends_on<Var, L>::value)
+        return MUL(MUL(LN(CPY(LEFT)), CPY(node)), D(RIGHT));
+    else if constexpr (Op == OP_POW && !depends_on<Var, R>::value)
+        return MUL(MUL(CPY(RIGHT), POW(CPY(LEFT), SUB(CPY(RIGHT), NUM(1)))), D(LEFT));
+    else if constexpr (Op == OP_POW)
+        return MUL(CPY(node),
+                   ADD(MUL(D(RIGHT), LN(CPY(LEFT))),
+                       MUL(CPY(RIGHT), FRAC(D(LEFT), CPY(LEFT)))));
+    else if constexpr (Op == OP_NEG)
+        return NEG(D(RIGHT));
+    #include "functions.h"
+    else
+        static_assert(Op == OP_ADD, "Unknown operation");
+
+    #undef MATH_FUNC
+    #undef LEFT
+    #undef RIGHT
+    #undef D
+    #undef CPY
+    #undef NUM
+    #undef ADD
+    #undef SUB
+    #undef MUL
+    #undef FRAC
+    #undef POW
+    #undef NEG
+    #undef SIN
+    #undef COS
+    #undef SQRT
+    #undef LN
+}
+
+/**
+ * @brief Differentiate expression by its first variable
+ */
+template <expression E>
+constexpr auto derivative(E node) { return derivative<0>(node); }
+
+template <expression L, expression R>
+constexpr auto operator+(L left, R right) { return make_binary<OP_ADD>(left, right); }
+template <expression L, expression R>
+constexpr auto operator-(L left, R right) { return make_binary<OP_SUB>(left, right); }
+template <expression L, expression R>
+constexpr auto operator*(L left, R right) { return make_binary<OP_MUL>(left, right); }
+template <expression L, expression R>
+constexpr auto operator/(L left, R right) { return make_binary<OP_DIV>(left, right); }
+template <expression R>
+constexpr auto operator-(R right) { return make_unary<OP_NEG>(right); }
+
+template <expression L, expression R>
+constexpr auto pow(L left, R right) { return make_binary<OP_POW>(left, right); }
+
+#define STATIC_FUNC(func, op) \
+    template <expression R> constexpr auto func(R right) { return make_unary<op>(right); }
+
+STATIC_FUNC(sqrt,   OP_SQRT)
+STATIC_FUNC(ln,     OP_LN)
+STATIC_FUNC(sin,    OP_SIN)
+STATIC_FUNC(cos,    OP_COS)
+STATIC_FUNC(tan,    OP_TAN)
+STATIC_FUNC(cot,    OP_COT)
+STATIC_FUNC(arcsin, OP_ARCSIN)
+STATIC_FUNC(arccos, OP_ARCCOS)
+STATIC_FUNC(arctan, OP_ARCTAN)
+STATIC_FUNC(arccot, OP_ARCCOT)
+
+#undef STATIC_FUNC
+
+/**
+ * @brief String literal, usable as template argument
+ */
+template <size_t N>
+struct latex_string
+{
+    char data[N] = {};
+
+    consteval latex_string(const char (&str)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+            data[i] = str[i];
+    }
+};
+
+/**
+ * @brief Missing operand of parsed node
+ */
+constexpr size_t PARSED_NONE = (size_t) -1;
+
+/**
+ * @brief Node of expression, parsed at compile time
+ */
+struct parsed_node
+{
+    node_type type;
+    op_type op;
+    double num;
+    size_t var;
+    size_t left;
+    size_t right;
+};
+
+/**
+ * @brief Expression, parsed at compile time. String of length `N` cannot
+ * contain more than `N` nodes or variables.
+ */
+template <size_t N>
+struct parsed_tree
+{
+    parsed_node nodes[N];
+    size_t size;
+    size_t root;
+
+    /**
+     * @brief Offsets of variable names in source string, in order of
+     * their first appearance
+     */
+    size_t var_start[N];
+    size_t var_length[N];
+    size_t var_count;
+};
+
+/**
+ * @brief Called upon syntax error. Not defined, as parsing only happens at
+ * compile time, so call to this function fails compilation.
+ */
+void static_parse_error(const char* message);
+
+template <size_t N>
+struct static_parser
+{
+    const char* str;
+    size_t pos;
+    parsed_tree<N>* tree;
+};
+
+struct static_keyword
+{
+    const char* name;
+    op_type op;
+};
+
+#define MATH_FUNC(name, ...) { "\\" #name, OP_##name },
+
+constexpr static_keyword STATIC_KEYWORDS[] = {
+    #include "functions.h"
+};
+
+#undef MATH_FUNC
+
+template <size_t N>
+consteval void skip_spaces(static_parser<N>* state)
+{
+    while (state->str[state->pos] == ' '  || state->str[state->pos] == '\t' ||
+           state->str[state->pos] == '\n' || state->str[state->pos] == '\r')
+        state->pos++;
+}
+
+consteval char to_lower(char c)
+{
+    return 'A' <= c && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+}
+
+/**
+ * @brief Consume keyword, case-insensitive like lexer
+ *
+ * @return Whether keyword was consumed
+ */
+template <size_t N>
+consteval int consume_word(static_parser<N>* state, const char* word)
+{
+    skip_spaces(state);
+    size_t len = 0;
+    for (; word[len]; len++)
+        if (to_lower(state->str[state->pos + len]) != to_lower(word[len]))
+            return 0;
+    state->pos += len;
+    return 1;
+}
+
+template <size_t N>
+consteval size_t add_node(static_parser<N>* state, parsed_node node)
+{
+    if (state->tree->size >= N)
+        static_parse_error("Too many nodes");
+    state->tree->nodes[state->tree->size] = node;
+    return state->tree->size++;
+}
+
+template <size_t N>
+consteval size_t add_op(static_parser<N>* state, op_type op, size_t left, size_t right)
+{
+    return add_node(state, {
+        .type  = NODE_OP,
+        .op    = op,
+        .num   = 0,
+        .var   = 0,
+        .left  = left,
+        .right = right
+    });
+}
+
+template <size_t N> consteval size_t parse_expression(static_parser<N>* state);
+template <size_t N> consteval size_t parse_product   (static_parser<N>* state);
+template <size_t N> consteval size_t parse_unary     (static_parser<N>* state);
+template <size_t N> consteval size_t parse_fraction  (static_parser<N>* state);
+template <size_t N> consteval size_t parse_power     (static_parser<N>* state);
+template <size_t N> consteval size_t parse_group     (static_parser<N>* state);
+template <size_t N> consteval size_t parse_atom      (static_parser<N>* state);
+template <size_t N> consteval size_t parse_number    (static_parser<N>* state);
+template <size_t N> consteval size_t parse_var       (static_parser<N>* state);
+
+template <size_t N>
+consteval size_t parse_expression(static_parser<N>* state)
+{
+    size_t left = parse_product(state);
+    while (true)
+    {
+        if (consume_word(state, "+"))
+            left = add_op(state, OP_ADD, left, parse_product(state));
+        else if (consume_word(state, "-"))
+            left = add_op(state, OP_SUB, left, parse_product(state));
+        else
+            return left;
+    }
+}
+
+template <size_t N>
+consteval size_t parse_product(static_parser<N>* state)
+{
+    size_t left = parse_unary(state);
+    while (consume_word(state, "\\cdot"))
+        left = add_op(state, OP_MUL, left, parse_unary(state));
+    return left;
+}
+
+template <size_t N>
+consteval size_t parse_unary(static_parser<N>* state)
+{
+    if (consume_word(state, "-"))
+        return add_op(state, OP_NEG, PARSED_NONE, parse_unary(state));
+
+    for (const static_keyword& keyword : STATIC_KEYWORDS)
+        if (consume_word(state, keyword.name))
+            return add_op(state, keyword.op, PARSED_NONE, parse_unary(state));
+
+    return parse_fraction(state);
+}
+
+template <size_t N>
+consteval size_t parse_fraction(static_parser<N>* state)
+{
+    if (!consume_word(state, "\\frac"))
+        return parse_power(state);
+
+    if (!consume_word(state, "{"))
+        static_parse_error("Expected '{' after '\\frac'");
+    size_t left = parse_expression(state);
+    if (!consume_word(state, "}"))
+        static_parse_error("Expected '}' after first argument of '\\frac'");
+
+    if (!consume_word(state, "{"))
+        static_parse_error("Expected '{' before second argument of '\\frac'");
+    size_t right = parse_expression(state);
+    if (!consume_word(state, "}"))
+        static_parse_error("Expected '}' after second argument of '\\frac'");
+
+    return add_op(state, OP_DIV, left, right);
+}
+
+template <size_t N>
+consteval size_t parse_power(static_parser<N>* state)
+{
+    size_t left = parse_group(state);
+
+    if (consume_word(state, "^"))
+        return add_op(state, OP_POW, left, parse_power(state));
+
+    return left;
+}
+
+template <size_t N>
+consteval size_t parse_group(static_parser<N>* state)
+{
+    const char* closing = NULL;
+    if (consume_word(state, "{")) closing = "}";
+    else if (consume_word(state, "(")) closing = ")";
+    else return parse_atom(state);
+
+    size_t result = parse_expression(state);
+    if (!consume_word(state, closing))
+        static_parse_error("Expected closing bracket");
+
+    return result;
+}
+
+template <size_t N>
+consteval size_t parse_atom(static_parser<N>* state)
+{
+    skip_spaces(state);
+    char c = state->str[state->pos];
+
+    if (('0' <= c && c <= '9') || c == '.')
+        return parse_number(state);
+
+    if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_' || c == '\\')
+        return parse_var(state);
+
+    static_parse_error("Unexpected symbol");
+    return PARSED_NONE;
+}
+
+template <size_t N>
+consteval size_t parse_number(static_parser<N>* state)
+{
+    /* Mantissa below 2^53 divided by exact power of ten is correctly
+       rounded, so most literals are parsed exactly like strtod() does */
+    const char* str = state->str;
+    unsigned long long mantissa = 0;
+    long long exponent = 0;
+
+    for (; '0' <= str[state->pos] && str[state->pos] <= '9'; state->pos++)
+        mantissa = mantissa * 10 + (unsigned long long) (str[state->pos] - '0');
+    if (str[state->pos] == '.')
+        for (state->pos++; '0' <= str[state->pos] && str[state->pos] <= '9'; state->pos++)
+        {
+            mantissa = mantissa * 10 + (unsigned long long) (str[state->pos] - '0');
+            exponent--;
+        }
+    if (str[state->pos] == 'e' || str[state->pos] == 'E')
+    {
+        state->pos++;
+        long long sign = 1;
+        if (str[state->pos] == '-' || str[state->pos] == '+')
+            sign = str[state->pos++] == '-' ? -1 : 1;
+
+        long long value = 0;
+        for (; '0' <= str[state->pos] && str[state->pos] <= '9'; state->pos++)
+            value = value * 10 + (str[state->pos] - '0');
+        exponent += sign * value;
+    }
+
+    double value = exponent < 0
+                 ? (double) mantissa / whole_power(10, -exponent)
+                 : (double) mantissa * whole_power(10,  exponent);
+
+    return add_node(state, {
+        .type  = NODE_NUM,
+        .op    = OP_ADD,
+        .num   = value,
+        .var   = 0,
+        .left  = PARSED_NONE,
+        .right = PARSED_NONE
+    });
+}
+
+template <size_t N>
+consteval size_t parse_var(static_parser<N>* state)
+{
+    const char* str = state->str;
+    size_t start = state->pos;
+    while (('a' <= str[state->pos] && str[state->pos] <= 'z') ||
+           ('A' <= str[state->pos] && str[state->pos] <= 'Z') ||
+            str[state->pos] == '_' || str[state->pos] == '\\')
+        state->pos++;
+    size_t length = state->pos - start;
+
+    parsed_tree<N>* tree = state->tree;
+    size_t var_id = 0;
+    for (; var_id < tree->var_count; var_id++)
+    {
+        if (tree->var_length[var_id] != length) continue;
+
+        size_t i = 0;
+        while (i < length && str[tree->var_start[var_id] + i] == str[start + i])
+            i++;
+        if (i == length) break;
+    }
+
+    if (var_id == tree->var_count)
+    {
+        tree->var_start [var_id] = start;
+        tree->var_length[var_id] = length;
+        tree->var_count++;
+    }
+
+    return add_node(state, {
+        .type  = NODE_VAR,
+        .op    = OP_ADD,
+        .num   = 0,
+        .var   = var_id,
+        .left  = PARSED_NONE,
+        .right = PARSED_NONE
+    });
+}
+
+/**
+ * @brief Parse LaTeX formula, accepted by `build_tree()`
+ */
+template <size_t N>
+consteval parsed_tree<N> parse_latex(const latex_string<N>& str)
+{
+    parsed_tree<N> tree = {};
+    static_parser<N> state = {
+        .str  = str.data,
+        .pos  = 0,
+        .tree = &tree
+    };
+
+    tree.root = parse_expression(&state);
+
+    skip_spaces(&state);
+    if (str.data[state.pos] != '\0')
+        static_parse_error("Unexpected symbols after expression end");
+
+    return tree;
+}
+
+template <latex_string Str>
+constexpr parsed_tree<sizeof(Str.data)> parsed_latex = parse_latex(Str);
+
+/**
+ * @brief Convert parsed node into expression type
+ */
+template <latex_string Str, size_t Index>
+constexpr auto build_latex()
+{
+    constexpr parsed_node node = parsed_latex<Str>.nodes[Index];
+
+    if constexpr (node.type == NODE_NUM)
+        return num<node.num>{};
+    else if constexpr (node.type == NODE_VAR)
+        return var<node.var>{};
+    else if constexpr (node.left == PARSED_NONE)
+        return expr<node.op, none, decltype(build_latex<Str, node.right>())>{};
+    else
+        return expr<node.op,
+                    decltype(build_latex<Str, node.left >()),
+                    decltype(build_latex<Str, node.right>())>{};
+}
+
+/**
+ * @brief Parse LaTeX formula at compile time. Variables are indexed in order
+ * of their first appearance, same as in `abstract_syntax_tree::variables`.
+ */
+template <latex_string Str>
+constexpr auto operator""_latex()
+{
+    return build_latex<Str, parsed_latex<Str>.root>();
+}
+
+}
+
+#endif
@@ -2,64 +2,78 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <errno.h>
 #include <unistd.h>
+#include <sys/uio.h>
+
+#include <charconv>
 
 #include "logger.h"
 
 #include "string_builder.h"
 
 static const size_t DEFAULT_CAP = 128;
+static const size_t MAX_CHUNK_CAP = 1 << 16;
+
+/**
+ * @brief Buffer size, sufficient for any number in `"%g"` format
+ */
+static const size_t NUMBER_BUFFER_SIZE = 32;
+
+/**
+ * @brief Maximum number of chunks, written by single `writev()` call
+ */
+static const int WRITE_BATCH = 64;
 
-static inline size_t get_min_cap(size_t size)
+static inline size_t get_free_space(const string_builder* builder)
 {
-    size_t res = DEFAULT_CAP;
-    while (res <= size)
-        res *= 2;
-    return res;
+    return builder->tail ? builder->tail->capacity - builder->tail->size : 0;
 }
 
-static void ensure_fit(string_builder *builder, size_t new_size);
+static string_chunk* add_chunk(string_builder* builder, size_t min_cap);
 
 void string_builder_ctor(string_builder *builder, const char* str)
 {
     LOG_ASSERT(builder != NULL, return);
 
-    size_t cap = DEFAULT_CAP;
-
-    if (str) cap = get_min_cap(strlen(str));
-
     *builder = {
-        .data = (char*) calloc(cap, sizeof(char)),
-        .capacity = cap,
+        .head = NULL,
+        .tail = NULL,
         .size = 0
     };
 
-    if (str)
-    {
-        size_t len = strlen(str);
-        strncpy(builder->data, str, len);
-        builder->size = len;
-    }
+    if (str) string_builder_append(builder, str);
 }
 
 void string_builder_copy(string_builder *dest, const string_builder *src)
 {
     LOG_ASSERT(dest != NULL, return);
     LOG_ASSERT(src != NULL, return);
-    LOG_ASSERT(dest->data == NULL, return);
+    LOG_ASSERT(dest->head == NULL, return);
+
+    string_builder_ctor(dest);
+    if (src->size == 0) return;
 
-    dest->capacity = src->capacity;
-    dest->size = src->capacity;
-    dest->data = (char*) calloc(dest->capacity, sizeof(char));
+    string_chunk* chunk = add_chunk(dest, src->size);
+    if (!chunk) return;
 
-    strncpy(dest->data, src->data, dest->size);
+    string_builder_copy_range(src, 0, src->size, chunk->data);
+    chunk->size = src->size;
+    dest->size  = src->size;
 }
 
 void string_builder_dtor(string_builder *builder)
 {
     LOG_ASSERT(builder != NULL, return);
 
-    free(builder->data);
+    string_chunk* chunk = builder->head;
+    while (chunk)
+    {
+        string_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
     *builder = {};
     return;
 }
@@ -68,9 +82,11 @@ void string_builder_append(string_builder *builder, char c)
 {
     LOG_ASSERT(builder != NULL, return);
 
-    builder->data[builder->size] = c;
+    if (get_free_space(builder) == 0 && !add_chunk(builder, 1))
+        return;
+
+    builder->tail->data[builder->tail->size++] = c;
     builder->size++;
-    ensure_fit(builder, builder->size);
 }
 
 void string_builder_append(string_builder *builder, const char *str)
@@ -78,11 +94,47 @@ void string_builder_append(string_builder *builder, const char *str)
     LOG_ASSERT(builder != NULL, return);
     LOG_ASSERT(str != NULL, return);
 
-    size_t len = strlen(str);
-    ensure_fit(builder, builder->size + len);
+    string_builder_append_n(builder, str, strlen(str));
+}
+
+void string_builder_append_n(string_builder* builder, const char* str, size_t length)
+{
+    LOG_ASSERT(builder != NULL, return);
+    LOG_ASSERT(str != NULL, return);
 
-    strncpy(builder->data + builder->size, str, len);
-    builder->size += len;
+    /* Text is split between chunks, so that chunks stay bounded */
+    while (length > 0)
+    {
+        size_t space = get_free_space(builder);
+        if (space == 0)
+        {
+            if (!add_chunk(builder, 1)) return;
+            space = get_free_space(builder);
+        }
+
+        size_t part = length < space ? length : space;
+        memcpy(builder->tail->data + builder->tail->size, str, part);
+        builder->tail->size += part;
+        builder->size       += part;
+
+        str    += part;
+        length -= part;
+    }
+}
+
+void string_builder_append_number(string_builder* builder, double num)
+{
+    LOG_ASSERT(builder != NULL, return);
+
+    /* Same as "%g" with default precision */
+    const int PRECISION = 6;
+
+    char buffer[NUMBER_BUFFER_SIZE] = "";
+    std::to_chars_result result = std::to_chars(buffer, buffer + NUMBER_BUFFER_SIZE, num,
+                                                std::chars_format::general, PRECISION);
+    LOG_ASSERT(result.ec == std::errc(), return);
+
+    string_builder_append_n(builder, buffer, (size_t) (result.ptr - buffer));
 }
 
 void string_builder_append_format(string_builder *builder, const char *format, ...)
@@ -91,44 +143,157 @@ void string_builder_append_format(string_builder *builder, const char *format, .
     LOG_ASSERT(format != NULL, return);
 
     va_list args = {};
-    va_start(args, format);
 
-    int len = vsnprintf(NULL, 0, format, args);
+    /* Formatted text usually fits into last chunk, so it is printed there
+       directly. Space for terminating null character is required */
+    size_t space = get_free_space(builder);
+    char* dest = space > 0 ? builder->tail->data + builder->tail->size : NULL;
 
+    va_start(args, format);
+    int len = vsnprintf(dest, space, format, args);
     va_end(args);
 
-    ensure_fit(builder, builder->size + len);
+    LOG_ASSERT_ERROR(len >= 0, return, "Invalid format string '%s'", format);
 
-    va_start(args, format);
+    if ((size_t) len >= space)
+    {
+        string_chunk* chunk = add_chunk(builder, (size_t) len + 1);
+        if (!chunk) return;
 
-    vsprintf(builder->data + builder->size, format, args);
-    builder->size += len;
+        va_start(args, format);
+        vsnprintf(chunk->data, chunk->capacity, format, args);
+        va_end(args);
+    }
 
-    va_end(args);
+    builder->tail->size += (size_t) len;
+    builder->size       += (size_t) len;
+}
+
+void string_builder_append_chunk(string_builder* builder, string_chunk* chunk)
+{
+    LOG_ASSERT(builder != NULL, return);
+    LOG_ASSERT(chunk != NULL, return);
+
+    chunk->next = NULL;
+    if (builder->tail)
+        builder->tail->next = chunk;
+    else
+        builder->head = chunk;
+
+    builder->tail  = chunk;
+    builder->size += chunk->size;
+}
+
+string_chunk* string_builder_release(string_builder* builder)
+{
+    LOG_ASSERT(builder != NULL, return NULL);
+
+    string_chunk* chunks = builder->head;
+    *builder = {};
+
+    return chunks;
+}
+
+void string_builder_copy_range(const string_builder* builder, size_t start, size_t length,
+                               char* dest)
+{
+    LOG_ASSERT(builder != NULL, return);
+    LOG_ASSERT(dest != NULL, return);
+    LOG_ASSERT(start + length <= builder->size, return);
+
+    for (const string_chunk* chunk = builder->head; chunk && length > 0; chunk = chunk->next)
+    {
+        if (start >= chunk->size)
+        {
+            start -= chunk->size;
+            continue;
+        }
+
+        size_t part = chunk->size - start;
+        if (part > length) part = length;
+
+        memcpy(dest, chunk->data + start, part);
+        dest   += part;
+        length -= part;
+        start   = 0;
+    }
 }
 
 char *string_builder_get_string(const string_builder *builder)
 {
-    return strndup(builder->data, builder->size);
+    LOG_ASSERT(builder != NULL, return NULL);
+
+    char* str = (char*) calloc(builder->size + 1, sizeof(char));
+    LOG_ASSERT_ERROR(str != NULL, return NULL, "Failed to allocate memory", NULL);
+
+    string_builder_copy_range(builder, 0, builder->size, str);
+    return str;
 }
 
 void string_builder_print(const string_builder *builder, FILE *stream)
 {
+    LOG_ASSERT(stream != NULL, return);
+
+    /* Text, already buffered by stream, must precede builder contents */
+    fflush(stream);
+
     int fd = fileno(stream);
     string_builder_write(builder, fd);
 }
 
 void string_builder_write(const string_builder *builder, int fd)
 {
-    write(fd, builder->data, builder->size * sizeof(char));
-}
+    LOG_ASSERT(builder != NULL, return);
 
-void ensure_fit(string_builder *builder, size_t new_size)
-{
-    size_t new_cap = get_min_cap(new_size);
-    if (new_cap > builder->capacity)
+    iovec vecs[WRITE_BATCH] = {};
+
+    const string_chunk* chunk = builder->head;
+    size_t offset = 0;
+    while (chunk)
     {
-        builder->capacity = new_cap;
-        builder->data = (char*) reallocarray(builder->data, builder->capacity, sizeof(char));
+        int count = 0;
+        for (const string_chunk* cur = chunk; cur && count < WRITE_BATCH; cur = cur->next)
+        {
+            size_t skip = cur == chunk ? offset : 0;
+            vecs[count++] = {
+                .iov_base = cur->data + skip,
+                .iov_len  = cur->size - skip
+            };
+        }
+
+        ssize_t written = writev(fd, vecs, count);
+        if (written < 0 && errno == EINTR) continue;
+        LOG_ASSERT_ERROR(written >= 0, return, "Failed to write string", NULL);
+
+        /* Writes may be partial, so position is advanced by written size */
+        size_t left = (size_t) written;
+        while (chunk && left >= chunk->size - offset)
+        {
+            left  -= chunk->size - offset;
+            offset = 0;
+            chunk  = chunk->next;
+        }
+        offset += left;
     }
 }
+
+static string_chunk* add_chunk(string_builder* builder, size_t min_cap)
+{
+    /* Chunks grow with string, as in contiguous builder */
+    size_t cap = builder->tail ? 2 * builder->tail->capacity : DEFAULT_CAP;
+    if (cap > MAX_CHUNK_CAP) cap = MAX_CHUNK_CAP;
+    if (cap < min_cap) cap = min_cap;
+
+    string_chunk* chunk = (string_chunk*) malloc(sizeof(*chunk) + cap * sizeof(char));
+    LOG_ASSERT_ERROR(chunk != NULL, return NULL, "Failed to allocate memory", NULL);
+
+    *chunk = {
+        .next     = NULL,
+        .data     = (char*) (chunk + 1),
+        .capacity = cap,
+        .size     = 0
+    };
+
+    string_builder_append_chunk(builder, chunk);
+    return chunk;
+}
@@ -1,26 +1,163 @@
+/**
+ * @file string_builder.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Growing string, stored as list of chunks
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Appended text is never moved: when last chunk is full, new chunk
+ * is added to list. String is flattened only upon explicit request,
+ * output writes all chunks at once with `writev()`.
+ */
+
 #ifndef STRING_BUILDER_H
 #define STRING_BUILDER_H
 
 #include <stdio.h>
 
-struct string_builder
+/**
+ * @brief Part of built string. Chunk and its data are single allocation,
+ * released with `free()`
+ */
+struct string_chunk
 {
+    string_chunk* next;
     char* data;
     size_t capacity;
     size_t size;
 };
 
-/* TODO: docs */
+struct string_builder
+{
+    string_chunk* head;
+    string_chunk* tail;
+    /**
+     * @brief Total length of string
+     */
+    size_t size;
+};
 
+/**
+ * @brief Construct string builder
+ *
+ * @param[out] builder Constructed builder
+ * @param[in] str Initial contents. Ignored if set to `NULL`
+ */
 void string_builder_ctor(string_builder* builder, const char* str = NULL);
+
+/**
+ * @brief Construct copy of string builder. Copy is stored in single chunk
+ *
+ * @param[out] dest Constructed builder
+ * @param[in] src Copied builder
+ */
 void string_builder_copy(string_builder* dest, const string_builder* src);
+
+/**
+ * @brief Destroy string builder, freeing all chunks
+ *
+ * @param[inout] builder Destroyed builder
+ */
 void string_builder_dtor(string_builder* builder);
+
+/**
+ * @brief Append single character
+ *
+ * @param[inout] builder String builder
+ * @param[in] c Appended character
+ */
 void string_builder_append(string_builder* builder, char c);
+
+/**
+ * @brief Append null-terminated string
+ *
+ * @param[inout] builder String builder
+ * @param[in] str Appended string
+ */
 void string_builder_append(string_builder* builder, const char* str);
+
+/**
+ * @brief Append first `length` characters of string
+ *
+ * @param[inout] builder String builder
+ * @param[in] str String, not necessarily null-terminated
+ * @param[in] length Number of appended characters
+ */
+void string_builder_append_n(string_builder* builder, const char* str, size_t length);
+
+/**
+ * @brief Append number, formatted same as with `"%g"`, without parsing
+ * format string
+ *
+ * @param[inout] builder String builder
+ * @param[in] num Appended number
+ */
+void string_builder_append_number(string_builder* builder, double num);
+
+/**
+ * @brief Append text, formatted as with `printf()`
+ *
+ * @param[inout] builder String builder
+ * @param[in] format Format string
+ * @param[in] ... Format arguments
+ */
 void string_builder_append_format(string_builder* builder, const char* format, ...)
     __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Append chunk to string without copying its contents
+ *
+ * @param[inout] builder String builder
+ * @param[in] chunk Single chunk, owned by builder afterwards
+ */
+void string_builder_append_chunk(string_builder* builder, string_chunk* chunk);
+
+/**
+ * @brief Take all chunks of string, leaving builder empty
+ *
+ * @param[inout] builder String builder
+ * @return List of chunks, owned by caller
+ */
+string_chunk* string_builder_release(string_builder* builder);
+
+/**
+ * @brief Copy part of string into buffer
+ *
+ * @param[in] builder String builder
+ * @param[in] start Offset of first copied character
+ * @param[in] length Number of copied characters
+ * @param[out] dest Buffer of at least `length` characters. No terminating
+ * null character is written
+ */
+void string_builder_copy_range(const string_builder* builder, size_t start, size_t length,
+                               char* dest);
+
+/**
+ * @brief Get contents of string builder as single string
+ *
+ * @param[in] builder String builder
+ * @return Null-terminated string, allocated with `calloc()`
+ */
 char* string_builder_get_string(const string_builder* builder);
+
+/**
+ * @brief Write contents of string builder to stream. Stream is flushed
+ * beforehand
+ *
+ * @param[in] builder String builder
+ * @param[in] stream Output stream
+ */
 void string_builder_print(const string_builder* builder, FILE* stream);
+
+/**
+ * @brief Write contents of string builder to file descriptor without
+ * copying chunks into single buffer
+ *
+ * @param[in] builder String builder
+ * @param[in] fd Output file descriptor
+ */
 void string_builder_write(const string_builder* builder, int fd);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,286 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#include "task_pool.h"
+
+static const long DEQUE_CAPACITY = 4096;
+
+/**
+ * @brief Chase-Lev deque. Owner pushes and pops at bottom, thieves take
+ * tasks from top.
+ */
+struct task_deque
+{
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::atomic<task*>* tasks;
+};
+
+struct task_worker
+{
+    task_pool* pool;
+    size_t index;
+    unsigned int seed;
+    task_deque deque;
+};
+
+static thread_local task_worker* current_worker_ = NULL;
+
+static int   deque_push (task_deque* deque, task* pushed);
+static task* deque_pop  (task_deque* deque);
+static task* deque_steal(task_deque* deque);
+
+static task* find_task(task_worker* worker);
+static void  run_task (task* running);
+static void* worker_loop(void* arg);
+
+int task_pool_ctor(task_pool* pool, size_t worker_count)
+{
+    LOG_ASSERT(pool != NULL, return -1);
+    LOG_ASSERT(current_worker_ == NULL, return -1);
+
+    if (worker_count == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = processors > 0 ? (size_t) processors : 1;
+    }
+
+    pool->workers      = (task_worker*) calloc(worker_count, sizeof(*pool->workers));
+    pool->threads      = (pthread_t*)   calloc(worker_count, sizeof(*pool->threads));
+    pool->worker_count = 0;
+    pool->pending  = 0;
+    pool->sleeping = 0;
+    pool->stopping = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeup, NULL);
+
+    LOG_ASSERT_ERROR(pool->workers && pool->threads,
+        { task_pool_dtor(pool); return -1; },
+        "Failed to allocate memory", NULL);
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        task_worker* worker = &pool->workers[i];
+        worker->pool  = pool;
+        worker->index = i;
+        worker->seed  = (unsigned int) i;
+        worker->deque.top    = 0;
+        worker->deque.bottom = 0;
+        worker->deque.tasks  = (std::atomic<task*>*)
+                                calloc(DEQUE_CAPACITY, sizeof(*worker->deque.tasks));
+        LOG_ASSERT_ERROR(worker->deque.tasks != NULL,
+            { task_pool_dtor(pool); return -1; },
+            "Failed to allocate memory", NULL);
+
+        pool->worker_count++;
+    }
+
+    current_worker_ = &pool->workers[0];
+
+    /* Worker 0 is the calling thread */
+    for (size_t i = 1; i < worker_count; i++)
+        LOG_ASSERT_ERROR(
+            pthread_create(&pool->threads[i], NULL, worker_loop, &pool->workers[i]) == 0,
+            {
+                for (size_t unused = i; unused < worker_count; unused++)
+                    free(pool->workers[unused].deque.tasks);
+                pool->worker_count = i;
+                break;
+            },
+            "Could not start worker thread", NULL);
+
+    return 0;
+}
+
+void task_pool_dtor(task_pool* pool)
+{
+    LOG_ASSERT(pool != NULL, return);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (pool->workers && current_worker_ == &pool->workers[0])
+    {
+        for (size_t i = 1; i < pool->worker_count; i++)
+            pthread_join(pool->threads[i], NULL);
+        current_worker_ = NULL;
+    }
+
+    for (size_t i = 0; i < pool->worker_count; i++)
+        free(pool->workers[i].deque.tasks);
+    free(pool->workers);
+    free(pool->threads);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wakeup);
+
+    pool->workers      = NULL;
+    pool->threads      = NULL;
+    pool->worker_count = 0;
+}
+
+int task_pool_active(void)
+{
+    return current_worker_ && current_worker_->pool->worker_count > 1;
+}
+
+void task_spawn(task* spawned, task_func func, void* arg)
+{
+    LOG_ASSERT(spawned != NULL, return);
+    LOG_ASSERT(func != NULL, return);
+
+    spawned->func = func;
+    spawned->arg  = arg;
+    spawned->done = 0;
+
+    task_worker* worker = current_worker_;
+    if (!worker || worker->pool->worker_count == 1)
+    {
+        run_task(spawned);
+        return;
+    }
+
+    task_pool* pool = worker->pool;
+
+    /* Counted before push, so that sleeping worker, which sees no pending
+       tasks, is guaranteed to be seen by us and woken up */
+    pool->pending++;
+    if (!deque_push(&worker->deque, spawned))
+    {
+        pool->pending--;
+        run_task(spawned);
+        return;
+    }
+
+    if (pool->sleeping.load() > 0)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wakeup);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+void task_wait(task* spawned)
+{
+    LOG_ASSERT(spawned != NULL, return);
+
+    task_worker* worker = current_worker_;
+
+    while (!spawned->done.load(std::memory_order_acquire))
+    {
+        task* other = worker ? find_task(worker) : NULL;
+        if (other)
+            run_task(other);
+        else
+            sched_yield();
+    }
+}
+
+static void* worker_loop(void* arg)
+{
+    task_worker* worker = (task_worker*) arg;
+    task_pool* pool = worker->pool;
+    current_worker_ = worker;
+
+    while (!pool->stopping.load())
+    {
+        task* found = find_task(worker);
+        if (found)
+        {
+            run_task(found);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->sleeping++;
+        while (pool->pending.load() <= 0 && !pool->stopping.load())
+            pthread_cond_wait(&pool->wakeup, &pool->lock);
+        pool->sleeping--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    current_worker_ = NULL;
+    return NULL;
+}
+
+static task* find_task(task_worker* worker)
+{
+    task_pool* pool = worker->pool;
+
+    task* found = deque_pop(&worker->deque);
+
+    /* Victims are tried in order starting from random one, so that thieves
+       do not contend for the same deque */
+    size_t start = (size_t) rand_r(&worker->seed);
+    for (size_t i = 0; !found && i < pool->worker_count; i++)
+    {
+        size_t victim = (start + i) % pool->worker_count;
+        if (victim != worker->index)
+            found = deque_steal(&pool->workers[victim].deque);
+    }
+
+    if (found) pool->pending--;
+    return found;
+}
+
+static void run_task(task* running)
+{
+    running->func(running->arg);
+    running->done.store(1, std::memory_order_release);
+}
+
+/**
+ * @return 1 upon success, 0 if deque is full
+ */
+static int deque_push(task_deque* deque, task* pushed)
+{
+    long bottom = deque->bottom.load();
+    if (bottom - deque->top.load() >= DEQUE_CAPACITY)
+        return 0;
+
+    deque->tasks[bottom % DEQUE_CAPACITY].store(pushed);
+    deque->bottom.store(bottom + 1);
+    return 1;
+}
+
+static task* deque_pop(task_deque* deque)
+{
+    long bottom = deque->bottom.load() - 1;
+    deque->bottom.store(bottom);
+    long top = deque->top.load();
+
+    if (top > bottom)
+    {
+        deque->bottom.store(bottom + 1);
+        return NULL;
+    }
+
+    task* popped = deque->tasks[bottom % DEQUE_CAPACITY].load();
+    if (top == bottom)
+    {
+        /* Last task, race with thieves */
+        if (!deque->top.compare_exchange_strong(top, top + 1))
+            popped = NULL;
+        deque->bottom.store(bottom + 1);
+    }
+
+    return popped;
+}
+
+static task* deque_steal(task_deque* deque)
+{
+    long top = deque->top.load();
+    if (top >= deque->bottom.load())
+        return NULL;
+
+    task* stolen = deque->tasks[top % DEQUE_CAPACITY].load();
+    if (!deque->top.compare_exchange_strong(top, top + 1))
+        return NULL;
+
+    return stolen;
+}
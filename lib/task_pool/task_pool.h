@@ -0,0 +1,106 @@
+/**
+ * @file task_pool.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ * @brief Work-stealing scheduler for fork-join parallelism
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @note Every worker pushes spawned tasks to its own deque and takes them
+ * back in LIFO order, idle workers steal the oldest tasks of others. Thread,
+ * which constructed the pool, is its first worker. Threads, which are not
+ * workers of any pool, run spawned tasks immediately, so code using tasks
+ * works the same way without a pool.
+ */
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include <atomic>
+
+typedef void (*task_func)(void* arg);
+
+/**
+ * @brief Spawned function call
+ * @warning Task MUST NOT be moved or destroyed until `task_wait` returns
+ */
+struct task
+{
+    task_func func;
+    void* arg;
+    std::atomic<int> done;
+};
+
+struct task_worker;
+
+/**
+ * @brief Set of worker threads
+ * @warning Pool MUST NOT be moved after construction
+ */
+struct task_pool
+{
+    task_worker* workers;
+    size_t worker_count;
+    pthread_t* threads;
+
+    /**
+     * @brief Number of tasks in deques, which are not taken by any worker
+     */
+    std::atomic<long> pending;
+    /**
+     * @brief Number of workers waiting for tasks
+     */
+    std::atomic<long> sleeping;
+    std::atomic<int> stopping;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+};
+
+/**
+ * @brief Create pool and make calling thread its first worker
+ *
+ * @param[out] pool Constructed pool
+ * @param[in] worker_count Number of workers including calling thread,
+ * 0 for number of processors
+ * @return 0 upon success, -1 otherwise
+ */
+int task_pool_ctor(task_pool* pool, size_t worker_count = 0);
+
+/**
+ * @brief Stop worker threads and destroy pool. MUST be called by thread,
+ * which constructed the pool, when no tasks are running.
+ *
+ * @param[inout] pool `task_pool` instance to be destroyed
+ */
+void task_pool_dtor(task_pool* pool);
+
+/**
+ * @brief Check whether tasks spawned by current thread may run concurrently
+ *
+ * @return 1 if current thread is a worker of pool with several workers,
+ * 0 otherwise
+ */
+int task_pool_active(void);
+
+/**
+ * @brief Schedule call of `func(arg)`
+ *
+ * @param[out] spawned Task, which is used for waiting
+ * @param[in] func Called function
+ * @param[in] arg Function argument
+ */
+void task_spawn(task* spawned, task_func func, void* arg);
+
+/**
+ * @brief Wait until task is finished, running other tasks meanwhile
+ *
+ * @param[inout] spawned Task, which was spawned by current thread
+ */
+void task_wait(task* spawned);
+
+#endif
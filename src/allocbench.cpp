@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "lexer.h"
+#include "parser.h"
+
+#include "diff_utils.h"
+
+/* Allocation functions are wrapped by linker (see `--wrap` options of this
+ * target), so that every call from lexer and parser is counted */
+extern "C"
+{
+void* __real_malloc      (size_t size);
+void* __real_calloc      (size_t count, size_t size);
+void* __real_realloc     (void* ptr, size_t size);
+void* __real_reallocarray(void* ptr, size_t count, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+void* __wrap_malloc      (size_t size);
+void* __wrap_calloc      (size_t count, size_t size);
+void* __wrap_realloc     (void* ptr, size_t size);
+void* __wrap_reallocarray(void* ptr, size_t count, size_t size);
+void* __wrap_aligned_alloc(size_t alignment, size_t size);
+}
+
+/**
+ * @brief Allocations made since last `reset_counters()`
+ */
+struct alloc_counters
+{
+    size_t calls;
+    size_t bytes;
+};
+
+static alloc_counters counters = {};
+
+static inline void reset_counters(void) { counters = {}; }
+
+static inline void count_allocation(size_t bytes)
+{
+    counters.calls++;
+    counters.bytes += bytes;
+}
+
+static size_t count_subtree(const ast_node* node);
+
+/**
+ * Usage: allocbench <Funcfile>
+ *
+ * Reports number of heap allocations made by `parse_tokens()` and
+ * `build_tree()` (which reads tokens from lexer one by one) for function
+ * from Funcfile. Input is processed twice and the second run is reported,
+ * so that one-time allocations (such as interning variable names) are not
+ * counted.
+ */
+int main(int argc, const char** argv)
+{
+    add_default_file_logger();
+    add_logger({
+        .name = "Console Logger",
+        .stream = stderr,
+        .logging_level = LOG_ERROR,
+        .settings_mask = LGS_KEEP_OPEN | LGS_USE_ESCAPE
+    });
+
+    LOG_ASSERT_ERROR(argc == 2, return 1, "Usage: %s <Funcfile>", argv[0]);
+
+    prog_state state = {};
+    LOG_ASSERT(prog_init(&state, argv[1]) == 0, {prog_state_dtor(&state); return 1;});
+
+    alloc_counters lexer  = {};
+    alloc_counters parser = {};
+    size_t token_count = 0;
+    size_t node_count  = 0;
+
+    for (int run = 0; run < 2; run++)
+    {
+        reset_counters();
+        dynamic_array(token)* tokens = parse_tokens(state.function);
+        lexer = counters;
+        LOG_ASSERT(tokens != NULL, {prog_state_dtor(&state); return 1;});
+
+        token_count = tokens->size;
+        array_dtor(tokens);
+        free(tokens);
+
+        reset_counters();
+        abstract_syntax_tree* ast = build_tree(state.function);
+        parser = counters;
+        LOG_ASSERT(ast != NULL, {prog_state_dtor(&state); return 1;});
+
+        node_count = count_subtree(ast->root);
+        tree_dtor(ast);
+    }
+
+    printf("%zu characters, %zu tokens, %zu nodes\n",
+           strlen(state.function), token_count, node_count);
+    printf("lexer:  %zu allocations, %zu bytes\n", lexer.calls,  lexer.bytes);
+    printf("parser: %zu allocations, %zu bytes\n", parser.calls, parser.bytes);
+
+    prog_state_dtor(&state);
+    return 0;
+}
+
+static size_t count_subtree(const ast_node* node)
+{
+    if (!node) return 0;
+    return 1 + count_subtree(node->left) + count_subtree(node->right);
+}
+
+void* __wrap_malloc(size_t size)
+{
+    count_allocation(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    count_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    count_allocation(size);
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_reallocarray(void* ptr, size_t count, size_t size)
+{
+    count_allocation(count * size);
+    return __real_reallocarray(ptr, count, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size)
+{
+    count_allocation(size);
+    return __real_aligned_alloc(alignment, size);
+}
@@ -0,0 +1,340 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "logger.h"
+
+#include "diff_utils.h"
+
+/**
+ * @brief Funcfiles to be processed and shared progress of workers
+ */
+struct batch
+{
+    char** funcfiles;
+    size_t count;
+    size_t capacity;
+
+    const char* output_dir;
+    int compile;
+    unsigned int seed;
+
+    /**
+     * @brief Cache shared by workers, `NULL` if disabled
+     */
+    formula_cache* cache;
+
+    /**
+     * @brief Index of next unclaimed Funcfile
+     */
+    std::atomic<size_t> next;
+    std::atomic<size_t> failed;
+
+    /**
+     * @brief Number of Funcfile among ones with the same name, starting
+     * from 1, or 0 if its name is unique
+     */
+    size_t* copy_numbers;
+};
+
+/**
+ * @brief Funcfile name with its index in batch
+ */
+struct job_name
+{
+    const char* basename;
+    size_t index;
+};
+
+static const size_t DEFAULT_CACHE_SIZE = 64 << 20;
+
+static int  batch_add(batch* jobs, const char* path);
+static int  batch_add_dir(batch* jobs, const char* dirname);
+static int  batch_number_copies(batch* jobs);
+static int  compare_names(const void* name1, const void* name2);
+static const char* get_basename(const char* path);
+static void batch_dtor(batch* jobs);
+static void* worker(void* arg);
+static int  run_job(batch* jobs, size_t index);
+static double now(void);
+
+/**
+ * Usage: mathbatch [-j <threads>] [-o <output directory>] [--tex-only]
+ *                  [--no-cache] [--cache-size <megabytes>]
+ *                  <Funcfile or directory>...
+ *
+ * Builds article for every Funcfile in `<output directory>/<Funcfile name>`.
+ * Funcfiles with the same name (such as `a/Funcfile` and `b/Funcfile`) are
+ * placed in `<output directory>/<Funcfile name>/<number>` in order of
+ * arguments instead. Directories are searched for Funcfiles non-recursively. Derivatives and
+ * series are cached in `<output directory>/.formula_cache` between runs.
+ */
+int main(int argc, const char** argv)
+{
+    /* Loggers are not modified after this point, so that workers only read them */
+    add_default_file_logger();
+    add_logger({
+        .name = "Console Logger",
+        .stream = stderr,
+        .logging_level = LOG_ERROR,
+        .settings_mask = LGS_KEEP_OPEN | LGS_USE_ESCAPE
+    });
+
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    batch jobs = {};
+    jobs.output_dir = "output";
+    jobs.compile    = 1;
+    jobs.seed       = (unsigned int) time(NULL);
+
+    int use_cache = 1;
+    size_t cache_size = DEFAULT_CACHE_SIZE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = strtol(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            jobs.output_dir = argv[++i];
+        else if (strcmp(argv[i], "--tex-only") == 0)
+            jobs.compile = 0;
+        else if (strcmp(argv[i], "--no-cache") == 0)
+            use_cache = 0;
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc)
+            cache_size = strtoul(argv[++i], NULL, 10) << 20;
+        else
+        {
+            struct stat info = {};
+            int added = stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode)
+                      ? batch_add_dir(&jobs, argv[i])
+                      : batch_add(&jobs, argv[i]);
+            LOG_ASSERT(added == 0, { batch_dtor(&jobs); return 1; });
+        }
+    }
+
+    LOG_ASSERT_ERROR(jobs.count > 0, { batch_dtor(&jobs); return 1; },
+        "Usage: %s [-j <threads>] [-o <output directory>] [--tex-only] "
+        "[--no-cache] [--cache-size <megabytes>] <Funcfile or directory>...", argv[0]);
+    LOG_ASSERT_ERROR(threads > 0, { batch_dtor(&jobs); return 1; },
+        "Invalid number of threads: %ld", threads);
+
+    if ((size_t) threads > jobs.count)
+        threads = (long) jobs.count;
+
+    LOG_ASSERT(batch_number_copies(&jobs) == 0, { batch_dtor(&jobs); return 1; });
+
+    mkdir(jobs.output_dir, 0755);
+
+    formula_cache cache = {};
+    if (use_cache)
+    {
+        char* cache_file = NULL;
+        if (asprintf(&cache_file, "%s/.formula_cache", jobs.output_dir) > 0
+            && formula_cache_ctor(&cache, cache_file, cache_size) == 0)
+            jobs.cache = &cache;
+        free(cache_file);
+    }
+
+    pthread_t* workers = (pthread_t*) calloc((size_t) threads, sizeof(*workers));
+    LOG_ASSERT_ERROR(workers != NULL, { batch_dtor(&jobs); return 1; },
+        "Failed to allocate memory", NULL);
+
+    double start = now();
+
+    /* Main thread is a worker too */
+    long started = 1;
+    for (; started < threads; started++)
+        if (pthread_create(&workers[started], NULL, worker, &jobs) != 0)
+            break;
+    worker(&jobs);
+    for (long i = 1; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    double elapsed = now() - start;
+
+    size_t failed = jobs.failed.load();
+    printf("%zu Funcfiles (%zu failed) in %.3lfs using %ld threads, %.1lf per second\n",
+           jobs.count, failed, elapsed, started,
+           elapsed > 0 ? (double) jobs.count / elapsed : 0.0);
+
+    if (jobs.cache)
+    {
+        formula_cache_save(&cache);
+        formula_cache_stats stats = formula_cache_get_stats(&cache);
+        printf("Formula cache: %zu hits, %zu misses, %zu evicted, %zu entries (%zu bytes)\n",
+               stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes);
+        formula_cache_dtor(&cache);
+    }
+
+    free(workers);
+    batch_dtor(&jobs);
+    return failed == 0 ? 0 : 1;
+}
+
+static int batch_add(batch* jobs, const char* path)
+{
+    if (jobs->count == jobs->capacity)
+    {
+        size_t capacity = jobs->capacity ? jobs->capacity * 2 : 16;
+        char** funcfiles = (char**) realloc(jobs->funcfiles, capacity * sizeof(*funcfiles));
+        LOG_ASSERT_ERROR(funcfiles != NULL, return -1, "Failed to allocate memory", NULL);
+
+        jobs->funcfiles = funcfiles;
+        jobs->capacity  = capacity;
+    }
+
+    jobs->funcfiles[jobs->count] = strdup(path);
+    LOG_ASSERT_ERROR(jobs->funcfiles[jobs->count] != NULL, return -1,
+        "Failed to allocate memory", NULL);
+    jobs->count++;
+
+    return 0;
+}
+
+static int batch_add_dir(batch* jobs, const char* dirname)
+{
+    DIR* dir = opendir(dirname);
+    LOG_ASSERT_ERROR(dir != NULL, return -1, "Could not open directory '%s'", dirname);
+
+    int result = 0;
+    while (const dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] == '.') continue;
+
+        char* path = NULL;
+        LOG_ASSERT(asprintf(&path, "%s/%s", dirname, entry->d_name) > 0,
+                    { result = -1; break; });
+
+        struct stat info = {};
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode))
+            result = batch_add(jobs, path);
+        free(path);
+
+        if (result != 0) break;
+    }
+
+    closedir(dir);
+    return result;
+}
+
+static int batch_number_copies(batch* jobs)
+{
+    jobs->copy_numbers = (size_t*) calloc(jobs->count, sizeof(*jobs->copy_numbers));
+    job_name* names = (job_name*) calloc(jobs->count, sizeof(*names));
+    LOG_ASSERT_ERROR(jobs->copy_numbers != NULL && names != NULL, { free(names); return -1; },
+        "Failed to allocate memory", NULL);
+
+    for (size_t i = 0; i < jobs->count; i++)
+        names[i] = { .basename = get_basename(jobs->funcfiles[i]), .index = i };
+
+    /* Equal names become adjacent, ordered by their position in batch */
+    qsort(names, jobs->count, sizeof(*names), compare_names);
+
+    for (size_t first = 0, last = 0; first < jobs->count; first = last)
+    {
+        last = first + 1;
+        while (last < jobs->count && strcmp(names[first].basename, names[last].basename) == 0)
+            last++;
+
+        if (last - first == 1) continue;
+
+        for (size_t i = first; i < last; i++)
+            jobs->copy_numbers[names[i].index] = i - first + 1;
+    }
+
+    free(names);
+    return 0;
+}
+
+static int compare_names(const void* name1, const void* name2)
+{
+    const job_name* job1 = (const job_name*) name1;
+    const job_name* job2 = (const job_name*) name2;
+
+    int result = strcmp(job1->basename, job2->basename);
+    if (result != 0) return result;
+
+    return job1->index < job2->index ? -1 : job1->index > job2->index;
+}
+
+static const char* get_basename(const char* path)
+{
+    const char* basename = strrchr(path, '/');
+    return basename ? basename + 1 : path;
+}
+
+static void batch_dtor(batch* jobs)
+{
+    for (size_t i = 0; i < jobs->count; i++)
+        free(jobs->funcfiles[i]);
+    free(jobs->funcfiles);
+    free(jobs->copy_numbers);
+
+    jobs->funcfiles = NULL;
+    jobs->copy_numbers = NULL;
+    jobs->count     = 0;
+    jobs->capacity  = 0;
+}
+
+static void* worker(void* arg)
+{
+    batch* jobs = (batch*) arg;
+
+    /* Funcfiles are claimed one by one, so that long jobs do not stall
+       threads, which finished early */
+    for (size_t index = jobs->next++; index < jobs->count; index = jobs->next++)
+        if (run_job(jobs, index) != 0)
+            jobs->failed++;
+
+    return NULL;
+}
+
+static int run_job(batch* jobs, size_t index)
+{
+    const char* funcfile = jobs->funcfiles[index];
+    size_t copy_number = jobs->copy_numbers[index];
+
+    /* Names of duplicates are directories with numbered subdirectories,
+       so they never collide with directories of unique names */
+    char* output_dir = NULL;
+    LOG_ASSERT(asprintf(&output_dir, "%s/%s", jobs->output_dir, get_basename(funcfile)) > 0,
+                return -1);
+    mkdir(output_dir, 0755);
+
+    if (copy_number > 0)
+    {
+        char* copy_dir = NULL;
+        int printed = asprintf(&copy_dir, "%s/%zu", output_dir, copy_number);
+        free(output_dir);
+        LOG_ASSERT(printed > 0, return -1);
+
+        output_dir = copy_dir;
+        mkdir(output_dir, 0755);
+    }
+
+    prog_state state = {};
+    int result = prog_init(&state, funcfile);
+    if (result == 0)
+        result = write_article(&state, output_dir, jobs->seed ^ (unsigned int) index,
+                               jobs->compile, jobs->cache);
+
+    prog_state_dtor(&state);
+    free(output_dir);
+
+    LOG_ASSERT_ERROR(result == 0, return -1,
+        "Could not build article for '%s'", funcfile);
+    return 0;
+}
+
+static double now(void)
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
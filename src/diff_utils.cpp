@@ -3,8 +3,39 @@
 
 #include "logger.h"
 
+#include "parser.h"
+#include "tree_math.h"
+#include "article_builder.h"
+#include "plot.h"
+#include "task_pool.h"
+#include "formula_cache.h"
+
 #include "diff_utils.h"
 
+enum analysis_type
+{
+    ANALYSIS_DERIVATIVE,
+    ANALYSIS_TAYLOR
+};
+
+/**
+ * @brief Section of article, which is independent of others
+ */
+struct analysis
+{
+    analysis_type type;
+    const char* title;
+    abstract_syntax_tree* ast;
+    const char* var_name;
+    double point;
+    int pow;
+    article_builder text;
+    formula_cache* cache;
+    abstract_syntax_tree* result;
+};
+
+static void run_analysis(void* arg);
+
 int prog_init(prog_state *state, const char *filename)
 {
     FILE* input = fopen(filename, "r");
@@ -65,3 +96,104 @@ void prog_state_dtor(prog_state *state)
     free(state->var_name);
     memset(state, 0, sizeof(*state));
 }
+
+int write_article(const prog_state* state, const char* output_dir,
+                  unsigned int seed, int compile, formula_cache* cache)
+{
+    abstract_syntax_tree* ast = build_tree(state->function);
+    LOG_ASSERT(ast != NULL, return -1);
+
+    article_builder article = {};
+    article_ctor(&article);
+    article_set_seed(&article, seed);
+    article_use_preamble(&article, "assets/preamble.sty");
+    article_use_starters(&article, "assets/starters.txt");
+    article_use_transitions(&article, "assets/transitions.txt");
+    article_use_placeholders(&article, "assets/placeholders.txt");
+
+    article_start(&article);
+    article_add_abstract(&article, "Wonderful article");
+
+    analysis sections[] = {
+        {
+            .type = ANALYSIS_DERIVATIVE, .title = "Derivative", .ast = ast,
+            .var_name = state->var_name, .point = 0, .pow = 0, .text = {},
+            .cache = cache, .result = NULL
+        },
+        {
+            .type = ANALYSIS_TAYLOR, .title = "Taylor series", .ast = ast,
+            .var_name = state->var_name, .point = state->taylor_at, .pow = state->taylor_pow,
+            .text = {}, .cache = cache, .result = NULL
+        },
+        {
+            .type = ANALYSIS_TAYLOR, .title = "Tangent", .ast = ast,
+            .var_name = state->var_name, .point = state->tangent_at, .pow = 1,
+            .text = {}, .cache = cache, .result = NULL
+        }
+    };
+    const size_t section_count = sizeof(sections) / sizeof(*sections);
+
+    /* Sections are computed concurrently, but joined in order, so that
+       article does not depend on scheduling */
+    task tasks[section_count] = {};
+    for (size_t i = 0; i < section_count; i++)
+    {
+        article_fork(&article, &sections[i].text);
+        task_spawn(&tasks[i], run_analysis, &sections[i]);
+    }
+    for (size_t i = 0; i < section_count; i++)
+    {
+        task_wait(&tasks[i]);
+        article_add_section(&article, sections[i].title);
+        article_join(&article, &sections[i].text);
+    }
+
+    abstract_syntax_tree* deriv   = sections[0].result;
+    abstract_syntax_tree* taylor  = sections[1].result;
+    abstract_syntax_tree* tangent = sections[2].result;
+
+    int result = deriv && taylor && tangent ? 0 : -1;
+
+    if (compile && tangent)
+    {
+        char* plot = NULL;
+        if (asprintf(&plot, "%s/plot.png", output_dir) > 0)
+            plot_tangent(ast, tangent, plot, state->range_start, state->range_end);
+        free(plot);
+        string_builder_append(&article.text, "\\includegraphics{\"plot.png\"}\n");
+    }
+
+    article_end(&article);
+
+    if (compile)
+        article_build(&article, output_dir);
+    else
+        article_write(&article, output_dir);
+
+    tree_dtor(ast);
+    if (deriv)   tree_dtor(deriv);
+    if (taylor)  tree_dtor(taylor);
+    if (tangent) tree_dtor(tangent);
+    article_dtor(&article);
+    return result;
+}
+
+static void run_analysis(void* arg)
+{
+    analysis* section = (analysis*) arg;
+
+    switch (section->type)
+    {
+    case ANALYSIS_DERIVATIVE:
+        section->result = cached_derivative(section->cache, section->ast,
+                                            section->var_name, &section->text);
+        break;
+    case ANALYSIS_TAYLOR:
+        section->result = cached_taylor_series(section->cache, section->ast, section->point,
+                                               section->var_name, section->pow,
+                                               &section->text);
+        break;
+    default:
+        LOG_ASSERT(0 && "Invalid enum value.", return);
+    }
+}
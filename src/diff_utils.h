@@ -1,6 +1,8 @@
 #ifndef DIFF_UTILS_H
 #define DIFF_UTILS_H
 
+#include "formula_cache.h"
+
 struct prog_state
 {
     char* function;
@@ -15,4 +17,7 @@ struct prog_state
 int prog_init(prog_state* state, const char* filename);
 void prog_state_dtor(prog_state* state);
 
+int write_article(const prog_state* state, const char* output_dir,
+                  unsigned int seed, int compile, formula_cache* cache = NULL);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "logger.h"
+
+#include "parser.h"
+#include "dag_math.h"
+#include "tree_math.h"
+
+#include "diff_utils.h"
+
+static int write_kernel(abstract_syntax_tree* ast, const char* funcfile,
+                        const char* name, FILE* source, FILE* header);
+
+/**
+ * Usage: funcgen <Funcfile> <output directory> <function name>
+ *
+ * Writes `<name>.h` and `<name>.cpp`, defining `<name>`, which computes
+ * the function from Funcfile and its partial derivatives at once.
+ */
+int main(int argc, const char** argv)
+{
+    add_default_file_logger();
+    add_logger({
+        .name = "Console Logger",
+        .stream = stderr,
+        .logging_level = LOG_ERROR,
+        .settings_mask = LGS_KEEP_OPEN | LGS_USE_ESCAPE
+    });
+
+    LOG_ASSERT_ERROR(argc == 4, return 1,
+        "Usage: %s <Funcfile> <output directory> <function name>", argv[0]);
+    const char* funcfile = argv[1];
+    const char* out_dir  = argv[2];
+    const char* name     = argv[3];
+
+    prog_state state = {};
+    LOG_ASSERT(prog_init(&state, funcfile) == 0, {prog_state_dtor(&state); return 1;});
+
+    abstract_syntax_tree* ast = build_tree(state.function);
+    LOG_ASSERT(ast != NULL, {prog_state_dtor(&state); return 1;});
+
+    char* source_name = NULL;
+    char* header_name = NULL;
+    LOG_ASSERT(asprintf(&source_name, "%s/%s.cpp", out_dir, name) > 0, return 1);
+    LOG_ASSERT(asprintf(&header_name, "%s/%s.h",   out_dir, name) > 0, return 1);
+
+    FILE* source = fopen(source_name, "w");
+    FILE* header = fopen(header_name, "w");
+
+    int status = 1;
+    LOG_ASSERT_ERROR(source != NULL && header != NULL, goto cleanup,
+        "Could not open output files in '%s'", out_dir);
+
+    status = write_kernel(ast, funcfile, name, source, header) == 0 ? 0 : 1;
+
+cleanup:
+    if (source) fclose(source);
+    if (header) fclose(header);
+    free(source_name);
+    free(header_name);
+    tree_dtor(ast);
+    prog_state_dtor(&state);
+    return status;
+}
+
+static int write_kernel(abstract_syntax_tree* ast, const char* funcfile,
+                        const char* name, FILE* source, FILE* header)
+{
+    size_t var_count = ast->variables.size;
+    size_t count = var_count + 1;
+
+    /* Function itself followed by derivatives in order of variables */
+    ast_node** roots = (ast_node**) calloc(count, sizeof(*roots));
+    LOG_ASSERT_ERROR(roots != NULL, return -1, "Failed to allocate memory", NULL);
+
+    expr_dag dag = {};
+    dag_ctor(&dag);
+    node_arena* prev_arena = node_arena_use(&ast->arena);
+
+    const dag_node* func = dag_from_node(&dag, ast->root);
+    for (size_t i = 0; i < var_count; i++)
+    {
+        var_name var = *array_get_element(&ast->variables, i);
+        roots[i + 1] = dag_to_node(dag_simplify(&dag, dag_differential(&dag, func, var)));
+    }
+
+    node_arena_use(prev_arena);
+    dag_dtor(&dag);
+
+    /* Derivatives are taken from unchanged function, so that both are
+     * computed from the same expression */
+    optimize(ast);
+    roots[0] = ast->root;
+
+    fprintf(header, "/* Generated by funcgen from %s, do not edit */\n\n"
+                    "#ifndef %s_FUNCGEN_H\n#define %s_FUNCGEN_H\n\n"
+                    "#include <stddef.h>\n\n", funcfile, name, name);
+    fprintf(header, "/* res[0] = f(args)");
+    for (size_t i = 0; i < var_count; i++)
+        fprintf(header, ", res[%zu] = df/d%s", i + 1,
+                            symbol_name(*array_get_element(&ast->variables, i)));
+    fprintf(header, " */\n");
+
+    fprintf(source, "/* Generated by funcgen from %s, do not edit */\n\n"
+                    "#include <math.h>\n#include <stddef.h>\n\n"
+                    "#include \"%s.h\"\n\n", funcfile, name);
+
+    int result = codegen_nodes(roots, count, &ast->variables, name, source, header);
+
+    fprintf(header, "\n#endif\n");
+
+    free(roots);
+    return result;
+}
@@ -0,0 +1,261 @@
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#include "parser.h"
+#include "flat_tree.h"
+
+#include "diff_utils.h"
+
+/**
+ * @brief Trees, traversed by benchmarks
+ */
+struct bench_input
+{
+    const ast_node* root;
+    const flat_tree* tree;
+    uint32_t flat_root;
+
+    var_name var;
+    size_t var_id;
+
+    /**
+     * @brief Flags for `flat_find_depends()`, one per flat tree node
+     */
+    uint8_t* depends;
+};
+
+/**
+ * @brief Single traversal, returns value, which prevents it from being
+ * optimized out
+ */
+typedef size_t (*traversal)(bench_input* input);
+
+struct bench_result
+{
+    double seconds;
+    /**
+     * @brief Cache misses counted by hardware, -1 if counter is unavailable
+     */
+    long long cache_misses;
+    size_t checksum;
+};
+
+static const size_t DEFAULT_REPEATS = 1000;
+
+static bench_result run_bench(traversal func, bench_input* input, size_t repeats, int counter);
+static void print_result(const char* name, bench_result pointer, bench_result flat, size_t repeats);
+
+static size_t pointer_count  (bench_input* input);
+static size_t flat_count     (bench_input* input);
+static size_t pointer_depends(bench_input* input);
+static size_t flat_depends   (bench_input* input);
+
+static size_t count_subtree  (const ast_node* node);
+static int    depends_subtree(const ast_node* node, var_name var, size_t* count);
+
+static int    open_cache_counter(void);
+static double now(void);
+
+/**
+ * Usage: treebench <Funcfile> [repeats]
+ *
+ * Compares traversals of pointer-linked syntax tree of function from
+ * Funcfile with traversals of its flat copy. Every traversal is repeated
+ * `repeats` times, total time and cache misses (if hardware counters are
+ * accessible) are reported. Numbers are only comparable within one build.
+ */
+int main(int argc, const char** argv)
+{
+    add_default_file_logger();
+    add_logger({
+        .name = "Console Logger",
+        .stream = stderr,
+        .logging_level = LOG_ERROR,
+        .settings_mask = LGS_KEEP_OPEN | LGS_USE_ESCAPE
+    });
+
+    LOG_ASSERT_ERROR(argc == 2 || argc == 3, return 1,
+        "Usage: %s <Funcfile> [repeats]", argv[0]);
+    size_t repeats = argc == 3 ? strtoul(argv[2], NULL, 10) : DEFAULT_REPEATS;
+    LOG_ASSERT_ERROR(repeats > 0, return 1, "Invalid number of repeats: '%s'", argv[2]);
+
+    prog_state state = {};
+    LOG_ASSERT(prog_init(&state, argv[1]) == 0, {prog_state_dtor(&state); return 1;});
+
+    abstract_syntax_tree* ast = build_tree(state.function);
+    LOG_ASSERT(ast != NULL, {prog_state_dtor(&state); return 1;});
+    LOG_ASSERT_ERROR(ast->variables.size > 0, {tree_dtor(ast); prog_state_dtor(&state); return 1;},
+        "Function in '%s' has no variables", argv[1]);
+
+    flat_tree tree = {};
+    flat_tree_ctor(&tree);
+
+    bench_input input = {
+        .root      = ast->root,
+        .tree      = &tree,
+        .flat_root = flat_from_node(&tree, ast->root, &ast->variables),
+        .var       = *array_get_element(&ast->variables, 0),
+        .var_id    = 0,
+        .depends   = NULL
+    };
+
+    int status = 1;
+    LOG_ASSERT(input.flat_root != FLAT_NONE, goto cleanup);
+
+    input.depends = (uint8_t*) calloc(tree.size, sizeof(*input.depends));
+    LOG_ASSERT_ERROR(input.depends != NULL, goto cleanup, "Failed to allocate memory", NULL);
+
+    {
+        int counter = open_cache_counter();
+
+        printf("Function of %zu variables, %zu pointer nodes, %zu flat nodes, %zu repeats\n",
+               ast->variables.size, count_subtree(ast->root), tree.size, repeats);
+        if (counter < 0)
+            printf("Hardware cache counter is unavailable, misses are not reported\n");
+        printf("%-16s %12s %12s %16s %16s\n",
+               "traversal", "pointer, ms", "flat, ms", "pointer misses", "flat misses");
+
+        print_result("count nodes",
+                     run_bench(pointer_count, &input, repeats, counter),
+                     run_bench(flat_count,    &input, repeats, counter), repeats);
+        print_result("find depends",
+                     run_bench(pointer_depends, &input, repeats, counter),
+                     run_bench(flat_depends,    &input, repeats, counter), repeats);
+
+        if (counter >= 0) close(counter);
+    }
+
+    status = 0;
+
+cleanup:
+    free(input.depends);
+    flat_tree_dtor(&tree);
+    tree_dtor(ast);
+    prog_state_dtor(&state);
+    return status;
+}
+
+static bench_result run_bench(traversal func, bench_input* input, size_t repeats, int counter)
+{
+    bench_result result = {
+        .seconds = 0,
+        .cache_misses = -1,
+        .checksum = 0
+    };
+
+    /* First traversal brings trees into cache, as in repeated use */
+    result.checksum = func(input);
+
+    if (counter >= 0)
+    {
+        ioctl(counter, PERF_EVENT_IOC_RESET,  0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    double start = now();
+    for (size_t i = 0; i < repeats; i++)
+        result.checksum += func(input);
+    result.seconds = now() - start;
+
+    if (counter >= 0)
+    {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+        long long misses = 0;
+        if (read(counter, &misses, sizeof(misses)) == sizeof(misses))
+            result.cache_misses = misses;
+    }
+
+    return result;
+}
+
+static void print_result(const char* name, bench_result pointer, bench_result flat, size_t repeats)
+{
+    /* Both traversals compute the same values */
+    LOG_ASSERT_ERROR(pointer.checksum == flat.checksum, return,
+        "Traversals '%s' disagree: %zu and %zu", name, pointer.checksum / (repeats + 1),
+                                                 flat.checksum / (repeats + 1));
+
+    printf("%-16s %12.3lf %12.3lf", name, pointer.seconds * 1e3, flat.seconds * 1e3);
+    if (pointer.cache_misses >= 0 && flat.cache_misses >= 0)
+        printf(" %16lld %16lld", pointer.cache_misses, flat.cache_misses);
+    printf("\n");
+}
+
+static size_t pointer_count(bench_input* input)
+{
+    return count_subtree(input->root);
+}
+
+static size_t flat_count(bench_input* input)
+{
+    return flat_count_nodes(input->tree, input->flat_root);
+}
+
+static size_t pointer_depends(bench_input* input)
+{
+    size_t count = 0;
+    depends_subtree(input->root, input->var, &count);
+    return count;
+}
+
+static size_t flat_depends(bench_input* input)
+{
+    flat_find_depends(input->tree, input->flat_root, input->var_id, input->depends);
+
+    /* Tree is a copy of pointer tree, so it has no shared nodes */
+    size_t count = 0;
+    for (uint32_t node = 0; node <= input->flat_root; node++)
+        count += input->depends[node];
+    return count;
+}
+
+static size_t count_subtree(const ast_node* node)
+{
+    if (!node) return 0;
+    return 1 + count_subtree(node->left) + count_subtree(node->right);
+}
+
+/* Precomputed `depends` masks of nodes are not used, so that whole tree is
+   traversed, as in flat tree */
+static int depends_subtree(const ast_node* node, var_name var, size_t* count)
+{
+    if (!node) return 0;
+
+    int left  = depends_subtree(node->left,  var, count);
+    int right = depends_subtree(node->right, var, count);
+
+    int res = var_cmp(node, var) || left || right;
+    *count += (size_t) res;
+    return res;
+}
+
+static int open_cache_counter(void)
+{
+    perf_event_attr attr = {};
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    /* Counter of calling thread on any CPU */
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double now(void)
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}